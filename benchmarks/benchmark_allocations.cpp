@@ -0,0 +1,82 @@
+#include <benchmark/benchmark.h>
+#include "in_process_lb.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+// Heap allocations made by lb2 per proxied request. Global operator new is
+// replaced for the whole benchmark binary, counting is enabled only here.
+
+namespace {
+
+std::atomic<bool> counting{false};
+std::atomic<std::size_t> allocations{0};
+
+} // anonymous namespace
+
+void* operator new(std::size_t size)
+{
+    if (counting.load(std::memory_order_relaxed)) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (void* result = std::malloc(size == 0 ? 1 : size)) {
+        return result;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+namespace asio = boost::asio;
+
+// Args: requests per connection. Connection setup is counted too, so with
+// many requests the counter approaches steady state cost of a request.
+template <const char* algorithm, lb::tcp::SessionEngine engine = lb::tcp::SessionEngine::CALLBACKS>
+static void BenchmarkAllocationsPerRequest(benchmark::State& state)
+{
+    const std::size_t requests = state.range(0);
+    lb::bench::InProcessLb lb(256, algorithm, engine);
+
+    const std::string request = "GET / HTTP/1.1\r\nHost: bench\r\nCookie: a=b\r\nAccept: */*\r\n\r\n";
+    std::string response(lb.ResponseSize(), '\0');
+    asio::io_context client_context;
+    auto run_connection = [&]() {
+        asio::ip::tcp::socket socket(client_context);
+        socket.connect(lb.Endpoint());
+        for (std::size_t i = 0; i < requests; ++i) {
+            asio::write(socket, asio::buffer(request));
+            asio::read(socket, asio::buffer(response));
+        }
+    };
+
+    run_connection(); // warm up pools and caches
+    std::size_t total = 0;
+    for (auto _ : state) {
+        allocations.store(0);
+        counting.store(true);
+        run_connection();
+        counting.store(false);
+        total += allocations.load();
+    }
+    state.counters["allocations_per_request"] = static_cast<double>(total) / (state.iterations() * requests);
+}
+
+static constexpr char kRoundRobin[] = "round_robin";
+static constexpr char kLeastConnections[] = "least_connections";
+
+BENCHMARK_TEMPLATE(BenchmarkAllocationsPerRequest, kRoundRobin)->Arg(1)->Arg(100);
+BENCHMARK_TEMPLATE(BenchmarkAllocationsPerRequest, kLeastConnections)->Arg(1)->Arg(100);
+#ifdef LB_COROUTINE_SESSIONS
+BENCHMARK_TEMPLATE(BenchmarkAllocationsPerRequest, kRoundRobin, lb::tcp::SessionEngine::COROUTINES)->Arg(1)->Arg(100);
+BENCHMARK_TEMPLATE(BenchmarkAllocationsPerRequest, kLeastConnections, lb::tcp::SessionEngine::COROUTINES)->Arg(1)->Arg(100);
+#endif
@@ -0,0 +1,52 @@
+#include <benchmark/benchmark.h>
+#include <lb/tcp/buffer_pool.hpp>
+
+#include "in_process_lb.hpp"
+
+#include <boost/beast/core/read_size.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+// One exchange of a session: message of range(1) bytes is read into one of
+// range(0) buffers in up to 64 KiB pieces, forwarded and the buffer released.
+
+static void ReadMessage(boost::beast::flat_buffer& buffer, std::size_t size)
+{
+    while (buffer.size() < size) {
+        auto space = buffer.prepare(std::min(boost::beast::read_size(buffer, 64 * 1024), size - buffer.size()));
+        std::memset(space.data(), 'x', space.size());
+        buffer.commit(space.size());
+    }
+}
+
+static void ReadMessage(lb::tcp::IoBuffer& buffer, std::size_t size)
+{
+    while (buffer.size() < size) {
+        auto space = lb::tcp::PrepareRead(buffer, size - buffer.size());
+        std::memset(space.data(), 'x', space.size());
+        buffer.commit(space.size());
+    }
+}
+
+template <class Buffer>
+static void BenchmarkBufferExchange(benchmark::State& state)
+{
+    lb::bench::RegisterNullLogger();
+    std::vector<Buffer> buffers(state.range(0));
+    std::size_t next = 0;
+    for (auto _ : state) {
+        Buffer& buffer = buffers[next++ % buffers.size()];
+        ReadMessage(buffer, state.range(1));
+        benchmark::DoNotOptimize(buffer.data().data());
+        buffer.consume(buffer.size());
+        buffer.shrink_to_fit();
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(1));
+}
+
+BENCHMARK_TEMPLATE(BenchmarkBufferExchange, boost::beast::flat_buffer)
+    ->Args({1024, 2 * 1024})->Args({1024, 16 * 1024})->Args({1024, 60 * 1024});
+BENCHMARK_TEMPLATE(BenchmarkBufferExchange, lb::tcp::IoBuffer)
+    ->Args({1024, 2 * 1024})->Args({1024, 16 * 1024})->Args({1024, 60 * 1024});
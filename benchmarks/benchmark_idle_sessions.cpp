@@ -0,0 +1,75 @@
+#include <benchmark/benchmark.h>
+#include "in_process_lb.hpp"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <malloc.h>
+#include <unistd.h>
+
+// Memory held by keep-alive connections left idle after one exchange. RSS
+// does not shrink when memory is freed, so run one case per process for it;
+// heap in use is exact either way.
+
+namespace asio = boost::asio;
+
+namespace {
+
+std::size_t ResidentSetSize()
+{
+    std::size_t pages = 0;
+    std::size_t resident = 0;
+    std::ifstream statm("/proc/self/statm");
+    statm >> pages >> resident;
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+std::size_t HeapInUse()
+{
+    return mallinfo2().uordblks;
+}
+
+} // anonymous namespace
+
+// Args: connections, response body size
+static void BenchmarkIdleSessionMemory(benchmark::State& state)
+{
+    const std::size_t connections = state.range(0);
+    lb::bench::InProcessLb lb(state.range(1));
+
+    const std::string request = "GET / HTTP/1.1\r\nHost: bench\r\n\r\n";
+    std::string response(lb.ResponseSize(), '\0');
+    asio::io_context client_context;
+    auto exchange = [&](asio::ip::tcp::socket& socket) {
+        socket.connect(lb.Endpoint());
+        asio::write(socket, asio::buffer(request));
+        asio::read(socket, asio::buffer(response));
+    };
+
+    for (auto _ : state) {
+        std::vector<asio::ip::tcp::socket> clients;
+        clients.reserve(connections + 1);
+
+        // first exchange warms up allocator and pools
+        exchange(clients.emplace_back(client_context));
+        const std::size_t rss_before = ResidentSetSize();
+        const std::size_t heap_before = HeapInUse();
+        for (std::size_t i = 0; i < connections; ++i) {
+            exchange(clients.emplace_back(client_context));
+        }
+        const std::size_t rss_after = ResidentSetSize();
+        const std::size_t heap_after = HeapInUse();
+
+        state.counters["rss_per_idle_connection"] = static_cast<double>(rss_after - rss_before) / connections;
+        state.counters["heap_per_idle_connection"] = static_cast<double>(heap_after - heap_before) / connections;
+        state.counters["sessions"] = lb::tcp::BasicSession::ActiveSessions();
+    }
+}
+
+BENCHMARK(BenchmarkIdleSessionMemory)
+    ->Args({4000, 256})
+    ->Args({4000, 16 * 1024})
+    ->Args({4000, 60 * 1024})
+    ->Iterations(1)
+    ->Unit(benchmark::kMillisecond);
@@ -0,0 +1,58 @@
+#include <benchmark/benchmark.h>
+#include <lb/tcp/router.hpp>
+
+#include <string>
+#include <vector>
+
+// Thousands of rules: every tenant host has a few api versions and a
+// wildcard host, plus catch-all path prefixes.
+static lb::tcp::RouteMatcher MakeMatcher(std::size_t tenants)
+{
+    lb::tcp::RouteMatcher matcher;
+    std::int32_t value = 0;
+    for (std::size_t i = 0; i < tenants; ++i) {
+        std::string host = "tenant" + std::to_string(i) + ".example.com";
+        for (const char* prefix : {"/", "/api/v1/", "/api/v2/", "/static/"}) {
+            matcher.Add(host, prefix, value++);
+        }
+        matcher.Add("*.tenant" + std::to_string(i) + ".example.org", "/", value++);
+    }
+    for (std::size_t i = 0; i < tenants; ++i) {
+        matcher.Add("", "/shared/" + std::to_string(i) + "/", value++);
+    }
+    matcher.Compile();
+    return matcher;
+}
+
+static void BenchmarkRouteExactHost(benchmark::State& state)
+{
+    lb::tcp::RouteMatcher matcher = MakeMatcher(state.range(0));
+    std::string host = "Tenant" + std::to_string(state.range(0) / 2) + ".example.com:8080";
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(matcher.Match(host, "/api/v2/users/42/orders?limit=10"));
+    }
+}
+
+BENCHMARK(BenchmarkRouteExactHost)->Arg(10)->Arg(1000)->Arg(10000);
+
+static void BenchmarkRouteWildcardHost(benchmark::State& state)
+{
+    lb::tcp::RouteMatcher matcher = MakeMatcher(state.range(0));
+    std::string host = "eu.cdn.tenant" + std::to_string(state.range(0) / 2) + ".example.org";
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(matcher.Match(host, "/index.html"));
+    }
+}
+
+BENCHMARK(BenchmarkRouteWildcardHost)->Arg(10)->Arg(1000)->Arg(10000);
+
+static void BenchmarkRouteAnyHost(benchmark::State& state)
+{
+    lb::tcp::RouteMatcher matcher = MakeMatcher(state.range(0));
+    std::string path = "/shared/" + std::to_string(state.range(0) / 2) + "/file.txt";
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(matcher.Match("unknown.example.net", path));
+    }
+}
+
+BENCHMARK(BenchmarkRouteAnyHost)->Arg(10)->Arg(1000)->Arg(10000);
@@ -0,0 +1,139 @@
+#include <benchmark/benchmark.h>
+#include <lb/metrics.hpp>
+#include <lb/tcp/tls.hpp>
+
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <thread>
+
+// Handshakes per second of the TLS terminator against a blocking local
+// client, full ones and ones resuming the client's first session. Where the
+// kernel has no kTLS the connections are relayed in userspace, which does not
+// change what is measured.
+
+namespace asio = boost::asio;
+namespace fs = std::filesystem;
+
+namespace {
+
+// Self-signed P-256 certificate for localhost, written to the temporary directory
+lb::tcp::TlsTerminator::Configuration TestConfig()
+{
+    lb::tcp::TlsTerminator::Configuration config;
+    config.certificate = fs::temp_directory_path() / "lb2_bench_tls_cert.pem";
+    config.private_key = fs::temp_directory_path() / "lb2_bench_tls_key.pem";
+
+    EVP_PKEY* key = EVP_EC_gen("P-256");
+    X509* cert = X509_new();
+    X509_set_version(cert, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 24 * 3600);
+    X509_set_pubkey(cert, key);
+    X509_NAME* name = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>("localhost"), -1, -1, 0);
+    X509_set_issuer_name(cert, name);
+    X509_sign(cert, key, EVP_sha256());
+
+    FILE* file = std::fopen(config.certificate.c_str(), "w");
+    PEM_write_X509(file, cert);
+    std::fclose(file);
+    file = std::fopen(config.private_key.c_str(), "w");
+    PEM_write_PrivateKey(file, key, nullptr, nullptr, 0, nullptr, nullptr);
+    std::fclose(file);
+    X509_free(cert);
+    EVP_PKEY_free(key);
+    return config;
+}
+
+// Terminator handshaking every accepted connection on a background thread
+class TlsServer {
+public:
+    TlsServer()
+        : terminator_(TestConfig())
+        , acceptor_(asio::make_strand(ioc_), {asio::ip::address_v4::loopback(), 0})
+        , work_(asio::make_work_guard(ioc_))
+    {
+        Accept();
+        thread_ = std::thread([this] { ioc_.run(); });
+    }
+
+    ~TlsServer()
+    {
+        ioc_.stop();
+        thread_.join();
+    }
+
+    asio::ip::tcp::endpoint Endpoint() const
+    {
+        return acceptor_.local_endpoint();
+    }
+private:
+    void Accept()
+    {
+        acceptor_.async_accept(asio::make_strand(ioc_), [this](const boost::system::error_code& ec,
+                                                               lb::tcp::SocketType socket) {
+            if (ec) {
+                return;
+            }
+            terminator_.AsyncHandshake(std::move(socket), [](const boost::system::error_code&, lb::tcp::SocketType) {});
+            Accept();
+        });
+    }
+private:
+    lb::tcp::TlsTerminator terminator_;
+    asio::io_context ioc_;
+    asio::basic_socket_acceptor<asio::ip::tcp, lb::tcp::ExecutorType> acceptor_;
+    asio::executor_work_guard<asio::io_context::executor_type> work_;
+    std::thread thread_;
+};
+
+} // anonymous namespace
+
+// Arg: 1 - resume the first session
+static void BenchmarkTlsHandshake(benchmark::State& state)
+{
+    const bool resume = state.range(0) != 0;
+    TlsServer server;
+    auto& handshakes = lb::metrics::Registry::Instance().GetCounter("tls.handshakes");
+    auto& resumed = lb::metrics::Registry::Instance().GetCounter("tls.resumed");
+
+    asio::io_context ioc;
+    asio::ssl::context client(asio::ssl::context::tls_client);
+    SSL_SESSION* session = nullptr;
+    const std::uint64_t handshakes_before = handshakes.Value();
+    const std::uint64_t resumed_before = resumed.Value();
+    for (auto _ : state) {
+        asio::ssl::stream<asio::ip::tcp::socket> stream(ioc, client);
+        stream.next_layer().connect(server.Endpoint());
+        stream.next_layer().set_option(asio::ip::tcp::no_delay(true));
+        if (session) {
+            SSL_set_session(stream.native_handle(), session);
+        }
+        stream.handshake(asio::ssl::stream_base::client);
+        if (resume && !session) {
+            session = SSL_get1_session(stream.native_handle());
+        }
+        SSL_set_shutdown(stream.native_handle(), SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+    }
+    SSL_SESSION_free(session);
+
+    // server counts a handshake after the client's one completed
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    const std::uint64_t done = handshakes.Value() - handshakes_before;
+    state.counters["handshakes_per_second"] = benchmark::Counter(state.iterations(), benchmark::Counter::kIsRate);
+    state.counters["resumption_ratio"] = done == 0 ? 0.0 : static_cast<double>(resumed.Value() - resumed_before) / done;
+}
+
+BENCHMARK(BenchmarkTlsHandshake)
+    ->Arg(0)
+    ->Arg(1)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
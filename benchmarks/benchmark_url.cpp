@@ -0,0 +1,81 @@
+#include <benchmark/benchmark.h>
+#include <lb/tcp/selectors.hpp>
+#include <lb/url.hpp>
+
+#include <string>
+#include <variant>
+#include <vector>
+
+// Previous representation of lb::Url: every component in its own string
+struct LegacyUrl {
+    static constexpr auto url_pattern = ctll::fixed_string{"((\\w+):\\/\\/)?([^/\\s:]+)(:(\\d{2,5}))?([^?\\s#]*)([?]([^\\s#]*))?([#]([^\\s]*))?"};
+    static constexpr auto MatchUrl = ctre::match<url_pattern>;
+
+    explicit LegacyUrl(const std::string& string)
+        : whole_url(string)
+    {
+        auto match_results = MatchUrl(string);
+        protocol = !match_results.get<2>().to_string().empty() ? match_results.get<2>().to_string() : "http";
+        hostname = match_results.get<3>().to_string();
+        port = !match_results.get<5>().to_string().empty() ? match_results.get<5>().to_string() : "443";
+        path = match_results.get<6>().to_string();
+        query = match_results.get<8>().to_string();
+        fragment = match_results.get<10>().to_string();
+    }
+
+    std::string whole_url;
+    std::string protocol;
+    std::string hostname;
+    std::string port;
+    std::string path;
+    std::string query;
+    std::string fragment;
+};
+
+using LegacyBackend = std::variant<boost::asio::ip::tcp::endpoint, LegacyUrl>;
+
+static const std::string kUrl = "https://backend-pool-17.internal.example.com:8443/api/v1/upstream?region=eu-west#primary";
+
+static void BenchmarkLegacyUrlParse(benchmark::State& state)
+{
+    for (auto _ : state) {
+        LegacyUrl url(kUrl);
+        benchmark::DoNotOptimize(url);
+    }
+}
+
+BENCHMARK(BenchmarkLegacyUrlParse);
+
+static void BenchmarkUrlParse(benchmark::State& state)
+{
+    for (auto _ : state) {
+        lb::Url url(kUrl);
+        benchmark::DoNotOptimize(url);
+    }
+}
+
+BENCHMARK(BenchmarkUrlParse);
+
+static void BenchmarkLegacyBackendCopy(benchmark::State& state)
+{
+    std::vector<LegacyBackend> backends(16, LegacyBackend(LegacyUrl(kUrl)));
+    std::size_t i = 0;
+    for (auto _ : state) {
+        LegacyBackend copy = backends[i++ % backends.size()];
+        benchmark::DoNotOptimize(copy);
+    }
+}
+
+BENCHMARK(BenchmarkLegacyBackendCopy);
+
+static void BenchmarkBackendCopy(benchmark::State& state)
+{
+    std::vector<lb::tcp::Backend> backends(16, lb::tcp::Backend(kUrl));
+    std::size_t i = 0;
+    for (auto _ : state) {
+        lb::tcp::Backend copy = backends[i++ % backends.size()];
+        benchmark::DoNotOptimize(copy);
+    }
+}
+
+BENCHMARK(BenchmarkBackendCopy);
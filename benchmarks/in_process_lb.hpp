@@ -0,0 +1,145 @@
+#pragma once
+
+#include <lb/tcp/acceptor.hpp>
+#include <lb/tcp/connector.hpp>
+#include <lb/tcp/router.hpp>
+
+#include <boost/asio.hpp>
+#include <boost/thread.hpp>
+#include <spdlog/sinks/null_sink.h>
+#include <spdlog/spdlog.h>
+#include <yaml-cpp/yaml.h>
+
+#include <memory>
+#include <string>
+
+// lb2 with one keep-alive backend running in-process on a background thread,
+// for benchmarks driving it with blocking client sockets.
+
+namespace lb::bench {
+
+namespace asio = boost::asio;
+
+inline void RegisterNullLogger()
+{
+    if (!spdlog::get("multi-sink")) {
+        spdlog::register_logger(std::make_shared<spdlog::logger>(
+            "multi-sink", std::make_shared<spdlog::sinks::null_sink_mt>()));
+    }
+}
+
+// Keep-alive backend answering every request with the same response. It has
+// no per-connection buffers, so measured memory belongs to lb2 sessions.
+class StaticBackend {
+public:
+    StaticBackend(asio::io_context& ioc, std::size_t body_size)
+        : acceptor_(ioc, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0))
+        , response_("HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(body_size) + "\r\n\r\n"
+                    + std::string(body_size, 'x'))
+    {
+        Accept();
+    }
+
+    unsigned short Port() const
+    {
+        return acceptor_.local_endpoint().port();
+    }
+
+    std::size_t ResponseSize() const
+    {
+        return response_.size();
+    }
+private:
+    using SocketPtr = std::shared_ptr<asio::ip::tcp::socket>;
+
+    void Accept()
+    {
+        acceptor_.async_accept([this](boost::system::error_code ec, asio::ip::tcp::socket socket) {
+            if (ec) {
+                return;
+            }
+            Serve(std::make_shared<asio::ip::tcp::socket>(std::move(socket)));
+            Accept();
+        });
+    }
+
+    void Serve(SocketPtr socket)
+    {
+        socket->async_wait(asio::ip::tcp::socket::wait_read, [this, socket](boost::system::error_code ec) {
+            if (ec) {
+                return;
+            }
+            // requests are small and arrive in one segment
+            std::size_t length = socket->read_some(asio::buffer(scratch_), ec);
+            if (ec || length == 0) {
+                return;
+            }
+            asio::async_write(*socket, asio::buffer(response_), [this, socket](boost::system::error_code ec, std::size_t) {
+                if (!ec) {
+                    Serve(socket);
+                }
+            });
+        });
+    }
+private:
+    asio::ip::tcp::acceptor acceptor_;
+    const std::string response_;
+    char scratch_[4096];
+};
+
+class InProcessLb {
+public:
+    explicit InProcessLb(std::size_t body_size,
+                         const std::string& algorithm = "round_robin",
+                         tcp::SessionEngine engine = tcp::SessionEngine::CALLBACKS)
+        : work_(asio::make_work_guard(ioc_))
+        , backend_(ioc_, body_size)
+        , connector_(ioc_, MakeRouter(algorithm), nullptr, nullptr, engine)
+        , acceptor_(ioc_, connector_, 0)
+    {
+        acceptor_.Run();
+        thread_ = boost::thread([this]() { ioc_.run(); });
+    }
+
+    ~InProcessLb()
+    {
+        acceptor_.Stop();
+        work_.reset();
+        ioc_.stop();
+        thread_.join();
+    }
+
+    asio::ip::tcp::endpoint Endpoint() const
+    {
+        return acceptor_.LocalEndpoint();
+    }
+
+    std::size_t ResponseSize() const
+    {
+        return backend_.ResponseSize();
+    }
+private:
+    tcp::RouterPtr MakeRouter(const std::string& algorithm)
+    {
+        RegisterNullLogger();
+        YAML::Node config;
+        config["load_balancing"]["algorithm"] = algorithm;
+        YAML::Node endpoint;
+        endpoint["ip"] = "127.0.0.1";
+        endpoint["port"] = backend_.Port();
+        config["load_balancing"]["endpoints"].push_back(endpoint);
+        return std::make_shared<tcp::Router>(tcp::Pool{
+            .name = "default",
+            .selector = tcp::DetectSelector(config),
+        });
+    }
+private:
+    asio::io_context ioc_;
+    asio::executor_work_guard<asio::io_context::executor_type> work_;
+    StaticBackend backend_;
+    tcp::Connector connector_;
+    tcp::Acceptor acceptor_;
+    boost::thread thread_;
+};
+
+} // namespace lb::bench
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace lb::bench {
+
+// Stores raw latency samples. Percentiles are exact, which is affordable for
+// the amount of requests a single benchmark run produces.
+class LatencyRecorder {
+public:
+    using Duration = std::chrono::nanoseconds;
+public:
+    void Reserve(std::size_t n)
+    {
+        samples_.reserve(n);
+    }
+
+    void Record(Duration latency)
+    {
+        samples_.push_back(latency.count());
+    }
+
+    void Merge(const LatencyRecorder& other)
+    {
+        samples_.insert(samples_.end(), other.samples_.begin(), other.samples_.end());
+    }
+
+    std::size_t Count() const
+    {
+        return samples_.size();
+    }
+
+    // percentile in [0, 100]
+    Duration Percentile(double percentile)
+    {
+        if (samples_.empty()) {
+            return Duration::zero();
+        }
+        std::size_t rank = static_cast<std::size_t>(percentile / 100.0 * (samples_.size() - 1) + 0.5);
+        std::nth_element(samples_.begin(), samples_.begin() + rank, samples_.end());
+        return Duration(samples_[rank]);
+    }
+
+    Duration Max() const
+    {
+        if (samples_.empty()) {
+            return Duration::zero();
+        }
+        return Duration(*std::max_element(samples_.begin(), samples_.end()));
+    }
+
+private:
+    std::vector<std::int64_t> samples_;
+};
+
+} // namespace lb::bench
@@ -0,0 +1,215 @@
+#include "load_generator.hpp"
+
+#include <boost/beast.hpp>
+
+namespace asio = boost::asio;
+namespace beast = boost::beast;
+namespace http = boost::beast::http;
+
+namespace lb::bench {
+
+class LoadGenerator::Connection : public std::enable_shared_from_this<Connection> {
+public:
+    Connection(LoadGenerator& owner)
+        : owner_(owner)
+        , stream_(owner.ioc_)
+    {}
+
+    void Connect()
+    {
+        stream_.async_connect(owner_.config_.target,
+            [self=shared_from_this()](beast::error_code ec) {
+                if (ec) {
+                    self->Fail();
+                    return;
+                }
+                self->stream_.socket().set_option(asio::ip::tcp::no_delay(true));
+                self->connected_ = true;
+                self->owner_.connecting_--;
+                self->owner_.idle_.push_back(self.get());
+                self->owner_.Dispatch();
+            });
+    }
+
+    void Send(Clock::time_point intended)
+    {
+        intended_ = intended;
+        busy_ = true;
+        asio::async_write(stream_, asio::buffer(owner_.request_),
+            [self=shared_from_this()](beast::error_code ec, std::size_t) {
+                if (ec) {
+                    self->Fail();
+                    return;
+                }
+                self->Receive();
+            });
+    }
+
+    bool Connected() const
+    {
+        return connected_;
+    }
+
+    void Close()
+    {
+        beast::error_code ec;
+        stream_.socket().close(ec);
+    }
+
+private:
+    void Receive()
+    {
+        parser_.emplace();
+        parser_->body_limit(boost::none);
+        http::async_read(stream_, buffer_, *parser_,
+            [self=shared_from_this()](beast::error_code ec, std::size_t) {
+                if (ec) {
+                    self->Fail();
+                    return;
+                }
+                self->busy_ = false;
+                self->owner_.OnComplete(self.get(), self->intended_, true);
+            });
+    }
+
+    void Fail()
+    {
+        if (!connected_) {
+            owner_.connecting_--;
+        }
+        bool was_busy = busy_;
+        busy_ = false;
+        connected_ = false;
+        Close();
+        owner_.OnComplete(this, intended_, !was_busy);
+    }
+
+private:
+    LoadGenerator& owner_;
+    beast::tcp_stream stream_;
+    beast::flat_buffer buffer_;
+    boost::optional<http::response_parser<http::string_body>> parser_;
+    Clock::time_point intended_;
+    bool connected_ = false;
+    bool busy_ = false;
+};
+
+LoadGenerator::LoadGenerator(asio::io_context& ioc, const Configuration& config)
+    : ioc_(ioc)
+    , config_(config)
+    , ticker_(ioc)
+    , interval_(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / config.rate)))
+{
+    request_ = "GET " + config_.path + " HTTP/1.1\r\n"
+               "Host: " + config_.target.address().to_string() + "\r\n"
+               "\r\n";
+    total_ = static_cast<std::size_t>(config_.rate * std::chrono::duration<double>(config_.duration).count());
+    report_.latencies.Reserve(total_);
+}
+
+LoadGenerator::~LoadGenerator()
+{
+    for (auto& connection : connections_) {
+        connection->Close();
+    }
+}
+
+void LoadGenerator::Start()
+{
+    start_ = Clock::now();
+    Tick();
+}
+
+LoadGenerator::Report& LoadGenerator::GetReport()
+{
+    return report_;
+}
+
+void LoadGenerator::Tick()
+{
+    Clock::time_point now = Clock::now();
+    while (issued_ < total_ && start_ + issued_ * interval_ <= now) {
+        pending_.push_back(start_ + issued_ * interval_);
+        ++issued_;
+    }
+    report_.scheduled = issued_;
+    Dispatch();
+
+    if (issued_ < total_) {
+        ticker_.expires_at(start_ + issued_ * interval_);
+        ticker_.async_wait([this](const boost::system::error_code& ec) {
+            if (!ec) {
+                Tick();
+            }
+        });
+        return;
+    }
+
+    // Every request is scheduled, wait for stragglers
+    ticker_.expires_after(config_.drain_timeout);
+    ticker_.async_wait([this](const boost::system::error_code& ec) {
+        if (!ec) {
+            Finish();
+        }
+    });
+}
+
+void LoadGenerator::Dispatch()
+{
+    while (!pending_.empty() && !idle_.empty()) {
+        Connection* connection = idle_.back();
+        idle_.pop_back();
+        connection->Send(pending_.front());
+        pending_.pop_front();
+    }
+
+    while (pending_.size() > connecting_ && connections_.size() < config_.max_connections) {
+        auto connection = std::make_shared<Connection>(*this);
+        connections_.push_back(connection);
+        ++connecting_;
+        connection->Connect();
+    }
+}
+
+void LoadGenerator::OnComplete(Connection* connection, Clock::time_point intended, bool ok)
+{
+    if (finished_) {
+        return;
+    }
+
+    if (ok && connection->Connected()) {
+        report_.latencies.Record(Clock::now() - intended);
+        ++report_.completed;
+        idle_.push_back(connection);
+    } else {
+        if (!ok) {
+            ++report_.errors;
+        }
+        idle_.erase(std::remove(idle_.begin(), idle_.end(), connection), idle_.end());
+        connections_.erase(
+            std::remove_if(connections_.begin(), connections_.end(),
+                           [connection](const auto& ptr) { return ptr.get() == connection; }),
+            connections_.end());
+    }
+
+    Dispatch();
+    if (issued_ == total_ && report_.completed + report_.errors == total_) {
+        Finish();
+    }
+}
+
+void LoadGenerator::Finish()
+{
+    if (finished_) {
+        return;
+    }
+    finished_ = true;
+    report_.elapsed = Clock::now() - start_;
+    report_.unfinished = total_ - report_.completed - report_.errors;
+    ticker_.cancel();
+    for (auto& connection : connections_) {
+        connection->Close();
+    }
+}
+
+} // namespace lb::bench
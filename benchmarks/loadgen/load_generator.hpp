@@ -0,0 +1,82 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include "latency_recorder.hpp"
+
+namespace lb::bench {
+
+// Open-loop HTTP load generator.
+//
+// Requests are scheduled at fixed intended send times (start + i / rate),
+// independently of how fast responses come back. Latency is measured from
+// the intended send time, so time a request spends queued behind a slow
+// response is accounted for (no coordinated omission).
+class LoadGenerator {
+public:
+    using EndpointType = boost::asio::ip::tcp::endpoint;
+    using Clock = std::chrono::steady_clock;
+
+    struct Configuration {
+        EndpointType target;
+        double rate = 1000.0;  // requests per second
+        std::chrono::milliseconds duration{10000};
+        std::chrono::milliseconds drain_timeout{5000};
+        std::size_t max_connections = 256;
+        std::string path = "/";
+    };
+
+    struct Report {
+        std::size_t scheduled = 0;
+        std::size_t completed = 0;
+        std::size_t errors = 0;
+        std::size_t unfinished = 0;
+        Clock::duration elapsed{};
+        LatencyRecorder latencies;
+    };
+public:
+    LoadGenerator(boost::asio::io_context& ioc, const Configuration& config);
+
+    LoadGenerator(const LoadGenerator&) = delete;
+    LoadGenerator& operator=(const LoadGenerator&) = delete;
+    ~LoadGenerator();
+
+    // Must be called from the thread running ioc; completes when every
+    // scheduled request finished or the drain timeout expired.
+    void Start();
+
+    Report& GetReport();
+
+private:
+    class Connection;
+    friend class Connection;
+
+    void Tick();
+    void Dispatch();
+    void OnComplete(Connection* connection, Clock::time_point intended, bool ok);
+    void Finish();
+
+private:
+    boost::asio::io_context& ioc_;
+    Configuration config_;
+    std::string request_;
+    boost::asio::steady_timer ticker_;
+    Clock::time_point start_;
+    Clock::duration interval_;
+    std::size_t total_ = 0;
+    std::size_t issued_ = 0;
+    std::size_t connecting_ = 0;
+    bool finished_ = false;
+    std::deque<Clock::time_point> pending_;
+    std::vector<std::shared_ptr<Connection>> connections_;
+    std::vector<Connection*> idle_;
+    Report report_;
+};
+
+} // namespace lb::bench
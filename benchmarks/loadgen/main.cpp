@@ -0,0 +1,268 @@
+// End-to-end load test of lb2.
+//
+// Spawns in-process mock backends, starts lb2 components (Connector and
+// Acceptor) in-process for every requested selector and drives them with an
+// open-loop HTTP load generator. Everything runs on localhost.
+
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/program_options.hpp>
+#include <boost/thread.hpp>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <yaml-cpp/yaml.h>
+
+#include <lb/tcp/acceptor.hpp>
+#include <lb/tcp/connector.hpp>
+#include <lb/tcp/selectors.hpp>
+
+#include "load_generator.hpp"
+#include "mock_backend.hpp"
+
+namespace asio = boost::asio;
+namespace opt = boost::program_options;
+
+namespace {
+
+struct Options {
+    std::size_t backends = 4;
+    std::size_t backend_threads = 1;
+    std::string backend_latency = "exponential:200";
+    std::size_t response_size = 1024;
+    std::size_t lb_threads = 2;
+    std::size_t loadgen_threads = 1;
+    double rate = 10000;
+    std::size_t duration_ms = 10000;
+    std::size_t max_connections = 256;
+    std::vector<std::string> algorithms;
+    lb::tcp::SessionEngine engine = lb::tcp::SessionEngine::CALLBACKS;
+};
+
+class ThreadedContext {
+public:
+    explicit ThreadedContext(std::size_t threads)
+        : work_(asio::make_work_guard(ioc_))
+    {
+        for (std::size_t i = 0; i < threads; ++i) {
+            threads_.create_thread([this]() { ioc_.run(); });
+        }
+    }
+
+    ~ThreadedContext()
+    {
+        Stop();
+    }
+
+    asio::io_context& Context()
+    {
+        return ioc_;
+    }
+
+    void Stop()
+    {
+        work_.reset();
+        ioc_.stop();
+        threads_.join_all();
+    }
+
+private:
+    asio::io_context ioc_;
+    asio::executor_work_guard<asio::io_context::executor_type> work_;
+    boost::thread_group threads_;
+};
+
+YAML::Node MakeBalancingConfig(const std::string& algorithm,
+                               const std::vector<std::unique_ptr<lb::bench::MockBackend>>& backends)
+{
+    YAML::Node balancing;
+    balancing["algorithm"] = algorithm;
+    if (algorithm == "consistent_hash") {
+        balancing["replicas"] = 5;
+    }
+    for (std::size_t i = 0; i < backends.size(); ++i) {
+        YAML::Node ep;
+        ep["ip"] = backends[i]->Endpoint().address().to_string();
+        ep["port"] = backends[i]->Endpoint().port();
+        if (algorithm == "weighted_round_robin") {
+            ep["weight"] = i + 1;
+        }
+        balancing["endpoints"].push_back(ep);
+    }
+
+    YAML::Node config;
+    config["load_balancing"] = balancing;
+    return config;
+}
+
+lb::bench::LoadGenerator::Report RunLoad(const Options& options, const asio::ip::tcp::endpoint& target)
+{
+    std::vector<std::unique_ptr<asio::io_context>> contexts;
+    std::vector<std::unique_ptr<lb::bench::LoadGenerator>> generators;
+    for (std::size_t i = 0; i < options.loadgen_threads; ++i) {
+        lb::bench::LoadGenerator::Configuration config;
+        config.target = target;
+        config.rate = options.rate / options.loadgen_threads;
+        config.duration = std::chrono::milliseconds(options.duration_ms);
+        config.max_connections = std::max<std::size_t>(1, options.max_connections / options.loadgen_threads);
+
+        contexts.push_back(std::make_unique<asio::io_context>());
+        generators.push_back(std::make_unique<lb::bench::LoadGenerator>(*contexts.back(), config));
+    }
+
+    boost::thread_group threads;
+    for (std::size_t i = 0; i < options.loadgen_threads; ++i) {
+        threads.create_thread([&, i]() {
+            generators[i]->Start();
+            contexts[i]->run();
+        });
+    }
+    threads.join_all();
+
+    lb::bench::LoadGenerator::Report total;
+    for (auto& generator : generators) {
+        auto& report = generator->GetReport();
+        total.scheduled += report.scheduled;
+        total.completed += report.completed;
+        total.errors += report.errors;
+        total.unfinished += report.unfinished;
+        total.elapsed = std::max(total.elapsed, report.elapsed);
+        total.latencies.Merge(report.latencies);
+    }
+    return total;
+}
+
+void PrintHeader()
+{
+    std::cout << std::left
+              << std::setw(22) << "algorithm"
+              << std::right
+              << std::setw(12) << "rps"
+              << std::setw(12) << "p50(us)"
+              << std::setw(12) << "p99(us)"
+              << std::setw(12) << "p99.9(us)"
+              << std::setw(12) << "max(us)"
+              << std::setw(10) << "errors"
+              << std::setw(12) << "unfinished"
+              << std::endl;
+}
+
+void PrintRow(const std::string& algorithm, lb::bench::LoadGenerator::Report& report)
+{
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+
+    double seconds = std::chrono::duration<double>(report.elapsed).count();
+    double rps = seconds > 0 ? report.completed / seconds : 0.0;
+    auto& lat = report.latencies;
+
+    std::cout << std::left
+              << std::setw(22) << algorithm
+              << std::right << std::fixed << std::setprecision(0)
+              << std::setw(12) << rps
+              << std::setw(12) << duration_cast<microseconds>(lat.Percentile(50)).count()
+              << std::setw(12) << duration_cast<microseconds>(lat.Percentile(99)).count()
+              << std::setw(12) << duration_cast<microseconds>(lat.Percentile(99.9)).count()
+              << std::setw(12) << duration_cast<microseconds>(lat.Max()).count()
+              << std::setw(10) << report.errors
+              << std::setw(12) << report.unfinished
+              << std::endl;
+}
+
+void ConfigureLogger(const std::string& level)
+{
+    auto sink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
+    auto logger = std::make_shared<spdlog::logger>("multi-sink", sink);
+    logger->set_level(spdlog::level::from_str(level));
+    spdlog::register_logger(logger);
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+    Options options;
+    std::string algorithms = "round_robin,weighted_round_robin,ip_hash,consistent_hash,least_connections,least_response_time";
+    std::string log_level = "warning";
+    std::string engine = "callbacks";
+
+    opt::options_description desc("Allowed options");
+    // .clang-format off
+    desc.add_options()
+        ("help", "show help message")
+        ("algorithms", opt::value(&algorithms)->default_value(algorithms), "comma separated selectors to benchmark")
+        ("backends", opt::value(&options.backends)->default_value(options.backends), "number of mock backends")
+        ("backend-threads", opt::value(&options.backend_threads)->default_value(options.backend_threads), "threads serving mock backends")
+        ("backend-latency", opt::value(&options.backend_latency)->default_value(options.backend_latency),
+         "backend latency distribution in us: constant:X, uniform:A:B, exponential:MEAN, lognormal:MEDIAN:SIGMA")
+        ("response-size", opt::value(&options.response_size)->default_value(options.response_size), "response body size in bytes")
+        ("lb-threads", opt::value(&options.lb_threads)->default_value(options.lb_threads), "lb2 worker threads")
+        ("loadgen-threads", opt::value(&options.loadgen_threads)->default_value(options.loadgen_threads), "load generator threads")
+        ("rate", opt::value(&options.rate)->default_value(options.rate), "offered load, requests per second")
+        ("duration-ms", opt::value(&options.duration_ms)->default_value(options.duration_ms), "duration of every run")
+        ("connections", opt::value(&options.max_connections)->default_value(options.max_connections), "max client connections")
+        ("log-level", opt::value(&log_level)->default_value(log_level), "lb2 log level")
+        ("engine", opt::value(&engine)->default_value(engine), "lb2 session engine: callbacks or coroutines")
+    ;
+    // .clang-format on
+
+    opt::variables_map parsed_options;
+    opt::store(opt::parse_command_line(argc, argv, desc), parsed_options);
+    opt::notify(parsed_options);
+
+    if (parsed_options.count("help")) {
+        std::cout << desc << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    boost::split(options.algorithms, algorithms, boost::is_any_of(","), boost::token_compress_on);
+    ConfigureLogger(log_level);
+    options.engine = lb::tcp::ConfigureSessionEngine(YAML::Load("sessions: {engine: " + engine + "}"));
+
+    lb::bench::MockBackend::Configuration backend_config;
+    backend_config.latency = lb::bench::LatencyDistribution::Parse(options.backend_latency);
+    backend_config.response_size = options.response_size;
+
+    ThreadedContext backends_context(options.backend_threads);
+    std::vector<std::unique_ptr<lb::bench::MockBackend>> backends;
+    for (std::size_t i = 0; i < options.backends; ++i) {
+        backends.push_back(std::make_unique<lb::bench::MockBackend>(backends_context.Context(), backend_config));
+        backends.back()->Run();
+    }
+
+    std::cout << "backends: " << options.backends
+              << ", latency: " << options.backend_latency
+              << ", response size: " << options.response_size
+              << ", rate: " << options.rate << " rps"
+              << ", duration: " << options.duration_ms << " ms"
+              << ", engine: " << engine
+              << std::endl;
+    PrintHeader();
+
+    for (const std::string& algorithm : options.algorithms) {
+        lb::bench::LoadGenerator::Report report;
+        {
+            ThreadedContext lb_context(options.lb_threads);
+            lb::tcp::SelectorPtr selector = lb::tcp::DetectSelector(MakeBalancingConfig(algorithm, backends));
+            auto router = std::make_shared<lb::tcp::Router>(lb::tcp::Pool{.name = "default", .selector = selector});
+            lb::tcp::Connector connector(lb_context.Context(), router, nullptr, nullptr, options.engine);
+            lb::tcp::Acceptor acceptor(lb_context.Context(), connector, 0);
+            acceptor.Run();
+
+            asio::ip::tcp::endpoint target(asio::ip::address_v4::loopback(), acceptor.LocalEndpoint().port());
+            report = RunLoad(options, target);
+
+            acceptor.Stop();
+            lb_context.Stop();
+        }
+        PrintRow(algorithm, report);
+    }
+
+    for (auto& backend : backends) {
+        backend->Stop();
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,195 @@
+#include "mock_backend.hpp"
+
+#include <boost/beast.hpp>
+#include <boost/algorithm/string.hpp>
+
+#include <cmath>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+namespace asio = boost::asio;
+namespace beast = boost::beast;
+namespace http = boost::beast::http;
+
+namespace lb::bench {
+
+namespace {
+
+std::string MakeResponse(std::size_t body_size)
+{
+    std::string response = "HTTP/1.1 200 OK\r\n"
+                           "Content-Type: text/plain\r\n"
+                           "Content-Length: " + std::to_string(body_size) + "\r\n"
+                           "\r\n";
+    response.append(body_size, 'x');
+    return response;
+}
+
+class MockSession : public std::enable_shared_from_this<MockSession> {
+public:
+    MockSession(asio::ip::tcp::socket socket,
+                const LatencyDistribution& latency,
+                std::shared_ptr<const std::string> response,
+                std::shared_ptr<std::atomic<std::size_t>> served)
+        : stream_(std::move(socket))
+        , timer_(stream_.get_executor())
+        , latency_(latency)
+        , response_(std::move(response))
+        , served_(std::move(served))
+        , gen_(std::random_device{}())
+    {}
+
+    void Run()
+    {
+        stream_.socket().set_option(asio::ip::tcp::no_delay(true));
+        Read();
+    }
+
+private:
+    void Read()
+    {
+        request_ = {};
+        http::async_read(stream_, buffer_, request_,
+            [self=shared_from_this()](beast::error_code ec, std::size_t) {
+                if (ec) {
+                    return;
+                }
+                self->Delay();
+            });
+    }
+
+    void Delay()
+    {
+        auto delay = latency_.Sample(gen_);
+        if (delay.count() == 0) {
+            Respond();
+            return;
+        }
+        timer_.expires_after(delay);
+        timer_.async_wait([self=shared_from_this()](beast::error_code ec) {
+            if (ec) {
+                return;
+            }
+            self->Respond();
+        });
+    }
+
+    void Respond()
+    {
+        asio::async_write(stream_, asio::buffer(*response_),
+            [self=shared_from_this()](beast::error_code ec, std::size_t) {
+                if (ec) {
+                    return;
+                }
+                self->served_->fetch_add(1, std::memory_order_relaxed);
+                self->Read();
+            });
+    }
+
+private:
+    beast::tcp_stream stream_;
+    asio::steady_timer timer_;
+    beast::flat_buffer buffer_;
+    http::request<http::string_body> request_;
+    const LatencyDistribution& latency_;
+    std::shared_ptr<const std::string> response_;
+    std::shared_ptr<std::atomic<std::size_t>> served_;
+    std::mt19937_64 gen_;
+};
+
+} // anonymous namespace
+
+LatencyDistribution LatencyDistribution::Parse(const std::string& spec)
+{
+    std::vector<std::string> parts;
+    boost::split(parts, spec, boost::is_any_of(":"));
+
+    static const std::unordered_map<std::string, std::pair<Kind, std::size_t>> kinds = {
+        {"constant", {Kind::CONSTANT, 1}},
+        {"uniform", {Kind::UNIFORM, 2}},
+        {"exponential", {Kind::EXPONENTIAL, 1}},
+        {"lognormal", {Kind::LOGNORMAL, 2}},
+    };
+
+    auto it = kinds.find(parts.front());
+    if (it == kinds.end()) {
+        throw std::invalid_argument("Unknown latency distribution: " + spec);
+    }
+
+    const auto& [kind, params] = it->second;
+    if (parts.size() != params + 1) {
+        throw std::invalid_argument("Invalid number of parameters in latency distribution: " + spec);
+    }
+
+    LatencyDistribution result;
+    result.kind = kind;
+    result.first = std::stod(parts[1]);
+    if (params > 1) {
+        result.second = std::stod(parts[2]);
+    }
+    return result;
+}
+
+std::chrono::microseconds LatencyDistribution::Sample(std::mt19937_64& gen) const
+{
+    double value = 0.0;
+    switch (kind) {
+    case Kind::CONSTANT:
+        value = first;
+        break;
+    case Kind::UNIFORM:
+        value = std::uniform_real_distribution<double>(first, second)(gen);
+        break;
+    case Kind::EXPONENTIAL:
+        value = first > 0 ? std::exponential_distribution<double>(1.0 / first)(gen) : 0.0;
+        break;
+    case Kind::LOGNORMAL:
+        value = first > 0 ? std::lognormal_distribution<double>(std::log(first), second)(gen) : 0.0;
+        break;
+    }
+    return std::chrono::microseconds(static_cast<long>(value));
+}
+
+MockBackend::MockBackend(asio::io_context& ioc, const Configuration& config)
+    : ioc_(ioc)
+    , acceptor_(ioc, EndpointType(asio::ip::address_v4::loopback(), 0))
+    , latency_(config.latency)
+    , response_(std::make_shared<const std::string>(MakeResponse(config.response_size)))
+    , served_(std::make_shared<std::atomic<std::size_t>>(0))
+{}
+
+void MockBackend::Run()
+{
+    DoAccept();
+}
+
+void MockBackend::Stop()
+{
+    acceptor_.close();
+}
+
+MockBackend::EndpointType MockBackend::Endpoint() const
+{
+    return acceptor_.local_endpoint();
+}
+
+std::size_t MockBackend::Served() const
+{
+    return served_->load(std::memory_order_relaxed);
+}
+
+void MockBackend::DoAccept()
+{
+    acceptor_.async_accept(
+        asio::make_strand(ioc_),
+        [this](const boost::system::error_code& ec, asio::ip::tcp::socket socket) {
+            if (ec) {
+                return;
+            }
+            DoAccept();
+            std::make_shared<MockSession>(std::move(socket), latency_, response_, served_)->Run();
+        });
+}
+
+} // namespace lb::bench
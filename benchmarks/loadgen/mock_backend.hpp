@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <string>
+
+#include <boost/asio.hpp>
+
+namespace lb::bench {
+
+// Server-side processing delay of a mock backend.
+// Spec format: "<kind>:<params>", all values in microseconds:
+//   constant:200
+//   uniform:100:300
+//   exponential:200        (mean)
+//   lognormal:200:0.5      (median, sigma)
+struct LatencyDistribution {
+    enum class Kind {
+        CONSTANT = 0,
+        UNIFORM,
+        EXPONENTIAL,
+        LOGNORMAL
+    };
+
+    Kind kind = Kind::CONSTANT;
+    double first = 0.0;
+    double second = 0.0;
+
+    static LatencyDistribution Parse(const std::string& spec);
+
+    std::chrono::microseconds Sample(std::mt19937_64& gen) const;
+};
+
+// Minimal keep-alive HTTP/1.1 server answering every request with the same
+// prebuilt response after a delay drawn from the latency distribution.
+class MockBackend {
+public:
+    using EndpointType = boost::asio::ip::tcp::endpoint;
+
+    struct Configuration {
+        LatencyDistribution latency;
+        std::size_t response_size = 1024;
+    };
+public:
+    MockBackend(boost::asio::io_context& ioc, const Configuration& config);
+
+    MockBackend(const MockBackend&) = delete;
+    MockBackend& operator=(const MockBackend&) = delete;
+
+    void Run();
+
+    void Stop();
+
+    EndpointType Endpoint() const;
+
+    std::size_t Served() const;
+
+private:
+    void DoAccept();
+
+private:
+    boost::asio::io_context& ioc_;
+    boost::asio::ip::tcp::acceptor acceptor_;
+    LatencyDistribution latency_;
+    std::shared_ptr<const std::string> response_;
+    std::shared_ptr<std::atomic<std::size_t>> served_;
+};
+
+} // namespace lb::bench
@@ -13,6 +13,7 @@ find_package(jemalloc REQUIRED)
 find_package(GTest REQUIRED)
 find_package(ctre REQUIRED)
 find_package(benchmark REQUIRED)
+find_package(OpenSSL REQUIRED)
 
 include_directories(${Boost_INCLUDE_DIRS})
 include_directories(${yaml-cpp_INCLUDE_DIRS})
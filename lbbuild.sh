@@ -8,7 +8,7 @@ function BuildApp() {
     conan profile detect --force
     conan install . --output-folder=build --build=missing --settings=build_type=$BUILD_TYPE
     cd build
-    cmake .. -DCMAKE_BUILD_TYPE=$BUILD_TYPE -DCMAKE_TOOLCHAIN_FILE=conan_toolchain.cmake
+    cmake .. -DCMAKE_BUILD_TYPE=$BUILD_TYPE -DCMAKE_TOOLCHAIN_FILE=conan_toolchain.cmake "${CMAKE_OPTIONS[@]}"
     cmake --build . -j 3
 }
 
@@ -25,6 +25,8 @@ then
 fi
 
 CMD=$1
+# Arguments after the build type go to cmake, e.g. -DLB2_COROUTINE_SESSIONS=ON
+CMAKE_OPTIONS=("${@:3}")
 
 case $CMD in
     build )
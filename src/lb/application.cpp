@@ -3,6 +3,8 @@
 #include <cstdlib>
 #include <memory>
 
+#include <unistd.h>
+
 #include <boost/program_options.hpp>
 #include <boost/thread.hpp>
 
@@ -13,6 +15,10 @@
 #include <lb/tcp/connector.hpp>
 #include <lb/application.hpp>
 #include <lb/tcp/acceptor.hpp>
+#include <lb/tcp/buffer_pool.hpp>
+#include <lb/thread_pool.hpp>
+#include <lb/hot_restart.hpp>
+#include <lb/metrics.hpp>
 
 
 
@@ -110,32 +116,6 @@ void ConfigureLogging(const YAML::Node& config)
     spdlog::register_logger(logger);
 }
 
-std::size_t ConfigureThreadPool(const YAML::Node& config)
-{
-    std::size_t threads_num = boost::thread::hardware_concurrency();
-    DEBUG("threads_num = {}", threads_num);
-    threads_num += (threads_num == 0);
-
-    if (config["thread_pool"].IsDefined()) {
-        const YAML::Node& tp_config = config["thread_pool"];
-        if (!tp_config.IsMap()) {
-            EXCEPTION("thread_pool configuration must be a map");
-        }
-
-        if (tp_config["threads_number"].as<std::string>() == "auto") {
-            DEBUG("Selected automatically threads_num={}", threads_num);
-            return threads_num;
-        }
-
-        if (tp_config["threads_number"].IsScalar()) {
-            threads_num = tp_config["threads_number"].as<std::size_t>();
-            DEBUG("Selected explicitly threads_num={}", threads_num);
-        }
-    }
-
-    return threads_num;
-}
-
 tcp::Acceptor::Configuration ConfigFromYAML(const YAML::Node& config)
 {
     if (!config["acceptor"].IsDefined()) {
@@ -156,9 +136,22 @@ tcp::Acceptor::Configuration ConfigFromYAML(const YAML::Node& config)
         useIpV6 = (version == 6);
     }
 
+    std::size_t max_sessions = 0;
+    if (acceptor_node["max_sessions"].IsDefined()) {
+        max_sessions = acceptor_node["max_sessions"].as<std::size_t>();
+    }
+
+    std::size_t max_pending_connects = 0;
+    if (acceptor_node["max_pending_connects"].IsDefined()) {
+        max_pending_connects = acceptor_node["max_pending_connects"].as<std::size_t>();
+    }
+
     return tcp::Acceptor::Configuration{
         .port=acceptor_node["port"].as<tcp::Acceptor::PortType>(),
-        .useIpV6=useIpV6
+        .useIpV6=useIpV6,
+        .max_sessions=max_sessions,
+        .max_pending_connects=max_pending_connects,
+        .tls=tcp::ConfigureTls(acceptor_node)
     };
 }
 
@@ -197,17 +190,13 @@ void Application::RegisterConnector(tcp::Connector* connector)
     connector_ptr = connector;
 }
 
-void MakeThisThreadMaximumPriority()
-{
-    struct sched_param param;
-    param.sched_priority = sched_get_priority_max(SCHED_FIFO);
-    pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
-}
-
-void ThreadRoutine(boost::asio::io_context& ioc, boost::barrier& barrier)
+void ThreadRoutine(boost::asio::io_context& ioc,
+                   boost::barrier& barrier,
+                   const ThreadPoolConfig& config,
+                   std::size_t worker_index)
 {
+    SetupWorkerThread(config, worker_index);
     barrier.wait();
-    MakeThisThreadMaximumPriority();
 
     Application& app = Application::GetInstance();
     try {
@@ -226,33 +215,122 @@ void ThreadRoutine(boost::asio::io_context& ioc, boost::barrier& barrier)
     app.SetExitCode(EXIT_SUCCESS);
 }
 
+void DrainSessions(boost::asio::io_context& ioc, std::chrono::steady_clock::time_point deadline)
+{
+    static constexpr auto poll_interval = std::chrono::milliseconds(100);
+
+    std::size_t active = tcp::BasicSession::ActiveSessions();
+    if (active == 0 || std::chrono::steady_clock::now() >= deadline) {
+        INFO("Drain finished, {} sessions left", active);
+        Application::GetInstance().Terminate();
+        return;
+    }
+
+    auto timer = std::make_shared<boost::asio::steady_timer>(ioc, poll_interval);
+    timer->async_wait([&ioc, timer, deadline](const boost::system::error_code& ec) {
+        if (!ec) {
+            DrainSessions(ioc, deadline);
+        }
+    });
+}
+
+void ReportMetrics(boost::asio::io_context& ioc, std::chrono::milliseconds interval)
+{
+    auto timer = std::make_shared<boost::asio::steady_timer>(ioc, interval);
+    timer->async_wait([&ioc, timer, interval](const boost::system::error_code& ec) {
+        if (ec) {
+            return;
+        }
+        INFO("Metrics: {}", metrics::Registry::Instance().Dump());
+        ReportMetrics(ioc, interval);
+    });
+}
+
+void ConfigureMetricsReport(boost::asio::io_context& ioc, const YAML::Node& config)
+{
+    if (!config["metrics"].IsDefined()) {
+        return;
+    }
+    const YAML::Node& metrics_node = config["metrics"];
+    if (!metrics_node.IsMap()) {
+        EXCEPTION("metrics node must be a map");
+    }
+    if (metrics_node["report_interval_ms"].IsDefined()) {
+        ReportMetrics(ioc, std::chrono::milliseconds(metrics_node["report_interval_ms"].as<std::size_t>()));
+    }
+}
+
 void Application::Start()
 {
     INFO("Starting app");
 
-    tcp::Acceptor acceptor(io_context, ConfigFromYAML(Config()));
-    acceptor.Run();
+    tcp::BufferPool::Instance().Configure(tcp::ConfigureBufferPool(Config()));
+    lb::tcp::RouterPtr router = lb::tcp::ConfigureRouter(Config());
+    auto admission = std::make_shared<tcp::AdmissionControl>(tcp::ConfigureAdmission(Config()));
+    lb::tcp::RateLimiterPtr rate_limiter = tcp::ConfigureRateLimiter(Config());
+    lb::tcp::Connector connector(io_context, router, admission, rate_limiter,
+                                 tcp::ConfigureSessionEngine(Config()), tcp::ConfigureTimeouts(Config()),
+                                 tcp::ConfigureRetries(Config()), tcp::ConfigureDeadlines(Config()));
+    RegisterConnector(&connector);
+
+    std::optional<HotRestartConfig> hot_restart = ConfigureHotRestart(Config());
+    std::vector<int> inherited_sockets;
+    if (hot_restart) {
+        inherited_sockets = ReceiveListeningSockets(hot_restart->socket_path);
+    }
+    if (inherited_sockets.size() > 1) {
+        // the previous instance has stopped accepting already, keep its first listener
+        WARN("Received {} listening sockets, one is expected, closing the rest", inherited_sockets.size());
+        for (std::size_t i = 1; i < inherited_sockets.size(); ++i) {
+            ::close(inherited_sockets[i]);
+        }
+        inherited_sockets.resize(1);
+    }
+
+    tcp::Acceptor::Configuration acceptor_config = ConfigFromYAML(Config());
+
+    std::unique_ptr<tcp::Acceptor> acceptor;
+    if (inherited_sockets.empty()) {
+        acceptor = std::make_unique<tcp::Acceptor>(io_context, connector, acceptor_config);
+    } else {
+        acceptor = std::make_unique<tcp::Acceptor>(io_context, connector, acceptor_config, inherited_sockets.front());
+    }
+    acceptor->Run();
+
+    std::unique_ptr<HandoffServer> handoff_server;
+    if (hot_restart) {
+        handoff_server = std::make_unique<HandoffServer>(
+            io_context,
+            hot_restart->socket_path,
+            std::vector<int>{acceptor->ListeningSocket()},
+            [this, &acceptor, drain_timeout=hot_restart->drain_timeout]() {
+                INFO("Stop accepting, draining sessions");
+                acceptor->Stop();
+                DrainSessions(io_context, std::chrono::steady_clock::now() + drain_timeout);
+            });
+        handoff_server->Run();
+    }
 
     boost::asio::signal_set signals(io_context, SIGINT, SIGTERM);
     signals.async_wait([&acceptor](const boost::system::error_code& ec, int signum) {
-        acceptor.Stop();
+        acceptor->Stop();
         HandleInterruptSignal(ec, signum);
     });
 
-    lb::tcp::SelectorPtr selector = lb::tcp::DetectSelector(Config());
-    lb::tcp::Connector connector(io_context, selector);
-    RegisterConnector(&connector);
+    ConfigureMetricsReport(io_context, Config());
 
-    std::size_t threads_num = ConfigureThreadPool(Config());
+    ThreadPoolConfig tp_config = ConfigureThreadPool(Config());
+    std::size_t threads_num = tp_config.threads_number;
     INFO("Threads num={}", threads_num);
     boost::barrier barrier(threads_num);
     for (std::size_t i = 0; i + 1 < threads_num; ++i) {
-        threads.create_thread([this, &barrier](){
-            ThreadRoutine(io_context, barrier);
+        threads.create_thread([this, &barrier, &tp_config, i](){
+            ThreadRoutine(io_context, barrier, tp_config, i + 1);
         });
     }
-    ThreadRoutine(io_context, barrier);
+    ThreadRoutine(io_context, barrier, tp_config, 0);
     threads.join_all();
+    INFO("Metrics: {}", metrics::Registry::Instance().Dump());
     INFO("Finishing app");
 }
 
@@ -0,0 +1,227 @@
+#include <lb/hot_restart.hpp>
+#include <lb/logging.hpp>
+
+#include <cstring>
+
+#include <yaml-cpp/yaml.h>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace asio = boost::asio;
+namespace sys = boost::system;
+
+namespace lb {
+
+namespace {
+
+constexpr char kHandoffRequest = 'H';
+constexpr std::size_t kMaxSockets = 16;
+
+} // anonymous namespace
+
+void SendSockets(int fd, const std::vector<int>& sockets)
+{
+    std::uint32_t count = sockets.size();
+    iovec iov{.iov_base = &count, .iov_len = sizeof(count)};
+
+    std::vector<char> control(CMSG_SPACE(sizeof(int) * sockets.size()), 0);
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.data();
+    msg.msg_controllen = control.size();
+
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * sockets.size());
+    std::memcpy(CMSG_DATA(cmsg), sockets.data(), sizeof(int) * sockets.size());
+
+    if (sendmsg(fd, &msg, MSG_NOSIGNAL) < 0) {
+        EXCEPTION("Unable to send listening sockets: {}", std::strerror(errno));
+    }
+}
+
+std::vector<int> ReceiveSockets(int fd)
+{
+    std::uint32_t count = 0;
+    iovec iov{.iov_base = &count, .iov_len = sizeof(count)};
+
+    std::vector<char> control(CMSG_SPACE(sizeof(int) * kMaxSockets), 0);
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.data();
+    msg.msg_controllen = control.size();
+
+    if (recvmsg(fd, &msg, MSG_CMSG_CLOEXEC) != sizeof(count)) {
+        EXCEPTION("Unable to receive listening sockets: {}", std::strerror(errno));
+    }
+
+    std::vector<int> result;
+    for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+            continue;
+        }
+        std::size_t n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        result.resize(n);
+        std::memcpy(result.data(), CMSG_DATA(cmsg), sizeof(int) * n);
+    }
+
+    if (result.size() != count) {
+        for (int socket : result) {
+            ::close(socket);
+        }
+        EXCEPTION("Expected {} listening sockets, received {}", count, result.size());
+    }
+    return result;
+}
+
+std::optional<HotRestartConfig> ConfigureHotRestart(const YAML::Node& config)
+{
+    if (!config["hot_restart"].IsDefined()) {
+        return std::nullopt;
+    }
+
+    const YAML::Node& hr_node = config["hot_restart"];
+    if (!hr_node.IsMap()) {
+        EXCEPTION("hot_restart node must be a map");
+    }
+    if (!hr_node["socket"].IsDefined()) {
+        EXCEPTION("hot_restart node missed socket field");
+    }
+
+    HotRestartConfig result;
+    result.socket_path = hr_node["socket"].as<std::string>();
+    if (hr_node["drain_timeout_ms"].IsDefined()) {
+        result.drain_timeout = std::chrono::milliseconds(hr_node["drain_timeout_ms"].as<std::size_t>());
+    }
+    return result;
+}
+
+std::vector<int> ReceiveListeningSockets(const std::string& socket_path)
+{
+    asio::io_context ioc;
+    asio::local::stream_protocol::socket peer(ioc);
+    sys::error_code ec;
+    peer.connect(asio::local::stream_protocol::endpoint(socket_path), ec);
+    if (ec) {
+        DEBUG("No running instance at {}: {}", socket_path, ec.message());
+        return {};
+    }
+
+    timeval timeout{.tv_sec = 5, .tv_usec = 0};
+    setsockopt(peer.native_handle(), SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    asio::write(peer, asio::buffer(&kHandoffRequest, 1));
+    std::vector<int> sockets = ReceiveSockets(peer.native_handle());
+    INFO("Received {} listening sockets from running instance", sockets.size());
+    return sockets;
+}
+
+HandoffServer::HandoffServer(asio::io_context& ioc,
+                             const std::string& socket_path,
+                             std::vector<NativeHandle> sockets,
+                             HandoffCallback on_handoff)
+    : socket_path_(socket_path)
+    , acceptor_(asio::make_strand(ioc))
+    , sockets_(std::move(sockets))
+    , on_handoff_(std::move(on_handoff))
+{
+    // Previous instance (if any) has already handed its sockets over
+    ::unlink(socket_path_.c_str());
+    Protocol::endpoint endpoint(socket_path_);
+    acceptor_.open(endpoint.protocol());
+    // Listening sockets go to whoever connects, nobody else may
+    const mode_t umask = ::umask(0077);
+    sys::error_code ec;
+    acceptor_.bind(endpoint, ec);
+    ::umask(umask);
+    if (ec || ::chmod(socket_path_.c_str(), 0600) != 0) {
+        EXCEPTION("Unable to create handoff socket {}: {}", socket_path_,
+                  ec ? ec.message() : std::strerror(errno));
+    }
+    acceptor_.listen();
+}
+
+HandoffServer::~HandoffServer()
+{
+    Stop();
+}
+
+void HandoffServer::Run()
+{
+    DoAccept();
+}
+
+void HandoffServer::Stop()
+{
+    if (acceptor_.is_open()) {
+        sys::error_code ec;
+        acceptor_.close(ec);
+    }
+}
+
+void HandoffServer::DoAccept()
+{
+    acceptor_.async_accept(
+        [this](const sys::error_code& ec, SocketType peer) {
+            if (ec) {
+                if (ec != asio::error::operation_aborted) {
+                    ERROR("Handoff acceptor error: {}", ec.message());
+                }
+                return;
+            }
+            // Requests are served concurrently, a silent peer holds up nobody
+            DoAccept();
+
+            ucred credentials{};
+            socklen_t size = sizeof(credentials);
+            if (::getsockopt(peer.native_handle(), SOL_SOCKET, SO_PEERCRED, &credentials, &size) != 0
+                || credentials.uid != ::geteuid()) {
+                WARN("Handoff request of uid {} refused", credentials.uid);
+                return;
+            }
+            HandleRequest(std::make_shared<SocketType>(std::move(peer)));
+        });
+}
+
+void HandoffServer::HandleRequest(std::shared_ptr<SocketType> peer)
+{
+    auto request = std::make_shared<char>(0);
+    auto deadline = std::make_shared<TimerType>(peer->get_executor(), kRequestTimeout);
+    deadline->async_wait([peer](const sys::error_code& ec) {
+        if (!ec) {
+            sys::error_code ignored;
+            peer->close(ignored); // fails the read
+        }
+    });
+    asio::async_read(*peer, asio::buffer(request.get(), 1),
+        [this, peer, request, deadline](const sys::error_code& ec, std::size_t) {
+            deadline->cancel();
+            if (ec || *request != kHandoffRequest) {
+                WARN("Invalid handoff request: {}", ec ? ec.message() : "unknown request");
+                return;
+            }
+            if (handed_over_) {
+                return; // to another instance
+            }
+            try {
+                SendSockets(peer->native_handle(), sockets_);
+            } catch (const std::exception& exc) {
+                ERROR("{}", exc.what());
+                return;
+            }
+            handed_over_ = true;
+            INFO("Listening sockets are handed over to new instance");
+            // Next instance owns socket_path now, do not unlink it
+            sys::error_code ignored;
+            acceptor_.close(ignored);
+            on_handoff_();
+        });
+}
+
+} // namespace lb
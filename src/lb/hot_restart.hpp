@@ -0,0 +1,76 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+namespace YAML {class Node;}
+
+namespace lb {
+
+// Zero-downtime upgrade: a freshly started lb2 connects to the unix socket of
+// the running instance and receives its listening sockets (SCM_RIGHTS). The
+// old instance stops accepting and drains its sessions until drain timeout.
+struct HotRestartConfig {
+    std::string socket_path;
+    std::chrono::milliseconds drain_timeout{30000};
+};
+
+std::optional<HotRestartConfig> ConfigureHotRestart(const YAML::Node& config);
+
+// Takes listening sockets over from previous instance.
+// Returns empty vector if there is no instance listening on socket_path.
+std::vector<int> ReceiveListeningSockets(const std::string& socket_path);
+
+// Passes sockets over the unix socket fd with their count (SCM_RIGHTS)
+void SendSockets(int fd, const std::vector<int>& sockets);
+
+// Throws if received sockets do not match the count sent with them
+std::vector<int> ReceiveSockets(int fd);
+
+// Hands listening sockets to the next instance. Its socket is private to the
+// user running lb2 and peers of other users are refused; a peer that does
+// not send its request within kRequestTimeout does not hold others up.
+class HandoffServer {
+public:
+    using NativeHandle = int;
+    using HandoffCallback = std::function<void()>;
+    using ExecutorType = boost::asio::strand<boost::asio::io_context::executor_type>;
+    using Protocol = boost::asio::local::stream_protocol;
+    using SocketType = boost::asio::basic_stream_socket<Protocol, ExecutorType>;
+    using TimerType = boost::asio::basic_waitable_timer<std::chrono::steady_clock,
+                                                        boost::asio::wait_traits<std::chrono::steady_clock>,
+                                                        ExecutorType>;
+
+    static constexpr std::chrono::seconds kRequestTimeout{5};
+public:
+    HandoffServer(boost::asio::io_context& ioc,
+                  const std::string& socket_path,
+                  std::vector<NativeHandle> sockets,
+                  HandoffCallback on_handoff);
+
+    HandoffServer(const HandoffServer&) = delete;
+    HandoffServer& operator=(const HandoffServer&) = delete;
+    ~HandoffServer();
+
+    void Run();
+
+    void Stop();
+
+private:
+    void DoAccept();
+    void HandleRequest(std::shared_ptr<SocketType> peer);
+
+private:
+    std::string socket_path_;
+    boost::asio::basic_socket_acceptor<Protocol, ExecutorType> acceptor_; // handlers run on its strand
+    std::vector<NativeHandle> sockets_;
+    HandoffCallback on_handoff_;
+    bool handed_over_ = false;
+};
+
+} // namespace lb
@@ -0,0 +1,53 @@
+#include <lb/metrics.hpp>
+
+#include <sstream>
+
+namespace lb::metrics {
+
+Registry& Registry::Instance()
+{
+    static Registry registry;
+    return registry;
+}
+
+Counter& Registry::GetCounter(const std::string& name)
+{
+    boost::mutex::scoped_lock lock(mutex_);
+    auto& counter = counters_[name];
+    if (!counter) {
+        counter = std::make_unique<Counter>();
+    }
+    return *counter;
+}
+
+Gauge& Registry::GetGauge(const std::string& name)
+{
+    boost::mutex::scoped_lock lock(mutex_);
+    auto& gauge = gauges_[name];
+    if (!gauge) {
+        gauge = std::make_unique<Gauge>();
+    }
+    return *gauge;
+}
+
+std::string Registry::Dump()
+{
+    boost::mutex::scoped_lock lock(mutex_);
+    std::map<std::string, std::string> values;
+    for (const auto& [name, counter] : counters_) {
+        values[name] = std::to_string(counter->Value());
+    }
+    for (const auto& [name, gauge] : gauges_) {
+        values[name] = std::to_string(gauge->Value());
+    }
+
+    std::ostringstream out;
+    bool first = true;
+    for (const auto& [name, value] : values) {
+        out << (first ? "" : " ") << name << "=" << value;
+        first = false;
+    }
+    return out.str();
+}
+
+} // namespace lb::metrics
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+
+#include <boost/thread/mutex.hpp>
+
+namespace lb::metrics {
+
+class Counter {
+public:
+    void Add(std::uint64_t value = 1)
+    {
+        value_.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    std::uint64_t Value() const
+    {
+        return value_.load(std::memory_order_relaxed);
+    }
+private:
+    std::atomic<std::uint64_t> value_{0};
+};
+
+class Gauge {
+public:
+    void Add(std::int64_t value = 1)
+    {
+        value_.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    void Sub(std::int64_t value = 1)
+    {
+        value_.fetch_sub(value, std::memory_order_relaxed);
+    }
+
+    void Set(std::int64_t value)
+    {
+        value_.store(value, std::memory_order_relaxed);
+    }
+
+    std::int64_t Value() const
+    {
+        return value_.load(std::memory_order_relaxed);
+    }
+private:
+    std::atomic<std::int64_t> value_{0};
+};
+
+// Process-wide named metrics. Lookups take a lock, so callers resolve
+// metrics once and keep references: they stay valid for process lifetime.
+class Registry {
+public:
+    static Registry& Instance();
+
+    Counter& GetCounter(const std::string& name);
+
+    Gauge& GetGauge(const std::string& name);
+
+    // "name=value" pairs sorted by name
+    std::string Dump();
+
+private:
+    Registry() = default;
+
+private:
+    boost::mutex mutex_;
+    std::map<std::string, std::unique_ptr<Counter>> counters_; // guarded by mutex
+    std::map<std::string, std::unique_ptr<Gauge>> gauges_; // guarded by mutex
+};
+
+} // namespace lb::metrics
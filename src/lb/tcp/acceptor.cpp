@@ -1,5 +1,4 @@
 #include <lb/tcp/acceptor.hpp>
-#include <lb/application.hpp>
 #include <lb/logging.hpp>
 
 namespace asio = boost::asio;
@@ -21,14 +20,33 @@ asio::ip::tcp::endpoint AcceptorEndpoint(Acceptor::PortType port, bool useIpV6)
 
 } // anonimous namespace
 
-Acceptor::Acceptor(asio::io_context& io_ctx, PortType port, bool useIpV6)
+Acceptor::Acceptor(asio::io_context& io_ctx, Connector& connector, PortType port, bool useIpV6)
     : io_context(io_ctx)
+    , connector(connector)
     , acceptor(boost::asio::make_strand(io_ctx), AcceptorEndpoint(port, useIpV6))
+    , pause_timer(acceptor.get_executor())
+    , sessions_limit(std::make_shared<ConcurrencyLimit>())
+    , connects_limit(std::make_shared<ConcurrencyLimit>())
 {}
 
-Acceptor::Acceptor(asio::io_context& io_ctx, const Acceptor::Configuration& config)
+Acceptor::Acceptor(asio::io_context& io_ctx, Connector& connector, const Acceptor::Configuration& config)
     : io_context(io_ctx)
-    , acceptor(io_ctx, AcceptorEndpoint(config.port, config.useIpV6))
+    , connector(connector)
+    , acceptor(boost::asio::make_strand(io_ctx), AcceptorEndpoint(config.port, config.useIpV6))
+    , pause_timer(acceptor.get_executor())
+    , sessions_limit(std::make_shared<ConcurrencyLimit>(config.max_sessions))
+    , connects_limit(std::make_shared<ConcurrencyLimit>(config.max_pending_connects))
+    , tls(config.tls)
+{}
+
+Acceptor::Acceptor(asio::io_context& io_ctx, Connector& connector, const Acceptor::Configuration& config, NativeHandle socket)
+    : io_context(io_ctx)
+    , connector(connector)
+    , acceptor(boost::asio::make_strand(io_ctx), config.useIpV6 ? asio::ip::tcp::v6() : asio::ip::tcp::v4(), socket)
+    , pause_timer(acceptor.get_executor())
+    , sessions_limit(std::make_shared<ConcurrencyLimit>(config.max_sessions))
+    , connects_limit(std::make_shared<ConcurrencyLimit>(config.max_pending_connects))
+    , tls(config.tls)
 {}
 
 void Acceptor::Run()
@@ -38,18 +56,61 @@ void Acceptor::Run()
 
 void Acceptor::DoAccept()
 {
+    AdmissionControl& admission = connector.Admission();
+    if (admission.Config().action == AdmissionControl::Action::PAUSE && !admission.HasRoom(sessions_limit)) {
+        // Leave connections in kernel backlog until some session finishes
+        admission.OnAcceptPaused();
+        pause_timer.expires_after(admission.Config().pause);
+        pause_timer.async_wait([this](const sys::error_code& ec) {
+            if (!ec && acceptor.is_open()) {
+                DoAccept();
+            }
+        });
+        return;
+    }
+
     acceptor.async_accept(
         boost::asio::make_strand(io_context),
-        [&](const sys::error_code& ec, asio::ip::tcp::socket client_socket){
+        [&](const sys::error_code& ec, SocketType client_socket){
             if (ec) {
-                ERROR("Acceptor error: {}", ec.message());
+                if (ec != asio::error::operation_aborted) {
+                    ERROR("Acceptor error: {}", ec.message());
+                }
                 acceptor.close();
                 return;
             }
             DoAccept();
             INFO("Accepted {}:{}", client_socket.local_endpoint().address().to_string(), client_socket.local_endpoint().port());
-            auto& connector = ::lb::Application::GetInstance().Connector();
-            connector.MakeAndRunSession(std::move(client_socket));
+            // taken here, sessions of relayed TLS connections have no peer address
+            sys::error_code remote_ec;
+            const asio::ip::tcp::endpoint remote = client_socket.remote_endpoint(remote_ec);
+            if (RateLimiter* limiter = connector.ClientRateLimiter()) {
+                if (remote_ec || !limiter->AllowConnection(remote.address())) {
+                    DEBUG("Connection rate limit exceeded, resetting connection");
+                    client_socket.set_option(asio::socket_base::linger(true, 0), remote_ec);
+                    client_socket.close(remote_ec);
+                    return;
+                }
+            }
+            std::optional<AdmissionTicket> ticket = admission.AdmitSession(sessions_limit);
+            if (!ticket) {
+                DEBUG("Session limit reached, shedding connection");
+                admission.Shed(std::move(client_socket));
+                return;
+            }
+            if (tls) {
+                tls->AsyncHandshake(
+                    std::move(client_socket),
+                    [this, remote, ticket=std::move(*ticket)](const sys::error_code& ec, SocketType socket) mutable {
+                        if (ec) {
+                            DEBUG("TLS handshake failed: {}", ec.message());
+                            return;
+                        }
+                        connector.MakeAndRunSession(std::move(socket), remote, std::move(ticket), connects_limit);
+                    });
+                return;
+            }
+            connector.MakeAndRunSession(std::move(client_socket), remote, std::move(*ticket), connects_limit);
         });
 }
 
@@ -57,6 +118,17 @@ void Acceptor::DoAccept()
 void Acceptor::Stop()
 {
     acceptor.cancel();
+    pause_timer.cancel();
+}
+
+asio::ip::tcp::endpoint Acceptor::LocalEndpoint() const
+{
+    return acceptor.local_endpoint();
+}
+
+Acceptor::NativeHandle Acceptor::ListeningSocket()
+{
+    return acceptor.native_handle();
 }
 
 } // namespace tcp
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <boost/asio.hpp>
+#include <lb/tcp/connector.hpp>
+#include <lb/tcp/tls.hpp>
 
 namespace lb {
 
@@ -10,16 +12,23 @@ namespace tcp {
 class Acceptor{
 public:
     using PortType = unsigned;
+    using NativeHandle = boost::asio::ip::tcp::acceptor::native_handle_type;
 
     struct Configuration {
         PortType port;
         bool useIpV6 = false;
+        std::size_t max_sessions = 0;         // per-listener cap, 0 - unlimited
+        std::size_t max_pending_connects = 0; // per-listener cap on upstream connects of its sessions
+        TlsTerminatorPtr tls;                 // nullptr - plaintext
     };
 
 public:
-    Acceptor(boost::asio::io_context& io_ctx, PortType port, bool useIpV6=false);
+    Acceptor(boost::asio::io_context& io_ctx, Connector& connector, PortType port, bool useIpV6=false);
 
-    Acceptor(boost::asio::io_context& io_ctx, const Configuration& config);
+    Acceptor(boost::asio::io_context& io_ctx, Connector& connector, const Configuration& config);
+
+    // Adopts already listening socket, e.g. inherited from previous lb2 instance
+    Acceptor(boost::asio::io_context& io_ctx, Connector& connector, const Configuration& config, NativeHandle socket);
 
     Acceptor(const Acceptor&) = delete;
     Acceptor& operator=(const Acceptor&) = delete;
@@ -30,6 +39,11 @@ public:
 
     void Stop();
 
+    // Useful when listening on port 0
+    boost::asio::ip::tcp::endpoint LocalEndpoint() const;
+
+    NativeHandle ListeningSocket();
+
 private:
 
     // Acception callbacks
@@ -37,7 +51,12 @@ private:
 
 private:
     boost::asio::io_context& io_context;
-    boost::asio::ip::tcp::acceptor acceptor;
+    Connector& connector;
+    boost::asio::basic_socket_acceptor<boost::asio::ip::tcp, ExecutorType> acceptor;
+    boost::asio::steady_timer pause_timer;
+    ConcurrencyLimitPtr sessions_limit;
+    ConcurrencyLimitPtr connects_limit;
+    TlsTerminatorPtr tls;
 };
 
 } // namespace tcp
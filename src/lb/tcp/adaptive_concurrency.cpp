@@ -0,0 +1,289 @@
+#include <lb/tcp/adaptive_concurrency.hpp>
+#include <lb/logging.hpp>
+#include <lb/metrics.hpp>
+
+#include <yaml-cpp/yaml.h>
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace lb::tcp {
+
+namespace {
+
+constexpr double kLongTermWeight = 0.05;       // of a window in the gradient's long-term time
+constexpr double kDropBackoff = 0.9;           // limit factor after a window with timeouts
+constexpr std::size_t kVegasProbeInterval = 100; // windows between resets of the lowest time
+
+} // anonymous namespace
+
+// ============================ Permit ============================
+
+AdaptiveConcurrency::Permit::Permit(AdaptiveConcurrency* limiter, std::size_t index, std::size_t in_flight)
+    : limiter_(limiter)
+    , index_(index)
+    , in_flight_(in_flight)
+    , start_(std::chrono::steady_clock::now())
+{}
+
+AdaptiveConcurrency::Permit::Permit(Permit&& other) noexcept
+    : limiter_(std::exchange(other.limiter_, nullptr))
+    , index_(other.index_)
+    , in_flight_(other.in_flight_)
+    , start_(other.start_)
+{}
+
+AdaptiveConcurrency::Permit& AdaptiveConcurrency::Permit::operator=(Permit&& other) noexcept
+{
+    if (this != &other) {
+        Release();
+        limiter_ = std::exchange(other.limiter_, nullptr);
+        index_ = other.index_;
+        in_flight_ = other.in_flight_;
+        start_ = other.start_;
+    }
+    return *this;
+}
+
+AdaptiveConcurrency::Permit::~Permit()
+{
+    Release();
+}
+
+AdaptiveConcurrency::Permit::operator bool() const
+{
+    return limiter_ != nullptr;
+}
+
+void AdaptiveConcurrency::Permit::OnResponse()
+{
+    if (limiter_) {
+        limiter_->Record(index_, std::chrono::steady_clock::now() - start_, in_flight_, false);
+        Release();
+    }
+}
+
+void AdaptiveConcurrency::Permit::OnDropped()
+{
+    if (limiter_) {
+        limiter_->Record(index_, std::chrono::steady_clock::now() - start_, in_flight_, true);
+        Release();
+    }
+}
+
+void AdaptiveConcurrency::Permit::Release()
+{
+    if (limiter_) {
+        std::exchange(limiter_, nullptr)->states_[index_].in_flight.fetch_sub(1);
+    }
+}
+
+// ============================ AdaptiveConcurrency ============================
+
+AdaptiveConcurrency::AdaptiveConcurrency(const Configuration& config,
+                                         const std::vector<Backend>& backends,
+                                         const std::string& pool_name)
+    : config_(config)
+    , states_(std::make_unique<BackendState[]>(backends.size()))
+    , limits_(metrics::Registry::Instance().GetGauge("pools." + pool_name + ".concurrency_limit"))
+    , rejected_(metrics::Registry::Instance().GetCounter("pools." + pool_name + ".concurrency_rejected"))
+    , dropped_(metrics::Registry::Instance().GetCounter("pools." + pool_name + ".concurrency_dropped"))
+{
+    for (std::size_t i = 0; i < backends.size(); ++i) {
+        indexes_.emplace(backends[i], i);
+        states_[i].exact_limit = config_.initial_limit;
+        states_[i].limit.store(config_.initial_limit);
+    }
+    limits_.Add(static_cast<std::int64_t>(config_.initial_limit * backends.size()));
+}
+
+const AdaptiveConcurrency::Configuration& AdaptiveConcurrency::Config() const
+{
+    return config_;
+}
+
+std::optional<AdaptiveConcurrency::Permit> AdaptiveConcurrency::TryAcquire(const Backend& backend)
+{
+    auto it = indexes_.find(backend);
+    if (it == indexes_.end()) {
+        return Permit(); // backend is not limited
+    }
+    BackendState& state = states_[it->second];
+    std::size_t current = state.in_flight.load();
+    do {
+        if (current >= state.limit.load(std::memory_order_relaxed)) {
+            rejected_.Add();
+            return std::nullopt;
+        }
+    } while (!state.in_flight.compare_exchange_weak(current, current + 1));
+    return Permit(this, it->second, current + 1);
+}
+
+std::size_t AdaptiveConcurrency::Limit(const Backend& backend) const
+{
+    auto it = indexes_.find(backend);
+    return it == indexes_.end() ? 0 : states_[it->second].limit.load(std::memory_order_relaxed);
+}
+
+std::size_t AdaptiveConcurrency::InFlight(const Backend& backend) const
+{
+    auto it = indexes_.find(backend);
+    return it == indexes_.end() ? 0 : states_[it->second].in_flight.load(std::memory_order_relaxed);
+}
+
+void AdaptiveConcurrency::Record(const Backend& backend,
+                                 std::chrono::nanoseconds latency,
+                                 std::size_t in_flight,
+                                 bool dropped)
+{
+    auto it = indexes_.find(backend);
+    if (it != indexes_.end()) {
+        Record(it->second, latency, in_flight, dropped);
+    }
+}
+
+void AdaptiveConcurrency::Record(std::size_t index,
+                                 std::chrono::nanoseconds latency,
+                                 std::size_t in_flight,
+                                 bool dropped)
+{
+    if (dropped) {
+        dropped_.Add();
+    }
+    BackendState& state = states_[index];
+    const auto sample = static_cast<double>(std::max<std::int64_t>(latency.count(), 1));
+    boost::mutex::scoped_lock lock(state.mutex);
+    if (state.samples == 0 || sample < state.window_min) {
+        state.window_min = sample;
+    }
+    state.window_sum += sample;
+    state.window_max_in_flight = std::max(state.window_max_in_flight, in_flight);
+    state.window_dropped |= dropped;
+    if (++state.samples >= config_.window) {
+        Update(state);
+    }
+}
+
+void AdaptiveConcurrency::Update(BackendState& state)
+{
+    double limit = config_.algorithm == Algorithm::GRADIENT
+                 ? Gradient(state, state.window_sum / state.samples)
+                 : Vegas(state, state.window_min);
+    if (state.window_max_in_flight * 2 < state.exact_limit) {
+        // too few requests to tell whether the backend takes more
+        limit = std::min(limit, state.exact_limit);
+    }
+    if (state.window_dropped) {
+        limit = std::min(limit, state.exact_limit * kDropBackoff);
+    }
+    state.exact_limit = std::clamp(limit, static_cast<double>(config_.min_limit), static_cast<double>(config_.max_limit));
+
+    const auto rounded = static_cast<std::size_t>(state.exact_limit);
+    const std::size_t previous = state.limit.exchange(rounded, std::memory_order_relaxed);
+    limits_.Add(static_cast<std::int64_t>(rounded) - static_cast<std::int64_t>(previous));
+
+    ++state.windows;
+    state.samples = 0;
+    state.window_sum = 0;
+    state.window_max_in_flight = 0;
+    state.window_dropped = false;
+}
+
+double AdaptiveConcurrency::Gradient(BackendState& state, double window_average) const
+{
+    if (state.long_term == 0) {
+        state.long_term = window_average;
+    } else {
+        state.long_term += (window_average - state.long_term) * kLongTermWeight;
+    }
+    // after an overload times recover faster than the long-term average
+    if (state.long_term > 2 * window_average) {
+        state.long_term *= 0.95;
+    }
+
+    const double limit = state.exact_limit;
+    const double gradient = std::clamp(config_.tolerance * state.long_term / window_average, 0.5, 1.0);
+    const double target = limit * gradient + std::sqrt(limit); // sqrt(limit) is the allowed queue
+    return limit * (1 - config_.smoothing) + target * config_.smoothing;
+}
+
+double AdaptiveConcurrency::Vegas(BackendState& state, double window_min) const
+{
+    // a redeployed backend may never get back to the old lowest time
+    if (state.no_load == 0 || window_min < state.no_load || state.windows % kVegasProbeInterval == 0) {
+        state.no_load = window_min;
+    }
+
+    const double limit = state.exact_limit;
+    const double step = std::max(1.0, std::log10(limit));
+    const double queue = std::ceil(limit * (1 - state.no_load / window_min));
+    if (queue <= step) {
+        return limit + 6 * step;
+    }
+    if (queue < 3 * step) {
+        return limit + step;
+    }
+    if (queue > 6 * step) {
+        return limit - step;
+    }
+    return limit;
+}
+
+AdaptiveConcurrencyPtr ConfigureAdaptiveConcurrency(const YAML::Node& pool_node, const std::string& pool_name)
+{
+    if (!pool_node["adaptive_concurrency"].IsDefined()) {
+        return nullptr;
+    }
+
+    const YAML::Node& node = pool_node["adaptive_concurrency"];
+    if (!node.IsMap()) {
+        EXCEPTION("adaptive_concurrency node must be a map");
+    }
+
+    AdaptiveConcurrency::Configuration config;
+    if (node["algorithm"].IsDefined()) {
+        static const std::unordered_map<std::string, AdaptiveConcurrency::Algorithm> algorithms = {
+            {"gradient", AdaptiveConcurrency::Algorithm::GRADIENT},
+            {"vegas", AdaptiveConcurrency::Algorithm::VEGAS},
+        };
+        auto it = algorithms.find(node["algorithm"].as<std::string>());
+        if (it == algorithms.end()) {
+            EXCEPTION("Unknown adaptive concurrency algorithm: {}", node["algorithm"].as<std::string>());
+        }
+        config.algorithm = it->second;
+    }
+    if (node["initial_limit"].IsDefined()) {
+        config.initial_limit = node["initial_limit"].as<std::size_t>();
+    }
+    if (node["min_limit"].IsDefined()) {
+        config.min_limit = node["min_limit"].as<std::size_t>();
+    }
+    if (node["max_limit"].IsDefined()) {
+        config.max_limit = node["max_limit"].as<std::size_t>();
+    }
+    if (config.min_limit == 0 || config.min_limit > config.initial_limit || config.initial_limit > config.max_limit) {
+        EXCEPTION("adaptive_concurrency limits must satisfy 0 < min_limit <= initial_limit <= max_limit");
+    }
+    if (node["window"].IsDefined()) {
+        config.window = node["window"].as<std::size_t>();
+        if (config.window == 0) {
+            EXCEPTION("adaptive_concurrency.window must be positive");
+        }
+    }
+    if (node["smoothing"].IsDefined()) {
+        config.smoothing = node["smoothing"].as<double>();
+        if (config.smoothing <= 0 || config.smoothing > 1) {
+            EXCEPTION("adaptive_concurrency.smoothing must be in (0, 1]");
+        }
+    }
+    if (node["tolerance"].IsDefined()) {
+        config.tolerance = node["tolerance"].as<double>();
+        if (config.tolerance < 1) {
+            EXCEPTION("adaptive_concurrency.tolerance must be at least 1");
+        }
+    }
+    return std::make_shared<AdaptiveConcurrency>(config, ReadBackends(pool_node), pool_name);
+}
+
+} // namespace lb::tcp
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+#include <lb/tcp/selectors.hpp>
+
+namespace YAML {class Node;}
+
+namespace lb::metrics {
+class Counter;
+class Gauge;
+}
+
+namespace lb::tcp {
+
+// Adaptive cap on in-flight requests of every backend of a pool. Response
+// times are collected in windows of samples, after every window the limit
+// of the backend is recomputed:
+//  - gradient compares the window's average time with a long-term one and
+//    shrinks the limit by their ratio once it exceeds tolerance,
+//  - vegas estimates the backend's queue from the lowest time seen and
+//    grows the limit while the queue is short, shrinks it when it is long.
+// Limits are not raised by windows that used less than half of them.
+class AdaptiveConcurrency {
+public:
+    enum class Algorithm {
+        GRADIENT = 0,
+        VEGAS,
+    };
+
+    struct Configuration {
+        Algorithm algorithm = Algorithm::GRADIENT;
+        std::size_t initial_limit = 20;
+        std::size_t min_limit = 1;
+        std::size_t max_limit = 1000;
+        std::size_t window = 20;  // samples per limit update
+        double smoothing = 0.2;   // gradient: weight of a new limit
+        double tolerance = 1.5;   // gradient: window to long-term time ratio taken as no queueing
+    };
+
+    // Request in flight to one backend, released on destruction without a sample
+    class Permit {
+    public:
+        Permit() = default;
+
+        Permit(Permit&& other) noexcept;
+        Permit& operator=(Permit&& other) noexcept;
+        Permit(const Permit&) = delete;
+        Permit& operator=(const Permit&) = delete;
+        ~Permit();
+
+        explicit operator bool() const;
+
+        // Samples the time since the permit was acquired and releases it
+        void OnResponse();
+
+        // Releases the permit, the request timed out
+        void OnDropped();
+
+        void Release();
+    private:
+        friend class AdaptiveConcurrency;
+
+        Permit(AdaptiveConcurrency* limiter, std::size_t index, std::size_t in_flight);
+    private:
+        AdaptiveConcurrency* limiter_ = nullptr; // pools outlive sessions
+        std::size_t index_ = 0;
+        std::size_t in_flight_ = 0; // including this one, when acquired
+        std::chrono::steady_clock::time_point start_;
+    };
+public:
+    // Metrics are named after the pool
+    AdaptiveConcurrency(const Configuration& config, const std::vector<Backend>& backends, const std::string& pool_name);
+
+    AdaptiveConcurrency(const AdaptiveConcurrency&) = delete;
+    AdaptiveConcurrency& operator=(const AdaptiveConcurrency&) = delete;
+
+    const Configuration& Config() const;
+
+    // Nullopt if backend has as many requests in flight as its limit allows
+    std::optional<Permit> TryAcquire(const Backend& backend);
+
+    std::size_t Limit(const Backend& backend) const;
+
+    std::size_t InFlight(const Backend& backend) const;
+
+    // Response time of a request sent with in_flight requests to backend,
+    // dropped if it timed out. Permits record their samples on their own.
+    void Record(const Backend& backend, std::chrono::nanoseconds latency, std::size_t in_flight, bool dropped);
+private:
+    struct BackendState {
+        std::atomic<std::size_t> in_flight{0};
+        std::atomic<std::size_t> limit{0};
+
+        boost::mutex mutex;
+        // guarded by mutex
+        double exact_limit = 0;
+        std::size_t samples = 0;
+        std::size_t windows = 0;
+        double window_sum = 0;      // ns
+        double window_min = 0;      // ns
+        std::size_t window_max_in_flight = 0;
+        bool window_dropped = false;
+        double long_term = 0;       // gradient: average time, ns
+        double no_load = 0;         // vegas: lowest time, ns
+    };
+
+    void Record(std::size_t index, std::chrono::nanoseconds latency, std::size_t in_flight, bool dropped);
+
+    // Called under the backend's lock once its window is full
+    void Update(BackendState& state);
+
+    double Gradient(BackendState& state, double window_average) const;
+
+    double Vegas(BackendState& state, double window_min) const;
+private:
+    const Configuration config_;
+    std::unordered_map<Backend, std::size_t, BackendHasher> indexes_;
+    std::unique_ptr<BackendState[]> states_;
+    metrics::Gauge& limits_;   // sum over backends
+    metrics::Counter& rejected_;
+    metrics::Counter& dropped_;
+};
+
+using AdaptiveConcurrencyPtr = std::shared_ptr<AdaptiveConcurrency>;
+
+// Reads adaptive_concurrency node of a pool, returns nullptr if it is missing
+AdaptiveConcurrencyPtr ConfigureAdaptiveConcurrency(const YAML::Node& pool_node, const std::string& pool_name);
+
+} // namespace lb::tcp
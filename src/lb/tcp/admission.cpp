@@ -0,0 +1,204 @@
+#include <lb/tcp/admission.hpp>
+#include <lb/logging.hpp>
+#include <lb/metrics.hpp>
+#include <lb/tcp/session.hpp>
+
+#include <yaml-cpp/yaml.h>
+
+namespace asio = boost::asio;
+namespace sys = boost::system;
+
+namespace lb::tcp {
+
+// ============================ ConcurrencyLimit ============================
+
+ConcurrencyLimit::ConcurrencyLimit(std::size_t limit)
+    : limit_(limit)
+{}
+
+bool ConcurrencyLimit::TryAcquire()
+{
+    if (limit_ == 0) {
+        active_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    std::size_t active = active_.load(std::memory_order_relaxed);
+    do {
+        if (active >= limit_) {
+            return false;
+        }
+    } while (!active_.compare_exchange_weak(active, active + 1, std::memory_order_relaxed));
+    return true;
+}
+
+void ConcurrencyLimit::Release()
+{
+    active_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+bool ConcurrencyLimit::HasRoom() const
+{
+    return limit_ == 0 || Active() < limit_;
+}
+
+std::size_t ConcurrencyLimit::Active() const
+{
+    return active_.load(std::memory_order_relaxed);
+}
+
+std::size_t ConcurrencyLimit::Limit() const
+{
+    return limit_;
+}
+
+// ============================ AdmissionTicket ============================
+
+AdmissionTicket::AdmissionTicket(ConcurrencyLimitPtr first, ConcurrencyLimitPtr second)
+    : first_(std::move(first))
+    , second_(std::move(second))
+{}
+
+AdmissionTicket& AdmissionTicket::operator=(AdmissionTicket&& other) noexcept
+{
+    if (this != &other) {
+        Release();
+        first_ = std::move(other.first_);
+        second_ = std::move(other.second_);
+    }
+    return *this;
+}
+
+AdmissionTicket::~AdmissionTicket()
+{
+    Release();
+}
+
+void AdmissionTicket::Release()
+{
+    if (first_) {
+        first_->Release();
+        first_.reset();
+    }
+    if (second_) {
+        second_->Release();
+        second_.reset();
+    }
+}
+
+// ============================ AdmissionControl ============================
+
+AdmissionControl::AdmissionControl()
+    : AdmissionControl(Configuration{})
+{}
+
+AdmissionControl::AdmissionControl(const Configuration& config)
+    : config_(config)
+    , sessions_(std::make_shared<ConcurrencyLimit>(config.max_sessions))
+    , connects_(std::make_shared<ConcurrencyLimit>(config.max_pending_connects))
+    , shed_reset_(metrics::Registry::Instance().GetCounter("admission.shed_reset"))
+    , shed_rejected_(metrics::Registry::Instance().GetCounter("admission.shed_rejected"))
+    , shed_connects_(metrics::Registry::Instance().GetCounter("admission.shed_connects"))
+    , accept_paused_(metrics::Registry::Instance().GetCounter("admission.accept_paused"))
+{}
+
+const AdmissionControl::Configuration& AdmissionControl::Config() const
+{
+    return config_;
+}
+
+bool AdmissionControl::HasRoom(const ConcurrencyLimitPtr& listener_limit) const
+{
+    return sessions_->HasRoom() && (!listener_limit || listener_limit->HasRoom());
+}
+
+std::optional<AdmissionTicket> AdmissionControl::AdmitSession(const ConcurrencyLimitPtr& listener_limit)
+{
+    if (!sessions_->TryAcquire()) {
+        return std::nullopt;
+    }
+    if (listener_limit && !listener_limit->TryAcquire()) {
+        sessions_->Release();
+        return std::nullopt;
+    }
+    return AdmissionTicket(sessions_, listener_limit);
+}
+
+std::optional<AdmissionTicket> AdmissionControl::AdmitConnect(const ConcurrencyLimitPtr& listener_limit)
+{
+    if (!connects_->TryAcquire()) {
+        shed_connects_.Add();
+        return std::nullopt;
+    }
+    if (listener_limit && !listener_limit->TryAcquire()) {
+        connects_->Release();
+        shed_connects_.Add();
+        return std::nullopt;
+    }
+    return AdmissionTicket(connects_, listener_limit);
+}
+
+void AdmissionControl::Shed(SocketType socket)
+{
+    sys::error_code ec;
+    if (config_.action == Action::RESET) {
+        shed_reset_.Add();
+        // Zero linger makes close() send RST instead of FIN
+        socket.set_option(asio::socket_base::linger(true, 0), ec);
+        socket.close(ec);
+        return;
+    }
+
+    // Pause falls back to reject for connections that are already accepted
+    shed_rejected_.Add();
+    auto shared_socket = std::make_shared<SocketType>(std::move(socket));
+    asio::async_write(*shared_socket, asio::buffer(kServiceUnavailableResponse),
+        [shared_socket](const sys::error_code& ec, std::size_t) {
+            sys::error_code ignored;
+            shared_socket->shutdown(SocketType::shutdown_both, ignored);
+            shared_socket->close(ignored);
+        });
+}
+
+void AdmissionControl::OnAcceptPaused()
+{
+    accept_paused_.Add();
+}
+
+AdmissionControl::Configuration ConfigureAdmission(const YAML::Node& config)
+{
+    AdmissionControl::Configuration result;
+    if (!config["admission"].IsDefined()) {
+        return result;
+    }
+
+    const YAML::Node& node = config["admission"];
+    if (!node.IsMap()) {
+        EXCEPTION("admission node must be a map");
+    }
+
+    if (node["max_sessions"].IsDefined()) {
+        result.max_sessions = node["max_sessions"].as<std::size_t>();
+    }
+    if (node["max_pending_connects"].IsDefined()) {
+        result.max_pending_connects = node["max_pending_connects"].as<std::size_t>();
+    }
+    if (node["action"].IsDefined()) {
+        static const std::unordered_map<std::string, AdmissionControl::Action> actions = {
+            {"reset", AdmissionControl::Action::RESET},
+            {"reject", AdmissionControl::Action::REJECT},
+            {"pause", AdmissionControl::Action::PAUSE},
+        };
+        auto it = actions.find(node["action"].as<std::string>());
+        if (it == actions.end()) {
+            EXCEPTION("Unknown admission action: {}", node["action"].as<std::string>());
+        }
+        result.action = it->second;
+    }
+    if (node["pause_ms"].IsDefined()) {
+        result.pause = std::chrono::milliseconds(node["pause_ms"].as<std::size_t>());
+    }
+    return result;
+}
+
+} // namespace lb::tcp
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <optional>
+
+#include <boost/asio.hpp>
+#include <lb/tcp/socket.hpp>
+
+namespace YAML {class Node;}
+
+namespace lb::metrics {class Counter;}
+
+namespace lb::tcp {
+
+// Allows at most limit simultaneous holders, 0 means unlimited
+class ConcurrencyLimit {
+public:
+    explicit ConcurrencyLimit(std::size_t limit = 0);
+
+    bool TryAcquire();
+
+    void Release();
+
+    bool HasRoom() const;
+
+    std::size_t Active() const;
+
+    std::size_t Limit() const;
+private:
+    const std::size_t limit_;
+    std::atomic<std::size_t> active_{0};
+};
+
+using ConcurrencyLimitPtr = std::shared_ptr<ConcurrencyLimit>;
+
+// Holds one slot of every limit it was acquired from, releases them on destruction
+class AdmissionTicket {
+public:
+    AdmissionTicket() = default;
+    AdmissionTicket(ConcurrencyLimitPtr first, ConcurrencyLimitPtr second = nullptr);
+
+    AdmissionTicket(AdmissionTicket&& other) noexcept = default;
+    AdmissionTicket& operator=(AdmissionTicket&& other) noexcept;
+    AdmissionTicket(const AdmissionTicket&) = delete;
+    AdmissionTicket& operator=(const AdmissionTicket&) = delete;
+    ~AdmissionTicket();
+
+    void Release();
+private:
+    ConcurrencyLimitPtr first_;
+    ConcurrencyLimitPtr second_;
+};
+
+// Admission control: caps active sessions and in-flight upstream connects,
+// globally and per listener, and sheds connections above the caps.
+class AdmissionControl {
+public:
+    using SocketType = tcp::SocketType;
+
+    enum class Action {
+        RESET = 0, // accept and reset connection
+        REJECT,    // accept and reply with prebuilt 503
+        PAUSE      // stop accepting for pause duration, connections wait in backlog
+    };
+
+    struct Configuration {
+        std::size_t max_sessions = 0;         // 0 - unlimited
+        std::size_t max_pending_connects = 0; // 0 - unlimited
+        Action action = Action::REJECT;
+        std::chrono::milliseconds pause{100};
+    };
+public:
+    AdmissionControl();
+
+    explicit AdmissionControl(const Configuration& config);
+
+    const Configuration& Config() const;
+
+    // Session slot in global limit and in listener's one
+    bool HasRoom(const ConcurrencyLimitPtr& listener_limit) const;
+    std::optional<AdmissionTicket> AdmitSession(const ConcurrencyLimitPtr& listener_limit);
+
+    // Connect slot in global limit and in listener's one
+    std::optional<AdmissionTicket> AdmitConnect(const ConcurrencyLimitPtr& listener_limit = nullptr);
+
+    // Drops connection according to configured action
+    void Shed(SocketType socket);
+
+    void OnAcceptPaused();
+private:
+    Configuration config_;
+    ConcurrencyLimitPtr sessions_;
+    ConcurrencyLimitPtr connects_;
+    metrics::Counter& shed_reset_;
+    metrics::Counter& shed_rejected_;
+    metrics::Counter& shed_connects_;
+    metrics::Counter& accept_paused_;
+};
+
+using AdmissionControlPtr = std::shared_ptr<AdmissionControl>;
+
+AdmissionControl::Configuration ConfigureAdmission(const YAML::Node& config);
+
+} // namespace lb::tcp
@@ -0,0 +1,280 @@
+#include <lb/tcp/buffer_pool.hpp>
+#include <lb/logging.hpp>
+#include <lb/metrics.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <string>
+
+#include <sys/mman.h>
+#include <yaml-cpp/yaml.h>
+
+namespace lb::tcp {
+
+namespace {
+
+constexpr std::size_t kThreadCacheBytes = 128 * 1024; // per size class, batches move half of it
+
+// Set when the thread's cache is destroyed, later calls on the thread go to shared lists
+thread_local bool thread_cache_destroyed = false;
+
+std::string ClassName(std::size_t slab_size)
+{
+    return std::to_string(slab_size / 1024) + "k";
+}
+
+} // anonymous namespace
+
+class BufferPool::ThreadCache {
+public:
+    explicit ThreadCache(BufferPool& pool)
+        : pool_(pool)
+    {}
+
+    ~ThreadCache()
+    {
+        for (std::size_t i = 0; i < kClassesCount; ++i) {
+            pool_.Flush(i, lists[i], lists[i].count);
+        }
+        thread_cache_destroyed = true;
+    }
+public:
+    std::array<FreeList, kClassesCount> lists;
+private:
+    BufferPool& pool_;
+};
+
+void BufferPool::FreeList::Push(void* slab)
+{
+    FreeSlab* free_slab = static_cast<FreeSlab*>(slab);
+    free_slab->next = head;
+    head = free_slab;
+    ++count;
+}
+
+void* BufferPool::FreeList::Pop()
+{
+    FreeSlab* result = head;
+    head = head->next;
+    --count;
+    return result;
+}
+
+BufferPool& BufferPool::Instance()
+{
+    // Never destroyed: buffers of sessions may outlive other statics
+    static BufferPool* pool = new BufferPool();
+    return *pool;
+}
+
+BufferPool::BufferPool()
+    : mapped_bytes_(metrics::Registry::Instance().GetGauge("buffers.mapped_bytes"))
+    , huge_page_bytes_(metrics::Registry::Instance().GetGauge("buffers.huge_page_bytes"))
+    , heap_bytes_(metrics::Registry::Instance().GetGauge("buffers.heap_bytes"))
+{
+    for (std::size_t i = 0; i < kClassesCount; ++i) {
+        classes_[i].slabs = &metrics::Registry::Instance().GetGauge("buffers." + ClassName(kSlabSizes[i]) + ".slabs");
+        classes_[i].in_use = &metrics::Registry::Instance().GetGauge("buffers." + ClassName(kSlabSizes[i]) + ".in_use");
+    }
+}
+
+void BufferPool::Configure(const Configuration& config)
+{
+    huge_pages_.store(config.huge_pages, std::memory_order_relaxed);
+}
+
+int BufferPool::ClassOf(std::size_t size)
+{
+    for (std::size_t i = 0; i < kClassesCount; ++i) {
+        if (size <= kSlabSizes[i]) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+std::size_t BufferPool::RoundUp(std::size_t size)
+{
+    int size_class = ClassOf(size);
+    return size_class < 0 ? size : kSlabSizes[size_class];
+}
+
+std::size_t BufferPool::BatchSize(int size_class)
+{
+    return std::max<std::size_t>(1, kThreadCacheBytes / 2 / kSlabSizes[size_class]);
+}
+
+BufferPool::ThreadCache* BufferPool::LocalCache()
+{
+    if (thread_cache_destroyed) {
+        return nullptr;
+    }
+    thread_local ThreadCache cache(*this);
+    return &cache;
+}
+
+void* BufferPool::Allocate(std::size_t size)
+{
+    int size_class = ClassOf(size);
+    if (size_class < 0) {
+        void* result = ::operator new(size);
+        heap_bytes_.Add(size);
+        return result;
+    }
+
+    FreeList fallback;
+    ThreadCache* cache = LocalCache();
+    FreeList& list = cache ? cache->lists[size_class] : fallback;
+    if (list.count == 0) {
+        Refill(size_class, list);
+    }
+    classes_[size_class].in_use->Add();
+    void* result = list.Pop();
+    if (!cache) {
+        Flush(size_class, list, list.count);
+    }
+    return result;
+}
+
+void BufferPool::Deallocate(void* pointer, std::size_t size) noexcept
+{
+    if (!pointer) {
+        return;
+    }
+    int size_class = ClassOf(size);
+    if (size_class < 0) {
+        ::operator delete(pointer);
+        heap_bytes_.Sub(size);
+        return;
+    }
+
+    classes_[size_class].in_use->Sub();
+    FreeList fallback;
+    ThreadCache* cache = LocalCache();
+    FreeList& list = cache ? cache->lists[size_class] : fallback;
+    if (cache && list.count >= 2 * BatchSize(size_class)) {
+        // before push: recently used slab stays in the thread, it is likely cached
+        Flush(size_class, list, BatchSize(size_class));
+    }
+    list.Push(pointer);
+    if (!cache) {
+        Flush(size_class, list, list.count);
+    }
+}
+
+void BufferPool::Refill(int size_class, FreeList& cache)
+{
+    SharedClass& shared = classes_[size_class];
+    const std::size_t slab_size = kSlabSizes[size_class];
+    boost::mutex::scoped_lock lock(shared.mutex);
+    if (shared.free.count == 0) {
+        // regions are 2 MiB aligned, so are slabs to their size
+        char* region = static_cast<char*>(MapRegion());
+        for (std::size_t offset = kRegionSize; offset > 0; offset -= slab_size) {
+            shared.free.Push(region + offset - slab_size);
+        }
+        shared.slabs->Add(kRegionSize / slab_size);
+    }
+    for (std::size_t i = BatchSize(size_class); i > 0 && shared.free.count > 0; --i) {
+        cache.Push(shared.free.Pop());
+    }
+}
+
+void BufferPool::Flush(int size_class, FreeList& cache, std::size_t count) noexcept
+{
+    SharedClass& shared = classes_[size_class];
+    boost::mutex::scoped_lock lock(shared.mutex);
+    for (; count > 0 && cache.count > 0; --count) {
+        shared.free.Push(cache.Pop());
+    }
+}
+
+void* BufferPool::MapRegion()
+{
+    if (huge_pages_.load(std::memory_order_relaxed)) {
+        void* region = mmap(nullptr, kRegionSize, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (region != MAP_FAILED) {
+            mapped_bytes_.Add(kRegionSize);
+            huge_page_bytes_.Add(kRegionSize);
+            return region;
+        }
+        static std::once_flag logged;
+        std::call_once(logged, []() {
+            INFO("No reserved huge pages for I/O buffers, using transparent ones");
+        });
+    }
+
+    // Map twice the size and trim to alignment, so that a transparent huge page can back the region
+    void* mapping = mmap(nullptr, 2 * kRegionSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+    const std::uintptr_t begin = reinterpret_cast<std::uintptr_t>(mapping);
+    const std::uintptr_t aligned = (begin + kRegionSize - 1) & ~(kRegionSize - 1);
+    if (aligned > begin) {
+        munmap(mapping, aligned - begin);
+    }
+    if (aligned + kRegionSize < begin + 2 * kRegionSize) {
+        munmap(reinterpret_cast<void*>(aligned + kRegionSize), begin + kRegionSize - aligned);
+    }
+    void* region = reinterpret_cast<void*>(aligned);
+    if (huge_pages_.load(std::memory_order_relaxed)) {
+        madvise(region, kRegionSize, MADV_HUGEPAGE);
+    }
+    mapped_bytes_.Add(kRegionSize);
+    return region;
+}
+
+BufferPool::Stats BufferPool::GetStats() const
+{
+    Stats result;
+    result.mapped_bytes = mapped_bytes_.Value();
+    result.huge_page_bytes = huge_page_bytes_.Value();
+    result.heap_bytes = heap_bytes_.Value();
+    for (std::size_t i = 0; i < kClassesCount; ++i) {
+        result.classes[i].slab_size = kSlabSizes[i];
+        result.classes[i].slabs = classes_[i].slabs->Value();
+        result.classes[i].in_use = classes_[i].in_use->Value();
+    }
+    return result;
+}
+
+IoBuffer::mutable_buffers_type PrepareRead(IoBuffer& buffer, std::size_t max_size)
+{
+    constexpr std::size_t kMinRead = 512;
+    const std::size_t size = buffer.size();
+    if (buffer.capacity() - size < kMinRead) {
+        // flat_buffer allocates max(2 * size, requested): request a whole slab not smaller than that
+        buffer.reserve(BufferPool::RoundUp(std::max(2 * size, size + kMinRead)));
+    }
+    return buffer.prepare(std::min(buffer.capacity() - size, max_size));
+}
+
+void ReleaseBuffer(IoBuffer& buffer)
+{
+    if (buffer.size() == 0) {
+        buffer.shrink_to_fit();
+    }
+}
+
+BufferPool::Configuration ConfigureBufferPool(const YAML::Node& config)
+{
+    BufferPool::Configuration result;
+    if (!config["buffers"].IsDefined()) {
+        return result;
+    }
+
+    const YAML::Node& node = config["buffers"];
+    if (!node.IsMap()) {
+        EXCEPTION("buffers node must be a map");
+    }
+    if (node["huge_pages"].IsDefined()) {
+        result.huge_pages = node["huge_pages"].as<bool>();
+    }
+    return result;
+}
+
+} // namespace lb::tcp
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace YAML {class Node;}
+
+namespace lb::metrics {class Gauge;}
+
+namespace lb::tcp {
+
+// Process-wide memory of I/O buffers. Slabs of a few fixed sizes are carved
+// from 2 MiB regions mapped with huge pages when the system has them
+// reserved (transparent huge pages are requested otherwise). Every thread
+// keeps own free lists, the shared ones are touched only to move slabs in
+// batches. Regions are never unmapped: memory use is bounded by the peak.
+class BufferPool {
+public:
+    static constexpr std::size_t kClassesCount = 3;
+    static constexpr std::array<std::size_t, kClassesCount> kSlabSizes = {4 * 1024, 16 * 1024, 64 * 1024};
+    static constexpr std::size_t kMaxBufferCapacity = kSlabSizes.back(); // larger ones come from heap
+    static constexpr std::size_t kRegionSize = 2 * 1024 * 1024;
+
+    struct Configuration {
+        bool huge_pages = true;
+    };
+
+    struct ClassStats {
+        std::size_t slab_size = 0;
+        std::size_t slabs = 0;  // carved from regions
+        std::size_t in_use = 0;
+    };
+
+    struct Stats {
+        std::size_t mapped_bytes = 0;
+        std::size_t huge_page_bytes = 0; // part of mapped bytes backed by reserved huge pages
+        std::size_t heap_bytes = 0;      // buffers larger than slabs
+        std::array<ClassStats, kClassesCount> classes;
+    };
+public:
+    static BufferPool& Instance();
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    // Applies to regions mapped afterwards
+    void Configure(const Configuration& config);
+
+    void* Allocate(std::size_t size);
+
+    // Size must be the one passed to Allocate
+    void Deallocate(void* pointer, std::size_t size) noexcept;
+
+    // Slab size serving allocation of size bytes, size itself if no slab fits
+    static std::size_t RoundUp(std::size_t size);
+
+    Stats GetStats() const;
+private:
+    struct FreeSlab {
+        FreeSlab* next;
+    };
+
+    struct FreeList {
+        FreeSlab* head = nullptr;
+        std::size_t count = 0;
+
+        void Push(void* slab);
+        void* Pop();
+    };
+
+    struct SharedClass {
+        boost::mutex mutex;
+        FreeList free; // guarded by mutex
+        metrics::Gauge* slabs;
+        metrics::Gauge* in_use;
+    };
+
+    class ThreadCache;
+private:
+    BufferPool();
+
+    static int ClassOf(std::size_t size);
+
+    // Number of slabs moved between thread and shared lists at once
+    static std::size_t BatchSize(int size_class);
+
+    void Refill(int size_class, FreeList& cache);
+
+    void Flush(int size_class, FreeList& cache, std::size_t count) noexcept;
+
+    // nullptr while the thread is exiting
+    ThreadCache* LocalCache();
+
+    void* MapRegion();
+private:
+    std::array<SharedClass, kClassesCount> classes_;
+    std::atomic<bool> huge_pages_{true};
+    metrics::Gauge& mapped_bytes_;
+    metrics::Gauge& huge_page_bytes_;
+    metrics::Gauge& heap_bytes_;
+};
+
+// Allocator drawing memory from BufferPool
+template <class T>
+class BufferAllocator {
+public:
+    using value_type = T;
+    using propagate_on_container_move_assignment = std::true_type;
+    using is_always_equal = std::true_type;
+public:
+    BufferAllocator() = default;
+
+    template <class U>
+    BufferAllocator(const BufferAllocator<U>&) noexcept
+    {}
+
+    T* allocate(std::size_t n)
+    {
+        return static_cast<T*>(BufferPool::Instance().Allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T* pointer, std::size_t n) noexcept
+    {
+        BufferPool::Instance().Deallocate(pointer, n * sizeof(T));
+    }
+
+    template <class U>
+    bool operator==(const BufferAllocator<U>&) const noexcept
+    {
+        return true;
+    }
+
+    template <class U>
+    bool operator!=(const BufferAllocator<U>&) const noexcept
+    {
+        return false;
+    }
+};
+
+using IoBuffer = boost::beast::basic_flat_buffer<BufferAllocator<char>>;
+
+// Space for the next read of at most max_size bytes. Buffer grows a whole
+// slab at a time: flat_buffer alone would reallocate on every doubling.
+IoBuffer::mutable_buffers_type PrepareRead(IoBuffer& buffer, std::size_t max_size);
+
+// Returns storage of a buffer without data to the pool
+void ReleaseBuffer(IoBuffer& buffer);
+
+// Reads optional buffers node: {huge_pages: bool}
+BufferPool::Configuration ConfigureBufferPool(const YAML::Node& config);
+
+} // namespace lb::tcp
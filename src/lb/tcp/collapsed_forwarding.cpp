@@ -0,0 +1,159 @@
+#include <lb/tcp/collapsed_forwarding.hpp>
+#include <lb/logging.hpp>
+#include <lb/metrics.hpp>
+
+#include <yaml-cpp/yaml.h>
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+namespace lb::tcp {
+
+// ============================ CollapseLead ============================
+
+CollapseLead::CollapseLead(CollapsedForwarding* forwarding, std::string key)
+    : forwarding_(forwarding)
+    , key_(std::move(key))
+{}
+
+CollapseLead::CollapseLead(CollapseLead&& other) noexcept
+    : forwarding_(std::exchange(other.forwarding_, nullptr))
+    , key_(std::move(other.key_))
+{}
+
+CollapseLead& CollapseLead::operator=(CollapseLead&& other) noexcept
+{
+    if (this != &other) {
+        Complete(nullptr);
+        forwarding_ = std::exchange(other.forwarding_, nullptr);
+        key_ = std::move(other.key_);
+    }
+    return *this;
+}
+
+CollapseLead::~CollapseLead()
+{
+    Complete(nullptr);
+}
+
+CollapseLead::operator bool() const
+{
+    return forwarding_ != nullptr;
+}
+
+void CollapseLead::Complete(CachedResponsePtr response)
+{
+    if (forwarding_) {
+        std::exchange(forwarding_, nullptr)->Complete(key_, response);
+    }
+}
+
+// ============================ CollapsedForwarding ============================
+
+CollapsedForwarding::CollapsedForwarding(const Configuration& config, const std::string& pool_name)
+    : config_(config)
+    , collapsed_(metrics::Registry::Instance().GetCounter("pools." + pool_name + ".collapsed"))
+    , timeouts_(metrics::Registry::Instance().GetCounter("pools." + pool_name + ".collapse_timeouts"))
+{}
+
+const CollapsedForwarding::Configuration& CollapsedForwarding::Config() const
+{
+    return config_;
+}
+
+CollapseLead CollapsedForwarding::Lead(const std::string& key)
+{
+    Shard& shard = ShardOf(key);
+    boost::mutex::scoped_lock lock(shard.mutex);
+    if (!shard.waiters.try_emplace(key).second) {
+        return CollapseLead();
+    }
+    return CollapseLead(this, key);
+}
+
+bool CollapsedForwarding::Enqueue(const std::string& key, const CollapseWaiterPtr& waiter)
+{
+    Shard& shard = ShardOf(key);
+    boost::mutex::scoped_lock lock(shard.mutex);
+    auto it = shard.waiters.find(key);
+    if (it == shard.waiters.end()) {
+        return false;
+    }
+    it->second.push_back(waiter);
+    return true;
+}
+
+bool CollapsedForwarding::Remove(const std::string& key, const CollapseWaiter* waiter)
+{
+    Shard& shard = ShardOf(key);
+    boost::mutex::scoped_lock lock(shard.mutex);
+    auto it = shard.waiters.find(key);
+    if (it == shard.waiters.end()) {
+        return false;
+    }
+    auto& waiters = it->second;
+    auto found = std::find_if(waiters.begin(), waiters.end(),
+                              [waiter](const CollapseWaiterPtr& queued) { return queued.get() == waiter; });
+    if (found == waiters.end()) {
+        return false;
+    }
+    waiters.erase(found);
+    return true;
+}
+
+void CollapsedForwarding::OnFollowEnd(bool served, bool timed_out)
+{
+    if (served) {
+        collapsed_.Add();
+    }
+    if (timed_out) {
+        timeouts_.Add();
+    }
+}
+
+CollapsedForwarding::Shard& CollapsedForwarding::ShardOf(const std::string& key)
+{
+    return shards_[std::hash<std::string>{}(key) % kShards];
+}
+
+void CollapsedForwarding::Complete(const std::string& key, const CachedResponsePtr& response)
+{
+    std::vector<CollapseWaiterPtr> waiters;
+    {
+        Shard& shard = ShardOf(key);
+        boost::mutex::scoped_lock lock(shard.mutex);
+        auto it = shard.waiters.find(key);
+        if (it == shard.waiters.end()) {
+            return;
+        }
+        waiters = std::move(it->second);
+        shard.waiters.erase(it);
+    }
+    for (const CollapseWaiterPtr& waiter : waiters) {
+        waiter->Deliver(response);
+    }
+}
+
+CollapsedForwardingPtr ConfigureCollapsedForwarding(const YAML::Node& pool_node, const std::string& pool_name)
+{
+    if (!pool_node["collapsed_forwarding"].IsDefined()) {
+        return nullptr;
+    }
+
+    const YAML::Node& node = pool_node["collapsed_forwarding"];
+    if (!node.IsMap()) {
+        EXCEPTION("collapsed_forwarding node must be a map");
+    }
+
+    CollapsedForwarding::Configuration config;
+    if (node["max_wait_ms"].IsDefined()) {
+        config.max_wait = std::chrono::milliseconds(node["max_wait_ms"].as<std::size_t>());
+        if (config.max_wait.count() == 0) {
+            EXCEPTION("collapsed_forwarding.max_wait_ms must be positive");
+        }
+    }
+    return std::make_shared<CollapsedForwarding>(config, pool_name);
+}
+
+} // namespace lb::tcp
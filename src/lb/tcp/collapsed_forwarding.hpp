@@ -0,0 +1,195 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/thread/mutex.hpp>
+#include <lb/tcp/recycling_allocator.hpp>
+#include <lb/tcp/response_cache.hpp>
+#include <lb/tcp/socket.hpp>
+
+namespace YAML {class Node;}
+
+namespace lb::metrics {class Counter;}
+
+namespace lb::tcp {
+
+class CollapsedForwarding;
+
+// Request waiting for the response of an identical one in flight
+class CollapseWaiter {
+public:
+    virtual ~CollapseWaiter() = default;
+
+    // Called once, from the leader's thread
+    virtual void Deliver(CachedResponsePtr response) = 0;
+};
+
+using CollapseWaiterPtr = std::shared_ptr<CollapseWaiter>;
+
+// Held by the request of a key that went upstream. The response is handed
+// to requests that waited for it on Complete or destruction.
+class CollapseLead {
+public:
+    CollapseLead() = default;
+
+    CollapseLead(CollapseLead&& other) noexcept;
+    CollapseLead& operator=(CollapseLead&& other) noexcept;
+    CollapseLead(const CollapseLead&) = delete;
+    CollapseLead& operator=(const CollapseLead&) = delete;
+    ~CollapseLead();
+
+    explicit operator bool() const;
+
+    // Nullptr sends the waiting requests upstream
+    void Complete(CachedResponsePtr response);
+private:
+    friend class CollapsedForwarding;
+
+    CollapseLead(CollapsedForwarding* forwarding, std::string key);
+private:
+    CollapsedForwarding* forwarding_ = nullptr; // pools outlive sessions
+    std::string key_;
+};
+
+// Collapses identical GETs of a pool in flight at the same time: the first
+// one goes upstream, the others wait for its response and are sent the
+// same shared copy. Requests whose Vary values differ from the first one,
+// or that wait longer than max_wait, go upstream themselves.
+class CollapsedForwarding {
+public:
+    static constexpr std::size_t kShards = 16;
+
+    struct Configuration {
+        std::chrono::milliseconds max_wait{1000};
+    };
+public:
+    CollapsedForwarding(const Configuration& config, const std::string& pool_name);
+
+    CollapsedForwarding(const CollapsedForwarding&) = delete;
+    CollapsedForwarding& operator=(const CollapsedForwarding&) = delete;
+
+    const Configuration& Config() const;
+
+    // Lead of key, empty if a request with it is in flight already
+    CollapseLead Lead(const std::string& key);
+
+    // False if no request with key is in flight anymore
+    bool Enqueue(const std::string& key, const CollapseWaiterPtr& waiter);
+
+    // False if waiter was delivered the response already
+    bool Remove(const std::string& key, const CollapseWaiter* waiter);
+
+    void OnFollowEnd(bool served, bool timed_out);
+
+    // Waits for the response to the request in flight with key. Completes
+    // with void(ErrorCode, CachedResponsePtr) on executor: nullptr if the
+    // request has to go upstream itself, timed_out after max_wait.
+    template <class CompletionToken>
+    auto AsyncFollow(const std::string& key, ExecutorType executor, CompletionToken&& token);
+private:
+    friend class CollapseLead;
+
+    struct Shard {
+        boost::mutex mutex;
+        std::unordered_map<std::string, std::vector<CollapseWaiterPtr>> waiters; // by key in flight, guarded by mutex
+    };
+
+    Shard& ShardOf(const std::string& key);
+
+    void Complete(const std::string& key, const CachedResponsePtr& response);
+private:
+    const Configuration config_;
+    std::array<Shard, kShards> shards_;
+    metrics::Counter& collapsed_;
+    metrics::Counter& timeouts_;
+};
+
+using CollapsedForwardingPtr = std::shared_ptr<CollapsedForwarding>;
+
+// Reads collapsed_forwarding node of a pool, returns nullptr if it is missing
+CollapsedForwardingPtr ConfigureCollapsedForwarding(const YAML::Node& pool_node, const std::string& pool_name);
+
+// AsyncFollow operation. Delivery and max_wait race for the waiter: the one
+// that takes it out of the key's list completes the wait.
+template <class Handler>
+class CollapseFollow : public CollapseWaiter, public std::enable_shared_from_this<CollapseFollow<Handler>> {
+public:
+    using ErrorCode = boost::system::error_code;
+    using Clock = std::chrono::steady_clock;
+    using TimerType = boost::asio::basic_waitable_timer<Clock, boost::asio::wait_traits<Clock>, ExecutorType>;
+public:
+    CollapseFollow(CollapsedForwarding& forwarding, std::string key, ExecutorType executor, Handler handler)
+        : forwarding_(forwarding)
+        , key_(std::move(key))
+        , executor_(std::move(executor))
+        , timer_(executor_)
+        , handler_(std::move(handler))
+    {}
+
+    // Must be called on executor, completes through it even if no wait is needed
+    void Start()
+    {
+        if (!forwarding_.Enqueue(key_, this->shared_from_this())) {
+            Finish({}, nullptr);
+            return;
+        }
+        timer_.expires_after(forwarding_.Config().max_wait);
+        timer_.async_wait([self=this->shared_from_this()](const ErrorCode& ec) {
+            if (!ec && !self->done_ && self->forwarding_.Remove(self->key_, self.get())) {
+                self->Complete(boost::asio::error::timed_out, nullptr);
+            }
+        });
+    }
+
+    void Deliver(CachedResponsePtr response) override
+    {
+        Finish({}, std::move(response));
+    }
+private:
+    void Finish(const ErrorCode& ec, CachedResponsePtr response)
+    {
+        boost::asio::post(executor_, [self=this->shared_from_this(), ec, response=std::move(response)]() mutable {
+            if (!self->done_) {
+                self->Complete(ec, std::move(response));
+            }
+        });
+    }
+
+    void Complete(const ErrorCode& ec, CachedResponsePtr response)
+    {
+        done_ = true;
+        timer_.cancel();
+        forwarding_.OnFollowEnd(response != nullptr, ec == boost::asio::error::timed_out);
+        Handler handler = std::move(handler_);
+        handler(ec, std::move(response));
+    }
+private:
+    CollapsedForwarding& forwarding_;
+    std::string key_;
+    ExecutorType executor_;
+    TimerType timer_;
+    Handler handler_;
+    bool done_ = false;
+};
+
+template <class CompletionToken>
+auto CollapsedForwarding::AsyncFollow(const std::string& key, ExecutorType executor, CompletionToken&& token)
+{
+    auto initiation = [this, key, executor](auto handler) {
+        using Follow = CollapseFollow<decltype(handler)>;
+        auto follow = std::allocate_shared<Follow>(RecyclingAllocator<Follow>(), *this, key, executor, std::move(handler));
+        follow->Start();
+    };
+    return boost::asio::async_initiate<CompletionToken, void(boost::system::error_code, CachedResponsePtr)>(
+        std::move(initiation), token);
+}
+
+} // namespace lb::tcp
@@ -0,0 +1,242 @@
+#include <lb/tcp/connection_limits.hpp>
+#include <lb/logging.hpp>
+#include <lb/metrics.hpp>
+
+#include <yaml-cpp/yaml.h>
+
+#include <algorithm>
+#include <thread>
+#include <utility>
+
+namespace lb::tcp {
+
+// ============================ BackendSlot ============================
+
+BackendSlot::BackendSlot(ConnectionLimits* limits, std::size_t index)
+    : limits_(limits)
+    , index_(index)
+{}
+
+BackendSlot::BackendSlot(BackendSlot&& other) noexcept
+    : limits_(std::exchange(other.limits_, nullptr))
+    , index_(other.index_)
+{}
+
+BackendSlot& BackendSlot::operator=(BackendSlot&& other) noexcept
+{
+    if (this != &other) {
+        Release();
+        limits_ = std::exchange(other.limits_, nullptr);
+        index_ = other.index_;
+    }
+    return *this;
+}
+
+BackendSlot::~BackendSlot()
+{
+    Release();
+}
+
+BackendSlot::operator bool() const
+{
+    return limits_ != nullptr;
+}
+
+const Backend& BackendSlot::GetBackend() const
+{
+    return limits_->backends_[index_];
+}
+
+void BackendSlot::Release()
+{
+    if (limits_) {
+        std::exchange(limits_, nullptr)->Release(index_);
+    }
+}
+
+// ============================ ConnectionLimits ============================
+
+ConnectionLimits::ConnectionLimits(const Configuration& config,
+                                   const std::vector<Backend>& backends,
+                                   const std::string& pool_name)
+    : config_(config)
+    , backends_(backends)
+    , active_(std::make_unique<std::atomic<std::size_t>[]>(backends.size()))
+    , queue_depth_(metrics::Registry::Instance().GetGauge("pools." + pool_name + ".queue_depth"))
+    , queued_(metrics::Registry::Instance().GetCounter("pools." + pool_name + ".queued"))
+    , queue_wait_us_(metrics::Registry::Instance().GetCounter("pools." + pool_name + ".queue_wait_us"))
+    , queue_timeouts_(metrics::Registry::Instance().GetCounter("pools." + pool_name + ".queue_timeouts"))
+    , queue_full_(metrics::Registry::Instance().GetCounter("pools." + pool_name + ".queue_full"))
+{
+    for (std::size_t i = 0; i < backends_.size(); ++i) {
+        indexes_.emplace(backends_[i], i);
+        active_[i].store(0, std::memory_order_relaxed);
+    }
+    const std::size_t queues = std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+    for (std::size_t i = 0; i < queues; ++i) {
+        queues_.push_back(std::make_unique<Queue>());
+    }
+}
+
+const ConnectionLimits::Configuration& ConnectionLimits::Config() const
+{
+    return config_;
+}
+
+bool ConnectionLimits::TryAcquireIndex(std::size_t index)
+{
+    std::atomic<std::size_t>& active = active_[index];
+    std::size_t current = active.load();
+    do {
+        if (current >= config_.max_connections) {
+            return false;
+        }
+    } while (!active.compare_exchange_weak(current, current + 1));
+    return true;
+}
+
+std::optional<BackendSlot> ConnectionLimits::TryAcquire(const Backend& backend)
+{
+    std::optional<std::size_t> index = IndexOf(backend);
+    if (!index) {
+        return std::nullopt;
+    }
+    return TryAcquireIndexed(*index);
+}
+
+std::optional<BackendSlot> ConnectionLimits::TryAcquireIndexed(std::size_t index)
+{
+    if (!TryAcquireIndex(index)) {
+        return std::nullopt;
+    }
+    return BackendSlot(this, index);
+}
+
+std::optional<std::size_t> ConnectionLimits::IndexOf(const Backend& backend) const
+{
+    auto it = indexes_.find(backend);
+    if (it == indexes_.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+std::size_t ConnectionLimits::Active(const Backend& backend) const
+{
+    auto it = indexes_.find(backend);
+    return it == indexes_.end() ? 0 : active_[it->second].load(std::memory_order_relaxed);
+}
+
+std::size_t ConnectionLimits::LocalQueueIndex() const
+{
+    static std::atomic<std::size_t> threads{0};
+    thread_local const std::size_t thread_index = threads.fetch_add(1, std::memory_order_relaxed);
+    return thread_index % queues_.size();
+}
+
+ConnectionLimits::Queue& ConnectionLimits::LocalQueue()
+{
+    return *queues_[LocalQueueIndex()];
+}
+
+bool ConnectionLimits::Enqueue(std::size_t index, const SlotWaiterPtr& waiter)
+{
+    Queue& queue = LocalQueue();
+    boost::mutex::scoped_lock lock(queue.mutex);
+    if (queue.waiters.size() >= config_.max_pending) {
+        queue_full_.Add();
+        return false;
+    }
+    queue.waiters.push_back(Waiting{.index = index, .waiter = waiter});
+    // Pairs with the check in Release: either the releasing thread sees the
+    // waiter or the waiter sees the released slot
+    waiting_.fetch_add(1);
+    queue_depth_.Add();
+    queued_.Add();
+    return true;
+}
+
+bool ConnectionLimits::Remove(const SlotWaiter* waiter)
+{
+    // Waiter may have been queued on another thread
+    for (const std::unique_ptr<Queue>& queue : queues_) {
+        boost::mutex::scoped_lock lock(queue->mutex);
+        auto it = std::find_if(queue->waiters.begin(), queue->waiters.end(), [waiter](const Waiting& queued) {
+            return queued.waiter.get() == waiter;
+        });
+        if (it != queue->waiters.end()) {
+            queue->waiters.erase(it);
+            waiting_.fetch_sub(1);
+            queue_depth_.Sub();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ConnectionLimits::Release(std::size_t index)
+{
+    active_[index].fetch_sub(1);
+    if (waiting_.load() == 0) {
+        return;
+    }
+
+    const std::size_t first = LocalQueueIndex();
+    for (std::size_t i = 0; i < queues_.size(); ++i) {
+        Queue& queue = *queues_[(first + i) % queues_.size()];
+        SlotWaiterPtr waiter;
+        {
+            boost::mutex::scoped_lock lock(queue.mutex);
+            auto it = std::find_if(queue.waiters.begin(), queue.waiters.end(), [index](const Waiting& queued) {
+                return queued.index == index;
+            });
+            if (it == queue.waiters.end()) {
+                continue;
+            }
+            if (!TryAcquireIndex(index)) {
+                return; // taken by a session that did not wait
+            }
+            waiter = std::move(it->waiter);
+            queue.waiters.erase(it);
+            waiting_.fetch_sub(1);
+            queue_depth_.Sub();
+        }
+        waiter->Grant(BackendSlot(this, index));
+        return;
+    }
+}
+
+void ConnectionLimits::OnWaitEnd(std::chrono::microseconds waited, bool timed_out)
+{
+    queue_wait_us_.Add(waited.count());
+    if (timed_out) {
+        queue_timeouts_.Add();
+    }
+}
+
+ConnectionLimitsPtr ConfigureConnectionLimits(const YAML::Node& pool_node, const std::string& pool_name)
+{
+    if (!pool_node["connection_limits"].IsDefined()) {
+        return nullptr;
+    }
+
+    const YAML::Node& node = pool_node["connection_limits"];
+    if (!node.IsMap()) {
+        EXCEPTION("connection_limits node must be a map");
+    }
+
+    ConnectionLimits::Configuration config;
+    if (!node["max_connections"].IsDefined() || node["max_connections"].as<std::size_t>() == 0) {
+        EXCEPTION("connection_limits.max_connections must be positive");
+    }
+    config.max_connections = node["max_connections"].as<std::size_t>();
+    if (node["max_pending"].IsDefined()) {
+        config.max_pending = node["max_pending"].as<std::size_t>();
+    }
+    if (node["queue_timeout_ms"].IsDefined()) {
+        config.queue_timeout = std::chrono::milliseconds(node["queue_timeout_ms"].as<std::size_t>());
+    }
+    return std::make_shared<ConnectionLimits>(config, ReadBackends(pool_node), pool_name);
+}
+
+} // namespace lb::tcp
@@ -0,0 +1,246 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/thread/mutex.hpp>
+#include <lb/tcp/recycling_allocator.hpp>
+#include <lb/tcp/selectors.hpp>
+#include <lb/tcp/socket.hpp>
+
+namespace YAML {class Node;}
+
+namespace lb::metrics {
+class Counter;
+class Gauge;
+}
+
+namespace lb::tcp {
+
+class ConnectionLimits;
+
+// Connection slot of one backend, returned on destruction
+class BackendSlot {
+public:
+    BackendSlot() = default;
+
+    BackendSlot(BackendSlot&& other) noexcept;
+    BackendSlot& operator=(BackendSlot&& other) noexcept;
+    BackendSlot(const BackendSlot&) = delete;
+    BackendSlot& operator=(const BackendSlot&) = delete;
+    ~BackendSlot();
+
+    explicit operator bool() const;
+
+    // Slot must not be empty
+    const Backend& GetBackend() const;
+
+    void Release();
+private:
+    friend class ConnectionLimits;
+
+    BackendSlot(ConnectionLimits* limits, std::size_t index);
+private:
+    ConnectionLimits* limits_ = nullptr; // pools outlive sessions
+    std::size_t index_ = 0;
+};
+
+// Session waiting in a queue of ConnectionLimits
+class SlotWaiter {
+public:
+    virtual ~SlotWaiter() = default;
+
+    // Called once, from the thread that released the slot
+    virtual void Grant(BackendSlot slot) = 0;
+};
+
+using SlotWaiterPtr = std::shared_ptr<SlotWaiter>;
+
+// Caps connections of every backend of a pool. Slots are taken only on the
+// backend a session was given, the connector decides whether another one
+// may take the connection. Sessions that have to wait for a slot of their
+// backend wait in FIFO queues, one per thread shard, each bounded by
+// max_pending. A released slot goes to the oldest waiter for its backend in
+// the releasing thread's queue, then in the other queues.
+class ConnectionLimits {
+public:
+    struct Configuration {
+        std::size_t max_connections = 0; // per backend
+        std::size_t max_pending = 100;   // waiting sessions per queue, 0 - sessions don't wait
+        std::chrono::milliseconds queue_timeout{1000};
+    };
+public:
+    // Metrics are named after the pool
+    ConnectionLimits(const Configuration& config, const std::vector<Backend>& backends, const std::string& pool_name);
+
+    ConnectionLimits(const ConnectionLimits&) = delete;
+    ConnectionLimits& operator=(const ConnectionLimits&) = delete;
+
+    const Configuration& Config() const;
+
+    // Slot of backend, nullopt if it is at its cap or not in the pool
+    std::optional<BackendSlot> TryAcquire(const Backend& backend);
+
+    // Connections to backend
+    std::size_t Active(const Backend& backend) const;
+
+    // Index of backend in the pool, nullopt if it is not there
+    std::optional<std::size_t> IndexOf(const Backend& backend) const;
+
+    // Queues waiter for a slot of backend index unless the local queue is full
+    bool Enqueue(std::size_t index, const SlotWaiterPtr& waiter);
+
+    // Slot of backend index if it is under its cap
+    std::optional<BackendSlot> TryAcquireIndexed(std::size_t index);
+
+    // False if waiter was granted a slot already
+    bool Remove(const SlotWaiter* waiter);
+
+    void OnWaitEnd(std::chrono::microseconds waited, bool timed_out);
+
+    // Waits in the local queue for a slot of backend. Completes with
+    // void(ErrorCode, BackendSlot) on executor: no_buffer_space if the queue
+    // is full, timed_out after queue_timeout, invalid_argument if backend is
+    // not in the pool.
+    template <class CompletionToken>
+    auto AsyncWait(const Backend& backend, ExecutorType executor, CompletionToken&& token);
+private:
+    friend class BackendSlot;
+
+    struct Waiting {
+        std::size_t index; // of the backend waited for
+        SlotWaiterPtr waiter;
+    };
+
+    struct Queue {
+        boost::mutex mutex;
+        std::deque<Waiting> waiters; // guarded by mutex
+    };
+
+    bool TryAcquireIndex(std::size_t index);
+
+    void Release(std::size_t index);
+
+    // Queue of the calling thread
+    std::size_t LocalQueueIndex() const;
+
+    Queue& LocalQueue();
+private:
+    const Configuration config_;
+    std::vector<Backend> backends_;
+    std::unordered_map<Backend, std::size_t, BackendHasher> indexes_;
+    std::unique_ptr<std::atomic<std::size_t>[]> active_; // per backend
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::atomic<std::size_t> waiting_{0}; // in all queues
+    metrics::Gauge& queue_depth_;
+    metrics::Counter& queued_;
+    metrics::Counter& queue_wait_us_;
+    metrics::Counter& queue_timeouts_;
+    metrics::Counter& queue_full_;
+};
+
+using ConnectionLimitsPtr = std::shared_ptr<ConnectionLimits>;
+
+// Reads connection_limits node of a pool, returns nullptr if it is missing
+ConnectionLimitsPtr ConfigureConnectionLimits(const YAML::Node& pool_node, const std::string& pool_name);
+
+// AsyncWait operation. Grant and the queue timeout race for the waiter:
+// the one that takes it out of the queue completes the wait.
+template <class Handler>
+class SlotWait : public SlotWaiter, public std::enable_shared_from_this<SlotWait<Handler>> {
+public:
+    using ErrorCode = boost::system::error_code;
+    using Clock = std::chrono::steady_clock;
+    using TimerType = boost::asio::basic_waitable_timer<Clock, boost::asio::wait_traits<Clock>, ExecutorType>;
+public:
+    SlotWait(ConnectionLimits& limits, std::optional<std::size_t> index, ExecutorType executor, Handler handler)
+        : limits_(limits)
+        , index_(index)
+        , executor_(std::move(executor))
+        , timer_(executor_)
+        , handler_(std::move(handler))
+        , start_(Clock::now())
+    {}
+
+    // Must be called on executor, completes through it even if no wait is needed
+    void Start()
+    {
+        if (!index_) {
+            Finish(boost::asio::error::invalid_argument, {});
+            return;
+        }
+        if (!limits_.Enqueue(*index_, this->shared_from_this())) {
+            Finish(boost::asio::error::no_buffer_space, {});
+            return;
+        }
+        timer_.expires_after(limits_.Config().queue_timeout);
+        timer_.async_wait([self=this->shared_from_this()](const ErrorCode& ec) {
+            if (!ec && !self->done_ && self->limits_.Remove(self.get())) {
+                self->Complete(boost::asio::error::timed_out, {});
+            }
+        });
+        // Slot released while the waiter was being queued
+        if (std::optional<BackendSlot> slot = limits_.TryAcquireIndexed(*index_)) {
+            if (limits_.Remove(this)) {
+                Finish({}, std::move(*slot));
+            }
+        }
+    }
+
+    void Grant(BackendSlot slot) override
+    {
+        Finish({}, std::move(slot));
+    }
+private:
+    void Finish(const ErrorCode& ec, BackendSlot slot)
+    {
+        boost::asio::post(executor_, [self=this->shared_from_this(), ec, slot=std::move(slot)]() mutable {
+            if (!self->done_) {
+                self->Complete(ec, std::move(slot));
+            }
+        });
+    }
+
+    void Complete(const ErrorCode& ec, BackendSlot slot)
+    {
+        done_ = true;
+        timer_.cancel();
+        if (ec != boost::asio::error::no_buffer_space && ec != boost::asio::error::invalid_argument) {
+            limits_.OnWaitEnd(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start_),
+                              ec == boost::asio::error::timed_out);
+        }
+        Handler handler = std::move(handler_);
+        handler(ec, std::move(slot));
+    }
+private:
+    ConnectionLimits& limits_;
+    std::optional<std::size_t> index_;
+    ExecutorType executor_;
+    TimerType timer_;
+    Handler handler_;
+    Clock::time_point start_;
+    bool done_ = false;
+};
+
+template <class CompletionToken>
+auto ConnectionLimits::AsyncWait(const Backend& backend, ExecutorType executor, CompletionToken&& token)
+{
+    auto initiation = [this, index=IndexOf(backend), executor](auto handler) {
+        using Wait = SlotWait<decltype(handler)>;
+        auto wait = std::allocate_shared<Wait>(RecyclingAllocator<Wait>(), *this, index, executor, std::move(handler));
+        wait->Start();
+    };
+    return boost::asio::async_initiate<CompletionToken, void(boost::system::error_code, BackendSlot)>(
+        std::move(initiation), token);
+}
+
+} // namespace lb::tcp
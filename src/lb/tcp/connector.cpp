@@ -1,159 +1,337 @@
 #include <lb/logging.hpp>
+#include <lb/metrics.hpp>
 #include <lb/tcp/connector.hpp>
+#include <lb/tcp/coroutine_session.hpp>
 #include <lb/tcp/session.hpp>
 
-using SocketType = lb::tcp::HttpSession::SocketType;
+#include <yaml-cpp/yaml.h>
+
+#include <algorithm>
 
 namespace lb::tcp {
 
-Connector::Connector(boost::asio::io_context& ctx, SelectorPtr selector)
+namespace {
+
+template <class Session>
+SessionPtr MakeSession(SocketType client_socket,
+                       const Connector::EndpointType& client_endpoint,
+                       Connector& connector,
+                       AdmissionTicket ticket,
+                       ConcurrencyLimitPtr connects_limit)
+{
+    // session objects are recycled through per-thread cache
+    return std::allocate_shared<Session>(RecyclingAllocator<Session>(), std::move(client_socket), client_endpoint,
+                                         connector, std::move(ticket), std::move(connects_limit));
+}
+
+template <template <class> class Session>
+Connector::SessionFactory ChooseNotifier(const Router& router)
+{
+    std::optional<SelectorType> type = router.CommonSelectorType();
+    if (!type) {
+        return &MakeSession<Session<AnyNotifier>>;
+    }
+    switch (*type) {
+    case SelectorType::LEAST_CONNECTIONS:
+        return &MakeSession<Session<LeastConnectionsNotifier>>;
+    case SelectorType::LEAST_RESPONSE_TIME:
+        return &MakeSession<Session<LeastResponseTimeNotifier>>;
+    default:
+        return &MakeSession<Session<NoopNotifier>>;
+    }
+}
+
+Connector::SessionFactory ChooseSessionFactory(const Router& router, SessionEngine engine)
+{
+#ifdef LB_COROUTINE_SESSIONS
+    if (engine == SessionEngine::COROUTINES) {
+        return ChooseNotifier<CoroutineSession>(router);
+    }
+#endif
+    return ChooseNotifier<HttpSession>(router);
+}
+
+} // anonymous namespace
+
+SessionEngine ConfigureSessionEngine(const YAML::Node& config)
+{
+    if (!config["sessions"].IsDefined()) {
+        return SessionEngine::CALLBACKS;
+    }
+    const YAML::Node& node = config["sessions"];
+    if (!node.IsMap()) {
+        EXCEPTION("sessions node must be a map");
+    }
+    if (!node["engine"].IsDefined()) {
+        return SessionEngine::CALLBACKS;
+    }
+    const std::string engine = node["engine"].as<std::string>();
+    if (engine == "callbacks") {
+        return SessionEngine::CALLBACKS;
+    }
+    if (engine == "coroutines") {
+#ifndef LB_COROUTINE_SESSIONS
+        EXCEPTION("lb2 is built without coroutine sessions, reconfigure with -DLB2_COROUTINE_SESSIONS=ON");
+#endif
+        return SessionEngine::COROUTINES;
+    }
+    EXCEPTION("Unknown session engine: {}", engine);
+}
+
+Connector::Connector(boost::asio::io_context& ctx,
+                     RouterPtr router,
+                     AdmissionControlPtr admission,
+                     RateLimiterPtr rate_limiter,
+                     SessionEngine engine,
+                     SessionTimeouts timeouts,
+                     RetryPolicy retry_policy,
+                     DeadlinePolicy deadline_policy)
     : ioc(ctx)
-    , resolver(boost::asio::make_strand(ctx))
-    , selector(selector)
+    , router(std::move(router))
+    , admission(admission ? std::move(admission) : std::make_shared<AdmissionControl>())
+    , rate_limiter(std::move(rate_limiter))
+    , make_session(ChooseSessionFactory(*this->router, engine))
+    , timers(ctx)
+    , timeouts(timeouts)
+    , retry_policy(retry_policy)
+    , retry_budget(retry_policy.budget)
+    , deadline_policy(std::move(deadline_policy))
+    , retries(metrics::Registry::Instance().GetCounter("connects.retries"))
+    , retries_exhausted(metrics::Registry::Instance().GetCounter("connects.retry_budget_exhausted"))
+    , replays(metrics::Registry::Instance().GetCounter("requests.replays"))
+    , hedges(metrics::Registry::Instance().GetCounter("requests.hedges"))
+    , hedges_exhausted(metrics::Registry::Instance().GetCounter("requests.hedge_budget_exhausted"))
+    , hedge_wins(metrics::Registry::Instance().GetCounter("requests.hedge_wins"))
 {}
 
+RateLimiter* Connector::ClientRateLimiter()
+{
+    return rate_limiter.get();
+}
 
-class LeastConnectionsCallbacks : public StateNotifier
+AdmissionControl& Connector::Admission()
 {
-public:
-    LeastConnectionsCallbacks(Backend backend, SelectorPtr selector)
-        : StateNotifier()
-        , backend(std::move(backend))
-        , selector(std::dynamic_pointer_cast<LeastConnectionsSelector>(selector))
-    {}
+    return *admission;
+}
+
+TimerService& Connector::Timers()
+{
+    return timers;
+}
+
+const SessionTimeouts& Connector::Timeouts() const
+{
+    return timeouts;
+}
+
+const DeadlinePolicy& Connector::Deadlines() const
+{
+    return deadline_policy;
+}
 
-    void OnConnect() override
-    {
-        selector->IncreaseConnectionCount(backend);
-    }
 
-    void OnDisconnect() override
-    {
-        selector->DecreaseConnectionCount(backend);
+void Connector::MakeAndRunSession(SocketType client_socket,
+                                  const EndpointType& client_endpoint,
+                                  AdmissionTicket ticket,
+                                  ConcurrencyLimitPtr connects_limit)
+{
+    DEBUG("In connector");
+    SessionPtr session = make_session(std::move(client_socket), client_endpoint, *this, std::move(ticket),
+                                      std::move(connects_limit));
+    session->Run();
+}
+
+Pool* Connector::Route(const MessageView& request)
+{
+    return router->Select(request);
+}
+
+Connector::Connection Connector::SelectBackend(Pool& pool,
+                                              const MessageView& request,
+                                              const EndpointType& client_endpoint)
+{
+    retry_budget.Deposit();
+    if (pool.sticky) {
+        std::optional<Backend> backend;
+        request.ForEach(boost::beast::http::field::cookie, [&](std::string_view cookie) {
+            if (!backend) {
+                backend = pool.sticky->Lookup(cookie);
+            }
+        });
+        if (backend) {
+            DEBUG("Sticky backend: {}", *backend);
+            return Connection{.backend = std::move(*backend)};
+        }
     }
 
-    using StateNotifier::StateNotifier;
-private:
-    Backend backend;
-    std::shared_ptr<LeastConnectionsSelector> selector;
-};
+    Backend backend = pool.selector->SelectBackend(client_endpoint);
+    std::string set_cookie = pool.sticky ? pool.sticky->MakeSetCookie(backend) : "";
+    return Connection{.backend = std::move(backend), .set_cookie = std::move(set_cookie)};
+}
 
+std::optional<Connector::Connection> Connector::Reselect(Pool& pool,
+                                                         const TriedBackends& tried,
+                                                         const ErrorCode& error,
+                                                         const EndpointType& client_endpoint)
+{
+    // Aborted connects belong to closed sessions
+    if (error == boost::asio::error::operation_aborted || tried.size() >= retry_policy.connect_attempts) {
+        return std::nullopt;
+    }
+    // Refusing backends are only skipped by this request: excluding them from
+    // the selector would be for good, and the last one can not be excluded
+    return NextBackend(pool, tried, client_endpoint, retries);
+}
 
-class LeastResponseTimeCallbacks : public StateNotifier
+std::optional<Connector::Connection> Connector::TakeSlot(Pool& pool,
+                                                        Connection connection,
+                                                        const TriedBackends& tried,
+                                                        const EndpointType& client_endpoint)
 {
-public:
-    using TimeType = decltype(std::chrono::high_resolution_clock::now());
-public:
-    LeastResponseTimeCallbacks(Backend backend, SelectorPtr selector)
-        : StateNotifier()
-        , backend(std::move(backend))
-        , selector(std::dynamic_pointer_cast<LeastResponseTimeSelector>(selector))
-    {}
+    if (std::optional<BackendSlot> slot = pool.limits->TryAcquire(connection.backend)) {
+        connection.slot = std::move(*slot);
+        return connection;
+    }
+    const SelectorType type = pool.selector->Type();
+    const bool bound = (pool.sticky && connection.set_cookie.empty())
+                    || type == SelectorType::IP_HASH
+                    || type == SelectorType::CONSISTENT_HASH;
+    if (bound) {
+        return std::nullopt;
+    }
 
-    void OnRequestSent() override
-    {
-        response_begin = std::chrono::high_resolution_clock::now();
+    // Selector skips backends it excluded, a few picks give the others
+    for (std::size_t i = 0; i < 2 * RetryPolicy::kMaxConnectAttempts; ++i) {
+        Backend next = pool.selector->SelectBackend(client_endpoint);
+        if (next == connection.backend || std::find(tried.begin(), tried.end(), next) != tried.end()) {
+            continue;
+        }
+        if (std::optional<BackendSlot> slot = pool.limits->TryAcquire(next)) {
+            std::string set_cookie = pool.sticky ? pool.sticky->MakeSetCookie(next) : "";
+            return Connection{.backend = std::move(next), .set_cookie = std::move(set_cookie), .slot = std::move(*slot)};
+        }
     }
+    return std::nullopt;
+}
 
-    void OnResponseReceive() override
-    {
-        response_end = std::chrono::high_resolution_clock::now();
-        std::chrono::duration<long, std::nano> duration = response_end - response_begin;
-        selector->AddResponseTime(backend, duration.count());
+bool Connector::Replayable(const MessageHead& request) const
+{
+    using boost::beast::http::verb;
+    switch (request.method) {
+    case verb::get:
+    case verb::head:
+    case verb::put:
+    case verb::delete_:
+    case verb::options:
+    case verb::trace:
+        return request.message_size <= retry_policy.replay_max_bytes;
+    default:
+        return false;
     }
+}
 
-    using StateNotifier::StateNotifier;
-private:
-    Backend backend;
-    std::shared_ptr<LeastResponseTimeSelector> selector;
-    TimeType response_begin;
-    TimeType response_end;
-};
+std::optional<Connector::Connection> Connector::Replay(Pool& pool,
+                                                       const TriedBackends& tried,
+                                                       const ErrorCode& error,
+                                                       const EndpointType& client_endpoint)
+{
+    // Stale keep-alive connections are closed or reset by backends
+    const bool closed = error == boost::asio::error::eof
+                     || error == boost::asio::error::connection_reset
+                     || error == boost::asio::error::connection_aborted
+                     || error == boost::asio::error::broken_pipe;
+    if (!closed || tried.size() >= retry_policy.connect_attempts) {
+        return std::nullopt;
+    }
+    return NextBackend(pool, tried, client_endpoint, replays);
+}
 
-SessionPtr MakeSession(SelectorPtr& selector,
-                       SocketType client_socket,
-                       SocketType server_socket,
-                       Backend backend)
+std::optional<Connector::Connection> Connector::NextBackend(Pool& pool,
+                                                            const TriedBackends& tried,
+                                                            const EndpointType& client_endpoint,
+                                                            metrics::Counter& counter)
 {
-    switch (selector->Type()) {
-    case SelectorType::LEAST_CONNECTIONS:
-    {
-        return std::make_shared<HttpSession>(std::move(client_socket), std::move(server_socket),
-                                             std::make_unique<LeastConnectionsCallbacks>(std::move(backend), selector));
-    } break;
+    if (!retry_budget.TryWithdraw()) {
+        DEBUG("Retry budget exhausted");
+        retries_exhausted.Add();
+        return std::nullopt;
+    }
+    counter.Add();
 
-    case SelectorType::LEAST_RESPONSE_TIME:
-    {
-        return std::make_shared<HttpSession>(std::move(client_socket), std::move(server_socket),
-                                             std::make_unique<LeastResponseTimeCallbacks>(std::move(backend), selector));
-    } break;
-    default:
-        return std::make_shared<HttpSession>(std::move(client_socket), std::move(server_socket));
+    Backend next = Untried(pool, tried, client_endpoint);
+    std::string next_cookie = pool.sticky ? pool.sticky->MakeSetCookie(next) : "";
+    return Connection{.backend = std::move(next), .set_cookie = std::move(next_cookie)};
+}
+
+Backend Connector::Untried(Pool& pool, const TriedBackends& tried, const EndpointType& client_endpoint)
+{
+    // Hash selectors map a client to one backend, other source ports are
+    // tried until they give a backend not tried yet
+    auto is_tried = [&tried](const Backend& backend) {
+        return std::find(tried.begin(), tried.end(), backend) != tried.end();
+    };
+    Backend next = pool.selector->SelectBackend(client_endpoint);
+    EndpointType endpoint = client_endpoint;
+    for (std::size_t i = 0; i < 2 * RetryPolicy::kMaxConnectAttempts && is_tried(next); ++i) {
+        endpoint.port(endpoint.port() + 1);
+        next = pool.selector->SelectBackend(endpoint);
     }
+    return next;
 }
 
+bool Connector::Hedgeable(const Pool& pool, const MessageHead& request) const
+{
+    using boost::beast::http::verb;
+    return pool.hedging
+        && (request.method == verb::get || request.method == verb::head)
+        && Replayable(request);
+}
 
-void Connector::MakeAndRunSession(SocketType client_socket)
+std::optional<Connector::Connection> Connector::Hedge(Pool& pool,
+                                                      const TriedBackends& tried,
+                                                      const EndpointType& client_endpoint)
 {
-    DEBUG("In connector");
-    Backend backend = selector->SelectBackend(client_socket.remote_endpoint());
-
-    if (backend.IsIpEndpoint()) {
-        DEBUG("Is ip endpoint");
-        auto server_socket = std::make_shared<SocketType>(client_socket.get_executor());
-
-        server_socket->async_connect(
-            backend.AsEndpoint(),
-            [this, server_socket, client_socket=std::move(client_socket), backend=std::move(backend)]
-            (const boost::system::error_code& error) mutable
-            {
-                if (error) {
-                    ERROR("{}", error.message());
-                    if (error == boost::asio::error::connection_refused) {
-                        selector->ExcludeBackend(std::move(backend));
-                        MakeAndRunSession(std::move(client_socket));
-                    }
-                    return;
-                }
-                SessionPtr session = MakeSession(selector, std::move(client_socket), std::move(*server_socket), std::move(backend));
-                session->Run();
-            });
-    } else if (backend.IsUrl()) {
-        DEBUG("Is url");
-        auto server_socket = std::make_shared<SocketType>(client_socket.get_executor());
-
-        const auto& url = backend.AsUrl();
-        DEBUG("URL: hostname: {}, port: {}", url.Hostname(), url.Port());
-        ResolverQuery resolve_query{url.Hostname(), url.Port()};
-        resolver.async_resolve(
-            resolve_query,
-            [this, server_socket, client_socket=std::move(client_socket), backend=std::move(backend)]
-            (const boost::system::error_code& error, ResolverResults resolver_results) mutable
-            {
-                if (error) {
-                    ERROR("Resolve error: {}", error.message());
-                    if (error == boost::asio::error::connection_refused) {
-                        selector->ExcludeBackend(backend);
-                        MakeAndRunSession(std::move(client_socket));
-                    }
-                    return;
-                }
-                DEBUG("Resolved successfully!");
-                boost::asio::async_connect(
-                    *server_socket,
-                    resolver_results,
-                    [this, server_socket, client_socket=std::move(client_socket), backend=std::move(backend)]
-                    (const boost::system::error_code& error, const boost::asio::ip::tcp::endpoint& endpoint) mutable
-                    {
-                        if (error) {
-                            ERROR("{}", error.message());
-                            return;
-                        }
-                        SessionPtr session = MakeSession(selector, std::move(client_socket), std::move(*server_socket), std::move(backend));
-                        session->Run();
-                    });
-            });
+    if (tried.size() >= RetryPolicy::kMaxConnectAttempts) {
+        return std::nullopt;
+    }
+    Backend backend = Untried(pool, tried, client_endpoint);
+    if (std::find(tried.begin(), tried.end(), backend) != tried.end()) {
+        return std::nullopt;
+    }
+    // hedges never wait for a slot
+    BackendSlot slot;
+    if (pool.limits) {
+        std::optional<BackendSlot> free = pool.limits->TryAcquire(backend);
+        if (!free) {
+            return std::nullopt;
+        }
+        slot = std::move(*free);
+    }
+    // nor for a permit, the hedge's response time is sampled like any other
+    AdaptiveConcurrency::Permit permit;
+    if (pool.concurrency) {
+        std::optional<AdaptiveConcurrency::Permit> free = pool.concurrency->TryAcquire(backend);
+        if (!free) {
+            return std::nullopt;
+        }
+        permit = std::move(*free);
     }
+    if (!pool.hedging->TryWithdraw()) {
+        DEBUG("Hedging budget of pool {} exhausted", pool.name);
+        hedges_exhausted.Add();
+        return std::nullopt;
+    }
+    hedges.Add();
+    std::string set_cookie = pool.sticky ? pool.sticky->MakeSetCookie(backend) : "";
+    return Connection{.backend = std::move(backend),
+                      .set_cookie = std::move(set_cookie),
+                      .slot = std::move(slot),
+                      .permit = std::move(permit)};
+}
+
+void Connector::CountHedgeWin()
+{
+    hedge_wins.Add();
 }
 
 } // namespace lb::tcp
@@ -1,31 +1,270 @@
 #pragma once
 
 #include <boost/asio.hpp>
-#include <lb/tcp/selectors.hpp>
+#include <boost/beast/http.hpp>
+#include <lb/tcp/admission.hpp>
+#include <lb/tcp/deadline.hpp>
+#include <lb/tcp/happy_eyeballs.hpp>
+#include <lb/tcp/hedging.hpp>
+#include <lb/tcp/rate_limiter.hpp>
+#include <lb/tcp/retry.hpp>
+#include <lb/tcp/router.hpp>
 #include <lb/tcp/session.hpp>
+#include <lb/tcp/socket.hpp>
+#include <lb/tcp/timeouts.hpp>
+#include <lb/tcp/timer_wheel.hpp>
 
 #include <memory>
+#include <optional>
+
+namespace YAML {class Node;}
+
+namespace lb::metrics {class Counter;}
 
 namespace lb::tcp {
 
+enum class SessionEngine {
+    CALLBACKS=0,
+    COROUTINES, // needs lb2 built with LB2_COROUTINE_SESSIONS
+};
+
+// Reads optional sessions node: {engine: callbacks|coroutines}
+SessionEngine ConfigureSessionEngine(const YAML::Node& config);
+
 class Connector {
 public:
     using ResolverResults = boost::asio::ip::tcp::resolver::results_type;
     using ResolverQuery = boost::asio::ip::tcp::resolver::query;
+    using ResolverType = boost::asio::ip::tcp::resolver;
+    using SocketType = tcp::SocketType;
+    using EndpointType = boost::asio::ip::tcp::endpoint;
+    using ErrorCode = boost::system::error_code;
+
+    struct Connection {
+        Backend backend;
+        std::string set_cookie; // empty if client is already bound to backend
+        BackendSlot slot;       // held in pools with connection limits
+        AdaptiveConcurrency::Permit permit; // held by hedges of pools with adaptive concurrency
+    };
+
+    // Creates session instantiated for notifier policy of the router's selectors
+    using SessionFactory = SessionPtr (*)(SocketType client,
+                                          const EndpointType& client_endpoint,
+                                          Connector& connector,
+                                          AdmissionTicket ticket,
+                                          ConcurrencyLimitPtr connects_limit);
 public:
-    explicit Connector(boost::asio::io_context& ctx, SelectorPtr selector);
+    Connector(boost::asio::io_context& ctx,
+              RouterPtr router,
+              AdmissionControlPtr admission = nullptr,
+              RateLimiterPtr rate_limiter = nullptr,
+              SessionEngine engine = SessionEngine::CALLBACKS,
+              SessionTimeouts timeouts = {},
+              RetryPolicy retry_policy = {},
+              DeadlinePolicy deadline_policy = {});
 
     Connector(const Connector&) = delete;
     Connector& operator=(const Connector& other) = delete;
     Connector(Connector&&) = delete;
     Connector& operator=(Connector&&) = delete;
 
-    void MakeAndRunSession(boost::asio::ip::tcp::socket client);
+    // Upstream connects of the session take a slot of connects_limit too if it is set
+    void MakeAndRunSession(SocketType client,
+                           const EndpointType& client_endpoint,
+                           AdmissionTicket ticket = {},
+                           ConcurrencyLimitPtr connects_limit = nullptr);
+
+    // Pool serving the request, nullptr if there is none
+    Pool* Route(const MessageView& request);
+
+    // Backend of the first connect attempt: bound by sticky cookie or chosen
+    // by selector. Sessions admit connects and connect on their own.
+    Connection SelectBackend(Pool& pool, const MessageView& request, const EndpointType& client_endpoint);
+
+    // Backend for the next attempt after tried.back() failed with error,
+    // not tried yet if the selector has one. Nullopt once attempts or the
+    // retry budget are used up.
+    std::optional<Connection> Reselect(Pool& pool,
+                                       const TriedBackends& tried,
+                                       const ErrorCode& error,
+                                       const EndpointType& client_endpoint);
+
+    // Connection holding a slot of pool's connection limits: on its backend
+    // or, if that one is at its cap and the client is not bound to it by a
+    // sticky cookie or hash selector, on another backend the selector gives
+    // that is not in tried. Nullopt if the session has to wait for a slot of
+    // its backend.
+    std::optional<Connection> TakeSlot(Pool& pool,
+                                       Connection connection,
+                                       const TriedBackends& tried,
+                                       const EndpointType& client_endpoint);
+
+    // True if request may be sent again after the upstream closed without
+    // responding: it is idempotent and small enough to be kept buffered
+    bool Replayable(const MessageHead& request) const;
+
+    // Backend to replay a request on after the connection to tried.back()
+    // was reset or closed before the first response byte. Nullopt for other
+    // errors and once attempts or the retry budget are used up.
+    std::optional<Connection> Replay(Pool& pool,
+                                     const TriedBackends& tried,
+                                     const ErrorCode& error,
+                                     const EndpointType& client_endpoint);
+
+    // True if request may be hedged: pool opted in and it is a replayable
+    // GET or HEAD
+    bool Hedgeable(const Pool& pool, const MessageHead& request) const;
+
+    // Backend for a copy of the request sent to tried backends, nullopt if
+    // the pool has no other one, it is at its connection cap or concurrency
+    // limit or the hedging budget is used up
+    std::optional<Connection> Hedge(Pool& pool, const TriedBackends& tried, const EndpointType& client_endpoint);
+
+    // Reads the first response bytes of request written to socket into
+    // buffer, hedged by pool's hedging as HedgedRead describes. Completes
+    // with void(ErrorCode, std::optional<Connection>), the connection is set
+    // if the hedge won and replaced socket. Cancellation (if set) aborts the
+    // read and the hedge. Arguments must outlive the operation.
+    template <class CompletionToken>
+    auto AsyncReadFirstBytes(Pool& pool,
+                             SocketType& socket,
+                             IoBuffer& buffer,
+                             const Segments& request,
+                             const TriedBackends& tried,
+                             const EndpointType& client_endpoint,
+                             ConnectCancellation* cancellation,
+                             CompletionToken&& token);
+
+    // Connects socket to backend. Addresses of url backends are raced as
+    // RFC 8305 suggests, the one that won last time is tried first.
+    // Cancelling socket aborts a direct connect, cancellation (if set) aborts
+    // resolving and the race too.
+    // Completes with void(ErrorCode), backend must outlive the operation.
+    template <class CompletionToken>
+    auto AsyncConnect(SocketType& socket,
+                      const Backend& backend,
+                      ConnectCancellation* cancellation,
+                      CompletionToken&& token);
+
+    AdmissionControl& Admission();
+
+    // nullptr if rate limiting is disabled
+    RateLimiter* ClientRateLimiter();
+
+    // Wheels sessions arm their phase timers on
+    TimerService& Timers();
+
+    const SessionTimeouts& Timeouts() const;
+
+    const DeadlinePolicy& Deadlines() const;
+
+private:
+    // Withdraws from the retry budget and picks a backend not tried yet
+    std::optional<Connection> NextBackend(Pool& pool,
+                                          const TriedBackends& tried,
+                                          const EndpointType& client_endpoint,
+                                          metrics::Counter& counter);
+
+    // Backend not in tried if the selector gives one, the last selected otherwise
+    Backend Untried(Pool& pool, const TriedBackends& tried, const EndpointType& client_endpoint);
+
+    void CountHedgeWin();
 
 private:
     boost::asio::io_context& ioc;
-    boost::asio::ip::tcp::resolver resolver;
-    ::lb::tcp::SelectorPtr selector;
+    RouterPtr router;
+    AdmissionControlPtr admission;
+    RateLimiterPtr rate_limiter;
+    SessionFactory make_session;
+    TimerService timers;
+    SessionTimeouts timeouts;
+    RetryPolicy retry_policy;
+    RetryBudget retry_budget;
+    DeadlinePolicy deadline_policy;
+    metrics::Counter& retries;
+    metrics::Counter& retries_exhausted;
+    metrics::Counter& replays;
+    metrics::Counter& hedges;
+    metrics::Counter& hedges_exhausted;
+    metrics::Counter& hedge_wins;
+    PreferredEndpoints preferred_endpoints;
 };
 
-} // namespace lb::tcp
\ No newline at end of file
+template <class CompletionToken>
+auto Connector::AsyncReadFirstBytes(Pool& pool,
+                                    SocketType& socket,
+                                    IoBuffer& buffer,
+                                    const Segments& request,
+                                    const TriedBackends& tried,
+                                    const EndpointType& client_endpoint,
+                                    ConnectCancellation* cancellation,
+                                    CompletionToken&& token)
+{
+    auto initiation = [this, &pool, &socket, &buffer, &request, &tried, &client_endpoint, cancellation](auto handler) {
+        auto counting = [this, handler=std::move(handler)]
+                        (const ErrorCode& ec, std::optional<Connection> hedge) mutable {
+            if (hedge) {
+                CountHedgeWin();
+            }
+            handler(ec, std::move(hedge));
+        };
+        using Read = HedgedRead<Connector, decltype(counting)>;
+        auto read = std::allocate_shared<Read>(RecyclingAllocator<Read>(), *this, pool, *pool.hedging, socket, buffer,
+                                               request, tried, client_endpoint, std::move(counting));
+        if (cancellation) {
+            cancellation->Emplace([weak=std::weak_ptr<Read>(read)]() {
+                if (std::shared_ptr<Read> read = weak.lock()) {
+                    read->Cancel();
+                }
+            });
+        }
+        read->Start();
+    };
+    return boost::asio::async_initiate<CompletionToken, void(ErrorCode, std::optional<Connection>)>(
+        std::move(initiation), token);
+}
+
+template <class CompletionToken>
+auto Connector::AsyncConnect(SocketType& socket,
+                             const Backend& backend,
+                             ConnectCancellation* cancellation,
+                             CompletionToken&& token)
+{
+    auto initiation = [this, &socket, &backend, cancellation](auto handler) {
+        if (backend.IsIpEndpoint()) {
+            socket.async_connect(backend.AsEndpoint(), std::move(handler));
+            return;
+        }
+        const auto& url = backend.AsUrl();
+        std::string hostname(url.Hostname());
+        // Resolver of its own, cancelling it does not abort resolving of others
+        auto resolver = std::make_shared<ResolverType>(socket.get_executor());
+        if (cancellation) {
+            cancellation->Emplace([weak=std::weak_ptr<ResolverType>(resolver)]() {
+                if (std::shared_ptr<ResolverType> resolver = weak.lock()) {
+                    resolver->cancel();
+                }
+            });
+        }
+        // Socket is owned by session, handler keeps it alive
+        resolver->async_resolve(
+            hostname, std::to_string(url.Port()), ResolverQuery::numeric_service,
+            [this, &socket, resolver, hostname, cancellation, handler=std::move(handler)]
+            (const ErrorCode& error, ResolverResults results) mutable {
+                if (error) {
+                    handler(error);
+                    return;
+                }
+                std::vector<EndpointType> candidates;
+                candidates.reserve(results.size());
+                for (const auto& entry : results) {
+                    candidates.push_back(entry.endpoint());
+                }
+                RaceConnect(socket, std::move(candidates), std::move(handler),
+                            &preferred_endpoints, std::move(hostname), cancellation);
+            });
+    };
+    return boost::asio::async_initiate<CompletionToken, void(ErrorCode)>(std::move(initiation), token);
+}
+
+} // namespace lb::tcp
@@ -0,0 +1,514 @@
+#ifdef LB_COROUTINE_SESSIONS
+
+#include <lb/tcp/coroutine_session.hpp>
+#include <lb/tcp/connector.hpp>
+#include <lb/logging.hpp>
+#include <lb/metrics.hpp>
+
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <boost/beast.hpp>
+
+namespace lb::tcp {
+
+template <class Notifier>
+CoroutineSession<Notifier>::CoroutineSession(SocketType client_socket,
+                                             const EndpointType& client_endpoint,
+                                             Connector& connector,
+                                             AdmissionTicket ticket,
+                                             ConcurrencyLimitPtr connects_limit)
+    : BasicSession()
+    , client_socket_(std::move(client_socket))
+    , server_socket_(client_socket_.get_executor())
+    , id(GenerateId())
+    , connector_(connector)
+    , ticket_(std::move(ticket))
+    , connects_limit_(std::move(connects_limit))
+    , rate_limiter_(connector.ClientRateLimiter())
+    , timer_(connector.Timers().LocalWheel(), connector.Timeouts(), &CoroutineSession::OnTimerExpired, this)
+{
+    if (rate_limiter_ && !rate_limiter_->LimitsRequests()) {
+        rate_limiter_ = nullptr;
+    }
+    client_endpoint_ = client_endpoint;
+    request_head_.fields.reserve(kReservedFields);
+    response_head_.fields.reserve(kReservedFields);
+    segments_.reserve(kReservedSegments);
+    DEBUG("CoroutineSession id:{} created", id);
+}
+
+template <class Notifier>
+void CoroutineSession<Notifier>::Run()
+{
+    boost::asio::co_spawn(client_socket_.get_executor(), Serve(this->shared_from_this()), boost::asio::detached);
+}
+
+template <class Notifier>
+typename CoroutineSession<Notifier>::Awaitable CoroutineSession<Notifier>::Serve(std::shared_ptr<CoroutineSession>)
+{
+    ErrorCode ec;
+    auto token = boost::asio::redirect_error(boost::asio::use_awaitable_t<ExecutorType>(), ec);
+    const std::string* final_response = nullptr; // sent before closing, errors are not logged then
+
+    for (;;) {
+        if (client_buffer_.size() == 0) {
+            // Idle keep-alive connection holds no buffers until the client speaks
+            ReleaseBuffer(client_buffer_);
+            ReleaseBuffer(server_buffer_);
+            timer_.Arm(TimeoutPhase::IDLE);
+            co_await client_socket_.async_wait(SocketType::wait_read, token);
+            if (ec || timed_out_ != TimeoutPhase::NONE) {
+                break;
+            }
+        }
+
+        timer_.Arm(TimeoutPhase::HEADER_READ);
+        const RequestDeadline::Clock::time_point request_start = RequestDeadline::Clock::now();
+        RawRequestParser request_parser(request_head_);
+        while (!request_parser.Parse(client_buffer_.data(), ec) && !ec) {
+            if (request_parser.is_header_done() && timer_.Phase() == TimeoutPhase::HEADER_READ) {
+                timer_.Arm(TimeoutPhase::BODY_READ);
+            }
+            auto space = PrepareRead(client_buffer_, kReadSize);
+            client_buffer_.commit(co_await client_socket_.async_read_some(space, token));
+            if (ec || timed_out_ != TimeoutPhase::NONE) {
+                break;
+            }
+        }
+        if (ec || timed_out_ != TimeoutPhase::NONE) {
+            break;
+        }
+        timer_.Disarm();
+
+        if (rate_limiter_ && !rate_limiter_->AllowRequest(client_endpoint_.address())) {
+            DEBUG("sid:{} request rate limit exceeded", id);
+            final_response = &kTooManyRequestsResponse;
+            break;
+        }
+
+        Pool* pool = connector_.Route(RequestView());
+        if (!pool) {
+            final_response = &kNotFoundResponse;
+            break;
+        }
+
+        deadline_.Reset(connector_.Deadlines(), RequestView(), request_start, pool->deadline);
+        if (deadline_.Expired()) {
+            DEBUG("sid:{} request deadline passed", id);
+            ExpiredRequests().Add();
+            final_response = &kGatewayTimeoutResponse;
+            break;
+        }
+
+        cache_key_.clear();
+        if ((pool->cache || pool->collapsing) && CacheKey(RequestView(), cache_key_)) {
+            CachedResponsePtr cached = pool->cache ? pool->cache->Find(cache_key_, RequestView()) : nullptr;
+            if (!cached && pool->collapsing && !(lead_ = pool->collapsing->Lead(cache_key_))) {
+                DEBUG("sid:{} waiting for an identical request in flight", id);
+                cached = co_await pool->collapsing->AsyncFollow(cache_key_, client_socket_.get_executor(), token);
+                ec = {}; // goes upstream after max_wait
+                if (cached && !cached->Matches(RequestView())) {
+                    cached = nullptr;
+                }
+            }
+            if (cached) {
+                cached->Splice(pool->response_headers.get(), age_line_, segments_);
+                co_await boost::asio::async_write(client_socket_, boost::beast::buffers_range_ref(segments_), token);
+                if (ec) {
+                    break;
+                }
+                client_buffer_.consume(request_head_.message_size);
+                if (!request_head_.keep_alive) {
+                    break;
+                }
+                continue;
+            }
+        }
+        WatchClient();
+
+        if (pool != pool_) {
+            DisconnectFromPool();
+            std::optional<AdmissionTicket> connect_ticket = connector_.Admission().AdmitConnect(connects_limit_);
+            if (!connect_ticket) {
+                DEBUG("Too many pending connects");
+                connector_.Admission().Shed(std::move(client_socket_));
+                co_return;
+            }
+            tried_backends_.clear();
+            Connector::Connection connection = connector_.SelectBackend(*pool, RequestView(), client_endpoint_);
+            final_response = co_await Connect(*pool, std::move(connection.backend), std::move(connection.set_cookie));
+            connect_ticket->Release();
+            if (final_response) {
+                break;
+            }
+        } else {
+            // attempts are bounded per request
+            tried_backends_.erase(tried_backends_.begin(), tried_backends_.end() - 1);
+        }
+
+        // Idempotent requests stay in client buffer until the first response
+        // byte and are sent again if the upstream closes before it
+        const bool replay = connector_.Replayable(request_head_);
+        for (;;) {
+            if (deadline_.Expired()) {
+                DEBUG("sid:{} request deadline passed", id);
+                ExpiredRequests().Add();
+                final_response = &kGatewayTimeoutResponse;
+                break;
+            }
+            permit_.Release();
+            if (pool_->concurrency) {
+                std::optional<AdaptiveConcurrency::Permit> permit =
+                    pool_->concurrency->TryAcquire(tried_backends_.back());
+                if (!permit) {
+                    DEBUG("sid:{} {} is at its concurrency limit", id, tried_backends_.back());
+                    final_response = &kServiceUnavailableResponse;
+                    break;
+                }
+                permit_ = std::move(*permit);
+            }
+            SpliceMessage(RequestView(), pool_->request_headers.get(), deadline_.UpstreamLine(), segments_,
+                          deadline_.Replaced(request_head_));
+            co_await boost::asio::async_write(server_socket_, boost::beast::buffers_range_ref(segments_), token);
+            if (!ec) {
+                DEBUG("sid: {} sent to server", id);
+                notifier_.OnRequestSent();
+                if (server_buffer_.size() == 0) {
+                    timer_.Arm(TimeoutPhase::FIRST_BYTE, deadline_.Left());
+                    if (replay && connector_.Hedgeable(*pool_, request_head_)) {
+                        std::optional<Connector::Connection> hedge = co_await connector_.AsyncReadFirstBytes(
+                            *pool_, server_socket_, server_buffer_, segments_, tried_backends_, client_endpoint_,
+                            &connect_cancellation_, token);
+                        if (hedge) {
+                            AdoptHedge(std::move(hedge->backend), hedge->set_cookie, std::move(hedge->slot),
+                                       std::move(hedge->permit));
+                        }
+                    } else {
+                        auto space = PrepareRead(server_buffer_, kReadSize);
+                        server_buffer_.commit(co_await server_socket_.async_read_some(space, token));
+                    }
+                    timer_.Disarm();
+                }
+            }
+            if (!ec || !replay || client_gone_ || timed_out_ != TimeoutPhase::NONE) {
+                break;
+            }
+            std::optional<Connector::Connection> next =
+                connector_.Replay(*pool_, tried_backends_, ec, client_endpoint_);
+            if (!next) {
+                break;
+            }
+            std::optional<AdmissionTicket> connect_ticket = connector_.Admission().AdmitConnect(connects_limit_);
+            if (!connect_ticket) {
+                break;
+            }
+            DEBUG("sid:{} replaying request, {}: {}", id, tried_backends_.back(), ec.message());
+            DisconnectFromPool();
+            final_response = co_await Connect(*pool, std::move(next->backend), std::move(next->set_cookie));
+            connect_ticket->Release();
+            if (final_response) {
+                ec = {};
+                break;
+            }
+        }
+        if (ec || final_response || timed_out_ != TimeoutPhase::NONE) {
+            break;
+        }
+        if (cache_key_.empty()) {
+            client_buffer_.consume(request_head_.message_size);
+        }
+
+        // 1xx responses are followed by the final one
+        bool interim = false;
+        do {
+            RawResponseParser response_parser(response_head_);
+            if (request_head_.method == boost::beast::http::verb::head) {
+                response_parser.skip(true);
+            }
+            bool done = server_buffer_.size() > 0 && response_parser.Parse(server_buffer_.data(), ec);
+            if (!done && !ec) {
+                timer_.Arm(TimeoutPhase::FIRST_BYTE);
+            }
+            while (!done && !ec) {
+                auto space = PrepareRead(server_buffer_, kReadSize);
+                server_buffer_.commit(co_await server_socket_.async_read_some(space, token));
+                if (timed_out_ != TimeoutPhase::NONE) {
+                    break;
+                }
+                timer_.Disarm();
+                if (!ec) {
+                    done = response_parser.Parse(server_buffer_.data(), ec);
+                } else if (ec == boost::asio::error::eof
+                           && response_parser.is_header_done()
+                           && response_parser.need_eof()) {
+                    // body is delimited by end of stream
+                    ec = {};
+                    done = response_parser.ParseEof(ec);
+                }
+            }
+            if (ec || timed_out_ != TimeoutPhase::NONE) {
+                break;
+            }
+            notifier_.OnResponseReceive();
+            permit_.OnResponse();
+
+            interim = response_head_.status / 100 == 1;
+            if (!interim) {
+                ++watch_generation_;
+            }
+            if (!cache_key_.empty() && (!interim || response_head_.status == 101)) {
+                // request was kept to share the response
+                const bool cache = pool_->cache
+                                && response_head_.message_size <= pool_->cache->Config().max_object_bytes;
+                if (cache || lead_) {
+                    CachedResponsePtr shared = ShareResponse(RequestView(), ResponseView());
+                    if (cache && shared) {
+                        pool_->cache->Store(cache_key_, shared);
+                    }
+                    lead_.Complete(std::move(shared));
+                }
+                client_buffer_.consume(request_head_.message_size);
+                cache_key_.clear();
+            }
+            SpliceMessage(ResponseView(), pool_->response_headers.get(),
+                          interim ? std::string_view{} : std::string_view(set_cookie_), segments_);
+            co_await boost::asio::async_write(client_socket_, boost::beast::buffers_range_ref(segments_), token);
+            if (ec) {
+                break;
+            }
+            server_buffer_.consume(response_head_.message_size);
+        } while (interim && response_head_.status != 101);
+        if (ec || timed_out_ != TimeoutPhase::NONE) {
+            break;
+        }
+
+        set_cookie_.clear();
+        if (!response_head_.keep_alive || !request_head_.keep_alive) {
+            break;
+        }
+    }
+
+    timer_.Disarm();
+    if (client_gone_) {
+        // nobody to respond to
+        final_response = nullptr;
+        ec = {};
+    }
+    if (timed_out_ == TimeoutPhase::FIRST_BYTE) {
+        permit_.OnDropped();
+    }
+    if (timed_out_ != TimeoutPhase::NONE) {
+        DEBUG("sid:{} {} timeout", id, ToString(timed_out_));
+        final_response = TimeoutResponse(timed_out_);
+        ec = {};
+    }
+    if (final_response) {
+        co_await boost::asio::async_write(client_socket_, boost::asio::buffer(*final_response), token);
+    } else if (ec && NeedErrorLogging(ec)) {
+        SERROR("sid:{} {}", id, ec.message());
+    }
+    Cancel();
+}
+
+template <class Notifier>
+boost::asio::awaitable<const std::string*, ExecutorType>
+CoroutineSession<Notifier>::Connect(Pool& pool, Backend backend, std::string set_cookie)
+{
+    ErrorCode ec;
+    auto token = boost::asio::redirect_error(boost::asio::use_awaitable_t<ExecutorType>(), ec);
+    std::optional<Connector::Connection> connection =
+        Connector::Connection{.backend = std::move(backend), .set_cookie = std::move(set_cookie)};
+    while (connection) {
+        backend_slot_.Release();
+        if (pool.limits) {
+            // may move the connection to another backend
+            if (std::optional<Connector::Connection> other =
+                    connector_.TakeSlot(pool, std::move(*connection), tried_backends_, client_endpoint_)) {
+                connection = std::move(other);
+            } else {
+                DEBUG("sid:{} backend {} of pool {} is at its connection cap", id, connection->backend, pool.name);
+                connection->slot = co_await pool.limits->AsyncWait(connection->backend,
+                                                                   client_socket_.get_executor(), token);
+                if (ec) {
+                    DEBUG("sid:{} no connection slot in pool {}: {}", id, pool.name, ec.message());
+                    co_return &kServiceUnavailableResponse;
+                }
+            }
+            backend_slot_ = std::move(connection->slot);
+        }
+        tried_backends_.push_back(connection->backend);
+        const Backend& attempt = tried_backends_.back();
+        timer_.Arm(TimeoutPhase::CONNECT);
+        co_await connector_.AsyncConnect(server_socket_, attempt, &connect_cancellation_, token);
+        timer_.Disarm();
+        if (client_gone_) {
+            co_return &kBadGatewayResponse; // not sent, the client is gone
+        }
+        if (ec && connect_timed_out_) {
+            ec = boost::asio::error::timed_out;
+        }
+        connect_timed_out_ = false;
+        if (!ec) {
+            break;
+        }
+        ERROR("sid:{} connect to {}: {}", id, attempt, ec.message());
+        connection = connector_.Reselect(pool, tried_backends_, ec, client_endpoint_);
+        if (connection) {
+            ErrorCode ignored;
+            server_socket_.close(ignored);
+        }
+    }
+    if (!connection) {
+        backend_slot_.Release();
+        co_return ec == boost::asio::error::timed_out ? &kGatewayTimeoutResponse : &kBadGatewayResponse;
+    }
+
+    pool_ = &pool;
+    if (!connection->set_cookie.empty()) {
+        set_cookie_ = "Set-Cookie: " + connection->set_cookie + "\r\n";
+    }
+    notifier_.OnConnect(*pool.selector, connection->backend);
+    co_return nullptr;
+}
+
+template <class Notifier>
+void CoroutineSession<Notifier>::AdoptHedge(Backend backend,
+                                 const std::string& set_cookie,
+                                 BackendSlot slot,
+                                 AdaptiveConcurrency::Permit permit)
+{
+    DEBUG("sid:{} hedge to {} answered first", id, backend);
+    notifier_.OnDisconnect();
+    notifier_ = Notifier();
+    notifier_.OnConnect(*pool_->selector, backend);
+    notifier_.OnRequestSent();
+    if (!set_cookie.empty()) {
+        set_cookie_ = "Set-Cookie: " + set_cookie + "\r\n";
+    }
+    tried_backends_.push_back(std::move(backend));
+    backend_slot_ = std::move(slot);
+    // primary's response time is unknown, the hedge's is sampled when it arrives
+    permit_.Release();
+    permit_ = std::move(permit);
+}
+
+template <class Notifier>
+void CoroutineSession<Notifier>::WatchClient()
+{
+    if (!connector_.Deadlines().cancel_abandoned) {
+        return;
+    }
+    // Completes on the next request bytes as well, watching ends then
+    client_socket_.async_wait(
+        SocketType::wait_read,
+        [self=this->shared_from_this(), generation=watch_generation_](const ErrorCode& ec) {
+            if (!ec && generation == self->watch_generation_ && PeerClosed(self->client_socket_)) {
+                self->OnClientGone();
+            }
+        });
+}
+
+template <class Notifier>
+void CoroutineSession<Notifier>::OnClientGone()
+{
+    DEBUG("sid:{} client closed, cancelling upstream work", id);
+    AbandonedRequests().Add();
+    client_gone_ = true;
+    ErrorCode ec;
+    server_socket_.cancel(ec);
+    connect_cancellation_.Cancel();
+}
+
+template <class Notifier>
+void CoroutineSession<Notifier>::OnTimerExpired(void* context)
+{
+    // Under lock of the wheel, session may be destroyed concurrently
+    auto* session = static_cast<CoroutineSession*>(context);
+    std::shared_ptr<CoroutineSession> self = session->weak_from_this().lock();
+    if (!self) {
+        return;
+    }
+    boost::asio::post(session->client_socket_.get_executor(),
+                      [self=std::move(self), generation=session->timer_.Generation()]() {
+                          if (self->timer_.Generation() == generation) {
+                              self->OnTimeout();
+                          }
+                      });
+}
+
+template <class Notifier>
+void CoroutineSession<Notifier>::OnTimeout()
+{
+    const TimeoutPhase phase = timer_.Phase();
+    timer_.Disarm();
+    PhaseTimer::Count(phase);
+    ErrorCode ec;
+    server_socket_.cancel(ec);
+    connect_cancellation_.Cancel();
+    if (phase == TimeoutPhase::CONNECT) {
+        // connect loop fails the attempt and retries another backend
+        connect_timed_out_ = true;
+        timer_.Arm(TimeoutPhase::CONNECT);
+        return;
+    }
+    timed_out_ = phase;
+    client_socket_.cancel(ec);
+}
+
+template <class Notifier>
+void CoroutineSession<Notifier>::DisconnectFromPool()
+{
+    if (!pool_) {
+        return;
+    }
+    DEBUG("sid:{} switching from pool {}", id, pool_->name);
+    ErrorCode ec;
+    server_socket_.close(ec);
+    backend_slot_.Release();
+    permit_.Release();
+    notifier_.OnDisconnect();
+    notifier_ = Notifier();
+    pool_ = nullptr;
+    set_cookie_.clear();
+    server_buffer_.clear();
+}
+
+template <class Notifier>
+MessageView CoroutineSession<Notifier>::RequestView() const
+{
+    return MessageView(request_head_, std::string_view(static_cast<const char*>(client_buffer_.data().data()),
+                                                       client_buffer_.size()));
+}
+
+template <class Notifier>
+MessageView CoroutineSession<Notifier>::ResponseView() const
+{
+    return MessageView(response_head_, std::string_view(static_cast<const char*>(server_buffer_.data().data()),
+                                                        server_buffer_.size()));
+}
+
+template <class Notifier>
+void CoroutineSession<Notifier>::Cancel()
+{
+    CloseSocket(client_socket_);
+    CloseSocket(server_socket_);
+    connect_cancellation_.Cancel();
+    notifier_.OnDisconnect();
+}
+
+template <class Notifier>
+CoroutineSession<Notifier>::~CoroutineSession() noexcept
+{
+    Cancel();
+}
+
+template class CoroutineSession<NoopNotifier>;
+template class CoroutineSession<LeastConnectionsNotifier>;
+template class CoroutineSession<LeastResponseTimeNotifier>;
+template class CoroutineSession<AnyNotifier>;
+
+} // namespace lb::tcp
+
+#endif // LB_COROUTINE_SESSIONS
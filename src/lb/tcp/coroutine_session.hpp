@@ -0,0 +1,104 @@
+#pragma once
+
+#ifdef LB_COROUTINE_SESSIONS
+
+#include <lb/tcp/session.hpp>
+
+#include <boost/asio/awaitable.hpp>
+
+#include <memory>
+#include <string>
+
+namespace lb::tcp {
+
+// Session engine of lb2 built with LB2_COROUTINE_SESSIONS (C++20), selected
+// by sessions.engine config. Behaves as HttpSession, but the whole proxy loop
+// is one asio coroutine: its frame is allocated once per session and holds
+// parsers and the session reference, async operations are awaited in place
+// without handler objects capturing the session.
+template <class Notifier>
+class CoroutineSession : public BasicSession,
+                         public std::enable_shared_from_this<CoroutineSession<Notifier>> {
+public:
+    using SocketType    = tcp::SocketType;
+    using EndpointType  = boost::asio::ip::tcp::endpoint;
+    using BufferType    = IoBuffer;
+    using ErrorCode     = boost::system::error_code;
+public:
+    CoroutineSession(SocketType client_socket,
+                     const EndpointType& client_endpoint,
+                     Connector& connector,
+                     AdmissionTicket ticket={},
+                     ConcurrencyLimitPtr connects_limit=nullptr);
+
+    CoroutineSession(const CoroutineSession&) = delete;
+    CoroutineSession& operator=(const CoroutineSession&) = delete;
+    ~CoroutineSession() noexcept;
+
+    void Run() override;
+
+    void Cancel() override;
+private:
+    using Awaitable = boost::asio::awaitable<void, ExecutorType>;
+
+    // Frame keeps the session alive
+    Awaitable Serve(std::shared_ptr<CoroutineSession> self);
+
+    // Connects to backend, then to other backends of pool while retries
+    // last, waiting for a slot if the pool caps connections. Sets pool_ on
+    // success, returns the response to close the client connection with otherwise.
+    boost::asio::awaitable<const std::string*, ExecutorType> Connect(Pool& pool, Backend backend, std::string set_cookie);
+
+    // Continues with the connection, slot and permit of a hedge that answered first
+    void AdoptHedge(Backend backend, const std::string& set_cookie, BackendSlot slot,
+                    AdaptiveConcurrency::Permit permit);
+
+    // Cancels upstream work if the client closes before the response
+    void WatchClient();
+    void OnClientGone();
+
+    static void OnTimerExpired(void* context); // called by timer wheel
+    void OnTimeout();
+    void DisconnectFromPool();
+    MessageView RequestView() const;
+    MessageView ResponseView() const;
+private:
+    SocketType client_socket_;
+    SocketType server_socket_;
+    BufferType client_buffer_;
+    BufferType server_buffer_;
+    MessageHead request_head_;
+    MessageHead response_head_;
+    Segments segments_; // of message being written
+    IdType id;
+    Connector& connector_;
+    Notifier notifier_;
+    AdmissionTicket ticket_;
+    ConcurrencyLimitPtr connects_limit_; // of the listener, nullptr if it has none
+    RateLimiter* rate_limiter_; // not owner
+    EndpointType client_endpoint_;
+    Pool* pool_ = nullptr; // pool of connected backend
+    std::string set_cookie_; // "Set-Cookie: ...\r\n" spliced into the next response if not empty
+    PhaseTimer timer_;
+    TimeoutPhase timed_out_ = TimeoutPhase::NONE; // all pending operations are failed once set
+    TriedBackends tried_backends_; // by the current request
+    BackendSlot backend_slot_; // empty unless the pool caps connections
+    AdaptiveConcurrency::Permit permit_; // of the request in flight, empty unless the pool caps them
+    RequestDeadline deadline_;
+    std::uint64_t watch_generation_ = 0; // bumped once the final response begins, stale watches are ignored
+    bool client_gone_ = false; // upstream work was cancelled
+    std::string cache_key_; // of the request in flight if the pool may cache its response
+    std::string age_line_; // of the cached response being sent
+    CollapseLead lead_; // of the request in flight if identical ones wait for its response
+    bool connect_timed_out_ = false; // attempt was cancelled by CONNECT timeout
+    ConnectCancellation connect_cancellation_; // of the pending connect attempt or hedged read
+};
+
+extern template class CoroutineSession<NoopNotifier>;
+extern template class CoroutineSession<LeastConnectionsNotifier>;
+extern template class CoroutineSession<LeastResponseTimeNotifier>;
+extern template class CoroutineSession<AnyNotifier>;
+
+} // namespace lb::tcp
+
+#endif // LB_COROUTINE_SESSIONS
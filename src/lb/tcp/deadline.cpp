@@ -0,0 +1,114 @@
+#include <lb/tcp/deadline.hpp>
+#include <lb/logging.hpp>
+#include <lb/metrics.hpp>
+
+#include <boost/beast/core/string.hpp>
+#include <yaml-cpp/yaml.h>
+
+#include <algorithm>
+#include <charconv>
+
+namespace lb::tcp {
+
+DeadlinePolicy ConfigureDeadlines(const YAML::Node& config)
+{
+    DeadlinePolicy result;
+    if (!config["deadlines"].IsDefined()) {
+        return result;
+    }
+
+    const YAML::Node& node = config["deadlines"];
+    if (!node.IsMap()) {
+        EXCEPTION("deadlines node must be a map");
+    }
+    if (node["header"].IsDefined()) {
+        result.header = node["header"].as<std::string>();
+    }
+    if (node["cancel_abandoned"].IsDefined()) {
+        result.cancel_abandoned = node["cancel_abandoned"].as<bool>();
+    }
+    return result;
+}
+
+void RequestDeadline::Reset(const DeadlinePolicy& policy,
+                            const MessageView& request,
+                            Clock::time_point start,
+                            std::chrono::milliseconds budget)
+{
+    header_ = policy.header;
+    deadline_.reset();
+    field_.reset();
+    if (budget > std::chrono::milliseconds::zero()) {
+        deadline_ = start + budget;
+    }
+    if (header_.empty()) {
+        return;
+    }
+
+    const auto& fields = request.Head().fields;
+    for (std::size_t i = 0; i < fields.size(); ++i) {
+        const std::string_view name = request.Text(fields[i].name_text);
+        if (!boost::beast::iequals(boost::beast::string_view(name.data(), name.size()),
+                                   boost::beast::string_view(header_.data(), header_.size()))) {
+            continue;
+        }
+        field_ = i;
+        const std::string_view value = request.Text(fields[i].value);
+        std::uint64_t millis = 0;
+        auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), millis);
+        if (error == std::errc() && end == value.data() + value.size()) {
+            // bounded before the conversion, huge values would overflow the time point
+            const std::uint64_t max_millis = std::chrono::milliseconds(kMaxClientTimeout).count();
+            const Clock::time_point client = start + std::chrono::milliseconds(std::min(millis, max_millis));
+            deadline_ = deadline_ ? std::min(*deadline_, client) : client;
+        }
+        break;
+    }
+}
+
+RequestDeadline::operator bool() const
+{
+    return deadline_.has_value();
+}
+
+bool RequestDeadline::Expired() const
+{
+    return deadline_ && Clock::now() >= *deadline_;
+}
+
+std::optional<std::chrono::milliseconds> RequestDeadline::Left() const
+{
+    if (!deadline_) {
+        return std::nullopt;
+    }
+    const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(*deadline_ - Clock::now());
+    return std::max(left, std::chrono::milliseconds::zero());
+}
+
+std::string_view RequestDeadline::UpstreamLine()
+{
+    line_.clear();
+    if (deadline_ && !header_.empty()) {
+        line_.append(header_).append(": ").append(std::to_string(Left()->count())).append("\r\n");
+    }
+    return line_;
+}
+
+const MessageHead::Field* RequestDeadline::Replaced(const MessageHead& head) const
+{
+    return deadline_ && field_ ? &head.fields[*field_] : nullptr;
+}
+
+metrics::Counter& ExpiredRequests()
+{
+    static metrics::Counter& counter = metrics::Registry::Instance().GetCounter("requests.expired");
+    return counter;
+}
+
+metrics::Counter& AbandonedRequests()
+{
+    static metrics::Counter& counter = metrics::Registry::Instance().GetCounter("requests.abandoned");
+    return counter;
+}
+
+} // namespace lb::tcp
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <lb/tcp/raw_message.hpp>
+
+#include <chrono>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace YAML {class Node;}
+
+namespace lb::metrics {class Counter;}
+
+namespace lb::tcp {
+
+struct DeadlinePolicy {
+    std::string header = "X-Request-Timeout-Ms"; // time the client waits, ms; empty - not read nor forwarded
+    bool cancel_abandoned = true; // cancel upstream work of requests whose client closed
+};
+
+// Reads optional deadlines node: {header, cancel_abandoned}
+DeadlinePolicy ConfigureDeadlines(const YAML::Node& config);
+
+// Deadline of one request: the client's one from the policy's header,
+// capped by the budget of its pool. Requests past it are not sent
+// upstream, the header is forwarded with the time left.
+class RequestDeadline {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr std::chrono::hours kMaxClientTimeout{24}; // longer client deadlines are cut to it
+public:
+    // Budget of zero leaves the client's deadline as is
+    void Reset(const DeadlinePolicy& policy,
+               const MessageView& request,
+               Clock::time_point start,
+               std::chrono::milliseconds budget);
+
+    explicit operator bool() const;
+
+    bool Expired() const;
+
+    // Nullopt if there is no deadline
+    std::optional<std::chrono::milliseconds> Left() const;
+
+    // "Header: <ms left>\r\n" for the upstream request, empty if there is
+    // no deadline or header. Valid until the next call.
+    std::string_view UpstreamLine();
+
+    // Field of head that UpstreamLine replaces, nullptr if there is none
+    const MessageHead::Field* Replaced(const MessageHead& head) const;
+private:
+    std::string_view header_;
+    std::optional<Clock::time_point> deadline_;
+    std::optional<std::size_t> field_; // index of the client's header
+    std::string line_;
+};
+
+// Requests not sent upstream because their deadline passed
+metrics::Counter& ExpiredRequests();
+
+// Requests whose upstream work was cancelled because the client closed
+metrics::Counter& AbandonedRequests();
+
+} // namespace lb::tcp
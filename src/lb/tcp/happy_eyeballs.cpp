@@ -0,0 +1,49 @@
+#include <lb/tcp/happy_eyeballs.hpp>
+
+#include <algorithm>
+
+namespace lb::tcp {
+
+std::optional<PreferredEndpoints::EndpointType> PreferredEndpoints::Get(std::string_view hostname) const
+{
+    boost::mutex::scoped_lock lock(mutex_);
+    auto it = endpoints_.find(std::string(hostname));
+    if (it == endpoints_.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+void PreferredEndpoints::Set(std::string_view hostname, const EndpointType& endpoint)
+{
+    boost::mutex::scoped_lock lock(mutex_);
+    endpoints_.insert_or_assign(std::string(hostname), endpoint);
+}
+
+void SortCandidates(std::vector<boost::asio::ip::tcp::endpoint>& candidates,
+                    const std::optional<boost::asio::ip::tcp::endpoint>& preferred)
+{
+    if (preferred) {
+        auto it = std::find(candidates.begin(), candidates.end(), *preferred);
+        if (it != candidates.end()) {
+            std::rotate(candidates.begin(), it, it + 1);
+        }
+    }
+    // Stable interleave: the next candidate of the other family follows
+    // every candidate while there are any left
+    for (std::size_t i = 1; i < candidates.size(); ++i) {
+        const bool previous_v6 = candidates[i - 1].address().is_v6();
+        if (candidates[i].address().is_v6() != previous_v6) {
+            continue;
+        }
+        auto other = std::find_if(candidates.begin() + i, candidates.end(), [previous_v6](const auto& endpoint) {
+            return endpoint.address().is_v6() != previous_v6;
+        });
+        if (other == candidates.end()) {
+            break;
+        }
+        std::rotate(candidates.begin() + i, other, other + 1);
+    }
+}
+
+} // namespace lb::tcp
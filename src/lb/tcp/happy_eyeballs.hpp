@@ -0,0 +1,256 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/thread/mutex.hpp>
+#include <lb/tcp/recycling_allocator.hpp>
+#include <lb/tcp/socket.hpp>
+
+namespace lb::tcp {
+
+// Addresses of hostnames that accepted the last raced connection
+class PreferredEndpoints {
+public:
+    using EndpointType = boost::asio::ip::tcp::endpoint;
+public:
+    std::optional<EndpointType> Get(std::string_view hostname) const;
+
+    void Set(std::string_view hostname, const EndpointType& endpoint);
+private:
+    mutable boost::mutex mutex_;
+    std::unordered_map<std::string, EndpointType> endpoints_; // guarded by mutex
+};
+
+// Cancels what cancelling the target socket does not reach of a pending
+// connect: resolving and race attempts on sockets of their own. Stages of
+// the connect register themselves, cancelling a finished stage does nothing.
+// Used on the socket's strand only.
+class ConnectCancellation {
+public:
+    void Emplace(std::function<void()> cancel)
+    {
+        cancel_ = std::move(cancel);
+    }
+
+    void Cancel()
+    {
+        if (std::function<void()> cancel = std::exchange(cancel_, nullptr)) {
+            cancel();
+        }
+    }
+private:
+    std::function<void()> cancel_;
+};
+
+// Orders resolved addresses for a race as RFC 8305 does: the preferred one
+// first, then address families alternate starting from the first address.
+void SortCandidates(std::vector<boost::asio::ip::tcp::endpoint>& candidates,
+                    const std::optional<boost::asio::ip::tcp::endpoint>& preferred);
+
+// RFC 8305 connection race: the next candidate is tried kAttemptDelay after
+// the previous one started or right after it failed, the first connected
+// socket is moved into the target socket and the other attempts are closed.
+// Target socket carries an attempt whenever it is free, cancelling it while
+// that attempt is pending aborts the race; Cancel aborts it at any time.
+// Handler is called once as void(const ErrorCode&), on the socket's strand.
+template <class Handler>
+class ConnectRace : public std::enable_shared_from_this<ConnectRace<Handler>> {
+public:
+    using EndpointType = boost::asio::ip::tcp::endpoint;
+    using ErrorCode = boost::system::error_code;
+    using TimerType = boost::asio::basic_waitable_timer<std::chrono::steady_clock,
+                                                        boost::asio::wait_traits<std::chrono::steady_clock>,
+                                                        ExecutorType>;
+
+    static constexpr std::chrono::milliseconds kAttemptDelay{250};
+public:
+    // Winner is remembered for hostname if preferred is set
+    ConnectRace(SocketType& socket,
+                std::vector<EndpointType> candidates,
+                Handler handler,
+                PreferredEndpoints* preferred,
+                std::string hostname)
+        : socket_(socket)
+        , candidates_(std::move(candidates))
+        , sockets_(candidates_.size())
+        , timer_(socket.get_executor())
+        , handler_(std::move(handler))
+        , preferred_(preferred)
+        , hostname_(std::move(hostname))
+    {}
+
+    // Must be called on the socket's strand
+    void Start()
+    {
+        StartNext();
+    }
+
+    // Handler gets operation_aborted once the pending attempts are back
+    void Cancel()
+    {
+        if (done_ || cancelled_) {
+            return;
+        }
+        cancelled_ = true;
+        timer_.cancel();
+        ErrorCode ignored;
+        if (target_attempt_) {
+            socket_.cancel(ignored);
+        }
+        for (std::optional<SocketType>& socket : sockets_) {
+            if (socket) {
+                socket->cancel(ignored);
+            }
+        }
+    }
+private:
+    void StartNext()
+    {
+        if (next_ == candidates_.size()) {
+            return;
+        }
+        const std::size_t index = next_++;
+        SocketType* socket = &socket_;
+        if (target_attempt_) {
+            socket = &sockets_[index].emplace(socket_.get_executor());
+        } else {
+            ErrorCode ignored;
+            socket_.close(ignored); // may be of other address family
+            target_attempt_ = index;
+        }
+        ++pending_;
+        socket->async_connect(candidates_[index], [self=this->shared_from_this(), index](const ErrorCode& ec) {
+            self->HandleConnect(index, ec);
+        });
+
+        if (next_ < candidates_.size()) {
+            // rearming cancels the wait of the previous attempt
+            timer_.expires_after(kAttemptDelay);
+            timer_.async_wait([self=this->shared_from_this()](const ErrorCode& ec) {
+                if (!ec && !self->done_ && !self->cancelled_) {
+                    self->StartNext();
+                }
+            });
+        }
+    }
+
+    void HandleConnect(std::size_t index, const ErrorCode& ec)
+    {
+        --pending_;
+        const bool on_target = target_attempt_ == index;
+        if (on_target) {
+            target_attempt_.reset();
+        }
+        if (done_) {
+            return;
+        }
+        if (cancelled_) {
+            if (pending_ == 0) {
+                Complete(boost::asio::error::operation_aborted);
+            }
+            return;
+        }
+        if (!ec) {
+            Win(index);
+            return;
+        }
+        if (on_target && ec == boost::asio::error::operation_aborted) {
+            // target was cancelled by its owner
+            Complete(ec);
+            return;
+        }
+        error_ = ec;
+        if (next_ < candidates_.size()) {
+            StartNext();
+        } else if (pending_ == 0) {
+            Complete(error_);
+        }
+    }
+
+    void Win(std::size_t index)
+    {
+        if (sockets_[index]) {
+            ErrorCode ignored;
+            socket_.close(ignored);
+            socket_ = std::move(*sockets_[index]);
+        }
+        if (preferred_) {
+            preferred_->Set(hostname_, candidates_[index]);
+        }
+        Complete({});
+    }
+
+    void Complete(const ErrorCode& ec)
+    {
+        done_ = true;
+        timer_.cancel();
+        for (std::optional<SocketType>& socket : sockets_) {
+            if (socket) {
+                ErrorCode ignored;
+                socket->close(ignored);
+            }
+        }
+        Handler handler = std::move(handler_);
+        handler(ec);
+    }
+private:
+    SocketType& socket_;
+    std::vector<EndpointType> candidates_;
+    std::vector<std::optional<SocketType>> sockets_; // of attempts not on target socket
+    TimerType timer_;
+    Handler handler_;
+    PreferredEndpoints* preferred_;
+    std::string hostname_;
+    std::size_t next_ = 0;    // candidate to try next
+    std::size_t pending_ = 0; // attempts in flight
+    std::optional<std::size_t> target_attempt_; // candidate pending on target socket
+    ErrorCode error_ = boost::asio::error::host_not_found; // of the last failed attempt
+    bool cancelled_ = false;
+    bool done_ = false;
+};
+
+// Connects socket to one of candidates: directly if there is one, with
+// a race otherwise, which cancellation (if set) can abort. Must be called on
+// the socket's strand.
+template <class Handler>
+void RaceConnect(SocketType& socket,
+                 std::vector<boost::asio::ip::tcp::endpoint> candidates,
+                 Handler handler,
+                 PreferredEndpoints* preferred = nullptr,
+                 std::string hostname = {},
+                 ConnectCancellation* cancellation = nullptr)
+{
+    if (candidates.size() == 1) {
+        socket.async_connect(candidates.front(), std::move(handler));
+        return;
+    }
+    if (candidates.empty()) {
+        handler(boost::system::error_code(boost::asio::error::host_not_found));
+        return;
+    }
+    SortCandidates(candidates, preferred ? preferred->Get(hostname) : std::nullopt);
+    using Race = ConnectRace<Handler>;
+    auto race = std::allocate_shared<Race>(RecyclingAllocator<Race>(), socket, std::move(candidates),
+                                           std::move(handler), preferred, std::move(hostname));
+    if (cancellation) {
+        cancellation->Emplace([weak=std::weak_ptr<Race>(race)]() {
+            if (std::shared_ptr<Race> race = weak.lock()) {
+                race->Cancel();
+            }
+        });
+    }
+    race->Start();
+}
+
+} // namespace lb::tcp
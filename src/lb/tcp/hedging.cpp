@@ -0,0 +1,122 @@
+#include <lb/tcp/hedging.hpp>
+#include <lb/logging.hpp>
+
+#include <yaml-cpp/yaml.h>
+
+#include <algorithm>
+
+namespace lb::tcp {
+
+Hedging::Hedging(const Configuration& config)
+    : config_(config)
+    , budget_(config.budget)
+    , delay_us_(std::chrono::duration_cast<std::chrono::microseconds>(config.max_delay).count())
+{}
+
+std::chrono::microseconds Hedging::Delay() const
+{
+    return std::chrono::microseconds(delay_us_.load(std::memory_order_relaxed));
+}
+
+std::size_t Hedging::BucketOf(std::uint64_t micros)
+{
+    if (micros < 4) {
+        return micros;
+    }
+    // two bits after the leading one select the quarter of an octave
+    const std::size_t exponent = 63 - __builtin_clzll(micros);
+    const std::size_t quarter = (micros >> (exponent - 2)) & 3;
+    return std::min((exponent - 1) * 4 + quarter, kBuckets - 1);
+}
+
+std::uint64_t Hedging::UpperBound(std::size_t bucket)
+{
+    if (bucket < 4) {
+        return bucket + 1;
+    }
+    const std::size_t exponent = bucket / 4 + 1;
+    const std::uint64_t quarter = bucket % 4;
+    return (4 + quarter + 1) << (exponent - 2);
+}
+
+void Hedging::Record(std::chrono::microseconds first_byte)
+{
+    counts_[BucketOf(std::max<std::int64_t>(first_byte.count(), 0))].fetch_add(1, std::memory_order_relaxed);
+    if ((samples_.fetch_add(1, std::memory_order_relaxed) + 1) % kRecomputeInterval == 0) {
+        Recompute();
+    }
+}
+
+void Hedging::Recompute()
+{
+    std::uint64_t total = 0;
+    for (const auto& count : counts_) {
+        total += count.load(std::memory_order_relaxed);
+    }
+    const auto rank = static_cast<std::uint64_t>(total * config_.percentile / 100.0);
+    std::uint64_t seen = 0;
+    std::size_t bucket = 0;
+    for (; bucket + 1 < kBuckets; ++bucket) {
+        seen += counts_[bucket].load(std::memory_order_relaxed);
+        if (seen > rank) {
+            break;
+        }
+    }
+    const auto min_us = std::chrono::duration_cast<std::chrono::microseconds>(config_.min_delay).count();
+    const auto max_us = std::chrono::duration_cast<std::chrono::microseconds>(config_.max_delay).count();
+    const auto delay_us = std::clamp<std::int64_t>(UpperBound(bucket), min_us, max_us);
+    delay_us_.store(delay_us, std::memory_order_relaxed);
+
+    // halving keeps the percentile following recent latencies
+    for (auto& count : counts_) {
+        count.fetch_sub(count.load(std::memory_order_relaxed) / 2, std::memory_order_relaxed);
+    }
+}
+
+void Hedging::Deposit()
+{
+    budget_.Deposit();
+}
+
+bool Hedging::TryWithdraw()
+{
+    return budget_.TryWithdraw();
+}
+
+HedgingPtr ConfigureHedging(const YAML::Node& pool_node)
+{
+    if (!pool_node["hedging"].IsDefined()) {
+        return nullptr;
+    }
+
+    const YAML::Node& node = pool_node["hedging"];
+    if (!node.IsMap()) {
+        EXCEPTION("hedging node must be a map");
+    }
+
+    Hedging::Configuration config;
+    if (node["percentile"].IsDefined()) {
+        config.percentile = node["percentile"].as<double>();
+        if (config.percentile <= 0 || config.percentile >= 100) {
+            EXCEPTION("hedging.percentile must be in (0, 100)");
+        }
+    }
+    if (node["min_delay_ms"].IsDefined()) {
+        config.min_delay = std::chrono::milliseconds(node["min_delay_ms"].as<std::size_t>());
+    }
+    if (node["max_delay_ms"].IsDefined()) {
+        config.max_delay = std::chrono::milliseconds(node["max_delay_ms"].as<std::size_t>());
+    }
+    if (config.min_delay > config.max_delay) {
+        EXCEPTION("hedging.min_delay_ms must not exceed hedging.max_delay_ms");
+    }
+    if (node["budget_percent"].IsDefined()) {
+        config.budget.ratio = node["budget_percent"].as<double>() / 100.0;
+    }
+    if (node["min_hedges_per_second"].IsDefined()) {
+        config.budget.min_per_second = node["min_hedges_per_second"].as<double>();
+    }
+    return std::make_shared<Hedging>(config);
+}
+
+} // namespace lb::tcp
@@ -0,0 +1,286 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/beast/core/buffers_range.hpp>
+#include <lb/tcp/buffer_pool.hpp>
+#include <lb/tcp/happy_eyeballs.hpp>
+#include <lb/tcp/raw_message.hpp>
+#include <lb/tcp/retry.hpp>
+#include <lb/tcp/socket.hpp>
+
+namespace YAML {class Node;}
+
+namespace lb::tcp {
+
+struct Pool;
+
+// Request hedging of a pool: a request with no response byte after Delay()
+// is sent to another backend as well. Delay follows a percentile of recent
+// times to the first byte, hedges are bounded by a budget as retries are.
+class Hedging {
+public:
+    static constexpr std::size_t kBuckets = 96;             // quarter octaves of microseconds, up to ~16 s
+    static constexpr std::uint64_t kRecomputeInterval = 256; // samples between delay updates, older ones decay
+
+    struct Configuration {
+        double percentile = 95.0;
+        std::chrono::milliseconds min_delay{5};
+        std::chrono::milliseconds max_delay{1000}; // also the delay until samples are collected
+        RetryBudget::Configuration budget{.ratio = 0.05, .min_per_second = 1.0};
+    };
+public:
+    explicit Hedging(const Configuration& config);
+
+    Hedging(const Hedging&) = delete;
+    Hedging& operator=(const Hedging&) = delete;
+
+    std::chrono::microseconds Delay() const;
+
+    // Time from request sent to the first response byte
+    void Record(std::chrono::microseconds first_byte);
+
+    // Called for every request that may be hedged
+    void Deposit();
+
+    // False if the hedge would exceed the budget
+    bool TryWithdraw();
+private:
+    static std::size_t BucketOf(std::uint64_t micros);
+
+    static std::uint64_t UpperBound(std::size_t bucket);
+
+    void Recompute();
+private:
+    const Configuration config_;
+    RetryBudget budget_;
+    std::array<std::atomic<std::uint64_t>, kBuckets> counts_{};
+    std::atomic<std::uint64_t> samples_{0};
+    std::atomic<std::int64_t> delay_us_;
+};
+
+using HedgingPtr = std::shared_ptr<Hedging>;
+
+// Reads hedging node of a pool, returns nullptr if it is missing
+HedgingPtr ConfigureHedging(const YAML::Node& pool_node);
+
+// Waits for the first response bytes of request already written to socket.
+// Unless they arrive within the hedging delay, the request is written to
+// the backend connector.Hedge() gives as well. The first socket to receive
+// bytes wins: it is moved into socket with its bytes in buffer, the other
+// one is closed. A failed attempt leaves the other one running.
+// Cancelling socket aborts the operation while the primary read is pending,
+// Cancel aborts it at any time, the hedge's connect included. Handler is
+// called once as void(const ErrorCode&, std::optional<Connection>) on the
+// socket's strand, with the hedge connection if it won.
+template <class ConnectorType, class Handler>
+class HedgedRead : public std::enable_shared_from_this<HedgedRead<ConnectorType, Handler>> {
+public:
+    using Connection = typename ConnectorType::Connection;
+    using EndpointType = boost::asio::ip::tcp::endpoint;
+    using ErrorCode = boost::system::error_code;
+    using Clock = std::chrono::steady_clock;
+    using TimerType = boost::asio::basic_waitable_timer<Clock, boost::asio::wait_traits<Clock>, ExecutorType>;
+
+    static constexpr std::size_t kReadSize = 64 * 1024; // as sessions read
+public:
+    // Request, tried and pool must outlive the operation
+    HedgedRead(ConnectorType& connector,
+               Pool& pool,
+               Hedging& hedging,
+               SocketType& socket,
+               IoBuffer& buffer,
+               const Segments& request,
+               const TriedBackends& tried,
+               const EndpointType& client_endpoint,
+               Handler handler)
+        : connector_(connector)
+        , pool_(pool)
+        , hedging_(hedging)
+        , socket_(socket)
+        , buffer_(buffer)
+        , request_(request)
+        , tried_(tried)
+        , client_endpoint_(client_endpoint)
+        , timer_(socket.get_executor())
+        , handler_(std::move(handler))
+    {}
+
+    // Must be called on the socket's strand
+    void Start()
+    {
+        start_ = Clock::now();
+        hedging_.Deposit();
+        socket_.async_read_some(PrepareRead(primary_buffer_, kReadSize),
+                                [self=this->shared_from_this()](const ErrorCode& ec, std::size_t length) {
+                                    self->primary_buffer_.commit(length);
+                                    self->HandlePrimaryRead(ec);
+                                });
+        timer_.expires_after(hedging_.Delay());
+        timer_.async_wait([self=this->shared_from_this()](const ErrorCode& ec) {
+            if (!ec && !self->done_ && !self->cancelled_) {
+                self->StartHedge();
+            }
+        });
+    }
+
+    // Handler gets operation_aborted once the pending reads are back
+    void Cancel()
+    {
+        if (done_ || cancelled_) {
+            return;
+        }
+        cancelled_ = true;
+        timer_.cancel();
+        ErrorCode ignored;
+        socket_.cancel(ignored);
+        if (hedge_socket_) {
+            hedge_socket_->cancel(ignored);
+        }
+        hedge_cancellation_.Cancel();
+    }
+private:
+    void HandlePrimaryRead(const ErrorCode& ec)
+    {
+        if (done_) {
+            return;
+        }
+        if (!ec) {
+            std::swap(buffer_, primary_buffer_);
+            Win(std::nullopt);
+            return;
+        }
+        if (ec == boost::asio::error::operation_aborted || cancelled_ || !hedge_running_) {
+            Complete(cancelled_ ? boost::asio::error::operation_aborted : ec, std::nullopt);
+            return;
+        }
+        primary_error_ = ec; // hedge may still answer
+    }
+
+    void StartHedge()
+    {
+        hedge_ = connector_.Hedge(pool_, tried_, client_endpoint_);
+        if (!hedge_) {
+            return;
+        }
+        hedge_running_ = true;
+        hedge_socket_.emplace(socket_.get_executor());
+        connector_.AsyncConnect(*hedge_socket_, hedge_->backend, &hedge_cancellation_,
+                                [self=this->shared_from_this()](const ErrorCode& ec) {
+                                    if (ec) {
+                                        self->HandleHedgeError();
+                                        return;
+                                    }
+                                    self->WriteHedge();
+                                });
+    }
+
+    void WriteHedge()
+    {
+        if (done_) {
+            return;
+        }
+        boost::asio::async_write(
+            *hedge_socket_, boost::beast::buffers_range_ref(request_),
+            [self=this->shared_from_this()](const ErrorCode& ec, std::size_t) {
+                if (ec) {
+                    self->HandleHedgeError();
+                    return;
+                }
+                self->ReadHedge();
+            });
+    }
+
+    void ReadHedge()
+    {
+        if (done_) {
+            return;
+        }
+        hedge_socket_->async_read_some(PrepareRead(hedge_buffer_, kReadSize),
+                                       [self=this->shared_from_this()](const ErrorCode& ec, std::size_t length) {
+                                           self->hedge_buffer_.commit(length);
+                                           if (ec) {
+                                               self->HandleHedgeError();
+                                               return;
+                                           }
+                                           self->HandleHedgeRead();
+                                       });
+    }
+
+    void HandleHedgeRead()
+    {
+        if (done_) {
+            return;
+        }
+        // pending primary read completes as aborted
+        ErrorCode ignored;
+        socket_.close(ignored);
+        socket_ = std::move(*hedge_socket_);
+        hedge_socket_.reset();
+        std::swap(buffer_, hedge_buffer_);
+        Win(std::move(hedge_));
+    }
+
+    void HandleHedgeError()
+    {
+        if (done_) {
+            return;
+        }
+        hedge_running_ = false;
+        ErrorCode ignored;
+        hedge_socket_->close(ignored);
+        if (primary_error_) {
+            Complete(cancelled_ ? boost::asio::error::operation_aborted : primary_error_, std::nullopt);
+        }
+    }
+
+    void Win(std::optional<Connection> hedge)
+    {
+        hedging_.Record(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start_));
+        Complete({}, std::move(hedge));
+    }
+
+    void Complete(const ErrorCode& ec, std::optional<Connection> hedge)
+    {
+        done_ = true;
+        timer_.cancel();
+        if (hedge_socket_) {
+            ErrorCode ignored;
+            hedge_socket_->close(ignored);
+        }
+        Handler handler = std::move(handler_);
+        handler(ec, std::move(hedge));
+    }
+private:
+    ConnectorType& connector_;
+    Pool& pool_;
+    Hedging& hedging_;
+    SocketType& socket_;
+    IoBuffer& buffer_;
+    const Segments& request_;
+    const TriedBackends& tried_;
+    const EndpointType& client_endpoint_;
+    TimerType timer_;
+    Handler handler_;
+    IoBuffer primary_buffer_;
+    IoBuffer hedge_buffer_;
+    std::optional<SocketType> hedge_socket_;
+    ConnectCancellation hedge_cancellation_; // of the hedge's connect
+    std::optional<Connection> hedge_;
+    Clock::time_point start_;
+    ErrorCode primary_error_; // set once primary failed while hedge is running
+    bool hedge_running_ = false;
+    bool cancelled_ = false;
+    bool done_ = false;
+};
+
+} // namespace lb::tcp
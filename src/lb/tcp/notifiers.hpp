@@ -0,0 +1,113 @@
+#pragma once
+
+#include <lb/tcp/selectors.hpp>
+
+#include <chrono>
+#include <optional>
+#include <variant>
+
+namespace lb::tcp {
+
+// Notifier policies of HttpSession: hooks of the session lifecycle feeding
+// selectors that track backend load. A session type is instantiated per
+// policy, so hooks of other selectors inline to nothing and least-* ones
+// update their selector without virtual calls. OnConnect gets the selector
+// of the pool the session connected to, it must be of the policy's type.
+
+struct NoopNotifier {
+    void OnConnect(ISelector&, const Backend&) {}
+    void OnDisconnect() {}
+    void OnRequestSent() {}
+    void OnResponseReceive() {}
+};
+
+class LeastConnectionsNotifier {
+public:
+    void OnConnect(ISelector& selector, const Backend& backend)
+    {
+        selector_ = static_cast<LeastConnectionsSelector*>(&selector);
+        backend_.emplace(backend);
+        selector_->IncreaseConnectionCount(*backend_);
+    }
+
+    void OnDisconnect()
+    {
+        if (selector_) {
+            selector_->DecreaseConnectionCount(*backend_);
+        }
+    }
+
+    void OnRequestSent() {}
+    void OnResponseReceive() {}
+private:
+    LeastConnectionsSelector* selector_ = nullptr; // pools outlive sessions
+    std::optional<Backend> backend_;
+};
+
+class LeastResponseTimeNotifier {
+public:
+    using ClockType = std::chrono::steady_clock;
+public:
+    void OnConnect(ISelector& selector, const Backend& backend)
+    {
+        selector_ = static_cast<LeastResponseTimeSelector*>(&selector);
+        backend_.emplace(backend);
+    }
+
+    void OnDisconnect() {}
+
+    void OnRequestSent()
+    {
+        response_begin_ = ClockType::now();
+    }
+
+    void OnResponseReceive()
+    {
+        std::chrono::nanoseconds duration = ClockType::now() - response_begin_;
+        selector_->AddResponseTime(*backend_, duration.count());
+    }
+private:
+    LeastResponseTimeSelector* selector_ = nullptr; // pools outlive sessions
+    std::optional<Backend> backend_;
+    ClockType::time_point response_begin_;
+};
+
+// For routers whose pools use different selectors: the policy is picked
+// by selector type on connect, dispatch is a switch over the variant.
+class AnyNotifier {
+public:
+    void OnConnect(ISelector& selector, const Backend& backend)
+    {
+        switch (selector.Type()) {
+        case SelectorType::LEAST_CONNECTIONS:
+            notifier_.emplace<LeastConnectionsNotifier>();
+            break;
+        case SelectorType::LEAST_RESPONSE_TIME:
+            notifier_.emplace<LeastResponseTimeNotifier>();
+            break;
+        default:
+            notifier_.emplace<NoopNotifier>();
+            break;
+        }
+        std::visit([&](auto& notifier) { notifier.OnConnect(selector, backend); }, notifier_);
+    }
+
+    void OnDisconnect()
+    {
+        std::visit([](auto& notifier) { notifier.OnDisconnect(); }, notifier_);
+    }
+
+    void OnRequestSent()
+    {
+        std::visit([](auto& notifier) { notifier.OnRequestSent(); }, notifier_);
+    }
+
+    void OnResponseReceive()
+    {
+        std::visit([](auto& notifier) { notifier.OnResponseReceive(); }, notifier_);
+    }
+private:
+    std::variant<NoopNotifier, LeastConnectionsNotifier, LeastResponseTimeNotifier> notifier_;
+};
+
+} // namespace lb::tcp
@@ -0,0 +1,230 @@
+#include <lb/tcp/rate_limiter.hpp>
+#include <lb/logging.hpp>
+#include <lb/metrics.hpp>
+
+#include <random>
+
+#include <yaml-cpp/yaml.h>
+
+namespace lb::tcp {
+
+namespace {
+
+std::size_t RoundUpToPowerOfTwo(std::size_t value)
+{
+    std::size_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+std::uint64_t Mix(std::uint64_t x)
+{
+    // splitmix64 finalizer
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+} // anonymous namespace
+
+RateLimiter::RateLimiter(const Configuration& config)
+    : connections_(MakeGcra(config.connections))
+    , requests_(MakeGcra(config.requests))
+    , seed_(std::random_device{}() | (static_cast<std::uint64_t>(std::random_device{}()) << 32))
+    , epoch_(Clock::now())
+    , rejected_connections_(metrics::Registry::Instance().GetCounter("rate_limit.rejected_connections"))
+    , rejected_requests_(metrics::Registry::Instance().GetCounter("rate_limit.rejected_requests"))
+    , evictions_(metrics::Registry::Instance().GetCounter("rate_limit.evictions"))
+{
+    std::size_t shards = RoundUpToPowerOfTwo(std::max<std::size_t>(config.shards, 1));
+    std::size_t capacity = RoundUpToPowerOfTwo(std::max(config.table_size, shards * kProbeWindow));
+    shard_size_ = capacity / shards;
+    shard_mask_ = shard_size_ - 1;
+    shards_mask_ = shards - 1;
+    slots_ = std::make_unique<Slot[]>(capacity);
+}
+
+RateLimiter::Gcra RateLimiter::MakeGcra(const Limit& limit)
+{
+    if (limit.rate <= 0) {
+        return {};
+    }
+    Gcra gcra;
+    gcra.interval = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(1e9 / limit.rate));
+    gcra.tolerance = static_cast<std::uint64_t>(gcra.interval * std::max(limit.burst - 1.0, 0.0));
+    return gcra;
+}
+
+bool RateLimiter::Consume(std::atomic<std::uint64_t>& tat, const Gcra& gcra, std::uint64_t now)
+{
+    std::uint64_t current = tat.load(std::memory_order_relaxed);
+    while (true) {
+        std::uint64_t arrival = std::max(current, now);
+        if (arrival - now > gcra.tolerance) {
+            return false;
+        }
+        if (tat.compare_exchange_weak(current, arrival + gcra.interval, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+}
+
+std::uint64_t RateLimiter::Hash(const AddressType& address) const
+{
+    std::uint64_t hi = 0;
+    std::uint64_t lo = 0;
+    if (address.is_v4()) {
+        lo = address.to_v4().to_uint();
+    } else {
+        auto bytes = address.to_v6().to_bytes();
+        for (std::size_t i = 0; i < 8; ++i) {
+            hi = (hi << 8) | bytes[i];
+            lo = (lo << 8) | bytes[i + 8];
+        }
+    }
+    std::uint64_t hash = Mix(Mix(lo ^ seed_) ^ hi);
+    return hash == 0 ? 1 : hash;
+}
+
+RateLimiter::Slot& RateLimiter::FindOrInsert(std::uint64_t key)
+{
+    Slot* shard = slots_.get() + ((key >> 32) & shards_mask_) * shard_size_;
+    std::size_t start = key & shard_mask_;
+
+    Slot* empty = nullptr;
+    for (std::size_t i = 0; i < kProbeWindow; ++i) {
+        Slot& slot = shard[(start + i) & shard_mask_];
+        std::uint64_t slot_key = slot.key.load(std::memory_order_acquire);
+        if (slot_key == key) {
+            if (!slot.referenced.load(std::memory_order_relaxed)) {
+                slot.referenced.store(true, std::memory_order_relaxed);
+            }
+            return slot;
+        }
+        if (slot_key == 0 && empty == nullptr) {
+            empty = &slot;
+        }
+    }
+
+    if (empty != nullptr) {
+        std::uint64_t expected = 0;
+        if (empty->key.compare_exchange_strong(expected, key, std::memory_order_acq_rel)) {
+            empty->referenced.store(true, std::memory_order_relaxed);
+            return *empty;
+        }
+        if (expected == key) {
+            return *empty; // concurrently inserted by another thread
+        }
+    }
+
+    // CLOCK within the probe window: evict first entry not used since last sweep
+    Slot* victim = &shard[start];
+    for (std::size_t i = 0; i < kProbeWindow; ++i) {
+        Slot& slot = shard[(start + i) & shard_mask_];
+        if (!slot.referenced.exchange(false, std::memory_order_relaxed)) {
+            victim = &slot;
+            break;
+        }
+    }
+
+    evictions_.Add();
+    victim->connections_tat.store(0, std::memory_order_relaxed);
+    victim->requests_tat.store(0, std::memory_order_relaxed);
+    victim->key.store(key, std::memory_order_release);
+    victim->referenced.store(true, std::memory_order_relaxed);
+    return *victim;
+}
+
+std::uint64_t RateLimiter::Nanoseconds(Clock::time_point tp) const
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(tp - epoch_).count();
+}
+
+bool RateLimiter::AllowConnection(const AddressType& client)
+{
+    return AllowConnection(client, Clock::now());
+}
+
+bool RateLimiter::AllowRequest(const AddressType& client)
+{
+    return AllowRequest(client, Clock::now());
+}
+
+bool RateLimiter::AllowConnection(const AddressType& client, Clock::time_point now)
+{
+    if (connections_.interval == 0) {
+        return true;
+    }
+    Slot& slot = FindOrInsert(Hash(client));
+    if (!Consume(slot.connections_tat, connections_, Nanoseconds(now))) {
+        rejected_connections_.Add();
+        return false;
+    }
+    return true;
+}
+
+bool RateLimiter::AllowRequest(const AddressType& client, Clock::time_point now)
+{
+    if (requests_.interval == 0) {
+        return true;
+    }
+    Slot& slot = FindOrInsert(Hash(client));
+    if (!Consume(slot.requests_tat, requests_, Nanoseconds(now))) {
+        rejected_requests_.Add();
+        return false;
+    }
+    return true;
+}
+
+bool RateLimiter::LimitsRequests() const
+{
+    return requests_.interval != 0;
+}
+
+std::size_t RateLimiter::Capacity() const
+{
+    return shard_size_ * (shards_mask_ + 1);
+}
+
+RateLimiterPtr ConfigureRateLimiter(const YAML::Node& config)
+{
+    if (!config["rate_limit"].IsDefined()) {
+        return nullptr;
+    }
+
+    const YAML::Node& node = config["rate_limit"];
+    if (!node.IsMap()) {
+        EXCEPTION("rate_limit node must be a map");
+    }
+
+    RateLimiter::Configuration result;
+    auto read_limit = [&node](const std::string& name, RateLimiter::Limit& limit) {
+        if (node[name + "_per_second"].IsDefined()) {
+            limit.rate = node[name + "_per_second"].as<double>();
+            limit.burst = std::max(limit.rate, 1.0);
+        }
+        if (node[name + "_burst"].IsDefined()) {
+            limit.burst = node[name + "_burst"].as<double>();
+        }
+        if (limit.rate < 0 || limit.burst < 1) {
+            EXCEPTION("Invalid rate_limit for {}", name);
+        }
+    };
+    read_limit("connections", result.connections);
+    read_limit("requests", result.requests);
+
+    if (node["table_size"].IsDefined()) {
+        result.table_size = node["table_size"].as<std::size_t>();
+    }
+    if (node["shards"].IsDefined()) {
+        result.shards = node["shards"].as<std::size_t>();
+    }
+    return std::make_shared<RateLimiter>(result);
+}
+
+} // namespace lb::tcp
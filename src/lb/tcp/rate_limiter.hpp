@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <boost/asio/ip/address.hpp>
+
+namespace YAML {class Node;}
+
+namespace lb::metrics {class Counter;}
+
+namespace lb::tcp {
+
+// Per-client-address rate limiter for new connections and requests.
+//
+// Clients are tracked in a fixed-size table split into shards, so memory
+// stays constant no matter how many source addresses are seen. Every client
+// is looked up within a small probe window of its shard; when the window is
+// full the entry that was not used since the last sweep is evicted (CLOCK).
+// Buckets are GCRA token buckets: one atomic timestamp updated with CAS.
+class RateLimiter {
+public:
+    using AddressType = boost::asio::ip::address;
+    using Clock = std::chrono::steady_clock;
+
+    struct Limit {
+        double rate = 0.0;  // tokens per second, 0 - unlimited
+        double burst = 1.0; // bucket size
+    };
+
+    struct Configuration {
+        Limit connections;
+        Limit requests;
+        std::size_t table_size = 65536; // tracked clients
+        std::size_t shards = 64;
+    };
+public:
+    explicit RateLimiter(const Configuration& config);
+
+    RateLimiter(const RateLimiter&) = delete;
+    RateLimiter& operator=(const RateLimiter&) = delete;
+
+    bool AllowConnection(const AddressType& client);
+    bool AllowRequest(const AddressType& client);
+
+    bool AllowConnection(const AddressType& client, Clock::time_point now);
+    bool AllowRequest(const AddressType& client, Clock::time_point now);
+
+    bool LimitsRequests() const;
+
+    std::size_t Capacity() const;
+
+private:
+    struct alignas(32) Slot {
+        std::atomic<std::uint64_t> key{0};
+        std::atomic<std::uint64_t> connections_tat{0}; // theoretical arrival times, ns
+        std::atomic<std::uint64_t> requests_tat{0};
+        std::atomic<bool> referenced{false};
+    };
+
+    struct Gcra {
+        std::uint64_t interval = 0;  // ns between tokens, 0 - unlimited
+        std::uint64_t tolerance = 0; // ns of burst
+    };
+
+    static Gcra MakeGcra(const Limit& limit);
+
+    static bool Consume(std::atomic<std::uint64_t>& tat, const Gcra& gcra, std::uint64_t now);
+
+    std::uint64_t Hash(const AddressType& address) const;
+
+    Slot& FindOrInsert(std::uint64_t key);
+
+    std::uint64_t Nanoseconds(Clock::time_point tp) const;
+
+private:
+    static constexpr std::size_t kProbeWindow = 8;
+
+    Gcra connections_;
+    Gcra requests_;
+    std::size_t shard_size_;
+    std::size_t shard_mask_;
+    std::size_t shards_mask_;
+    std::uint64_t seed_;
+    Clock::time_point epoch_;
+    std::unique_ptr<Slot[]> slots_;
+    metrics::Counter& rejected_connections_;
+    metrics::Counter& rejected_requests_;
+    metrics::Counter& evictions_;
+};
+
+using RateLimiterPtr = std::shared_ptr<RateLimiter>;
+
+// Returns nullptr if rate_limit node is missing
+RateLimiterPtr ConfigureRateLimiter(const YAML::Node& config);
+
+} // namespace lb::tcp
@@ -0,0 +1,308 @@
+#include <lb/tcp/raw_message.hpp>
+#include <lb/logging.hpp>
+
+#include <boost/beast/core/string.hpp>
+#include <boost/beast/http/error.hpp>
+#include <yaml-cpp/yaml.h>
+
+namespace lb::tcp {
+
+namespace http = boost::beast::http;
+
+void MessageHead::Clear()
+{
+    method = http::verb::unknown;
+    status = 0;
+    target = {};
+    fields.clear();
+    header_size = 0;
+    message_size = 0;
+    keep_alive = true;
+}
+
+MessageView::MessageView(const MessageHead& head, std::string_view raw)
+    : head_(head)
+    , raw_(raw)
+{}
+
+std::string_view MessageView::Raw() const
+{
+    return raw_.substr(0, head_.message_size);
+}
+
+std::string_view MessageView::Target() const
+{
+    return Text(head_.target);
+}
+
+http::verb MessageView::Method() const
+{
+    return head_.method;
+}
+
+std::string_view MessageView::Find(http::field name) const
+{
+    for (const MessageHead::Field& field : head_.fields) {
+        if (field.name == name) {
+            return Text(field.value);
+        }
+    }
+    return {};
+}
+
+const MessageHead& MessageView::Head() const
+{
+    return head_;
+}
+
+std::string_view MessageView::Text(MessageHead::Span span) const
+{
+    return raw_.substr(span.offset, span.length);
+}
+
+template <bool isRequest>
+RawParser<isRequest>::RawParser(MessageHead& head)
+    : head_(head)
+{
+    head_.Clear();
+    this->eager(true);
+}
+
+template <bool isRequest>
+bool RawParser<isRequest>::Parse(boost::asio::const_buffer data, ErrorCode& ec)
+{
+    data_ = std::string_view(static_cast<const char*>(data.data()), data.size());
+    while (!this->is_done() && parsed_ < data_.size()) {
+        std::size_t used = this->put(boost::asio::buffer(data_.data() + parsed_, data_.size() - parsed_), ec);
+        parsed_ += used;
+        if (ec == http::error::need_more) {
+            ec = {};
+            break;
+        }
+        if (ec) {
+            return false;
+        }
+        if (used == 0) {
+            break;
+        }
+    }
+
+    if (this->is_done()) {
+        head_.message_size = parsed_;
+        head_.keep_alive = this->keep_alive();
+        return true;
+    }
+    return false;
+}
+
+template <bool isRequest>
+bool RawParser<isRequest>::ParseEof(ErrorCode& ec)
+{
+    this->put_eof(ec);
+    if (ec || !this->is_done()) {
+        return false;
+    }
+    head_.message_size = parsed_;
+    head_.keep_alive = false;
+    return true;
+}
+
+template <bool isRequest>
+bool RawParser<isRequest>::ToSpan(StringView text, MessageHead::Span& span) const
+{
+    // Values with obs-fold are unfolded by the parser into its own storage
+    if (text.data() < data_.data() || text.data() + text.size() > data_.data() + data_.size()) {
+        return false;
+    }
+    span.offset = text.data() - data_.data();
+    span.length = text.size();
+    return true;
+}
+
+template <bool isRequest>
+void RawParser<isRequest>::on_request_impl(http::verb method, StringView method_str,
+                                           StringView target, int version, ErrorCode& ec)
+{
+    head_.method = method;
+    if (!ToSpan(target, head_.target)) {
+        ec = http::error::bad_target;
+    }
+}
+
+template <bool isRequest>
+void RawParser<isRequest>::on_response_impl(int code, StringView reason, int version, ErrorCode& ec)
+{
+    head_.status = code;
+}
+
+template <bool isRequest>
+void RawParser<isRequest>::on_field_impl(http::field name, StringView name_string,
+                                         StringView value, ErrorCode& ec)
+{
+    MessageHead::Field field{.name = name};
+    if (!ToSpan(name_string, field.name_text) || !ToSpan(value, field.value)) {
+        ec = http::error::bad_value;
+        return;
+    }
+    field.line_begin = field.name_text.offset;
+    std::size_t line_end = data_.find("\r\n", field.value.offset + field.value.length);
+    if (line_end == std::string_view::npos) {
+        ec = http::error::bad_value;
+        return;
+    }
+    field.line_end = line_end + 2;
+    head_.fields.push_back(field);
+}
+
+template <bool isRequest>
+void RawParser<isRequest>::on_header_impl(ErrorCode& ec)
+{
+    std::size_t from = head_.fields.empty() ? 0 : head_.fields.back().line_end - 2;
+    std::size_t end = data_.find("\r\n\r\n", from);
+    if (end == std::string_view::npos) {
+        ec = http::error::bad_value;
+        return;
+    }
+    head_.header_size = end + 4;
+}
+
+template <bool isRequest>
+void RawParser<isRequest>::on_body_init_impl(const boost::optional<std::uint64_t>& content_length, ErrorCode& ec)
+{}
+
+template <bool isRequest>
+std::size_t RawParser<isRequest>::on_body_impl(StringView body, ErrorCode& ec)
+{
+    return body.size();
+}
+
+template <bool isRequest>
+void RawParser<isRequest>::on_chunk_header_impl(std::uint64_t size, StringView extensions, ErrorCode& ec)
+{}
+
+template <bool isRequest>
+std::size_t RawParser<isRequest>::on_chunk_body_impl(std::uint64_t remain, StringView body, ErrorCode& ec)
+{
+    return body.size();
+}
+
+template <bool isRequest>
+void RawParser<isRequest>::on_finish_impl(ErrorCode& ec)
+{}
+
+template class RawParser<true>;
+template class RawParser<false>;
+
+void HeaderRewrite::Set(std::string_view name, std::string_view value)
+{
+    Remove(name);
+    lines_.append(name).append(": ").append(value).append("\r\n");
+}
+
+void HeaderRewrite::Remove(std::string_view name)
+{
+    http::field field = http::string_to_field(boost::beast::string_view(name.data(), name.size()));
+    removed_.push_back(Name{.field = field, .text = field == http::field::unknown ? std::string(name) : ""});
+}
+
+bool HeaderRewrite::Removes(const MessageView& message, const MessageHead::Field& field) const
+{
+    for (const Name& name : removed_) {
+        if (name.field != field.name) {
+            continue;
+        }
+        if (name.field != http::field::unknown) {
+            return true;
+        }
+        std::string_view text = message.Text(field.name_text);
+        if (boost::beast::iequals(boost::beast::string_view(text.data(), text.size()), name.text)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string_view HeaderRewrite::Lines() const
+{
+    return lines_;
+}
+
+bool HeaderRewrite::Empty() const
+{
+    return removed_.empty() && lines_.empty();
+}
+
+HeaderRewritePtr ConfigureHeaderRewrite(const YAML::Node& node)
+{
+    if (!node.IsDefined() || node.IsNull()) {
+        return nullptr;
+    }
+    if (!node.IsMap()) {
+        EXCEPTION("headers rewrite node must be a map");
+    }
+
+    auto rewrite = std::make_shared<HeaderRewrite>();
+    if (node["remove"].IsDefined()) {
+        if (!node["remove"].IsSequence()) {
+            EXCEPTION("remove node must be a sequence");
+        }
+        for (const YAML::Node& name : node["remove"]) {
+            rewrite->Remove(name.as<std::string>());
+        }
+    }
+    if (node["set"].IsDefined()) {
+        if (!node["set"].IsMap()) {
+            EXCEPTION("set node must be a map");
+        }
+        for (const auto& field : node["set"]) {
+            rewrite->Set(field.first.as<std::string>(), field.second.as<std::string>());
+        }
+    }
+
+    if (rewrite->Empty()) {
+        return nullptr;
+    }
+    return rewrite;
+}
+
+void SpliceMessage(const MessageView& message,
+                   const HeaderRewrite* rewrite,
+                   std::string_view extra_lines,
+                   Segments& segments,
+                   const MessageHead::Field* replaced)
+{
+    segments.clear();
+    std::string_view raw = message.Raw();
+    if (!rewrite && extra_lines.empty()) {
+        segments.emplace_back(raw.data(), raw.size());
+        return;
+    }
+
+    const MessageHead& head = message.Head();
+    std::size_t cursor = 0;
+    auto append = [&segments](std::string_view text) {
+        if (!text.empty()) {
+            segments.emplace_back(text.data(), text.size());
+        }
+    };
+
+    if (rewrite || replaced) {
+        for (const MessageHead::Field& field : head.fields) {
+            if (&field == replaced || (rewrite && rewrite->Removes(message, field))) {
+                append(raw.substr(cursor, field.line_begin - cursor));
+                cursor = field.line_end;
+            }
+        }
+    }
+
+    // new fields go right before the empty line ending the header
+    std::size_t header_end = head.header_size - 2;
+    append(raw.substr(cursor, header_end - cursor));
+    if (rewrite) {
+        append(rewrite->Lines());
+    }
+    append(extra_lines);
+    append(raw.substr(header_end));
+}
+
+} // namespace lb::tcp
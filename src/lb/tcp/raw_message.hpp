@@ -0,0 +1,166 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <boost/asio/buffer.hpp>
+#include <boost/beast/http/basic_parser.hpp>
+#include <boost/beast/http/field.hpp>
+#include <boost/beast/http/verb.hpp>
+#include <lb/tcp/recycling_allocator.hpp>
+
+namespace YAML {class Node;}
+
+namespace lb::tcp {
+
+// Positions of the parts of a message within its raw bytes. Sessions keep one
+// per direction, so vectors keep their capacity between messages.
+struct MessageHead {
+    struct Span {
+        std::uint32_t offset = 0;
+        std::uint32_t length = 0;
+    };
+
+    struct Field {
+        boost::beast::http::field name;
+        Span name_text;
+        Span value;
+        std::uint32_t line_begin;
+        std::uint32_t line_end; // past CRLF
+    };
+
+    boost::beast::http::verb method = boost::beast::http::verb::unknown;
+    unsigned status = 0;
+    Span target;
+    std::vector<Field, RecyclingAllocator<Field>> fields;
+    std::size_t header_size = 0; // including empty line
+    std::size_t message_size = 0;
+    bool keep_alive = true;
+
+    void Clear();
+};
+
+// Parsed message together with its bytes
+class MessageView {
+public:
+    MessageView(const MessageHead& head, std::string_view raw);
+
+    std::string_view Raw() const;
+
+    std::string_view Target() const;
+
+    boost::beast::http::verb Method() const;
+
+    // Value of the first field with this name, empty if there is none
+    std::string_view Find(boost::beast::http::field name) const;
+
+    template <class Function>
+    void ForEach(boost::beast::http::field name, Function&& function) const
+    {
+        for (const MessageHead::Field& field : head_.fields) {
+            if (field.name == name) {
+                function(Text(field.value));
+            }
+        }
+    }
+
+    const MessageHead& Head() const;
+
+    std::string_view Text(MessageHead::Span span) const;
+private:
+    const MessageHead& head_;
+    std::string_view raw_;
+};
+
+// Finds message boundaries and records field positions without copying
+// anything: body and header stay in the read buffer and are forwarded as is.
+template <bool isRequest>
+class RawParser final : public boost::beast::http::basic_parser<isRequest> {
+public:
+    using ErrorCode = boost::system::error_code;
+    using StringView = boost::beast::string_view;
+public:
+    explicit RawParser(MessageHead& head);
+
+    // Data holds the message from its first byte, only the part that was not
+    // parsed yet is looked at. Returns true when the message is complete.
+    bool Parse(boost::asio::const_buffer data, ErrorCode& ec);
+
+    // For messages delimited by end of stream
+    bool ParseEof(ErrorCode& ec);
+private:
+    void on_request_impl(boost::beast::http::verb method, StringView method_str,
+                         StringView target, int version, ErrorCode& ec) override;
+
+    void on_response_impl(int code, StringView reason, int version, ErrorCode& ec) override;
+
+    void on_field_impl(boost::beast::http::field name, StringView name_string,
+                       StringView value, ErrorCode& ec) override;
+
+    void on_header_impl(ErrorCode& ec) override;
+
+    void on_body_init_impl(const boost::optional<std::uint64_t>& content_length, ErrorCode& ec) override;
+
+    std::size_t on_body_impl(StringView body, ErrorCode& ec) override;
+
+    void on_chunk_header_impl(std::uint64_t size, StringView extensions, ErrorCode& ec) override;
+
+    std::size_t on_chunk_body_impl(std::uint64_t remain, StringView body, ErrorCode& ec) override;
+
+    void on_finish_impl(ErrorCode& ec) override;
+
+    bool ToSpan(StringView text, MessageHead::Span& span) const;
+private:
+    MessageHead& head_;
+    std::string_view data_; // bytes known on the current Parse call
+    std::size_t parsed_ = 0;
+};
+
+using RawRequestParser = RawParser<true>;
+using RawResponseParser = RawParser<false>;
+
+// Header edits applied while forwarding
+class HeaderRewrite {
+public:
+    // Replaces all fields with this name
+    void Set(std::string_view name, std::string_view value);
+
+    void Remove(std::string_view name);
+
+    bool Removes(const MessageView& message, const MessageHead::Field& field) const;
+
+    // Fields appended to the header
+    std::string_view Lines() const;
+
+    bool Empty() const;
+private:
+    struct Name {
+        boost::beast::http::field field;
+        std::string text; // for unknown fields
+    };
+
+    std::vector<Name> removed_;
+    std::string lines_;
+};
+
+using HeaderRewritePtr = std::shared_ptr<const HeaderRewrite>;
+
+// Reads {set: {name: value}, remove: [name]}, returns nullptr if node is missing
+HeaderRewritePtr ConfigureHeaderRewrite(const YAML::Node& node);
+
+using Segments = std::vector<boost::asio::const_buffer, RecyclingAllocator<boost::asio::const_buffer>>;
+
+// Fills gather list for forwarding of the message. It is one buffer unless
+// rewrite or extra lines ("Name: value\r\n") are given; they are spliced in
+// between untouched segments of the original bytes. Replaced field of the
+// message, if given, is dropped in favour of one of extra lines.
+void SpliceMessage(const MessageView& message,
+                   const HeaderRewrite* rewrite,
+                   std::string_view extra_lines,
+                   Segments& segments,
+                   const MessageHead::Field* replaced = nullptr);
+
+} // namespace lb::tcp
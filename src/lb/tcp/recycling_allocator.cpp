@@ -0,0 +1,94 @@
+#include <lb/tcp/recycling_allocator.hpp>
+
+#include <array>
+#include <new>
+
+namespace lb::tcp {
+
+namespace {
+
+constexpr std::size_t kSizesCount = RecyclingCache::kMaxBlockSize / RecyclingCache::kGranularity;
+
+struct FreeBlock {
+    FreeBlock* next;
+};
+
+struct FreeList {
+    FreeBlock* head = nullptr;
+    std::size_t count = 0;
+};
+
+// Set when the thread's cache is destroyed, later calls on the thread use heap
+thread_local bool cache_destroyed = false;
+
+class ThreadCache {
+public:
+    ~ThreadCache()
+    {
+        for (FreeList& list : lists) {
+            while (list.head) {
+                FreeBlock* block = list.head;
+                list.head = block->next;
+                ::operator delete(block);
+            }
+        }
+        cache_destroyed = true;
+    }
+public:
+    std::array<FreeList, kSizesCount> lists;
+};
+
+ThreadCache* LocalCache()
+{
+    if (cache_destroyed) {
+        return nullptr;
+    }
+    thread_local ThreadCache cache;
+    return &cache;
+}
+
+std::size_t IndexOf(std::size_t size)
+{
+    return size == 0 ? 0 : (size - 1) / RecyclingCache::kGranularity;
+}
+
+} // anonymous namespace
+
+void* RecyclingCache::Allocate(std::size_t size)
+{
+    if (size > kMaxBlockSize) {
+        return ::operator new(size);
+    }
+    const std::size_t index = IndexOf(size);
+    if (ThreadCache* cache = LocalCache()) {
+        FreeList& list = cache->lists[index];
+        if (list.head) {
+            FreeBlock* block = list.head;
+            list.head = block->next;
+            --list.count;
+            return block;
+        }
+    }
+    return ::operator new((index + 1) * kGranularity);
+}
+
+void RecyclingCache::Deallocate(void* pointer, std::size_t size) noexcept
+{
+    if (!pointer) {
+        return;
+    }
+    if (size <= kMaxBlockSize) {
+        ThreadCache* cache = LocalCache();
+        FreeList* list = cache ? &cache->lists[IndexOf(size)] : nullptr;
+        if (list && list->count < kMaxBlocksPerSize) {
+            FreeBlock* block = static_cast<FreeBlock*>(pointer);
+            block->next = list->head;
+            list->head = block;
+            ++list->count;
+            return;
+        }
+    }
+    ::operator delete(pointer);
+}
+
+} // namespace lb::tcp
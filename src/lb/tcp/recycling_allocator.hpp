@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+
+namespace lb::tcp {
+
+// Per-thread cache of small blocks for objects created at connection rate:
+// sessions, notifiers, per-session vectors. Freed blocks are kept in lists
+// by size and handed out again, a block freed on another thread joins that
+// thread's cache. Larger blocks and overflow go to the heap.
+class RecyclingCache {
+public:
+    static constexpr std::size_t kGranularity = 64;
+    static constexpr std::size_t kMaxBlockSize = 4096;
+    static constexpr std::size_t kMaxBlocksPerSize = 256;
+public:
+    static void* Allocate(std::size_t size);
+
+    // Size must be the one passed to Allocate
+    static void Deallocate(void* pointer, std::size_t size) noexcept;
+};
+
+template <class T>
+class RecyclingAllocator {
+public:
+    using value_type = T;
+    using propagate_on_container_move_assignment = std::true_type;
+    using is_always_equal = std::true_type;
+public:
+    RecyclingAllocator() = default;
+
+    template <class U>
+    RecyclingAllocator(const RecyclingAllocator<U>&) noexcept
+    {}
+
+    T* allocate(std::size_t n)
+    {
+        return static_cast<T*>(RecyclingCache::Allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T* pointer, std::size_t n) noexcept
+    {
+        RecyclingCache::Deallocate(pointer, n * sizeof(T));
+    }
+
+    template <class U>
+    bool operator==(const RecyclingAllocator<U>&) const noexcept
+    {
+        return true;
+    }
+
+    template <class U>
+    bool operator!=(const RecyclingAllocator<U>&) const noexcept
+    {
+        return false;
+    }
+};
+
+} // namespace lb::tcp
@@ -0,0 +1,390 @@
+#include <lb/tcp/response_cache.hpp>
+#include <lb/logging.hpp>
+#include <lb/metrics.hpp>
+
+#include <boost/beast/core/string.hpp>
+#include <yaml-cpp/yaml.h>
+
+#include <algorithm>
+#include <charconv>
+#include <ctime>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+
+namespace lb::tcp {
+
+namespace {
+
+using boost::beast::http::field;
+
+struct CacheControl {
+    bool no_store = false;
+    bool no_cache = false;
+    bool is_private = false;
+    std::optional<std::int64_t> max_age;
+    std::optional<std::int64_t> s_maxage;
+};
+
+bool IEquals(std::string_view lhs, std::string_view rhs)
+{
+    return boost::beast::iequals(boost::beast::string_view(lhs.data(), lhs.size()),
+                                 boost::beast::string_view(rhs.data(), rhs.size()));
+}
+
+std::string_view Trim(std::string_view text)
+{
+    while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) {
+        text.remove_prefix(1);
+    }
+    while (!text.empty() && (text.back() == ' ' || text.back() == '\t')) {
+        text.remove_suffix(1);
+    }
+    return text;
+}
+
+// Calls function for every element of comma separated lists of name fields
+template <class Function>
+void ForEachElement(const MessageView& message, field name, Function&& function)
+{
+    message.ForEach(name, [&function](std::string_view value) {
+        while (!value.empty()) {
+            const std::size_t end = value.find(',');
+            const std::string_view element = Trim(value.substr(0, end));
+            value = end == std::string_view::npos ? std::string_view{} : value.substr(end + 1);
+            if (!element.empty()) {
+                function(element);
+            }
+        }
+    });
+}
+
+// Invalid values count as zero, the message is stale then
+std::int64_t ParseSeconds(std::string_view text)
+{
+    if (text.size() >= 2 && text.front() == '"' && text.back() == '"') {
+        text = text.substr(1, text.size() - 2);
+    }
+    std::int64_t seconds = 0;
+    auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), seconds);
+    return error == std::errc() && end == text.data() + text.size() ? std::max<std::int64_t>(seconds, 0) : 0;
+}
+
+CacheControl ParseCacheControl(const MessageView& message)
+{
+    CacheControl result;
+    ForEachElement(message, field::cache_control, [&result](std::string_view directive) {
+        std::string_view argument;
+        if (const std::size_t equals = directive.find('='); equals != std::string_view::npos) {
+            argument = Trim(directive.substr(equals + 1));
+            directive = Trim(directive.substr(0, equals));
+        }
+        if (IEquals(directive, "no-store")) {
+            result.no_store = true;
+        } else if (IEquals(directive, "no-cache")) {
+            result.no_cache = true;
+        } else if (IEquals(directive, "private")) {
+            result.is_private = true;
+        } else if (IEquals(directive, "max-age")) {
+            result.max_age = ParseSeconds(argument);
+        } else if (IEquals(directive, "s-maxage")) {
+            result.s_maxage = ParseSeconds(argument);
+        }
+    });
+    return result;
+}
+
+// IMF-fixdate, e.g. "Sun, 06 Nov 1994 08:49:37 GMT"
+std::optional<std::time_t> ParseHttpDate(std::string_view text)
+{
+    std::tm time{};
+    std::istringstream stream{std::string(text)};
+    stream >> std::get_time(&time, "%a, %d %b %Y %H:%M:%S");
+    if (stream.fail()) {
+        return std::nullopt;
+    }
+    return timegm(&time);
+}
+
+// Freshness lifetime given by the backend, nullopt if there is none
+std::optional<std::chrono::seconds> Lifetime(const MessageView& response, const CacheControl& control)
+{
+    if (control.s_maxage) {
+        return std::chrono::seconds(*control.s_maxage);
+    }
+    if (control.max_age) {
+        return std::chrono::seconds(*control.max_age);
+    }
+    const std::string_view expires_text = response.Find(field::expires);
+    if (expires_text.empty()) {
+        return std::nullopt;
+    }
+    // invalid Expires means the response is already stale
+    const std::optional<std::time_t> expires = ParseHttpDate(expires_text);
+    const std::optional<std::time_t> date = ParseHttpDate(response.Find(field::date));
+    const std::time_t now = date ? *date : std::time(nullptr);
+    return std::chrono::seconds(expires && *expires > now ? *expires - now : 0);
+}
+
+bool CacheableStatus(unsigned status)
+{
+    switch (status) {
+    case 200: case 203: case 204: case 300: case 301: case 308:
+    case 404: case 405: case 410: case 414: case 501:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool HasField(const MessageView& message, field name)
+{
+    const auto& fields = message.Head().fields;
+    return std::any_of(fields.begin(), fields.end(), [name](const MessageHead::Field& f) { return f.name == name; });
+}
+
+// Values of all request fields with this name, joined as one list
+void RequestValue(const MessageView& request, std::string_view name, std::string& value)
+{
+    value.clear();
+    for (const MessageHead::Field& f : request.Head().fields) {
+        if (IEquals(request.Text(f.name_text), name)) {
+            if (!value.empty()) {
+                value.append(", ");
+            }
+            value.append(request.Text(f.value));
+        }
+    }
+}
+
+} // anonymous namespace
+
+bool CacheKey(const MessageView& request, std::string& key)
+{
+    key.clear();
+    if (request.Method() != boost::beast::http::verb::get
+        || HasField(request, field::authorization)
+        || ParseCacheControl(request).no_store) {
+        return false;
+    }
+    key.append(request.Find(field::host)).append(" ").append(request.Target());
+    return true;
+}
+
+CachedResponsePtr ShareResponse(const MessageView& request, const MessageView& response)
+{
+    const MessageHead& head = response.Head();
+    if (!CacheableStatus(head.status) || !head.keep_alive) {
+        return nullptr;
+    }
+    const CacheControl control = ParseCacheControl(response);
+    if (control.no_store || control.no_cache || control.is_private || HasField(response, field::set_cookie)) {
+        return nullptr;
+    }
+
+    auto shared = std::make_shared<CachedResponse>();
+    bool varies_by_all = false;
+    ForEachElement(response, field::vary, [&](std::string_view name) {
+        varies_by_all |= name == "*";
+        shared->vary.emplace_back(std::string(name), std::string());
+        RequestValue(request, name, shared->vary.back().second);
+    });
+    if (varies_by_all) {
+        return nullptr;
+    }
+    shared->head = head;
+    shared->raw.assign(response.Raw().substr(0, head.message_size));
+    for (std::size_t i = 0; i < head.fields.size(); ++i) {
+        if (head.fields[i].name == field::age) {
+            shared->age_field = i;
+            break;
+        }
+    }
+    shared->initial_age = std::chrono::seconds(ParseSeconds(response.Find(field::age)));
+    shared->stored = CachedResponse::Clock::now();
+    shared->expires = shared->stored;
+    if (const std::optional<std::chrono::seconds> lifetime = Lifetime(response, control)) {
+        shared->expires += std::max(*lifetime - shared->initial_age, std::chrono::seconds::zero());
+    }
+    return shared;
+}
+
+// ============================ CachedResponse ============================
+
+MessageView CachedResponse::View() const
+{
+    return MessageView(head, raw);
+}
+
+std::chrono::seconds CachedResponse::Age(Clock::time_point now) const
+{
+    return initial_age + std::chrono::duration_cast<std::chrono::seconds>(now - stored);
+}
+
+bool CachedResponse::Matches(const MessageView& request) const
+{
+    std::string value;
+    for (const auto& [name, stored] : vary) {
+        RequestValue(request, name, value);
+        if (value != stored) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void CachedResponse::Splice(const HeaderRewrite* rewrite, std::string& age_line, Segments& segments) const
+{
+    age_line.assign("Age: ").append(std::to_string(Age(Clock::now()).count())).append("\r\n");
+    SpliceMessage(View(), rewrite, age_line, segments, age_field ? &head.fields[*age_field] : nullptr);
+}
+
+// ============================ ResponseCache ============================
+
+ResponseCache::ResponseCache(const Configuration& config, const std::string& pool_name)
+    : config_(config)
+    , shard_bytes_(config.max_bytes / config.shards)
+    , shards_(std::make_unique<Shard[]>(config.shards))
+    , hits_(metrics::Registry::Instance().GetCounter("pools." + pool_name + ".cache_hits"))
+    , misses_(metrics::Registry::Instance().GetCounter("pools." + pool_name + ".cache_misses"))
+    , stores_(metrics::Registry::Instance().GetCounter("pools." + pool_name + ".cache_stores"))
+    , evictions_(metrics::Registry::Instance().GetCounter("pools." + pool_name + ".cache_evictions"))
+    , bytes_(metrics::Registry::Instance().GetGauge("pools." + pool_name + ".cache_bytes"))
+{}
+
+const ResponseCache::Configuration& ResponseCache::Config() const
+{
+    return config_;
+}
+
+CachedResponsePtr ResponseCache::Find(const std::string& key, const MessageView& request)
+{
+    const CacheControl control = ParseCacheControl(request);
+    const bool pragma_no_cache = !HasField(request, field::cache_control)
+                              && IEquals(request.Find(field::pragma), "no-cache");
+    if (control.no_cache || pragma_no_cache || (control.max_age && *control.max_age == 0)) {
+        misses_.Add();
+        return nullptr;
+    }
+
+    const CachedResponse::Clock::time_point now = CachedResponse::Clock::now();
+    CachedResponsePtr result;
+    Shard& shard = ShardOf(key);
+    {
+        boost::mutex::scoped_lock lock(shard.mutex);
+        auto it = shard.index.find(key);
+        if (it != shard.index.end()) {
+            Slot& slot = shard.slots[it->second];
+            if (slot.response->expires <= now) {
+                Erase(shard, it->second);
+            } else if ((!control.max_age || slot.response->Age(now).count() <= *control.max_age)
+                       && slot.response->Matches(request)) {
+                slot.referenced = true;
+                result = slot.response;
+            }
+        }
+    }
+    (result ? hits_ : misses_).Add();
+    return result;
+}
+
+void ResponseCache::Store(const std::string& key, CachedResponsePtr response)
+{
+    if (response->expires <= response->stored || response->raw.size() > config_.max_object_bytes) {
+        return;
+    }
+    const std::size_t bytes = sizeof(CachedResponse) + key.size() + response->raw.size()
+                            + response->head.fields.size() * sizeof(MessageHead::Field);
+    if (bytes > shard_bytes_) {
+        return;
+    }
+
+    Shard& shard = ShardOf(key);
+    boost::mutex::scoped_lock lock(shard.mutex);
+    if (auto it = shard.index.find(key); it != shard.index.end()) {
+        Erase(shard, it->second);
+    }
+    while (shard.bytes + bytes > shard_bytes_) {
+        const std::size_t index = shard.hand;
+        shard.hand = (shard.hand + 1) % shard.slots.size();
+        Slot& slot = shard.slots[index];
+        if (!slot.response) {
+            continue;
+        }
+        if (slot.referenced && slot.response->expires > response->stored) {
+            slot.referenced = false; // second chance
+            continue;
+        }
+        Erase(shard, index);
+        evictions_.Add();
+    }
+
+    std::size_t index = shard.slots.size();
+    if (!shard.free.empty()) {
+        index = shard.free.back();
+        shard.free.pop_back();
+    } else {
+        shard.slots.emplace_back();
+    }
+    Slot& slot = shard.slots[index];
+    slot.key = key;
+    slot.response = std::move(response);
+    slot.bytes = bytes;
+    slot.referenced = false;
+    shard.index.emplace(key, index);
+    shard.bytes += bytes;
+    bytes_.Add(static_cast<std::int64_t>(bytes));
+    stores_.Add();
+}
+
+std::size_t ResponseCache::Bytes() const
+{
+    return static_cast<std::size_t>(bytes_.Value());
+}
+
+ResponseCache::Shard& ResponseCache::ShardOf(const std::string& key)
+{
+    return shards_[std::hash<std::string>{}(key) % config_.shards];
+}
+
+void ResponseCache::Erase(Shard& shard, std::size_t index)
+{
+    Slot& slot = shard.slots[index];
+    shard.index.erase(slot.key);
+    shard.bytes -= slot.bytes;
+    bytes_.Sub(static_cast<std::int64_t>(slot.bytes));
+    slot.key.clear();
+    slot.response.reset();
+    slot.bytes = 0;
+    slot.referenced = false;
+    shard.free.push_back(index);
+}
+
+ResponseCachePtr ConfigureResponseCache(const YAML::Node& pool_node, const std::string& pool_name)
+{
+    if (!pool_node["cache"].IsDefined()) {
+        return nullptr;
+    }
+
+    const YAML::Node& node = pool_node["cache"];
+    if (!node.IsMap()) {
+        EXCEPTION("cache node must be a map");
+    }
+
+    ResponseCache::Configuration config;
+    if (node["max_bytes"].IsDefined()) {
+        config.max_bytes = node["max_bytes"].as<std::size_t>();
+    }
+    if (node["max_object_bytes"].IsDefined()) {
+        config.max_object_bytes = node["max_object_bytes"].as<std::size_t>();
+    }
+    if (node["shards"].IsDefined()) {
+        config.shards = node["shards"].as<std::size_t>();
+    }
+    if (config.shards == 0 || config.max_bytes < config.shards) {
+        EXCEPTION("cache.shards must be positive and at most cache.max_bytes");
+    }
+    return std::make_shared<ResponseCache>(config, pool_name);
+}
+
+} // namespace lb::tcp
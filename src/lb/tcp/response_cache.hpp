@@ -0,0 +1,127 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+#include <lb/tcp/raw_message.hpp>
+
+namespace YAML {class Node;}
+
+namespace lb::metrics {
+class Counter;
+class Gauge;
+}
+
+namespace lb::tcp {
+
+// Response shared between clients, immutable once made: sessions write it
+// straight from raw while holding a reference.
+struct CachedResponse {
+    using Clock = std::chrono::steady_clock;
+
+    MessageHead head;
+    std::string raw; // response as received, header and body
+    std::vector<std::pair<std::string, std::string>> vary; // request fields it varies by and their values
+    std::optional<std::size_t> age_field; // index of the backend's Age field
+    std::chrono::seconds initial_age{0}; // when stored
+    Clock::time_point stored;
+    Clock::time_point expires;
+
+    MessageView View() const;
+
+    std::chrono::seconds Age(Clock::time_point now) const;
+
+    // True if request has the values of Vary fields this response was for
+    bool Matches(const MessageView& request) const;
+
+    // Fills gather list of the response with its current Age, which is
+    // written into age_line; both must outlive the write
+    void Splice(const HeaderRewrite* rewrite, std::string& age_line, Segments& segments) const;
+};
+
+using CachedResponsePtr = std::shared_ptr<const CachedResponse>;
+
+// Sets key of a request whose response may be shared with other clients,
+// returns false and leaves key empty for others: not GET, with credentials
+// or no-store
+bool CacheKey(const MessageView& request, std::string& key);
+
+// Copy of response to request that may be sent to other clients, nullptr
+// if the response is theirs only (no-store, no-cache, private, Set-Cookie,
+// Vary: *), closes the connection or has a status that is not cacheable.
+// It expires after its s-maxage, max-age or Expires, at once without them.
+CachedResponsePtr ShareResponse(const MessageView& request, const MessageView& response);
+
+// Cache of GET responses of a pool, shared by its sessions. Responses are
+// stored only with an explicit lifetime (s-maxage, max-age or Expires) and
+// served until it ends, without revalidation; a URL keeps one variant of
+// its Vary fields. Keys are split between shards, each with its own lock
+// and an equal part of max_bytes, CLOCK evicts responses that were not hit
+// since the hand passed them.
+class ResponseCache {
+public:
+    struct Configuration {
+        std::size_t max_bytes = 64 * 1024 * 1024;
+        std::size_t max_object_bytes = 1024 * 1024; // larger responses are not stored
+        std::size_t shards = 16;
+    };
+public:
+    ResponseCache(const Configuration& config, const std::string& pool_name);
+
+    ResponseCache(const ResponseCache&) = delete;
+    ResponseCache& operator=(const ResponseCache&) = delete;
+
+    const Configuration& Config() const;
+
+    // Fresh response matching Vary of request, nullptr on a miss or if the
+    // request asks for a response from the backend (no-cache, max-age=0)
+    CachedResponsePtr Find(const std::string& key, const MessageView& request);
+
+    // Stores response unless it is expired or too large
+    void Store(const std::string& key, CachedResponsePtr response);
+
+    std::size_t Bytes() const;
+private:
+    struct Slot {
+        std::string key;
+        CachedResponsePtr response;
+        std::size_t bytes = 0;
+        bool referenced = false; // hit since the hand passed
+    };
+
+    struct Shard {
+        boost::mutex mutex;
+        std::unordered_map<std::string, std::size_t> index; // key -> slot, guarded by mutex
+        std::vector<Slot> slots;                            // guarded by mutex
+        std::vector<std::size_t> free;                      // empty slots, guarded by mutex
+        std::size_t hand = 0;                               // guarded by mutex
+        std::size_t bytes = 0;                              // guarded by mutex
+    };
+
+    Shard& ShardOf(const std::string& key);
+
+    void Erase(Shard& shard, std::size_t slot);
+private:
+    const Configuration config_;
+    const std::size_t shard_bytes_;
+    std::unique_ptr<Shard[]> shards_;
+    metrics::Counter& hits_;
+    metrics::Counter& misses_;
+    metrics::Counter& stores_;
+    metrics::Counter& evictions_;
+    metrics::Gauge& bytes_;
+};
+
+using ResponseCachePtr = std::shared_ptr<ResponseCache>;
+
+// Reads cache node of a pool, returns nullptr if it is missing
+ResponseCachePtr ConfigureResponseCache(const YAML::Node& pool_node, const std::string& pool_name);
+
+} // namespace lb::tcp
@@ -0,0 +1,93 @@
+#include <lb/tcp/retry.hpp>
+#include <lb/logging.hpp>
+
+#include <yaml-cpp/yaml.h>
+
+namespace lb::tcp {
+
+RetryBudget::RetryBudget(const Configuration& config)
+    : config_(config)
+    , origin_(Clock::now())
+{}
+
+std::int64_t RetryBudget::Second(Clock::time_point now) const
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(now - origin_).count();
+}
+
+RetryBudget::Bucket& RetryBudget::Current(std::int64_t second)
+{
+    Bucket& bucket = buckets_[static_cast<std::uint64_t>(second) % kWindowSeconds];
+    if (bucket.second != second) {
+        bucket = Bucket{.second = second};
+    }
+    return bucket;
+}
+
+void RetryBudget::Deposit()
+{
+    Deposit(Clock::now());
+}
+
+void RetryBudget::Deposit(Clock::time_point now)
+{
+    const std::int64_t second = Second(now);
+    boost::mutex::scoped_lock lock(mutex_);
+    ++Current(second).deposits;
+}
+
+bool RetryBudget::TryWithdraw()
+{
+    return TryWithdraw(Clock::now());
+}
+
+bool RetryBudget::TryWithdraw(Clock::time_point now)
+{
+    const std::int64_t second = Second(now);
+    boost::mutex::scoped_lock lock(mutex_);
+    std::uint64_t deposits = 0;
+    std::uint64_t withdrawals = 0;
+    for (const Bucket& bucket : buckets_) {
+        if (bucket.second > second - static_cast<std::int64_t>(kWindowSeconds)) {
+            deposits += bucket.deposits;
+            withdrawals += bucket.withdrawals;
+        }
+    }
+    const double allowed = config_.min_per_second * kWindowSeconds + config_.ratio * deposits;
+    if (withdrawals + 1 > allowed) {
+        return false;
+    }
+    ++Current(second).withdrawals;
+    return true;
+}
+
+RetryPolicy ConfigureRetries(const YAML::Node& config)
+{
+    RetryPolicy result;
+    if (!config["retries"].IsDefined()) {
+        return result;
+    }
+
+    const YAML::Node& node = config["retries"];
+    if (!node.IsMap()) {
+        EXCEPTION("retries node must be a map");
+    }
+    if (node["connect_attempts"].IsDefined()) {
+        result.connect_attempts = node["connect_attempts"].as<std::size_t>();
+        if (result.connect_attempts == 0 || result.connect_attempts > RetryPolicy::kMaxConnectAttempts) {
+            EXCEPTION("retries.connect_attempts must be in [1, {}]", RetryPolicy::kMaxConnectAttempts);
+        }
+    }
+    if (node["budget_percent"].IsDefined()) {
+        result.budget.ratio = node["budget_percent"].as<double>() / 100.0;
+    }
+    if (node["min_retries_per_second"].IsDefined()) {
+        result.budget.min_per_second = node["min_retries_per_second"].as<double>();
+    }
+    if (node["replay_max_bytes"].IsDefined()) {
+        result.replay_max_bytes = node["replay_max_bytes"].as<std::size_t>();
+    }
+    return result;
+}
+
+} // namespace lb::tcp
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include <boost/container/static_vector.hpp>
+#include <boost/thread/mutex.hpp>
+#include <lb/tcp/selectors.hpp>
+
+namespace YAML {class Node;}
+
+namespace lb::tcp {
+
+// Caps retries at a share of recent traffic, so retrying cannot multiply
+// the load on backends that are already failing. Within a sliding window
+// of kWindowSeconds retries may add `ratio` of first attempts plus a floor
+// of min_per_second, which lets quiet listeners retry too.
+class RetryBudget {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr std::size_t kWindowSeconds = 10;
+
+    struct Configuration {
+        double ratio = 0.2;
+        double min_per_second = 10.0;
+    };
+public:
+    explicit RetryBudget(const Configuration& config);
+
+    RetryBudget(const RetryBudget&) = delete;
+    RetryBudget& operator=(const RetryBudget&) = delete;
+
+    // Called for every first attempt
+    void Deposit();
+    void Deposit(Clock::time_point now);
+
+    // False if the retry would exceed the budget
+    bool TryWithdraw();
+    bool TryWithdraw(Clock::time_point now);
+private:
+    struct Bucket {
+        std::int64_t second = -1;
+        std::uint64_t deposits = 0;
+        std::uint64_t withdrawals = 0;
+    };
+
+    Bucket& Current(std::int64_t second); // mutex must be held
+
+    std::int64_t Second(Clock::time_point now) const;
+private:
+    const Configuration config_;
+    const Clock::time_point origin_;
+    boost::mutex mutex_;
+    std::array<Bucket, kWindowSeconds> buckets_; // guarded by mutex
+};
+
+struct RetryPolicy {
+    static constexpr std::size_t kMaxConnectAttempts = 8;
+
+    std::size_t connect_attempts = 3; // first one included
+    std::size_t replay_max_bytes = 64 * 1024; // of idempotent requests, 0 disables replays
+    RetryBudget::Configuration budget;
+};
+
+// Backends tried by one connect, the failed one last
+using TriedBackends = boost::container::static_vector<Backend, RetryPolicy::kMaxConnectAttempts>;
+
+// Reads optional retries node: {connect_attempts, budget_percent, min_retries_per_second,
+// replay_max_bytes}
+RetryPolicy ConfigureRetries(const YAML::Node& config);
+
+} // namespace lb::tcp
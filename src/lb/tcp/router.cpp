@@ -0,0 +1,371 @@
+#include <lb/tcp/router.hpp>
+#include <lb/logging.hpp>
+
+#include <algorithm>
+#include <map>
+
+#include <yaml-cpp/yaml.h>
+
+namespace lb::tcp {
+
+namespace {
+
+constexpr char kDefaultPool[] = "default";
+
+char ToLower(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+std::string NormalizeRuleHost(std::string_view host)
+{
+    std::string result(host);
+    std::transform(result.begin(), result.end(), result.begin(), ToLower);
+    if (!result.empty() && result.back() == '.') {
+        result.pop_back();
+    }
+    return result;
+}
+
+} // anonymous namespace
+
+void PathTrie::Add(std::string_view prefix, std::int32_t value)
+{
+    for (const auto& [rule_prefix, rule_value] : rules_) {
+        if (rule_prefix == prefix) {
+            EXCEPTION("Duplicated route prefix: {}", prefix);
+        }
+    }
+    rules_.emplace_back(prefix, value);
+}
+
+void PathTrie::Compile()
+{
+    // Build byte trie first, then lay it out breadth-first collapsing chains
+    std::vector<std::map<unsigned char, std::uint32_t>> edges(1);
+    std::vector<std::int32_t> values(1, kNoMatch);
+    for (const auto& [prefix, value] : rules_) {
+        std::uint32_t node = 0;
+        for (unsigned char c : prefix) {
+            auto it = edges[node].find(c);
+            if (it == edges[node].end()) {
+                it = edges[node].emplace(c, edges.size()).first;
+                edges.emplace_back();
+                values.push_back(kNoMatch);
+            }
+            node = it->second;
+        }
+        values[node] = value;
+    }
+
+    nodes_.assign(1, Node{.value = values[0]});
+    first_bytes_.clear();
+    children_.clear();
+    labels_.clear();
+
+    // (byte trie node, compiled node)
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> queue{{0, 0}};
+    for (std::size_t i = 0; i < queue.size(); ++i) {
+        auto [source, compiled] = queue[i];
+        nodes_[compiled].first_edge = first_bytes_.size();
+        nodes_[compiled].edges_count = edges[source].size();
+
+        for (const auto& [c, child] : edges[source]) {
+            Node node{.label_offset = static_cast<std::uint32_t>(labels_.size())};
+            std::uint32_t last = child;
+            while (values[last] == kNoMatch && edges[last].size() == 1) {
+                labels_.push_back(edges[last].begin()->first);
+                last = edges[last].begin()->second;
+            }
+            node.label_length = labels_.size() - node.label_offset;
+            node.value = values[last];
+
+            first_bytes_.push_back(c);
+            children_.push_back(nodes_.size());
+            queue.emplace_back(last, nodes_.size());
+            nodes_.push_back(node);
+        }
+    }
+
+    rules_.clear();
+    rules_.shrink_to_fit();
+}
+
+std::int32_t PathTrie::Match(std::string_view path) const
+{
+    if (nodes_.empty()) {
+        return kNoMatch;
+    }
+
+    std::int32_t result = nodes_[0].value;
+    const Node* node = &nodes_[0];
+    std::size_t position = 0;
+    while (position < path.size() && node->edges_count > 0) {
+        const unsigned char* begin = first_bytes_.data() + node->first_edge;
+        const unsigned char* end = begin + node->edges_count;
+        const unsigned char c = path[position];
+        const unsigned char* edge = node->edges_count <= 8
+            ? std::find(begin, end, c)
+            : std::lower_bound(begin, end, c);
+        if (edge == end || *edge != c) {
+            break;
+        }
+
+        node = &nodes_[children_[edge - first_bytes_.data()]];
+        ++position;
+        if (node->label_length > path.size() - position
+            || labels_.compare(node->label_offset, node->label_length,
+                               path.data() + position, node->label_length) != 0) {
+            break;
+        }
+        position += node->label_length;
+        if (node->value != kNoMatch) {
+            result = node->value;
+        }
+    }
+    return result;
+}
+
+PathTrie& RouteMatcher::TrieFor(HostTable& table, std::string_view host)
+{
+    auto it = table.find(host);
+    if (it == table.end()) {
+        hosts_.emplace_back(host);
+        it = table.emplace(hosts_.back(), PathTrie{}).first;
+    }
+    return it->second;
+}
+
+void RouteMatcher::Add(std::string_view host, std::string_view path_prefix, std::int32_t value)
+{
+    std::string normalized = NormalizeRuleHost(host);
+    if (normalized.size() > kMaxHostLength) {
+        EXCEPTION("Route host is too long: {}", host);
+    }
+
+    if (normalized.empty()) {
+        any_host_.Add(path_prefix, value);
+    } else if (normalized.rfind("*.", 0) == 0) {
+        TrieFor(wildcard_, std::string_view(normalized).substr(2)).Add(path_prefix, value);
+    } else if (normalized.find('*') != std::string::npos) {
+        EXCEPTION("Only leading wildcard is supported in route host: {}", host);
+    } else {
+        TrieFor(exact_, normalized).Add(path_prefix, value);
+    }
+}
+
+void RouteMatcher::Compile()
+{
+    for (auto& [host, trie] : exact_) {
+        trie.Compile();
+    }
+    for (auto& [host, trie] : wildcard_) {
+        trie.Compile();
+    }
+    any_host_.Compile();
+}
+
+std::int32_t RouteMatcher::Match(std::string_view host, std::string_view path) const
+{
+    // Host header may carry port and trailing dot and is case-insensitive
+    char buffer[kMaxHostLength];
+    std::size_t length = 0;
+    if (host.size() <= kMaxHostLength) {
+        for (char c : host) {
+            if (c == ':') {
+                break;
+            }
+            buffer[length++] = ToLower(c);
+        }
+        if (length > 0 && buffer[length - 1] == '.') {
+            --length;
+        }
+    }
+    std::string_view name(buffer, length);
+
+    if (!name.empty()) {
+        if (auto it = exact_.find(name); it != exact_.end()) {
+            if (std::int32_t result = it->second.Match(path); result != kNoMatch) {
+                return result;
+            }
+        }
+
+        if (!wildcard_.empty()) {
+            for (std::size_t dot = name.find('.'); dot != std::string_view::npos; dot = name.find('.', dot + 1)) {
+                if (auto it = wildcard_.find(name.substr(dot + 1)); it != wildcard_.end()) {
+                    if (std::int32_t result = it->second.Match(path); result != kNoMatch) {
+                        return result;
+                    }
+                }
+            }
+        }
+    }
+
+    return any_host_.Match(path);
+}
+
+Router::Router(Pool pool)
+{
+    pools_.push_back(std::make_unique<Pool>(std::move(pool)));
+    default_pool_ = pools_.back().get();
+    matcher_.Compile();
+}
+
+Router::Router(std::vector<Pool> pools, const std::vector<Route>& routes, std::string default_pool)
+{
+    std::unordered_map<std::string, std::int32_t> index;
+    for (Pool& pool : pools) {
+        if (!index.emplace(pool.name, pools_.size()).second) {
+            EXCEPTION("Duplicated pool name: {}", pool.name);
+        }
+        pools_.push_back(std::make_unique<Pool>(std::move(pool)));
+    }
+
+    for (const Route& route : routes) {
+        auto it = index.find(route.pool);
+        if (it == index.end()) {
+            EXCEPTION("Route {}{} refers to unknown pool {}", route.host, route.path, route.pool);
+        }
+        matcher_.Add(route.host, route.path, it->second);
+    }
+    matcher_.Compile();
+
+    if (!default_pool.empty()) {
+        auto it = index.find(default_pool);
+        if (it == index.end()) {
+            EXCEPTION("Unknown default pool {}", default_pool);
+        }
+        default_pool_ = pools_[it->second].get();
+    }
+}
+
+Pool* Router::Select(std::string_view host, std::string_view path)
+{
+    std::int32_t result = matcher_.Match(host, path);
+    return result == RouteMatcher::kNoMatch ? default_pool_ : pools_[result].get();
+}
+
+Pool* Router::Select(const MessageView& request)
+{
+    std::string_view target = request.Target();
+    std::string_view host = request.Find(boost::beast::http::field::host);
+
+    // absolute-form target: http://host/path
+    if (!target.empty() && target.front() != '/') {
+        std::size_t scheme_end = target.find("://");
+        if (scheme_end != std::string_view::npos) {
+            target.remove_prefix(scheme_end + 3);
+            std::size_t path_begin = target.find('/');
+            host = target.substr(0, path_begin);
+            target = path_begin == std::string_view::npos ? "/" : target.substr(path_begin);
+        }
+    }
+
+    if (std::size_t query = target.find('?'); query != std::string_view::npos) {
+        target = target.substr(0, query);
+    }
+
+    return Select(host, target);
+}
+
+std::size_t Router::PoolsCount() const
+{
+    return pools_.size();
+}
+
+std::optional<SelectorType> Router::CommonSelectorType() const
+{
+    std::optional<SelectorType> result;
+    for (const auto& pool : pools_) {
+        if (result && *result != pool->selector->Type()) {
+            return std::nullopt;
+        }
+        result = pool->selector->Type();
+    }
+    return result;
+}
+
+namespace {
+
+Pool ReadPool(const std::string& name, const YAML::Node& node, bool named)
+{
+    INFO("Configuring pool {}", name);
+    Pool pool{
+        .name = name,
+        .selector = MakeSelector(node),
+        .sticky = ConfigureStickySessions(node, named ? name : ""),
+        .hedging = ConfigureHedging(node),
+        .limits = ConfigureConnectionLimits(node, name),
+        .concurrency = ConfigureAdaptiveConcurrency(node, name),
+        .cache = ConfigureResponseCache(node, name),
+        .collapsing = ConfigureCollapsedForwarding(node, name),
+    };
+    if (node["headers"].IsDefined()) {
+        const YAML::Node& headers = node["headers"];
+        if (!headers.IsMap()) {
+            EXCEPTION("headers node must be a map");
+        }
+        pool.request_headers = ConfigureHeaderRewrite(headers["request"]);
+        pool.response_headers = ConfigureHeaderRewrite(headers["response"]);
+    }
+    if (node["deadline_ms"].IsDefined()) {
+        pool.deadline = std::chrono::milliseconds(node["deadline_ms"].as<std::size_t>());
+    }
+    return pool;
+}
+
+} // anonymous namespace
+
+RouterPtr ConfigureRouter(const YAML::Node& config)
+{
+    if (!config["routes"].IsDefined()) {
+        if (!config["load_balancing"].IsDefined()) {
+            EXCEPTION("Load balancing node missed in configs");
+        }
+        return std::make_shared<Router>(ReadPool(kDefaultPool, config["load_balancing"], false));
+    }
+
+    std::vector<Pool> pools;
+    std::string default_pool;
+    if (config["load_balancing"].IsDefined()) {
+        pools.push_back(ReadPool(kDefaultPool, config["load_balancing"], false));
+        default_pool = kDefaultPool;
+    }
+
+    const YAML::Node& pools_node = config["pools"];
+    if (!pools_node.IsMap()) {
+        EXCEPTION("pools node must be a map");
+    }
+    for (const auto& pool_node : pools_node) {
+        std::string name = pool_node.first.as<std::string>();
+        if (name == kDefaultPool) {
+            EXCEPTION("Pool name {} is reserved for load_balancing node", name);
+        }
+        pools.push_back(ReadPool(name, pool_node.second, true));
+    }
+
+    const YAML::Node& routes_node = config["routes"];
+    if (!routes_node.IsSequence()) {
+        EXCEPTION("routes node must be a sequence");
+    }
+    std::vector<Router::Route> routes;
+    routes.reserve(routes_node.size());
+    for (const YAML::Node& route_node : routes_node) {
+        if (!route_node["pool"].IsDefined()) {
+            STACKTRACE("{} missed {} field", route_node, "pool");
+        }
+        Router::Route route;
+        route.pool = route_node["pool"].as<std::string>();
+        if (route_node["host"].IsDefined()) {
+            route.host = route_node["host"].as<std::string>();
+        }
+        if (route_node["path"].IsDefined()) {
+            route.path = route_node["path"].as<std::string>();
+        }
+        routes.push_back(std::move(route));
+    }
+
+    return std::make_shared<Router>(std::move(pools), routes, std::move(default_pool));
+}
+
+} // namespace lb::tcp
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <lb/tcp/adaptive_concurrency.hpp>
+#include <lb/tcp/collapsed_forwarding.hpp>
+#include <lb/tcp/connection_limits.hpp>
+#include <lb/tcp/hedging.hpp>
+#include <lb/tcp/raw_message.hpp>
+#include <lb/tcp/response_cache.hpp>
+#include <lb/tcp/selectors.hpp>
+#include <lb/tcp/sticky.hpp>
+
+namespace YAML {class Node;}
+
+namespace lb::tcp {
+
+// Longest path prefix match, compiled into a radix tree laid out in flat
+// arrays: every node keeps its outgoing edges contiguous and sorted by first
+// byte, chains without branches and values are collapsed into one label.
+class PathTrie {
+public:
+    static constexpr std::int32_t kNoMatch = -1;
+public:
+    void Add(std::string_view prefix, std::int32_t value);
+
+    void Compile();
+
+    std::int32_t Match(std::string_view path) const;
+private:
+    struct Node {
+        std::uint32_t first_edge = 0;
+        std::uint32_t edges_count = 0;
+        std::uint32_t label_offset = 0; // rest of the incoming edge label in labels_
+        std::uint32_t label_length = 0;
+        std::int32_t value = kNoMatch;
+    };
+
+    std::vector<std::pair<std::string, std::int32_t>> rules_; // dropped after Compile
+    std::vector<Node> nodes_;
+    std::vector<unsigned char> first_bytes_; // of edges
+    std::vector<std::uint32_t> children_;
+    std::string labels_;
+};
+
+// Maps (Host, path) to a value. Host is one of:
+//  - exact name: "api.example.com"
+//  - wildcard: "*.example.com", matches any subdomain but not example.com itself
+//  - empty: any host
+// Rules of the most specific matching host win, other hosts are tried only if
+// none of its prefixes match.
+class RouteMatcher {
+public:
+    static constexpr std::int32_t kNoMatch = PathTrie::kNoMatch;
+    static constexpr std::size_t kMaxHostLength = 255;
+public:
+    void Add(std::string_view host, std::string_view path_prefix, std::int32_t value);
+
+    void Compile();
+
+    std::int32_t Match(std::string_view host, std::string_view path) const;
+private:
+    using HostTable = std::unordered_map<std::string_view, PathTrie>;
+
+    PathTrie& TrieFor(HostTable& table, std::string_view host);
+private:
+    std::deque<std::string> hosts_; // storage of HostTable keys
+    HostTable exact_;
+    HostTable wildcard_; // keyed by name without "*."
+    PathTrie any_host_;
+};
+
+struct Pool {
+    std::string name;
+    SelectorPtr selector;
+    StickySessionsPtr sticky;           // nullptr if disabled
+    HeaderRewritePtr request_headers;   // nullptr if requests are forwarded as is
+    HeaderRewritePtr response_headers;  // nullptr if responses are forwarded as is
+    HedgingPtr hedging;                 // nullptr if requests are not hedged
+    ConnectionLimitsPtr limits;         // nullptr if connections to backends are not capped
+    AdaptiveConcurrencyPtr concurrency; // nullptr if requests in flight are not capped
+    ResponseCachePtr cache;             // nullptr if responses are not cached
+    CollapsedForwardingPtr collapsing;  // nullptr if identical requests are not collapsed
+    std::chrono::milliseconds deadline{0}; // budget of every request, 0 - only the client's deadline
+};
+
+class Router {
+public:
+    struct Route {
+        std::string host;
+        std::string path = "/";
+        std::string pool;
+    };
+public:
+    // Every request goes to the single pool
+    explicit Router(Pool pool);
+
+    Router(std::vector<Pool> pools, const std::vector<Route>& routes, std::string default_pool);
+
+    Router(const Router&) = delete;
+    Router& operator=(const Router&) = delete;
+
+    // nullptr if request matches no route and there is no default pool
+    Pool* Select(std::string_view host, std::string_view path);
+
+    Pool* Select(const MessageView& request);
+
+    std::size_t PoolsCount() const;
+
+    // Type of selector of every pool, nullopt if pools use different ones
+    std::optional<SelectorType> CommonSelectorType() const;
+private:
+    std::vector<std::unique_ptr<Pool>> pools_;
+    RouteMatcher matcher_;
+    Pool* default_pool_ = nullptr;
+};
+
+using RouterPtr = std::shared_ptr<Router>;
+
+// Pools from "pools" and routes from "routes" nodes; load_balancing node, if
+// present, is the pool of requests that match no route.
+RouterPtr ConfigureRouter(const YAML::Node& config);
+
+} // namespace lb::tcp
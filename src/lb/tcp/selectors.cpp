@@ -51,7 +51,7 @@ bool Backend::operator==(const Backend& other) const
 std::string Backend::ToString() const
 {
     if (IsUrl()) {
-        return AsUrl().ToString();
+        return std::string(AsUrl().ToString());
     } else {
         return AsEndpoint().address().to_string() + ":" + std::to_string(AsEndpoint().port());
     }
@@ -66,6 +66,23 @@ Backend::Backend(const Backend::UrlType& url)
 {}
 
 
+std::size_t BackendHasher::operator()(const Backend& backend) const
+{
+    if (backend.IsUrl()) {
+        return std::hash<std::string_view>{}(backend.AsUrl().ToString());
+    }
+
+    const auto& address = backend.AsEndpoint().address();
+    std::size_t port = backend.AsEndpoint().port();
+    if (address.is_v4()) {
+        std::uint64_t value = (std::uint64_t{address.to_v4().to_uint()} << 16) | port;
+        return std::hash<std::uint64_t>{}(value * 0x9e3779b97f4a7c15ULL);
+    }
+    auto bytes = address.to_v6().to_bytes();
+    std::string_view raw(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    return std::hash<std::string_view>{}(raw) ^ (port * 0x9e3779b97f4a7c15ULL);
+}
+
 std::ostream& operator<<(std::ostream& out, const Backend& backend)
 {
     if (backend.IsIpEndpoint()) {
@@ -76,13 +93,46 @@ std::ostream& operator<<(std::ostream& out, const Backend& backend)
     return out;
 }
 
+std::vector<Backend> ReadBackends(const YAML::Node& balancing_node)
+{
+    if (!balancing_node["endpoints"].IsDefined()) {
+        STACKTRACE("Endpoints node is missed");
+    }
+    const YAML::Node& ep_node = balancing_node["endpoints"];
+    if (!ep_node.IsSequence()) {
+        EXCEPTION("endpoints node must be a sequence");
+    }
+
+    std::vector<Backend> backends;
+    backends.reserve(ep_node.size());
+    for (const YAML::Node& ep : ep_node) {
+        if (ep["url"].IsDefined()) {
+            backends.emplace_back(ep["url"].as<std::string>());
+            continue;
+        }
+
+        if (!ep["ip"].IsDefined()) {
+            STACKTRACE("{} missed {} field", ep, "ip");
+        }
+        if (!ep["port"].IsDefined()) {
+            STACKTRACE("{} missed {} field", ep, "port");
+        }
+
+        backends.emplace_back(ep["ip"].as<std::string>(), ep["port"].as<int>());
+    }
+    return backends;
+}
+
 SelectorPtr DetectSelector(const YAML::Node& node)
 {
     if (!node["load_balancing"].IsDefined()) {
         EXCEPTION("Load balancing node missed in configs");
     }
+    return MakeSelector(node["load_balancing"]);
+}
 
-    const YAML::Node& balancing_node = node["load_balancing"];
+SelectorPtr MakeSelector(const YAML::Node& balancing_node)
+{
     static const std::unordered_map<std::string, SelectorType> selector_switch = {
         {"round_robin", SelectorType::ROUND_ROBIN},
         {"weighted_round_robin", SelectorType::WEIGHTED_ROUND_ROBIN},
@@ -153,29 +203,7 @@ SelectorPtr DetectSelector(const YAML::Node& node)
 void RoundRobinSelector::Configure(const YAML::Node &balancing_node)
 {
     INFO("Configuring RoundRobinSelector");
-    if (!balancing_node["endpoints"].IsDefined()) {
-        STACKTRACE("Round-robin endpoints node is missed");
-    }
-    const YAML::Node& ep_node = balancing_node["endpoints"];
-    if (!ep_node.IsSequence()) {
-        EXCEPTION("endpoints node must be a sequence");
-    }
-    backends_.reserve(ep_node.size());
-    for (const YAML::Node& ep : ep_node) {
-        if (ep["url"].IsDefined()) {
-            backends_.emplace_back(ep["url"].as<std::string>());
-            continue;
-        }
-
-        if (!ep["ip"].IsDefined()) {
-            STACKTRACE("{} missed {} field", ep, "ip");
-        }
-        if (!ep["port"].IsDefined()) {
-            STACKTRACE("{} missed {} field", ep, "port");
-        }
-
-        backends_.emplace_back(ep["ip"].as<std::string>(), ep["port"].as<int>());
-    }
+    backends_ = ReadBackends(balancing_node);
 
     for (const auto& backend : backends_) {
         DEBUG("\t{}", backend);
@@ -317,29 +345,7 @@ void WeightedRoundRobinSelector::AdvanceCounter()
 void IpHashSelector::Configure(const YAML::Node& balancing_node)
 {
     INFO("Configuring IpHashSelector");
-    if (!balancing_node["endpoints"].IsDefined()) {
-        STACKTRACE("Ip-hash endpoints node is missed");
-    }
-    const YAML::Node& ep_node = balancing_node["endpoints"];
-    if (!ep_node.IsSequence()) {
-        EXCEPTION("endpoints node must be a sequence");
-    }
-    backends_.reserve(ep_node.size());
-    for (const YAML::Node& ep : ep_node) {
-        if (ep["url"].IsDefined()) {
-            backends_.emplace_back(ep["url"].as<std::string>());
-            continue;
-        }
-
-        if (!ep["ip"].IsDefined()) {
-            STACKTRACE("{} missed {} field", ep, "ip");
-        }
-        if (!ep["port"].IsDefined()) {
-            STACKTRACE("{} missed {} field", ep, "port");
-        }
-
-        backends_.emplace_back(ep["ip"].as<std::string>(), ep["port"].as<int>());
-    }
+    backends_ = ReadBackends(balancing_node);
 
     for (const auto& backend : backends_) {
         DEBUG("\t{}", backend);
@@ -494,7 +500,7 @@ void LeastConnectionsSelector::InsertBackend(Backend&& b)
     boost::recursive_mutex::scoped_lock lock(mutex_);
     HandleType handle = backends_.push(CounterWrapper{.b = std::move(b),
                                                       .counter = 0});
-    handle_pool_[(*handle).b.ToString()] = std::move(handle);
+    handle_pool_.emplace((*handle).b, std::move(handle));
 }
 
 
@@ -510,12 +516,11 @@ void LeastConnectionsSelector::ExcludeBackend(const Backend& backend)
 {
     boost::recursive_mutex::scoped_lock lock(mutex_);
 
-    const std::string& str = backend.ToString();
-    if (auto it = handle_pool_.find(str); it != handle_pool_.end()) {
+    if (auto it = handle_pool_.find(backend); it != handle_pool_.end()) {
         HandleType& handle = it->second;
 
         backends_.erase(handle);
-        handle_pool_.erase(str);
+        handle_pool_.erase(it);
 
         if (backends_.empty()) {
             EXCEPTION("All backends are excluded!");
@@ -531,8 +536,7 @@ SelectorType LeastConnectionsSelector::Type() const
 void LeastConnectionsSelector::IncreaseConnectionCount(const Backend& backend)
 {
     boost::recursive_mutex::scoped_lock lock(mutex_);
-    const std::string& str = backend.ToString();
-    if (auto it = handle_pool_.find(str); it != handle_pool_.end()) {
+    if (auto it = handle_pool_.find(backend); it != handle_pool_.end()) {
         HandleType& handle = it->second;
         (*handle).counter++;
         backends_.decrease(handle);
@@ -542,8 +546,7 @@ void LeastConnectionsSelector::IncreaseConnectionCount(const Backend& backend)
 void LeastConnectionsSelector::DecreaseConnectionCount(const Backend& backend)
 {
     boost::recursive_mutex::scoped_lock lock(mutex_);
-    const std::string& str = backend.ToString();
-    if (auto it = handle_pool_.find(str); it != handle_pool_.end()) {
+    if (auto it = handle_pool_.find(backend); it != handle_pool_.end()) {
         HandleType& handle = it->second;
         if ((*handle).counter > 0) {
             (*handle).counter--;
@@ -597,11 +600,10 @@ Backend LeastResponseTimeSelector::SelectBackend(const boost::asio::ip::tcp::end
 void LeastResponseTimeSelector::ExcludeBackend(const Backend& backend)
 {
     boost::mutex::scoped_lock lock(mutex_);
-    const std::string& str = backend.ToString();
-    if (auto it = handle_pool_.find(str); it != handle_pool_.end()) {
+    if (auto it = handle_pool_.find(backend); it != handle_pool_.end()) {
         HandleType& handle = it->second;
         backends_.erase(handle);
-        handle_pool_.erase(str);
+        handle_pool_.erase(it);
         if (backends_.empty()) {
             EXCEPTION("All backends are excluded!");
         }
@@ -617,14 +619,13 @@ void LeastResponseTimeSelector::InsertBackend(Backend&& b)
 {
     boost::mutex::scoped_lock lock(mutex_);
     HandleType handle = backends_.push(AverageTimeWrapper{.backend = std::move(b)});
-    handle_pool_[(*handle).backend.ToString()] = std::move(handle);
+    handle_pool_.emplace((*handle).backend, std::move(handle));
 }
 
 void LeastResponseTimeSelector::AddResponseTime(const Backend& backend, long response_time)
 {
     boost::mutex::scoped_lock lock(mutex_);
-    const std::string& str = backend.ToString();
-    if (auto it = handle_pool_.find(str); it != handle_pool_.end()) {
+    if (auto it = handle_pool_.find(backend); it != handle_pool_.end()) {
         HandleType& handle = it->second;
         double old_ema = (*handle).response_time_ema;
         (*handle).response_time_ema = (1 - (*handle).alpha) * old_ema + (*handle).alpha * response_time;
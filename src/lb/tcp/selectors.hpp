@@ -42,11 +42,9 @@ private:
 };
 
 
+// Does not allocate, unlike hashing of ToString()
 struct BackendHasher {
-    std::size_t operator()(const lb::tcp::Backend& backend) const {
-        static std::hash<std::string> hash{};
-        return hash(backend.ToString());
-    }
+    std::size_t operator()(const lb::tcp::Backend& backend) const;
 };
 
 std::ostream& operator<<(std::ostream& out, const Backend& backend);
@@ -72,6 +70,12 @@ using SelectorPtr = std::shared_ptr<ISelector>;
 
 SelectorPtr DetectSelector(const YAML::Node& config);
 
+// Selector described by a node with algorithm and endpoints fields
+SelectorPtr MakeSelector(const YAML::Node& balancing_node);
+
+// Backends listed in endpoints node of load_balancing section
+std::vector<Backend> ReadBackends(const YAML::Node& balancing_node);
+
 class RoundRobinSelector final : public ISelector {
 public:
     using EndpointType = boost::asio::ip::tcp::endpoint;
@@ -191,7 +195,7 @@ private:
 
 private:
     boost::recursive_mutex mutex_;
-    std::unordered_map<std::string, HandleType> handle_pool_;
+    std::unordered_map<Backend, HandleType, BackendHasher> handle_pool_;
     PairingHeap backends_;
 };
 
@@ -226,7 +230,7 @@ private:
     using HandleType = PairingHeap::handle_type;
 private:
     boost::mutex mutex_;
-    std::unordered_map<std::string, HandleType> handle_pool_;
+    std::unordered_map<Backend, HandleType, BackendHasher> handle_pool_;
     PairingHeap backends_;
 
 };
@@ -1,9 +1,14 @@
 #include <lb/tcp/session.hpp>
+#include <lb/tcp/connector.hpp>
 #include <iostream>
 #include <lb/logging.hpp>
+#include <lb/metrics.hpp>
 #include <boost/beast.hpp>
 
 #include <atomic>
+#include <cerrno>
+
+#include <sys/socket.h>
 
 
 
@@ -11,25 +16,114 @@ namespace lb {
 
 namespace tcp {
 
-HttpSession::HttpSession(SocketType client_socket, SocketType server_socket, VisitorPtr visitor)
+namespace {
+
+metrics::Gauge& ActiveSessionsGauge()
+{
+    static metrics::Gauge& gauge = metrics::Registry::Instance().GetGauge("sessions.active");
+    return gauge;
+}
+
+} // anonymous namespace
+
+const std::string kNotFoundResponse = "HTTP/1.1 404 Not Found\r\n"
+                                      "Content-Length: 0\r\n"
+                                      "Connection: close\r\n"
+                                      "\r\n";
+
+const std::string kBadGatewayResponse = "HTTP/1.1 502 Bad Gateway\r\n"
+                                        "Content-Length: 0\r\n"
+                                        "Connection: close\r\n"
+                                        "\r\n";
+
+const std::string kServiceUnavailableResponse = "HTTP/1.1 503 Service Unavailable\r\n"
+                                                "Content-Length: 0\r\n"
+                                                "Connection: close\r\n"
+                                                "\r\n";
+
+const std::string kTooManyRequestsResponse = "HTTP/1.1 429 Too Many Requests\r\n"
+                                             "Content-Length: 0\r\n"
+                                             "Connection: close\r\n"
+                                             "\r\n";
+
+const std::string kRequestTimeoutResponse = "HTTP/1.1 408 Request Timeout\r\n"
+                                            "Content-Length: 0\r\n"
+                                            "Connection: close\r\n"
+                                            "\r\n";
+
+const std::string kGatewayTimeoutResponse = "HTTP/1.1 504 Gateway Timeout\r\n"
+                                            "Content-Length: 0\r\n"
+                                            "Connection: close\r\n"
+                                            "\r\n";
+
+const std::string* TimeoutResponse(TimeoutPhase phase)
+{
+    switch (phase) {
+    case TimeoutPhase::HEADER_READ:
+    case TimeoutPhase::BODY_READ:
+        return &kRequestTimeoutResponse;
+    case TimeoutPhase::CONNECT:
+    case TimeoutPhase::FIRST_BYTE:
+        return &kGatewayTimeoutResponse;
+    default:
+        return nullptr;
+    }
+}
+
+BasicSession::BasicSession()
+{
+    ActiveSessionsGauge().Add();
+}
+
+BasicSession::~BasicSession()
+{
+    ActiveSessionsGauge().Sub();
+}
+
+std::size_t BasicSession::ActiveSessions()
+{
+    return ActiveSessionsGauge().Value();
+}
+
+BasicSession::IdType BasicSession::GenerateId()
+{
+    static std::atomic<IdType> id = 0;
+    return id.fetch_add(1, std::memory_order_relaxed);
+}
+
+template <class Notifier>
+HttpSession<Notifier>::HttpSession(SocketType client_socket,
+                         const EndpointType& client_endpoint,
+                         Connector& connector,
+                         AdmissionTicket ticket,
+                         ConcurrencyLimitPtr connects_limit)
     : BasicSession()
-    , client_stream_(std::move(client_socket))
-    , server_stream_(std::move(server_socket))
-    , id(generateId())
-    , visitor_(std::move(visitor))
+    , client_socket_(std::move(client_socket))
+    , server_socket_(client_socket_.get_executor())
+    , id(GenerateId())
+    , connector_(connector)
+    , ticket_(std::move(ticket))
+    , connects_limit_(std::move(connects_limit))
+    , rate_limiter_(connector.ClientRateLimiter())
+    , timer_(connector.Timers().LocalWheel(), connector.Timeouts(), &HttpSession::OnTimerExpired, this)
 {
+    if (rate_limiter_ && !rate_limiter_->LimitsRequests()) {
+        rate_limiter_ = nullptr;
+    }
+    client_endpoint_ = client_endpoint;
+    request_head_.fields.reserve(kReservedFields);
+    response_head_.fields.reserve(kReservedFields);
+    segments_.reserve(kReservedSegments);
     DEBUG("HttpSession id:{} created", id);
 }
 
-void HttpSession::Run()
+template <class Notifier>
+void HttpSession<Notifier>::Run()
 {
-    if (visitor_) {
-        visitor_->OnConnect();
-    }
     ClientRead();
 }
 
-bool NeedErrorLogging(const HttpSession::ErrorCode& ec)
+bool NeedErrorLogging(const boost::system::error_code& ec)
 {
     return ec != boost::asio::error::eof
         && ec != boost::beast::http::error::end_of_stream
@@ -37,128 +131,677 @@ bool NeedErrorLogging(const HttpSession::ErrorCode& ec)
 }
 
 
-void HttpSession::ClientRead()
+template <class Notifier>
+void HttpSession<Notifier>::ClientRead()
 {
-    namespace http = boost::beast::http;
+    if (client_buffer_.size() > 0) {
+        // pipelined request is buffered already
+        timer_.Arm(TimeoutPhase::HEADER_READ);
+        request_start_ = RequestDeadline::Clock::now();
+        request_parser_.emplace(request_head_);
+        HandleClientRead({}, 0);
+        return;
+    }
+    WaitClientRead();
+}
 
-    client_buffer_.clear();
-    server_buffer_.clear();
-    client_request_.clear();
-    server_response_.clear();
-
-    http::async_read(
-        client_stream_,
-        client_buffer_,
-        client_request_,
-        [self=shared_from_this()](ErrorCode ec, std::size_t length){
+template <class Notifier>
+void HttpSession<Notifier>::WaitClientRead()
+{
+    // Idle keep-alive connection holds no buffers until the client speaks
+    ReleaseBuffer(client_buffer_);
+    ReleaseBuffer(server_buffer_);
+    request_parser_.reset();
+    response_parser_.reset();
+    timer_.Arm(TimeoutPhase::IDLE);
+    client_socket_.async_wait(
+        SocketType::wait_read,
+        [self=this->shared_from_this()](ErrorCode ec){
+            if (ec || self->timed_out_ != TimeoutPhase::NONE) {
+                self->HandleError(ec);
+                return;
+            }
+            self->timer_.Arm(TimeoutPhase::HEADER_READ);
+            self->request_start_ = RequestDeadline::Clock::now();
+            self->request_parser_.emplace(self->request_head_);
+            self->DoClientRead();
+        }
+    );
+}
+
+template <class Notifier>
+void HttpSession<Notifier>::DoClientRead()
+{
+    client_socket_.async_read_some(
+        PrepareRead(client_buffer_, kReadSize),
+        [self=this->shared_from_this()](ErrorCode ec, std::size_t length){
+            self->client_buffer_.commit(length);
             self->HandleClientRead(ec, length);
         }
     );
 }
 
-void HttpSession::HandleClientRead(ErrorCode ec, std::size_t length)
+template <class Notifier>
+void HttpSession<Notifier>::HandleClientRead(ErrorCode ec, std::size_t length)
 {
-    if (ec) {
-        if (NeedErrorLogging(ec)) {
-            SERROR("sid:{} {}", id, ec.message());
+    bool done = false;
+    if (!ec && timed_out_ == TimeoutPhase::NONE) {
+        done = request_parser_->Parse(client_buffer_.data(), ec);
+    }
+    if (ec || timed_out_ != TimeoutPhase::NONE) {
+        HandleError(ec);
+        return;
+    }
+    if (!done) {
+        if (request_parser_->is_header_done() && timer_.Phase() == TimeoutPhase::HEADER_READ) {
+            timer_.Arm(TimeoutPhase::BODY_READ);
         }
+        DoClientRead();
+        return;
+    }
+    timer_.Disarm();
+    HandleRequest();
+}
+
+template <class Notifier>
+void HttpSession<Notifier>::HandleRequest()
+{
+    if (rate_limiter_ && !rate_limiter_->AllowRequest(client_endpoint_.address())) {
+        DEBUG("sid:{} request rate limit exceeded", id);
+        RejectRequest();
+        return;
+    }
+
+    Pool* pool = connector_.Route(RequestView());
+    if (!pool) {
+        RespondAndClose(kNotFoundResponse);
+        return;
+    }
+
+    deadline_.Reset(connector_.Deadlines(), RequestView(), request_start_, pool->deadline);
+    if (deadline_.Expired()) {
+        RespondExpired();
+        return;
+    }
+
+    cache_key_.clear();
+    if ((pool->cache || pool->collapsing) && CacheKey(RequestView(), cache_key_)) {
+        if (CachedResponsePtr cached = pool->cache ? pool->cache->Find(cache_key_, RequestView()) : nullptr) {
+            SendCached(*pool, std::move(cached));
+            return;
+        }
+        if (pool->collapsing && !(lead_ = pool->collapsing->Lead(cache_key_))) {
+            FollowLeader(*pool);
+            return;
+        }
+    }
+    ForwardRequest(*pool);
+}
+
+template <class Notifier>
+void HttpSession<Notifier>::ForwardRequest(Pool& pool)
+{
+    replay_ = connector_.Replayable(request_head_);
+    WatchClient();
+    if (&pool != pool_) {
+        ConnectToServer(pool);
+        return;
+    }
+
+    // attempts are bounded per request
+    tried_backends_.erase(tried_backends_.begin(), tried_backends_.end() - 1);
+    SendToServer();
+}
+
+template <class Notifier>
+void HttpSession<Notifier>::FollowLeader(Pool& pool)
+{
+    DEBUG("sid:{} waiting for an identical request in flight", id);
+    pool.collapsing->AsyncFollow(
+        cache_key_,
+        client_socket_.get_executor(),
+        [self=this->shared_from_this(), &pool](const ErrorCode& ec, CachedResponsePtr response) {
+            if (!self->client_socket_.is_open()) {
+                return; // cancelled while waiting
+            }
+            if (response && response->Matches(self->RequestView())) {
+                self->SendCached(pool, std::move(response));
+                return;
+            }
+            self->ForwardRequest(pool);
+        });
+}
+
+template <class Notifier>
+void HttpSession<Notifier>::RespondExpired()
+{
+    DEBUG("sid:{} request deadline passed", id);
+    ExpiredRequests().Add();
+    RespondAndClose(kGatewayTimeoutResponse);
+}
+
+template <class Notifier>
+void HttpSession<Notifier>::SendCached(const Pool& pool, CachedResponsePtr response)
+{
+    DEBUG("sid:{} cache hit", id);
+    cached_ = std::move(response);
+    cached_->Splice(pool.response_headers.get(), age_line_, segments_);
+    boost::asio::async_write(
+        client_socket_,
+        boost::beast::buffers_range_ref(segments_),
+        [self=this->shared_from_this()](ErrorCode ec, std::size_t length){
+            self->HandleSendCached(ec);
+        });
+}
+
+template <class Notifier>
+void HttpSession<Notifier>::HandleSendCached(ErrorCode ec)
+{
+    cached_.reset();
+    if (ec) {
+        HandleError(ec);
+        return;
+    }
+    client_buffer_.consume(request_head_.message_size);
+    cache_key_.clear();
+    if (!request_head_.keep_alive) {
         Cancel();
         return;
     }
+    ClientRead();
+}
+
+template <class Notifier>
+void HttpSession<Notifier>::WatchClient()
+{
+    if (!connector_.Deadlines().cancel_abandoned) {
+        return;
+    }
+    // Completes on the next request bytes as well, watching ends then
+    client_socket_.async_wait(
+        SocketType::wait_read,
+        [self=this->shared_from_this(), generation=watch_generation_](const ErrorCode& ec) {
+            if (!ec && generation == self->watch_generation_ && PeerClosed(self->client_socket_)) {
+                self->OnClientGone();
+            }
+        });
+}
+
+template <class Notifier>
+void HttpSession<Notifier>::OnClientGone()
+{
+    DEBUG("sid:{} client closed, cancelling upstream work", id);
+    AbandonedRequests().Add();
+    client_gone_ = true;
+    ErrorCode ec;
+    server_socket_.cancel(ec);
+    connect_cancellation_.Cancel();
+}
+
+template <class Notifier>
+void HttpSession<Notifier>::ConnectToServer(Pool& pool)
+{
+    DisconnectFromPool();
+    std::optional<AdmissionTicket> connect_ticket = connector_.Admission().AdmitConnect(connects_limit_);
+    if (!connect_ticket) {
+        DEBUG("Too many pending connects");
+        connector_.Admission().Shed(std::move(client_socket_));
+        return;
+    }
+    connect_ticket_ = std::move(*connect_ticket);
+    tried_backends_.clear();
+    Connector::Connection connection = connector_.SelectBackend(pool, RequestView(), client_endpoint_);
+    ConnectAttempt(pool, std::move(connection.backend), connection.set_cookie);
+}
 
-    if (visitor_) {
-        visitor_->OnRequestReceive();
+template <class Notifier>
+void HttpSession<Notifier>::ConnectAttempt(Pool& pool, Backend backend, const std::string& set_cookie)
+{
+    backend_slot_.Release();
+    if (!pool.limits) {
+        StartConnect(pool, std::move(backend), set_cookie);
+        return;
+    }
+    std::optional<Connector::Connection> connection = connector_.TakeSlot(
+        pool, Connector::Connection{.backend = backend, .set_cookie = set_cookie}, tried_backends_, client_endpoint_);
+    if (!connection) {
+        WaitForSlot(pool, std::move(backend), set_cookie);
+        return;
     }
+    backend_slot_ = std::move(connection->slot);
+    StartConnect(pool, std::move(connection->backend), connection->set_cookie);
+}
+
+template <class Notifier>
+void HttpSession<Notifier>::WaitForSlot(Pool& pool, Backend backend, const std::string& set_cookie)
+{
+    DEBUG("sid:{} backend {} of pool {} is at its connection cap", id, backend, pool.name);
+    pool.limits->AsyncWait(
+        backend,
+        client_socket_.get_executor(),
+        [self=this->shared_from_this(), &pool, backend, set_cookie](const ErrorCode& ec, BackendSlot slot) mutable {
+            if (!self->client_socket_.is_open()) {
+                return; // cancelled while waiting
+            }
+            if (self->client_gone_) {
+                self->Cancel();
+                return;
+            }
+            if (ec) {
+                DEBUG("sid:{} no connection slot in pool {}: {}", self->id, pool.name, ec.message());
+                self->connect_ticket_.Release();
+                self->set_cookie_.clear();
+                self->RespondAndClose(kServiceUnavailableResponse);
+                return;
+            }
+            self->backend_slot_ = std::move(slot);
+            self->StartConnect(pool, std::move(backend), set_cookie);
+        });
+}
+
+template <class Notifier>
+void HttpSession<Notifier>::StartConnect(Pool& pool, Backend backend, const std::string& set_cookie)
+{
+    tried_backends_.push_back(std::move(backend));
+    set_cookie_.clear();
+    if (!set_cookie.empty()) {
+        set_cookie_ = "Set-Cookie: " + set_cookie + "\r\n";
+    }
+    timer_.Arm(TimeoutPhase::CONNECT);
+    connector_.AsyncConnect(
+        server_socket_,
+        tried_backends_.back(),
+        &connect_cancellation_,
+        [self=this->shared_from_this(), &pool](const ErrorCode& ec) {
+            self->HandleConnect(pool, ec);
+        });
+}
+
+template <class Notifier>
+void HttpSession<Notifier>::HandleConnect(Pool& pool, ErrorCode ec)
+{
+    timer_.Disarm();
+    if (client_gone_) {
+        connect_ticket_.Release();
+        Cancel();
+        return;
+    }
+    if (ec && connect_timed_out_) {
+        ec = boost::asio::error::timed_out;
+    }
+    connect_timed_out_ = false;
+    if (ec) {
+        ERROR("sid:{} connect to {}: {}", id, tried_backends_.back(), ec.message());
+        if (std::optional<Connector::Connection> next =
+                connector_.Reselect(pool, tried_backends_, ec, client_endpoint_)) {
+            ErrorCode ignored;
+            server_socket_.close(ignored);
+            ConnectAttempt(pool, std::move(next->backend), next->set_cookie);
+            return;
+        }
+        connect_ticket_.Release();
+        backend_slot_.Release();
+        set_cookie_.clear();
+        RespondAndClose(ec == boost::asio::error::timed_out ? kGatewayTimeoutResponse : kBadGatewayResponse);
+        return;
+    }
+
+    connect_ticket_.Release();
+    pool_ = &pool;
+    notifier_.OnConnect(*pool.selector, tried_backends_.back());
     SendToServer();
 }
 
-void HttpSession::SendToServer()
+template <class Notifier>
+void HttpSession<Notifier>::DisconnectFromPool()
 {
-    namespace http = boost::beast::http;
+    if (!pool_) {
+        return;
+    }
+    DEBUG("sid:{} disconnecting from pool {}", id, pool_->name);
+    ErrorCode ec;
+    server_socket_.close(ec);
+    backend_slot_.Release();
+    permit_.Release();
+    notifier_.OnDisconnect();
+    notifier_ = Notifier();
+    pool_ = nullptr;
+    set_cookie_.clear();
+    server_buffer_.clear();
+}
+
+template <class Notifier>
+bool HttpSession<Notifier>::Replay(const ErrorCode& ec)
+{
+    if (!replay_ || client_gone_ || timed_out_ != TimeoutPhase::NONE) {
+        return false;
+    }
+    std::optional<Connector::Connection> next = connector_.Replay(*pool_, tried_backends_, ec, client_endpoint_);
+    if (!next) {
+        return false;
+    }
+    std::optional<AdmissionTicket> connect_ticket = connector_.Admission().AdmitConnect(connects_limit_);
+    if (!connect_ticket) {
+        return false;
+    }
+    DEBUG("sid:{} replaying request, {}: {}", id, tried_backends_.back(), ec.message());
+    Pool& pool = *pool_;
+    DisconnectFromPool();
+    connect_ticket_ = std::move(*connect_ticket);
+    ConnectAttempt(pool, std::move(next->backend), next->set_cookie);
+    return true;
+}
 
-    http::async_write(
-        server_stream_,
-        client_request_,
-        [self=shared_from_this()](ErrorCode ec, std::size_t length){
+template <class Notifier>
+void HttpSession<Notifier>::RejectRequest()
+{
+    RespondAndClose(kTooManyRequestsResponse);
+}
+
+template <class Notifier>
+void HttpSession<Notifier>::RespondAndClose(const std::string& response)
+{
+    boost::asio::async_write(
+        client_socket_,
+        boost::asio::buffer(response),
+        [self=this->shared_from_this()](ErrorCode ec, std::size_t length){
+            self->Cancel();
+        });
+}
+
+template <class Notifier>
+void HttpSession<Notifier>::HandleError(const ErrorCode& ec, const std::string* response)
+{
+    timer_.Disarm();
+    if (client_gone_) {
+        Cancel();
+        return;
+    }
+    if (timed_out_ == TimeoutPhase::FIRST_BYTE) {
+        permit_.OnDropped();
+    }
+    if (timed_out_ != TimeoutPhase::NONE) {
+        DEBUG("sid:{} {} timeout", id, ToString(timed_out_));
+        response = TimeoutResponse(timed_out_);
+    } else if (NeedErrorLogging(ec)) {
+        SERROR("sid:{} {}", id, ec.message());
+    }
+    if (response) {
+        RespondAndClose(*response);
+        return;
+    }
+    Cancel();
+}
+
+template <class Notifier>
+void HttpSession<Notifier>::OnTimerExpired(void* context)
+{
+    // Under lock of the wheel, session may be destroyed concurrently
+    auto* session = static_cast<HttpSession*>(context);
+    std::shared_ptr<HttpSession> self = session->weak_from_this().lock();
+    if (!self) {
+        return;
+    }
+    boost::asio::post(session->client_socket_.get_executor(),
+                      [self=std::move(self), generation=session->timer_.Generation()]() {
+                          if (self->timer_.Generation() == generation) {
+                              self->OnTimeout();
+                          }
+                      });
+}
+
+template <class Notifier>
+void HttpSession<Notifier>::OnTimeout()
+{
+    const TimeoutPhase phase = timer_.Phase();
+    timer_.Disarm();
+    PhaseTimer::Count(phase);
+    ErrorCode ec;
+    server_socket_.cancel(ec);
+    connect_cancellation_.Cancel();
+    if (phase == TimeoutPhase::CONNECT) {
+        // connect handler fails the attempt and retries another backend
+        connect_timed_out_ = true;
+        timer_.Arm(TimeoutPhase::CONNECT);
+        return;
+    }
+    timed_out_ = phase;
+    client_socket_.cancel(ec);
+}
+
+template <class Notifier>
+void HttpSession<Notifier>::SendToServer()
+{
+    if (deadline_.Expired()) {
+        RespondExpired();
+        return;
+    }
+    permit_.Release();
+    if (pool_->concurrency) {
+        std::optional<AdaptiveConcurrency::Permit> permit = pool_->concurrency->TryAcquire(tried_backends_.back());
+        if (!permit) {
+            DEBUG("sid:{} {} is at its concurrency limit", id, tried_backends_.back());
+            RespondAndClose(kServiceUnavailableResponse);
+            return;
+        }
+        permit_ = std::move(*permit);
+    }
+    SpliceMessage(RequestView(), pool_->request_headers.get(), deadline_.UpstreamLine(), segments_,
+                  deadline_.Replaced(request_head_));
+    boost::asio::async_write(
+        server_socket_,
+        boost::beast::buffers_range_ref(segments_),
+        [self=this->shared_from_this()](ErrorCode ec, std::size_t length){
             self->HandleSendToServer(ec, length);
         });
 }
 
 
-void HttpSession::HandleSendToServer(ErrorCode ec, std::size_t length)
+template <class Notifier>
+void HttpSession<Notifier>::HandleSendToServer(ErrorCode ec, std::size_t length)
 {
     if (ec) {
-        if (NeedErrorLogging(ec)) {
-            SERROR("sid:{} {}", id, ec.message());
+        if (!Replay(ec)) {
+            HandleError(ec);
         }
-        Cancel();
         return;
     }
     DEBUG("sid: {} sent to server", id);
-    if (visitor_) {
-        visitor_->OnRequestSent();
+    if (!replay_ && cache_key_.empty()) {
+        client_buffer_.consume(request_head_.message_size);
     }
+    notifier_.OnRequestSent();
     ServerRead();
 }
 
 
-void HttpSession::ServerRead()
+template <class Notifier>
+void HttpSession<Notifier>::ServerRead()
+{
+    response_parser_.emplace(response_head_);
+    if (request_head_.method == boost::beast::http::verb::head) {
+        response_parser_->skip(true);
+    }
+    if (server_buffer_.size() > 0) {
+        HandleServerRead({}, 0);
+        return;
+    }
+    timer_.Arm(TimeoutPhase::FIRST_BYTE, deadline_.Left());
+    if (replay_ && connector_.Hedgeable(*pool_, request_head_)) {
+        connector_.AsyncReadFirstBytes(
+            *pool_, server_socket_, server_buffer_, segments_, tried_backends_, client_endpoint_,
+            &connect_cancellation_,
+            [self=this->shared_from_this()](const ErrorCode& ec, std::optional<Connector::Connection> hedge) {
+                if (hedge) {
+                    self->AdoptHedge(std::move(hedge->backend), hedge->set_cookie, std::move(hedge->slot),
+                                     std::move(hedge->permit));
+                }
+                self->HandleServerRead(ec, 0);
+            });
+        return;
+    }
+    DoServerRead();
+}
+
+template <class Notifier>
+void HttpSession<Notifier>::AdoptHedge(Backend backend,
+                                 const std::string& set_cookie,
+                                 BackendSlot slot,
+                                 AdaptiveConcurrency::Permit permit)
+{
+    DEBUG("sid:{} hedge to {} answered first", id, backend);
+    notifier_.OnDisconnect();
+    notifier_ = Notifier();
+    notifier_.OnConnect(*pool_->selector, backend);
+    notifier_.OnRequestSent();
+    if (!set_cookie.empty()) {
+        set_cookie_ = "Set-Cookie: " + set_cookie + "\r\n";
+    }
+    tried_backends_.push_back(std::move(backend));
+    backend_slot_ = std::move(slot);
+    // primary's response time is unknown, the hedge's is sampled when it arrives
+    permit_.Release();
+    permit_ = std::move(permit);
+}
+
+template <class Notifier>
+void HttpSession<Notifier>::DoServerRead()
 {
-    namespace http = boost::beast::http;
-    http::async_read(
-        server_stream_,
-        server_buffer_,
-        server_response_,
-        [self=shared_from_this()](ErrorCode ec, std::size_t length){
+    server_socket_.async_read_some(
+        PrepareRead(server_buffer_, kReadSize),
+        [self=this->shared_from_this()](ErrorCode ec, std::size_t length){
+            self->server_buffer_.commit(length);
             self->HandleServerRead(ec, length);
         }
     );
 }
 
-void HttpSession::HandleServerRead(ErrorCode ec, std::size_t length)
+template <class Notifier>
+void HttpSession<Notifier>::HandleServerRead(ErrorCode ec, std::size_t length)
 {
-    if (ec) {
-        if (NeedErrorLogging(ec)) {
-            SERROR("sid:{} {}", id, ec.message());
+    if (timed_out_ != TimeoutPhase::NONE) {
+        HandleError(ec);
+        return;
+    }
+    timer_.Disarm();
+    if (ec && Replay(ec)) {
+        return;
+    }
+    if (!ec && replay_) {
+        // response has begun, request can't be replayed anymore
+        replay_ = false;
+        if (cache_key_.empty()) {
+            client_buffer_.consume(request_head_.message_size);
         }
-        Cancel();
+    }
+    bool done = false;
+    if (!ec) {
+        done = response_parser_->Parse(server_buffer_.data(), ec);
+    } else if (ec == boost::asio::error::eof
+               && response_parser_->is_header_done()
+               && response_parser_->need_eof()) {
+        // body is delimited by end of stream
+        ec = {};
+        done = response_parser_->ParseEof(ec);
+    }
+    if (ec) {
+        HandleError(ec);
         return;
     }
-    if (visitor_) {
-        visitor_->OnResponseReceive();
+    if (!done) {
+        DoServerRead();
+        return;
     }
+
+    notifier_.OnResponseReceive();
+    permit_.OnResponse();
+    StoreResponse();
     SendToClient();
 }
 
-void HttpSession::SendToClient()
+template <class Notifier>
+void HttpSession<Notifier>::StoreResponse()
 {
-    namespace http = boost::beast::http;
-    http::async_write(
-        client_stream_,
-        server_response_,
-        [self=shared_from_this()](ErrorCode ec, std::size_t length){
+    if (cache_key_.empty() || (response_head_.status / 100 == 1 && response_head_.status != 101)) {
+        return;
+    }
+    const bool cache = pool_->cache && response_head_.message_size <= pool_->cache->Config().max_object_bytes;
+    if (cache || lead_) {
+        CachedResponsePtr shared = ShareResponse(RequestView(), ResponseView());
+        if (cache && shared) {
+            pool_->cache->Store(cache_key_, shared);
+        }
+        lead_.Complete(std::move(shared));
+    }
+    client_buffer_.consume(request_head_.message_size);
+    cache_key_.clear();
+}
+
+template <class Notifier>
+void HttpSession<Notifier>::SendToClient()
+{
+    const bool interim = response_head_.status / 100 == 1;
+    if (!interim) {
+        ++watch_generation_;
+    }
+    SpliceMessage(ResponseView(), pool_->response_headers.get(),
+                  interim ? std::string_view{} : std::string_view(set_cookie_), segments_);
+    boost::asio::async_write(
+        client_socket_,
+        boost::beast::buffers_range_ref(segments_),
+        [self=this->shared_from_this()](ErrorCode ec, std::size_t length){
             self->HandleSendToClient(ec, length);
         }
     );
 }
 
-void HttpSession::HandleSendToClient(ErrorCode ec, std::size_t length) {
+template <class Notifier>
+void HttpSession<Notifier>::HandleSendToClient(ErrorCode ec, std::size_t length) {
     if (ec) {
-        if (NeedErrorLogging(ec)) {
-            SERROR("sid:{} {}", id, ec.message());
-        }
-        Cancel();
+        HandleError(ec);
         return;
     }
-    if (visitor_) {
-        visitor_->OnResponseSent();
+    server_buffer_.consume(response_head_.message_size);
+
+    // 1xx responses are followed by the final one
+    if (response_head_.status / 100 == 1 && response_head_.status != 101) {
+        ServerRead();
+        return;
+    }
+
+    set_cookie_.clear();
+    if (!response_head_.keep_alive || !request_head_.keep_alive) {
+        Cancel();
+        return;
     }
     ClientRead();
 }
 
-void CloseSocket(HttpSession::SocketType& socket)
+template <class Notifier>
+MessageView HttpSession<Notifier>::RequestView() const
+{
+    return MessageView(request_head_, std::string_view(static_cast<const char*>(client_buffer_.data().data()),
+                                                       client_buffer_.size()));
+}
+
+template <class Notifier>
+MessageView HttpSession<Notifier>::ResponseView() const
+{
+    return MessageView(response_head_, std::string_view(static_cast<const char*>(server_buffer_.data().data()),
+                                                        server_buffer_.size()));
+}
+
+bool PeerClosed(SocketType& socket)
+{
+    // peeking must not block on a spurious wakeup
+    char byte;
+    const ssize_t length = ::recv(socket.native_handle(), &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+    return length == 0 || (length < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR);
+}
+
+void CloseSocket(SocketType& socket)
 {
-    HttpSession::ErrorCode ec;
+    boost::system::error_code ec;
     if (socket.is_open()) {
         socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
         if (!ec) {
@@ -171,32 +814,32 @@ void CloseSocket(HttpSession::SocketType& socket)
 }
 
 
-void HttpSession::Cancel()
+template <class Notifier>
+void HttpSession<Notifier>::Cancel()
 {
-    CloseSocket(client_stream_.socket());
-    CloseSocket(server_stream_.socket());
-    if (visitor_) {
-        visitor_->OnDisconnect();
-    }
+    CloseSocket(client_socket_);
+    CloseSocket(server_socket_);
+    connect_cancellation_.Cancel();
+    notifier_.OnDisconnect();
 }
 
-HttpSession::~HttpSession()
+template <class Notifier>
+HttpSession<Notifier>::~HttpSession() noexcept
 {
     Cancel();
 }
 
-HttpSession::IdType HttpSession::generateId()
-{
-    static std::atomic<IdType> id = 0;
-    HttpSession::IdType result = id.fetch_add(1, std::memory_order_relaxed);
-    return result;
-}
-
-const HttpSession::IdType& HttpSession::Id() const
+template <class Notifier>
+const typename HttpSession<Notifier>::IdType& HttpSession<Notifier>::Id() const
 {
     return id;
 }
 
+template class HttpSession<NoopNotifier>;
+template class HttpSession<LeastConnectionsNotifier>;
+template class HttpSession<LeastResponseTimeNotifier>;
+template class HttpSession<AnyNotifier>;
+
 } // namespace tcp
 
 } // namespace lb
\ No newline at end of file
@@ -4,45 +4,93 @@
 #include <boost/asio.hpp>
 #include <boost/beast.hpp>
 #include <boost/thread/mutex.hpp>
+#include <lb/tcp/adaptive_concurrency.hpp>
+#include <lb/tcp/admission.hpp>
+#include <lb/tcp/buffer_pool.hpp>
+#include <lb/tcp/collapsed_forwarding.hpp>
+#include <lb/tcp/deadline.hpp>
+#include <lb/tcp/happy_eyeballs.hpp>
+#include <lb/tcp/connection_limits.hpp>
+#include <lb/tcp/notifiers.hpp>
+#include <lb/tcp/rate_limiter.hpp>
+#include <lb/tcp/retry.hpp>
+#include <lb/tcp/raw_message.hpp>
+#include <lb/tcp/response_cache.hpp>
 #include <lb/tcp/selectors.hpp>
+#include <lb/tcp/socket.hpp>
+#include <lb/tcp/timeouts.hpp>
+
+#include <optional>
+#include <string>
+#include <vector>
 
 namespace lb {
 
 namespace tcp {
 
+class Connector;
+struct Pool;
+
 struct BasicSession {
+    using IdType = std::size_t;
+
+    BasicSession();
     virtual void Run() = 0;
     virtual void Cancel() = 0;
-    virtual ~BasicSession() = default;
+    virtual ~BasicSession();
+
+    // Number of sessions currently alive in the process
+    static std::size_t ActiveSessions();
+protected:
+    static constexpr std::size_t kReadSize = 64 * 1024;       // max bytes per read
+    static constexpr std::size_t kReservedFields = 32;        // per message, vectors grow past it
+    static constexpr std::size_t kReservedSegments = 8;
+
+    static IdType GenerateId();
 };
 
 using SessionPtr = std::shared_ptr<BasicSession>;
 
-struct StateNotifier {
-    virtual void OnConnect() {};
-    virtual void OnDisconnect() {};
-    virtual void OnResponseReceive() {};
-    virtual void OnResponseSent() {};
-    virtual void OnRequestReceive() {};
-    virtual void OnRequestSent() {};
-    virtual ~StateNotifier() = default;
-};
+// Responses sessions send before closing the client connection
+extern const std::string kNotFoundResponse;
+extern const std::string kBadGatewayResponse;
+extern const std::string kServiceUnavailableResponse;
+extern const std::string kTooManyRequestsResponse;
+extern const std::string kRequestTimeoutResponse;
+extern const std::string kGatewayTimeoutResponse;
+
+// Response to a timeout of phase, nullptr if connection is closed silently
+const std::string* TimeoutResponse(TimeoutPhase phase);
+
+// False for errors of a normally closed connection
+bool NeedErrorLogging(const boost::system::error_code& ec);
 
-using VisitorPtr = std::unique_ptr<StateNotifier>;
+void CloseSocket(SocketType& socket);
 
+// True if the peer of a readable socket closed or reset it
+bool PeerClosed(SocketType& socket);
+
+// Notifier is one of policies in notifiers.hpp, connector picks the
+// instantiation once, by selector types of its pools.
+template <class Notifier>
 class HttpSession : public BasicSession,
-                    public std::enable_shared_from_this<HttpSession> {
+                    public std::enable_shared_from_this<HttpSession<Notifier>> {
 public:
-    using IdType        = std::size_t;
-    using SocketType    = boost::asio::ip::tcp::socket;
+    using IdType        = BasicSession::IdType;
+    using SocketType    = tcp::SocketType;
     using EndpointType  = boost::asio::ip::tcp::endpoint;
-    using TcpStream     = boost::beast::tcp_stream;
-    using BufferType    = boost::beast::flat_buffer;
-    using RequestType   = boost::beast::http::request<boost::beast::http::string_body>;
-    using ResponseType  = boost::beast::http::response<boost::beast::http::string_body>;
+    using BufferType    = IoBuffer;
     using ErrorCode     = boost::system::error_code;
 public:
-    HttpSession(SocketType client_socket, SocketType server_socket, VisitorPtr visitor=nullptr);
+    // Backend is selected by connector after the first request is read, the
+    // session reconnects when a later request is routed to another pool.
+    // Messages are forwarded as received, only header edits are spliced in.
+    // Every phase waiting for a peer is bounded by connector's timeouts.
+    HttpSession(SocketType client_socket,
+                const EndpointType& client_endpoint,
+                Connector& connector,
+                AdmissionTicket ticket={},
+                ConcurrencyLimitPtr connects_limit=nullptr);
 
     HttpSession(const HttpSession&) = delete;
     HttpSession& operator=(const HttpSession&) = delete;
@@ -55,26 +103,99 @@ public:
     const IdType& Id() const;
 protected:
     void ClientRead();
+    // Waits for readability without buffers, their slabs are back in
+    // BufferPool until the next exchange
+    void WaitClientRead();
+    void DoClientRead();
     void HandleClientRead(ErrorCode ec, std::size_t length);
+    void HandleRequest();
+    // Answers a request past its deadline without sending it upstream
+    void RespondExpired();
+    void ForwardRequest(Pool& pool);
+    // Waits for the response to an identical request in flight
+    void FollowLeader(Pool& pool);
+    // Sends a fresh response from the pool's cache without a backend
+    void SendCached(const Pool& pool, CachedResponsePtr response);
+    void HandleSendCached(ErrorCode ec);
+    // Cancels upstream work if the client closes before the response
+    void WatchClient();
+    void OnClientGone();
+    void ConnectToServer(Pool& pool);
+    void ConnectAttempt(Pool& pool, Backend backend, const std::string& set_cookie);
+    // Waits for a slot of backend, which is at its cap
+    void WaitForSlot(Pool& pool, Backend backend, const std::string& set_cookie);
+    void StartConnect(Pool& pool, Backend backend, const std::string& set_cookie);
+    // Retries a failed attempt on another backend of the pool
+    void HandleConnect(Pool& pool, ErrorCode ec);
+    void DisconnectFromPool();
+    // Sends the request again on a new connection, false if it may not be
+    // replayed after ec
+    bool Replay(const ErrorCode& ec);
     void SendToServer();
     void HandleSendToServer(ErrorCode ec, std::size_t length);
+    // Hedges the wait for the first response byte if the pool says so
     void ServerRead();
+    void DoServerRead();
+    // Continues with the connection, slot and permit of a hedge that answered first
+    void AdoptHedge(Backend backend, const std::string& set_cookie, BackendSlot slot,
+                    AdaptiveConcurrency::Permit permit);
     void HandleServerRead(ErrorCode ec, std::size_t length);
+    // Offers the final response to the cache and requests collapsed into
+    // this one, the request is kept for it
+    void StoreResponse();
     void SendToClient();
     void HandleSendToClient(ErrorCode ec, std::size_t length);
+    void RejectRequest();
+    void RespondAndClose(const std::string& response); // response must be static
+    // Responds to a timeout if there was one, otherwise with response if set
+    void HandleError(const ErrorCode& ec, const std::string* response = nullptr);
+    static void OnTimerExpired(void* context); // called by timer wheel
+    void OnTimeout();
+    MessageView RequestView() const;
+    MessageView ResponseView() const;
 protected:
-    static IdType generateId();
-protected:
-    TcpStream client_stream_;
-    TcpStream server_stream_;
+    SocketType client_socket_;
+    SocketType server_socket_;
     BufferType client_buffer_;
     BufferType server_buffer_;
-    RequestType client_request_;
-    ResponseType server_response_;
+    MessageHead request_head_;
+    MessageHead response_head_;
+    std::optional<RawRequestParser> request_parser_;
+    std::optional<RawResponseParser> response_parser_;
+    Segments segments_; // of message being written
     IdType id;
-    VisitorPtr visitor_;
+    Connector& connector_;
+    Notifier notifier_;
+    AdmissionTicket ticket_;
+    ConcurrencyLimitPtr connects_limit_; // of the listener, nullptr if it has none
+    RateLimiter* rate_limiter_; // not owner
+    EndpointType client_endpoint_;
+    Pool* pool_ = nullptr; // pool of connected backend
+    std::string set_cookie_; // "Set-Cookie: ...\r\n" spliced into the next response if not empty
+    PhaseTimer timer_;
+    TimeoutPhase timed_out_ = TimeoutPhase::NONE; // all pending operations are failed once set
+    AdmissionTicket connect_ticket_; // held while connecting
+    TriedBackends tried_backends_; // by the current connect
+    BackendSlot backend_slot_; // of the connected backend, empty unless the pool caps connections
+    AdaptiveConcurrency::Permit permit_; // of the request in flight, requests refused one get 503
+    RequestDeadline::Clock::time_point request_start_;
+    RequestDeadline deadline_;
+    std::uint64_t watch_generation_ = 0; // bumped once the final response begins, stale watches are ignored
+    bool client_gone_ = false; // upstream work was cancelled
+    std::string cache_key_; // of the request in flight if the pool may cache its response
+    CachedResponsePtr cached_; // being sent
+    std::string age_line_; // of cached_
+    CollapseLead lead_; // of the request in flight if identical ones wait for its response
+    bool connect_timed_out_ = false; // attempt was cancelled by CONNECT timeout
+    ConnectCancellation connect_cancellation_; // of the pending connect attempt or hedged read
+    bool replay_ = false; // request is kept in client buffer until the first response byte
 };
 
+extern template class HttpSession<NoopNotifier>;
+extern template class HttpSession<LeastConnectionsNotifier>;
+extern template class HttpSession<LeastResponseTimeNotifier>;
+extern template class HttpSession<AnyNotifier>;
+
 } // namespace tcp
 
 
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/strand.hpp>
+
+namespace lb::tcp {
+
+// Sessions run on a strand of io_context. Executor type is spelled out:
+// strand does not fit into small buffer of type-erased any_io_executor, so
+// with it every async operation allocated copies of the executor.
+using ExecutorType = boost::asio::strand<boost::asio::io_context::executor_type>;
+using SocketType = boost::asio::basic_stream_socket<boost::asio::ip::tcp, ExecutorType>;
+
+} // namespace lb::tcp
@@ -0,0 +1,193 @@
+#include <lb/tcp/sticky.hpp>
+#include <lb/logging.hpp>
+
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+
+#include <yaml-cpp/yaml.h>
+
+namespace lb::tcp {
+
+namespace {
+
+constexpr std::size_t kIdHexLength = 16;
+constexpr std::size_t kSignatureHexLength = 32; // truncated HMAC-SHA256, 128 bit
+
+std::string ToHex(const unsigned char* data, std::size_t size)
+{
+    static constexpr char digits[] = "0123456789abcdef";
+    std::string result(size * 2, '0');
+    for (std::size_t i = 0; i < size; ++i) {
+        result[2 * i] = digits[data[i] >> 4];
+        result[2 * i + 1] = digits[data[i] & 0x0f];
+    }
+    return result;
+}
+
+std::optional<StickySessions::BackendId> ParseId(std::string_view hex)
+{
+    if (hex.size() != kIdHexLength) {
+        return std::nullopt;
+    }
+    StickySessions::BackendId id = 0;
+    for (char c : hex) {
+        id <<= 4;
+        if (c >= '0' && c <= '9') {
+            id |= c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            id |= c - 'a' + 10;
+        } else {
+            return std::nullopt;
+        }
+    }
+    return id;
+}
+
+std::string_view Trim(std::string_view str)
+{
+    while (!str.empty() && (str.front() == ' ' || str.front() == '\t')) {
+        str.remove_prefix(1);
+    }
+    while (!str.empty() && (str.back() == ' ' || str.back() == '\t')) {
+        str.remove_suffix(1);
+    }
+    return str;
+}
+
+} // anonymous namespace
+
+StickySessions::StickySessions(const Configuration& config, const std::vector<Backend>& backends)
+    : config_(config)
+{
+    if (config_.secret.empty()) {
+        WARN("Sticky sessions secret is not set, cookies are valid only for this process");
+        unsigned char key[32];
+        if (RAND_bytes(key, sizeof(key)) != 1) {
+            EXCEPTION("Unable to generate sticky sessions secret");
+        }
+        config_.secret.assign(reinterpret_cast<const char*>(key), sizeof(key));
+    }
+
+    for (const Backend& backend : backends) {
+        auto [it, inserted] = backends_.emplace(Id(backend), backend);
+        if (!inserted) {
+            EXCEPTION("Sticky sessions: duplicated backend {}", backend);
+        }
+    }
+}
+
+StickySessions::BackendId StickySessions::Id(const Backend& backend)
+{
+    // FNV-1a: must be stable across processes and builds
+    BackendId hash = 0xcbf29ce484222325ULL;
+    for (unsigned char c : backend.ToString()) {
+        hash ^= c;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+std::string StickySessions::Sign(BackendId id) const
+{
+    unsigned char message[sizeof(id)];
+    for (std::size_t i = 0; i < sizeof(id); ++i) {
+        message[i] = static_cast<unsigned char>(id >> (8 * (sizeof(id) - 1 - i)));
+    }
+
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_size = 0;
+    HMAC(EVP_sha256(), config_.secret.data(), config_.secret.size(),
+         message, sizeof(message), digest, &digest_size);
+    return ToHex(digest, kSignatureHexLength / 2);
+}
+
+std::string StickySessions::Encode(const Backend& backend) const
+{
+    BackendId id = Id(backend);
+    unsigned char bytes[sizeof(id)];
+    for (std::size_t i = 0; i < sizeof(id); ++i) {
+        bytes[i] = static_cast<unsigned char>(id >> (8 * (sizeof(id) - 1 - i)));
+    }
+    return ToHex(bytes, sizeof(bytes)) + "." + Sign(id);
+}
+
+std::optional<Backend> StickySessions::Decode(std::string_view token) const
+{
+    if (token.size() != kIdHexLength + 1 + kSignatureHexLength || token[kIdHexLength] != '.') {
+        return std::nullopt;
+    }
+
+    std::optional<BackendId> id = ParseId(token.substr(0, kIdHexLength));
+    if (!id) {
+        return std::nullopt;
+    }
+
+    std::string expected = Sign(*id);
+    if (CRYPTO_memcmp(expected.data(), token.data() + kIdHexLength + 1, kSignatureHexLength) != 0) {
+        return std::nullopt;
+    }
+
+    auto it = backends_.find(*id);
+    if (it == backends_.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+std::optional<Backend> StickySessions::Lookup(std::string_view cookie_header) const
+{
+    while (!cookie_header.empty()) {
+        std::size_t end = cookie_header.find(';');
+        std::string_view pair = Trim(cookie_header.substr(0, end));
+        cookie_header.remove_prefix(end == std::string_view::npos ? cookie_header.size() : end + 1);
+
+        std::size_t eq = pair.find('=');
+        if (eq == std::string_view::npos || Trim(pair.substr(0, eq)) != config_.cookie_name) {
+            continue;
+        }
+        return Decode(Trim(pair.substr(eq + 1)));
+    }
+    return std::nullopt;
+}
+
+std::string StickySessions::MakeSetCookie(const Backend& backend) const
+{
+    std::string result = config_.cookie_name + "=" + Encode(backend) + "; Path=/; HttpOnly";
+    if (config_.max_age.count() > 0) {
+        result += "; Max-Age=" + std::to_string(config_.max_age.count());
+    }
+    return result;
+}
+
+StickySessionsPtr ConfigureStickySessions(const YAML::Node& balancing_node, const std::string& pool_name)
+{
+    if (!balancing_node["sticky"].IsDefined()) {
+        return nullptr;
+    }
+
+    const YAML::Node& node = balancing_node["sticky"];
+    if (!node.IsMap()) {
+        EXCEPTION("sticky node must be a map");
+    }
+
+    StickySessions::Configuration sticky_config;
+    if (!pool_name.empty()) {
+        // pools must not overwrite affinity of each other
+        sticky_config.cookie_name += "_" + pool_name;
+    }
+    if (node["cookie"].IsDefined()) {
+        sticky_config.cookie_name = node["cookie"].as<std::string>();
+    }
+    if (node["secret"].IsDefined()) {
+        sticky_config.secret = node["secret"].as<std::string>();
+    }
+    if (node["max_age"].IsDefined()) {
+        sticky_config.max_age = std::chrono::seconds(node["max_age"].as<std::size_t>());
+    }
+
+    return std::make_shared<StickySessions>(sticky_config, ReadBackends(balancing_node));
+}
+
+} // namespace lb::tcp
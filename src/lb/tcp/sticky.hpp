@@ -0,0 +1,64 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <lb/tcp/selectors.hpp>
+
+namespace YAML {class Node;}
+
+namespace lb::tcp {
+
+// Cookie-based session affinity without per-client state.
+//
+// The cookie carries a stable backend id signed with HMAC-SHA256, so clients
+// cannot forge it to pick a backend. Requests with a valid cookie bypass the
+// selector.
+class StickySessions {
+public:
+    using BackendId = std::uint64_t;
+
+    struct Configuration {
+        std::string cookie_name = "lb2_affinity";
+        std::string secret;              // HMAC key, random per process if empty
+        std::chrono::seconds max_age{0}; // 0 - session cookie
+    };
+public:
+    StickySessions(const Configuration& config, const std::vector<Backend>& backends);
+
+    StickySessions(const StickySessions&) = delete;
+    StickySessions& operator=(const StickySessions&) = delete;
+
+    // Backend from affinity cookie in Cookie header value(s)
+    std::optional<Backend> Lookup(std::string_view cookie_header) const;
+
+    // Value of Set-Cookie header binding client to backend
+    std::string MakeSetCookie(const Backend& backend) const;
+
+    std::string Encode(const Backend& backend) const;
+
+    std::optional<Backend> Decode(std::string_view token) const;
+
+    static BackendId Id(const Backend& backend);
+
+private:
+    std::string Sign(BackendId id) const;
+
+private:
+    Configuration config_;
+    std::unordered_map<BackendId, Backend> backends_; // immutable after construction
+};
+
+using StickySessionsPtr = std::shared_ptr<StickySessions>;
+
+// Reads sticky node of a pool, returns nullptr if it is missing.
+// Default cookie name of a named pool is suffixed with the pool name.
+StickySessionsPtr ConfigureStickySessions(const YAML::Node& balancing_node, const std::string& pool_name = "");
+
+} // namespace lb::tcp
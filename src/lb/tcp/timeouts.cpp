@@ -0,0 +1,142 @@
+#include <lb/tcp/timeouts.hpp>
+#include <lb/logging.hpp>
+#include <lb/metrics.hpp>
+
+#include <algorithm>
+#include <array>
+#include <string>
+
+#include <yaml-cpp/yaml.h>
+
+namespace lb::tcp {
+
+std::string_view ToString(TimeoutPhase phase)
+{
+    switch (phase) {
+    case TimeoutPhase::IDLE:
+        return "idle";
+    case TimeoutPhase::HEADER_READ:
+        return "header_read";
+    case TimeoutPhase::BODY_READ:
+        return "body_read";
+    case TimeoutPhase::CONNECT:
+        return "connect";
+    case TimeoutPhase::FIRST_BYTE:
+        return "first_byte";
+    default:
+        return "none";
+    }
+}
+
+std::chrono::milliseconds SessionTimeouts::Of(TimeoutPhase phase) const
+{
+    switch (phase) {
+    case TimeoutPhase::IDLE:
+        return idle;
+    case TimeoutPhase::HEADER_READ:
+        return header_read;
+    case TimeoutPhase::BODY_READ:
+        return body_read;
+    case TimeoutPhase::CONNECT:
+        return connect;
+    case TimeoutPhase::FIRST_BYTE:
+        return first_byte;
+    default:
+        return std::chrono::milliseconds::zero();
+    }
+}
+
+SessionTimeouts ConfigureTimeouts(const YAML::Node& config)
+{
+    SessionTimeouts result;
+    if (!config["timeouts"].IsDefined()) {
+        return result;
+    }
+
+    const YAML::Node& node = config["timeouts"];
+    if (!node.IsMap()) {
+        EXCEPTION("timeouts node must be a map");
+    }
+    auto read = [&node](const char* name, std::chrono::milliseconds& value) {
+        if (node[name].IsDefined()) {
+            value = std::chrono::milliseconds(node[name].as<std::size_t>());
+        }
+    };
+    read("idle_ms", result.idle);
+    read("header_read_ms", result.header_read);
+    read("body_read_ms", result.body_read);
+    read("connect_ms", result.connect);
+    read("first_byte_ms", result.first_byte);
+    return result;
+}
+
+PhaseTimer::PhaseTimer(TimerService::WheelPtr wheel,
+                       const SessionTimeouts& timeouts,
+                       TimerWheel::Timer::Callback callback,
+                       void* context)
+    : wheel_(std::move(wheel))
+    , timeouts_(timeouts)
+    , timer_(callback, context)
+{}
+
+PhaseTimer::~PhaseTimer()
+{
+    Disarm();
+}
+
+void PhaseTimer::Arm(TimeoutPhase phase)
+{
+    Arm(phase, std::nullopt);
+}
+
+void PhaseTimer::Arm(TimeoutPhase phase, std::optional<std::chrono::milliseconds> cap)
+{
+    std::chrono::milliseconds timeout = timeouts_.Of(phase);
+    if (cap) {
+        // zero would disable the timeout
+        const std::chrono::milliseconds capped = std::max(*cap, std::chrono::milliseconds(1));
+        timeout = timeout == std::chrono::milliseconds::zero() ? capped : std::min(timeout, capped);
+    }
+    if (timeout == std::chrono::milliseconds::zero()) {
+        Disarm();
+        return;
+    }
+    phase_ = phase;
+    wheel_->Arm(timer_, timeout);
+}
+
+void PhaseTimer::Disarm()
+{
+    if (phase_ == TimeoutPhase::NONE) {
+        return;
+    }
+    phase_ = TimeoutPhase::NONE;
+    wheel_->Cancel(timer_);
+}
+
+TimeoutPhase PhaseTimer::Phase() const
+{
+    return phase_;
+}
+
+std::uint64_t PhaseTimer::Generation() const
+{
+    return timer_.Generation();
+}
+
+void PhaseTimer::Count(TimeoutPhase phase)
+{
+    static const std::array<metrics::Counter*, 6> counters = []() {
+        std::array<metrics::Counter*, 6> result = {};
+        for (std::size_t i = 1; i < result.size(); ++i) {
+            const std::string name(ToString(static_cast<TimeoutPhase>(i)));
+            result[i] = &metrics::Registry::Instance().GetCounter("sessions.timeouts." + name);
+        }
+        return result;
+    }();
+    if (metrics::Counter* counter = counters[static_cast<std::size_t>(phase)]) {
+        counter->Add();
+    }
+}
+
+} // namespace lb::tcp
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <lb/tcp/timer_wheel.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+namespace YAML {class Node;}
+
+namespace lb::tcp {
+
+enum class TimeoutPhase {
+    NONE=0,
+    IDLE,        // waiting for the next request
+    HEADER_READ, // from the first byte of request to the end of its header
+    BODY_READ,   // from the end of request header to the end of request
+    CONNECT,     // upstream connect, resolve included
+    FIRST_BYTE,  // from request sent upstream to the first byte of response
+};
+
+std::string_view ToString(TimeoutPhase phase);
+
+// Zero disables the timeout of a phase
+struct SessionTimeouts {
+    std::chrono::milliseconds idle{60000};
+    std::chrono::milliseconds header_read{10000};
+    std::chrono::milliseconds body_read{30000};
+    std::chrono::milliseconds connect{5000};
+    std::chrono::milliseconds first_byte{60000};
+
+    std::chrono::milliseconds Of(TimeoutPhase phase) const;
+};
+
+// Reads optional timeouts node: {idle_ms, header_read_ms, body_read_ms, connect_ms, first_byte_ms}
+SessionTimeouts ConfigureTimeouts(const YAML::Node& config);
+
+// Timeout of the phase a session is in. The callback is called on expiry
+// on a thread advancing the wheel, under its lock: sessions post to their
+// strand from it and compare Generation() there, it is changed under the
+// lock by every Arm and Disarm. Arm and Disarm must be called from the
+// session's strand.
+class PhaseTimer {
+public:
+    PhaseTimer(TimerService::WheelPtr wheel,
+               const SessionTimeouts& timeouts,
+               TimerWheel::Timer::Callback callback,
+               void* context);
+
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+    ~PhaseTimer();
+
+    // Rearms for the phase, disarms if its timeout is disabled
+    void Arm(TimeoutPhase phase);
+
+    // Rearms for the phase, for at most cap if it is set
+    void Arm(TimeoutPhase phase, std::optional<std::chrono::milliseconds> cap);
+
+    void Disarm();
+
+    // Phase of the last Arm, NONE if disarmed
+    TimeoutPhase Phase() const;
+
+    std::uint64_t Generation() const;
+
+    // Counts the timeout of phase in sessions.timeouts.* metrics
+    static void Count(TimeoutPhase phase);
+private:
+    TimerService::WheelPtr wheel_;
+    const SessionTimeouts& timeouts_;
+    TimerWheel::Timer timer_;
+    TimeoutPhase phase_ = TimeoutPhase::NONE;
+};
+
+} // namespace lb::tcp
@@ -0,0 +1,215 @@
+#include <lb/tcp/timer_wheel.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace lb::tcp {
+
+TimerWheel::Timer::Timer(Callback callback, void* context)
+    : callback_(callback)
+    , context_(context)
+{}
+
+bool TimerWheel::Timer::IsArmed() const
+{
+    return pprev_ != nullptr;
+}
+
+std::uint64_t TimerWheel::Timer::Generation() const
+{
+    return generation_;
+}
+
+void TimerWheel::Link(Timer*& head, Timer& timer)
+{
+    timer.next_ = head;
+    if (head) {
+        head->pprev_ = &timer.next_;
+    }
+    head = &timer;
+    timer.pprev_ = &head;
+}
+
+void TimerWheel::Unlink(Timer& timer)
+{
+    *timer.pprev_ = timer.next_;
+    if (timer.next_) {
+        timer.next_->pprev_ = timer.pprev_;
+    }
+    timer.next_ = nullptr;
+    timer.pprev_ = nullptr;
+}
+
+void TimerWheel::Schedule(Timer& timer, std::uint64_t deadline)
+{
+    if (timer.IsArmed()) {
+        Unlink(timer);
+        --size_;
+    }
+    ++timer.generation_;
+    timer.deadline_ = std::min(std::max(deadline, now_ + 1), now_ + kMaxDelay);
+    Insert(timer);
+    ++size_;
+}
+
+void TimerWheel::Insert(Timer& timer)
+{
+    // Lowest level where deadline is less than a revolution ahead: its slot
+    // comes exactly when the wheel reaches the deadline rounded to the level
+    std::size_t level = 0;
+    while (level + 1 < kLevels
+           && (timer.deadline_ >> (kSlotBits * level)) - (now_ >> (kSlotBits * level)) >= kSlots) {
+        ++level;
+    }
+    const std::size_t slot = (timer.deadline_ >> (kSlotBits * level)) & (kSlots - 1);
+    Link(slots_[level][slot], timer);
+}
+
+void TimerWheel::Cancel(Timer& timer)
+{
+    ++timer.generation_;
+    if (timer.IsArmed()) {
+        Unlink(timer);
+        --size_;
+    }
+}
+
+void TimerWheel::Advance(std::uint64_t now)
+{
+    if (size_ == 0) {
+        now_ = std::max(now_, now);
+        return;
+    }
+    while (now_ < now && size_ > 0) {
+        Tick();
+    }
+    now_ = std::max(now_, now);
+}
+
+void TimerWheel::Tick()
+{
+    ++now_;
+    // Upper levels first: their timers may land in the slot expiring now
+    std::size_t levels = 1;
+    while (levels < kLevels && (now_ & ((std::uint64_t(1) << (kSlotBits * levels)) - 1)) == 0) {
+        ++levels;
+    }
+    for (std::size_t level = levels - 1; level > 0; --level) {
+        Timer*& head = slots_[level][(now_ >> (kSlotBits * level)) & (kSlots - 1)];
+        Timer* timer = head;
+        head = nullptr;
+        while (timer) {
+            Timer* next = timer->next_;
+            timer->pprev_ = nullptr;
+            Insert(*timer);
+            timer = next;
+        }
+    }
+
+    Timer*& head = slots_[0][now_ & (kSlots - 1)];
+    while (head) {
+        Timer& timer = *head;
+        Unlink(timer);
+        --size_;
+        timer.callback_(timer.context_);
+    }
+}
+
+std::uint64_t TimerWheel::Now() const
+{
+    return now_;
+}
+
+std::size_t TimerWheel::Size() const
+{
+    return size_;
+}
+
+TimerService::Wheel::Wheel(boost::asio::io_context& ioc)
+    : ticker_(ioc)
+    , origin_(ClockType::now())
+{}
+
+std::uint64_t TimerService::Wheel::CurrentTick() const
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(ClockType::now() - origin_) / kTick;
+}
+
+void TimerService::Wheel::Arm(TimerWheel::Timer& timer, std::chrono::milliseconds timeout)
+{
+    const std::uint64_t ticks = (timeout + kTick - std::chrono::milliseconds(1)) / kTick;
+    boost::mutex::scoped_lock lock(mutex_);
+    const std::uint64_t now = CurrentTick();
+    if (wheel_.Size() == 0) {
+        wheel_.Advance(now);
+    }
+    wheel_.Schedule(timer, now + ticks);
+    if (!ticking_ && !stopped_) {
+        StartTicking();
+    }
+}
+
+void TimerService::Wheel::Cancel(TimerWheel::Timer& timer)
+{
+    boost::mutex::scoped_lock lock(mutex_);
+    wheel_.Cancel(timer);
+}
+
+void TimerService::Wheel::StartTicking()
+{
+    ticking_ = true;
+    ticker_.expires_at(origin_ + kTick * (wheel_.Now() + 1));
+    ticker_.async_wait([self=self_.lock()](const boost::system::error_code& ec) {
+        if (!ec) {
+            self->HandleTick();
+        }
+    });
+}
+
+void TimerService::Wheel::HandleTick()
+{
+    boost::mutex::scoped_lock lock(mutex_);
+    ticking_ = false;
+    if (stopped_) {
+        return;
+    }
+    wheel_.Advance(CurrentTick());
+    if (wheel_.Size() > 0) {
+        StartTicking();
+    }
+}
+
+void TimerService::Wheel::Stop()
+{
+    boost::mutex::scoped_lock lock(mutex_);
+    stopped_ = true;
+    ticker_.cancel();
+}
+
+TimerService::TimerService(boost::asio::io_context& ioc, std::size_t wheels)
+{
+    if (wheels == 0) {
+        wheels = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (std::size_t i = 0; i < wheels; ++i) {
+        wheels_.push_back(std::make_shared<Wheel>(ioc));
+        wheels_.back()->self_ = wheels_.back();
+    }
+}
+
+TimerService::~TimerService()
+{
+    for (const WheelPtr& wheel : wheels_) {
+        wheel->Stop();
+    }
+}
+
+TimerService::WheelPtr TimerService::LocalWheel()
+{
+    static std::atomic<std::size_t> threads{0};
+    thread_local const std::size_t thread_index = threads.fetch_add(1, std::memory_order_relaxed);
+    return wheels_[thread_index % wheels_.size()];
+}
+
+} // namespace lb::tcp
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace lb::tcp {
+
+// Hierarchical timer wheel: 4 levels of 64 slots, every level counts in
+// ticks of the previous one times 64. Timers are intrusive list nodes, so
+// scheduling and cancelling take O(1) and do not allocate. A timer moves to
+// a lower level when its slot comes, at most once per level.
+// Not thread safe.
+class TimerWheel {
+public:
+    static constexpr std::size_t kLevels = 4;
+    static constexpr std::size_t kSlotBits = 6;
+    static constexpr std::size_t kSlots = std::size_t(1) << kSlotBits;
+    // Longer delays are clamped to it
+    static constexpr std::uint64_t kMaxDelay = std::uint64_t(kSlots - 2) << (kSlotBits * (kLevels - 1));
+
+    class Timer {
+    public:
+        using Callback = void (*)(void* context);
+    public:
+        Timer(Callback callback, void* context);
+
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+
+        bool IsArmed() const;
+
+        // Changes on every Schedule and Cancel, not on expiry
+        std::uint64_t Generation() const;
+    private:
+        friend class TimerWheel;
+
+        Timer* next_ = nullptr;
+        Timer** pprev_ = nullptr; // link pointing to this timer, nullptr if not armed
+        std::uint64_t deadline_ = 0;
+        std::uint64_t generation_ = 0;
+        Callback callback_;
+        void* context_;
+    };
+public:
+    TimerWheel() = default;
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    // Timer expires once the wheel is advanced to deadline, reschedules
+    // an armed timer. Deadlines not after Now() expire on the next tick.
+    void Schedule(Timer& timer, std::uint64_t deadline);
+
+    void Cancel(Timer& timer);
+
+    // Moves the wheel to tick now and calls callbacks of expired timers.
+    // Timers are disarmed before their callbacks, which may schedule again.
+    void Advance(std::uint64_t now);
+
+    std::uint64_t Now() const;
+
+    std::size_t Size() const;
+private:
+    void Insert(Timer& timer);
+
+    static void Link(Timer*& head, Timer& timer);
+
+    static void Unlink(Timer& timer);
+
+    void Tick();
+private:
+    Timer* slots_[kLevels][kSlots] = {};
+    std::uint64_t now_ = 0;
+    std::size_t size_ = 0;
+};
+
+// Timer wheels of worker threads for timeouts armed at connection rate.
+// A session arms its timers on the wheel of the thread that created it.
+// Sessions move between threads of io_context, so every wheel has its own
+// mutex, contended only when two threads touch the same wheel. A wheel is
+// advanced by a steady_timer that ticks only while it has armed timers.
+class TimerService {
+public:
+    using ClockType = std::chrono::steady_clock;
+
+    static constexpr std::chrono::milliseconds kTick{10};
+
+    class Wheel {
+    public:
+        explicit Wheel(boost::asio::io_context& ioc);
+
+        // Timeout is rounded up to ticks
+        void Arm(TimerWheel::Timer& timer, std::chrono::milliseconds timeout);
+
+        void Cancel(TimerWheel::Timer& timer);
+
+        void Stop();
+    private:
+        friend class TimerService;
+
+        std::uint64_t CurrentTick() const;
+
+        void StartTicking(); // mutex must be held
+
+        void HandleTick();
+    private:
+        boost::mutex mutex_;
+        TimerWheel wheel_; // guarded by mutex
+        boost::asio::steady_timer ticker_; // guarded by mutex
+        bool ticking_ = false; // guarded by mutex
+        bool stopped_ = false; // guarded by mutex
+        const ClockType::time_point origin_;
+        std::weak_ptr<Wheel> self_;
+    };
+
+    using WheelPtr = std::shared_ptr<Wheel>;
+public:
+    // One wheel per hardware thread by default
+    explicit TimerService(boost::asio::io_context& ioc, std::size_t wheels = 0);
+
+    TimerService(const TimerService&) = delete;
+    TimerService& operator=(const TimerService&) = delete;
+
+    ~TimerService();
+
+    // Wheel of the calling thread. Holders keep it alive, so timers can be
+    // cancelled after the service is gone.
+    WheelPtr LocalWheel();
+private:
+    std::vector<WheelPtr> wheels_;
+};
+
+} // namespace lb::tcp
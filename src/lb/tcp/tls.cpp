@@ -0,0 +1,504 @@
+#include <lb/tcp/tls.hpp>
+#include <lb/logging.hpp>
+#include <lb/metrics.hpp>
+
+#include <boost/algorithm/string/join.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/ssl/error.hpp>
+#include <boost/asio/write.hpp>
+#include <openssl/bio.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <yaml-cpp/yaml.h>
+
+#include <array>
+#include <cerrno>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string_view>
+#include <utility>
+
+#include <linux/tls.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace asio = boost::asio;
+namespace sys = boost::system;
+
+namespace lb::tcp {
+
+namespace {
+
+constexpr std::size_t kTicketKeysSize = 80; // name, HMAC and AES keys
+
+std::string SslError()
+{
+    char text[256];
+    ERR_error_string_n(ERR_get_error(), text, sizeof(text));
+    return text;
+}
+
+sys::error_code SslErrorCode()
+{
+    return sys::error_code(static_cast<int>(ERR_get_error()), asio::error::get_ssl_category());
+}
+
+// Kernel cipher type of an OpenSSL cipher, 0 if kTLS has none
+std::uint16_t KernelCipher(const SSL_CIPHER* cipher)
+{
+    switch (SSL_CIPHER_get_cipher_nid(cipher)) {
+        case NID_aes_128_gcm:
+            return TLS_CIPHER_AES_GCM_128;
+        case NID_aes_256_gcm:
+            return TLS_CIPHER_AES_GCM_256;
+        case NID_chacha20_poly1305:
+            return TLS_CIPHER_CHACHA20_POLY1305;
+        default:
+            return 0;
+    }
+}
+
+// True if the kernel takes keys of cipher in both directions, tried with
+// dummy keys on a loopback connection
+bool KernelTakesCipher(std::uint16_t cipher, std::uint16_t version)
+{
+    union {
+        tls12_crypto_info_aes_gcm_128 aes_gcm_128;
+        tls12_crypto_info_aes_gcm_256 aes_gcm_256;
+        tls12_crypto_info_chacha20_poly1305 chacha20_poly1305;
+    } info{};
+    socklen_t size = 0;
+    switch (cipher) {
+        case TLS_CIPHER_AES_GCM_128:
+            size = sizeof(info.aes_gcm_128);
+            break;
+        case TLS_CIPHER_AES_GCM_256:
+            size = sizeof(info.aes_gcm_256);
+            break;
+        case TLS_CIPHER_CHACHA20_POLY1305:
+            size = sizeof(info.chacha20_poly1305);
+            break;
+        default:
+            return false;
+    }
+    info.aes_gcm_128.info.version = version;
+    info.aes_gcm_128.info.cipher_type = cipher;
+
+    // tls ULP takes only established connections, the listener's backlog completes it
+    asio::io_context ioc;
+    sys::error_code ec;
+    asio::ip::tcp::acceptor listener(ioc, {asio::ip::address_v4::loopback(), 0});
+    asio::ip::tcp::socket socket(ioc);
+    socket.connect(listener.local_endpoint(), ec);
+    if (ec) {
+        return false;
+    }
+    const int fd = socket.native_handle();
+    return ::setsockopt(fd, IPPROTO_TCP, TCP_ULP, "tls", sizeof("tls")) == 0
+        && ::setsockopt(fd, SOL_TLS, TLS_TX, &info, size) == 0
+        && ::setsockopt(fd, SOL_TLS, TLS_RX, &info, size) == 0;
+}
+
+// Moves plaintext between OpenSSL working the client's socket and the
+// session's end of a socket pair, for connections kTLS does not take. Lives
+// as long as one of the directions waits.
+class TlsRelay : public std::enable_shared_from_this<TlsRelay> {
+public:
+    using ErrorCode = sys::error_code;
+    static constexpr std::size_t kBufferSize = 16384; // plaintext of a record
+public:
+    TlsRelay(SocketType tls_socket, SocketType plain_socket, TlsConnection ssl)
+        : tls_socket_(std::move(tls_socket))
+        , plain_socket_(std::move(plain_socket))
+        , ssl_(std::move(ssl))
+    {}
+
+    void Start()
+    {
+        ReadRecords();
+        ReadPlain();
+    }
+private:
+    // client to session
+    void ReadRecords()
+    {
+        if (closed_) {
+            return;
+        }
+        ERR_clear_error();
+        const int read = SSL_read(ssl_.get(), inbound_.data(), inbound_.size());
+        if (read > 0) {
+            asio::async_write(plain_socket_, asio::buffer(inbound_.data(), read),
+                              [self=shared_from_this()](const ErrorCode& ec, std::size_t) {
+                                  if (ec) {
+                                      self->Close();
+                                      return;
+                                  }
+                                  self->ReadRecords();
+                              });
+            return;
+        }
+        switch (SSL_get_error(ssl_.get(), read)) {
+            case SSL_ERROR_WANT_READ:
+                WaitTls(SocketType::wait_read, &TlsRelay::ReadRecords);
+                return;
+            case SSL_ERROR_WANT_WRITE:
+                WaitTls(SocketType::wait_write, &TlsRelay::ReadRecords);
+                return;
+            case SSL_ERROR_ZERO_RETURN: {
+                // close_notify, the session sees end of stream and may still answer
+                ErrorCode ec;
+                plain_socket_.shutdown(SocketType::shutdown_send, ec);
+                return;
+            }
+            default:
+                Close();
+                return;
+        }
+    }
+
+    // session to client
+    void ReadPlain()
+    {
+        plain_socket_.async_read_some(asio::buffer(outbound_),
+                                      [self=shared_from_this()](const ErrorCode& ec, std::size_t size) {
+                                          if (ec) {
+                                              self->Finish();
+                                              return;
+                                          }
+                                          self->outbound_size_ = size;
+                                          self->WriteRecords();
+                                      });
+    }
+
+    void WriteRecords()
+    {
+        if (closed_) {
+            return;
+        }
+        ERR_clear_error();
+        // retried with the same buffer until the whole of it is written
+        const int written = SSL_write(ssl_.get(), outbound_.data(), outbound_size_);
+        if (written > 0) {
+            ReadPlain();
+            return;
+        }
+        switch (SSL_get_error(ssl_.get(), written)) {
+            case SSL_ERROR_WANT_READ:
+                WaitTls(SocketType::wait_read, &TlsRelay::WriteRecords);
+                return;
+            case SSL_ERROR_WANT_WRITE:
+                WaitTls(SocketType::wait_write, &TlsRelay::WriteRecords);
+                return;
+            default:
+                Close();
+                return;
+        }
+    }
+
+    void WaitTls(SocketType::wait_type type, void (TlsRelay::*next)())
+    {
+        tls_socket_.async_wait(type, [self=shared_from_this(), next](const ErrorCode& ec) {
+            if (ec) {
+                self->Close();
+                return;
+            }
+            ((*self).*next)();
+        });
+    }
+
+    // Session closed its end
+    void Finish()
+    {
+        if (!closed_) {
+            ERR_clear_error();
+            SSL_shutdown(ssl_.get()); // close_notify, best effort
+        }
+        Close();
+    }
+
+    void Close()
+    {
+        if (closed_) {
+            return;
+        }
+        closed_ = true;
+        ErrorCode ec;
+        tls_socket_.close(ec);
+        plain_socket_.close(ec);
+    }
+private:
+    SocketType tls_socket_;
+    SocketType plain_socket_; // relay's end of the pair
+    TlsConnection ssl_;
+    std::array<char, kBufferSize> inbound_;
+    std::array<char, kBufferSize> outbound_;
+    std::size_t outbound_size_ = 0;
+    bool closed_ = false;
+};
+
+} // anonymous namespace
+
+bool KernelTlsAvailable()
+{
+    const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return false;
+    }
+    // tls ULP takes only established connections, ENOTCONN tells it is there
+    const bool available = ::setsockopt(fd, IPPROTO_TCP, TCP_ULP, "tls", sizeof("tls")) == 0 || errno == ENOTCONN;
+    ::close(fd);
+    return available;
+}
+
+void SslDeleter::operator()(ssl_st* ssl) const
+{
+    // Connection goes on without OpenSSL, its session must stay resumable
+    SSL_set_shutdown(ssl, SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+    SSL_free(ssl);
+}
+
+void SslDeleter::operator()(ssl_ctx_st* ctx) const
+{
+    SSL_CTX_free(ctx);
+}
+
+TlsTerminator::TlsTerminator(const Configuration& config)
+    : config_(config)
+    , ctx_(SSL_CTX_new(TLS_server_method()))
+    , handshakes_(metrics::Registry::Instance().GetCounter("tls.handshakes"))
+    , resumed_(metrics::Registry::Instance().GetCounter("tls.resumed"))
+    , failures_(metrics::Registry::Instance().GetCounter("tls.handshake_failures"))
+    , ktls_unavailable_(metrics::Registry::Instance().GetCounter("tls.ktls_unavailable"))
+    , relayed_(metrics::Registry::Instance().GetCounter("tls.relayed"))
+{
+    SSL_CTX* ctx = ctx_.get();
+    if (!ctx) {
+        EXCEPTION("Can't create TLS context: {}", SslError());
+    }
+
+    // kTLS has no renegotiation, and 1.0/1.1 ciphers are not offloaded
+    SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+    SSL_CTX_set_max_proto_version(ctx, config_.tls13 ? TLS1_3_VERSION : TLS1_2_VERSION);
+    SSL_CTX_set_options(ctx, SSL_OP_NO_RENEGOTIATION | SSL_OP_CIPHER_SERVER_PREFERENCE);
+    if (config_.ktls != KtlsMode::OFF) {
+        SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+    }
+    if (SSL_CTX_set_cipher_list(ctx, config_.ciphers.c_str()) != 1) {
+        EXCEPTION("Invalid tls ciphers {}: {}", config_.ciphers, SslError());
+    }
+    if (SSL_CTX_use_certificate_chain_file(ctx, config_.certificate.c_str()) != 1) {
+        EXCEPTION("Can't load tls certificate {}: {}", config_.certificate, SslError());
+    }
+    if (SSL_CTX_use_PrivateKey_file(ctx, config_.private_key.c_str(), SSL_FILETYPE_PEM) != 1
+        || SSL_CTX_check_private_key(ctx) != 1) {
+        EXCEPTION("Can't load tls private key {}: {}", config_.private_key, SslError());
+    }
+
+    // One context serves all threads, so is its session cache
+    static constexpr unsigned char kSessionIdContext[] = "lb2";
+    SSL_CTX_set_session_id_context(ctx, kSessionIdContext, sizeof(kSessionIdContext) - 1);
+    if (config_.session_cache_size == 0) {
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+    } else {
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+        SSL_CTX_sess_set_cache_size(ctx, config_.session_cache_size);
+    }
+    SSL_CTX_set_timeout(ctx, config_.session_timeout.count());
+
+    if (!config_.session_tickets) {
+        SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+    } else if (!config_.ticket_key_file.empty()) {
+        std::ifstream file(config_.ticket_key_file, std::ios::binary);
+        std::string keys((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if (!file.eof() || keys.size() != kTicketKeysSize) {
+            EXCEPTION("tls ticket_key_file {} must hold {} bytes", config_.ticket_key_file, kTicketKeysSize);
+        }
+        SSL_CTX_set_tlsext_ticket_keys(ctx, keys.data(), keys.size());
+    }
+
+    // Kernel support is checked here rather than by every handshake
+    const bool kernel_tls = config_.ktls != KtlsMode::OFF && KernelTlsAvailable();
+    std::map<std::pair<std::uint16_t, std::uint16_t>, bool> kernel_takes;
+    STACK_OF(SSL_CIPHER)* ciphers = SSL_CTX_get_ciphers(ctx);
+    for (int i = 0; i < sk_SSL_CIPHER_num(ciphers); ++i) {
+        const SSL_CIPHER* cipher = sk_SSL_CIPHER_value(ciphers, i);
+        const bool tls13 = std::string_view(SSL_CIPHER_get_version(cipher)) == "TLSv1.3";
+        if (tls13 && !config_.tls13) {
+            continue;
+        }
+        bool offloaded = kernel_tls && (!tls13 || OpenSSL_version_num() >= 0x30200000L);
+        if (offloaded) {
+            const std::pair key{KernelCipher(cipher), tls13 ? TLS_1_3_VERSION : TLS_1_2_VERSION};
+            auto it = kernel_takes.find(key);
+            if (it == kernel_takes.end()) {
+                it = kernel_takes.emplace(key, KernelTakesCipher(key.first, key.second)).first;
+            }
+            offloaded = it->second;
+        }
+        if (!offloaded) {
+            userspace_ciphers_.emplace_back(SSL_CIPHER_get_name(cipher));
+        }
+    }
+    if (config_.ktls == KtlsMode::REQUIRED && !userspace_ciphers_.empty()) {
+        EXCEPTION("tls.ktls is required, but the kernel does not take ciphers {}: load tls module (modprobe tls) "
+                  "or change tls.ciphers", boost::algorithm::join(userspace_ciphers_, ", "));
+    }
+}
+
+const TlsTerminator::Configuration& TlsTerminator::Config() const
+{
+    return config_;
+}
+
+const std::vector<std::string>& TlsTerminator::UserspaceCiphers() const
+{
+    return userspace_ciphers_;
+}
+
+TlsConnection TlsTerminator::NewConnection(int socket, sys::error_code& ec)
+{
+    TlsConnection ssl(SSL_new(ctx_.get()));
+    if (!ssl || SSL_set_fd(ssl.get(), socket) != 1) {
+        ec = SslErrorCode();
+        return nullptr;
+    }
+    SSL_set_accept_state(ssl.get());
+    return ssl;
+}
+
+TlsStep TlsTerminator::Handshake(ssl_st* ssl, sys::error_code& ec)
+{
+    ERR_clear_error();
+    errno = 0;
+    const int result = SSL_do_handshake(ssl);
+    if (result == 1) {
+        handshakes_.Add();
+        if (SSL_session_reused(ssl)) {
+            resumed_.Add();
+        }
+        // Sessions read and write the socket only if OpenSSL keeps no records
+        if (BIO_get_ktls_send(SSL_get_wbio(ssl)) == 1 && BIO_get_ktls_recv(SSL_get_rbio(ssl)) == 1) {
+            return TlsStep::DONE;
+        }
+        if (config_.ktls == KtlsMode::REQUIRED) {
+            ktls_unavailable_.Add();
+            ec = asio::error::operation_not_supported;
+            return TlsStep::DONE;
+        }
+        return TlsStep::RELAY;
+    }
+
+    switch (SSL_get_error(ssl, result)) {
+        case SSL_ERROR_WANT_READ:
+            return TlsStep::WANT_READ;
+        case SSL_ERROR_WANT_WRITE:
+            return TlsStep::WANT_WRITE;
+        case SSL_ERROR_SYSCALL:
+            ec = errno != 0 ? sys::error_code(errno, sys::system_category()) : asio::error::eof;
+            break;
+        default:
+            ec = SslErrorCode();
+            break;
+    }
+    failures_.Add();
+    return TlsStep::DONE;
+}
+
+SocketType TlsTerminator::Relay(SocketType socket, TlsConnection ssl, sys::error_code& ec)
+{
+    const SocketType::executor_type executor = socket.get_executor();
+    int pair[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pair) != 0) {
+        ec = sys::error_code(errno, sys::system_category());
+        return SocketType(executor);
+    }
+    // Sessions take the client's address from the acceptor, the protocol
+    // only tells asio how to treat the descriptor
+    SocketType relay_end(executor);
+    SocketType session_end(executor);
+    relay_end.assign(asio::ip::tcp::v4(), pair[0], ec);
+    if (ec) {
+        ::close(pair[0]);
+        ::close(pair[1]);
+        return session_end;
+    }
+    session_end.assign(asio::ip::tcp::v4(), pair[1], ec);
+    if (ec) {
+        ::close(pair[1]);
+        return session_end;
+    }
+    relayed_.Add();
+    auto relay = std::allocate_shared<TlsRelay>(RecyclingAllocator<TlsRelay>(), std::move(socket),
+                                                std::move(relay_end), std::move(ssl));
+    relay->Start();
+    return session_end;
+}
+
+TlsTerminatorPtr ConfigureTls(const YAML::Node& acceptor_node)
+{
+    if (!acceptor_node["tls"].IsDefined()) {
+        return nullptr;
+    }
+
+    const YAML::Node& node = acceptor_node["tls"];
+    if (!node.IsMap()) {
+        EXCEPTION("tls node must be a map");
+    }
+    if (!node["certificate"].IsDefined() || !node["private_key"].IsDefined()) {
+        EXCEPTION("tls node must have certificate and private_key");
+    }
+
+    TlsTerminator::Configuration config;
+    config.certificate = node["certificate"].as<std::string>();
+    config.private_key = node["private_key"].as<std::string>();
+    config.tls13 = OpenSSL_version_num() >= 0x30200000L;
+    if (node["ciphers"].IsDefined()) {
+        config.ciphers = node["ciphers"].as<std::string>();
+    }
+    if (node["tls13"].IsDefined()) {
+        config.tls13 = node["tls13"].as<bool>();
+    }
+    if (node["session_cache_size"].IsDefined()) {
+        config.session_cache_size = node["session_cache_size"].as<std::size_t>();
+    }
+    if (node["session_timeout_s"].IsDefined()) {
+        config.session_timeout = std::chrono::seconds(node["session_timeout_s"].as<std::size_t>());
+    }
+    if (node["session_tickets"].IsDefined()) {
+        config.session_tickets = node["session_tickets"].as<bool>();
+    }
+    if (node["ticket_key_file"].IsDefined()) {
+        config.ticket_key_file = node["ticket_key_file"].as<std::string>();
+    }
+    if (node["handshake_timeout_ms"].IsDefined()) {
+        config.handshake_timeout = std::chrono::milliseconds(node["handshake_timeout_ms"].as<std::size_t>());
+        if (config.handshake_timeout.count() == 0) {
+            EXCEPTION("tls.handshake_timeout_ms must be positive");
+        }
+    }
+    if (node["ktls"].IsDefined()) {
+        const std::string ktls = node["ktls"].as<std::string>();
+        if (ktls == "auto") {
+            config.ktls = KtlsMode::AUTO;
+        } else if (ktls == "required") {
+            config.ktls = KtlsMode::REQUIRED;
+        } else if (ktls == "off") {
+            config.ktls = KtlsMode::OFF;
+        } else {
+            EXCEPTION("Unknown tls.ktls mode: {}", ktls);
+        }
+    }
+
+    auto terminator = std::make_shared<TlsTerminator>(config);
+    if (config.ktls == KtlsMode::AUTO && !terminator->UserspaceCiphers().empty()) {
+        WARN("Kernel does not take tls ciphers {}, their records are encrypted in userspace",
+             boost::algorithm::join(terminator->UserspaceCiphers(), ", "));
+    }
+    return terminator;
+}
+
+} // namespace lb::tcp
@@ -0,0 +1,213 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <lb/tcp/recycling_allocator.hpp>
+#include <lb/tcp/socket.hpp>
+
+namespace YAML {class Node;}
+
+namespace lb::metrics {class Counter;}
+
+struct ssl_ctx_st;
+struct ssl_st;
+
+namespace lb::tcp {
+
+// True if the kernel can take record encryption of TLS connections (tls ULP)
+bool KernelTlsAvailable();
+
+struct SslDeleter {
+    void operator()(ssl_st* ssl) const;
+    void operator()(ssl_ctx_st* ctx) const;
+};
+
+using TlsConnection = std::unique_ptr<ssl_st, SslDeleter>;
+
+enum class TlsStep {
+    WANT_READ=0,
+    WANT_WRITE,
+    DONE,  // failed or records are with the kernel
+    RELAY, // records stay with OpenSSL
+};
+
+enum class KtlsMode {
+    AUTO=0,   // kTLS where the kernel takes the cipher, userspace otherwise
+    REQUIRED, // start only if the kernel takes every cipher, close the rest
+    OFF,      // userspace only
+};
+
+// TLS termination on the listener. The handshake runs on the client's socket
+// through OpenSSL's socket BIO, then record encryption is handed over to the
+// kernel (kTLS): sessions read and write plaintext on the socket as on plain
+// connections. Connections kTLS does not take are relayed in userspace:
+// sessions get one end of a socket pair, OpenSSL works the other one.
+// Sessions are resumed by tickets and by a session cache shared by all
+// threads; tickets survive hot restart with ticket_key_file.
+class TlsTerminator {
+public:
+    struct Configuration {
+        std::string certificate; // PEM chain
+        std::string private_key; // PEM
+        std::string ciphers = "ECDHE+AESGCM:ECDHE+CHACHA20"; // TLS 1.2, AEADs kTLS supports
+        bool tls13 = false; // OpenSSL before 3.2 offloads only sending of TLS 1.3
+        std::size_t session_cache_size = 20480; // 0 - no server side cache
+        std::chrono::seconds session_timeout{300};
+        bool session_tickets = true;
+        std::string ticket_key_file; // 80 bytes, random keys per instance if empty
+        std::chrono::milliseconds handshake_timeout{10000};
+        KtlsMode ktls = KtlsMode::AUTO;
+    };
+public:
+    explicit TlsTerminator(const Configuration& config);
+
+    TlsTerminator(const TlsTerminator&) = delete;
+    TlsTerminator& operator=(const TlsTerminator&) = delete;
+
+    const Configuration& Config() const;
+
+    // Enabled ciphers the kernel does not take, checked at construction
+    const std::vector<std::string>& UserspaceCiphers() const;
+
+    TlsConnection NewConnection(int socket, boost::system::error_code& ec);
+
+    // One step of non-blocking handshake; at DONE ec is set if it failed or
+    // kTLS is required and could not be enabled
+    TlsStep Handshake(ssl_st* ssl, boost::system::error_code& ec);
+
+    // Starts relaying records of socket through ssl, returns the session's
+    // end of the relay
+    SocketType Relay(SocketType socket, TlsConnection ssl, boost::system::error_code& ec);
+
+    // Completes with void(ErrorCode, SocketType) on the socket's executor,
+    // the socket carries plaintext on success
+    template <class CompletionToken>
+    auto AsyncHandshake(SocketType socket, CompletionToken&& token);
+private:
+    const Configuration config_;
+    std::unique_ptr<ssl_ctx_st, SslDeleter> ctx_;
+    std::vector<std::string> userspace_ciphers_;
+    metrics::Counter& handshakes_;
+    metrics::Counter& resumed_;
+    metrics::Counter& failures_;
+    metrics::Counter& ktls_unavailable_;
+    metrics::Counter& relayed_;
+};
+
+using TlsTerminatorPtr = std::shared_ptr<TlsTerminator>;
+
+// Reads tls node of the acceptor, returns nullptr if it is missing. Throws if
+// ktls is required and the kernel does not take every configured cipher.
+TlsTerminatorPtr ConfigureTls(const YAML::Node& acceptor_node);
+
+// AsyncHandshake operation: steps the handshake whenever the socket is
+// ready, handshake_timeout cancels the wait.
+template <class Handler>
+class TlsHandshake : public std::enable_shared_from_this<TlsHandshake<Handler>> {
+public:
+    using ErrorCode = boost::system::error_code;
+    using Clock = std::chrono::steady_clock;
+    using TimerType = boost::asio::basic_waitable_timer<Clock, boost::asio::wait_traits<Clock>, ExecutorType>;
+public:
+    TlsHandshake(TlsTerminator& terminator, SocketType socket, Handler handler)
+        : terminator_(terminator)
+        , socket_(std::move(socket))
+        , timer_(socket_.get_executor())
+        , handler_(std::move(handler))
+    {}
+
+    void Start()
+    {
+        boost::asio::post(socket_.get_executor(), [self=this->shared_from_this()]() {
+            ErrorCode ec;
+            self->socket_.native_non_blocking(true, ec);
+            if (!ec) {
+                self->ssl_ = self->terminator_.NewConnection(self->socket_.native_handle(), ec);
+            }
+            if (ec) {
+                self->Complete(ec);
+                return;
+            }
+            self->timer_.expires_after(self->terminator_.Config().handshake_timeout);
+            self->timer_.async_wait([self](const ErrorCode& ec) {
+                if (!ec && !self->done_) {
+                    self->timed_out_ = true;
+                    ErrorCode ignored;
+                    self->socket_.cancel(ignored);
+                }
+            });
+            self->Step();
+        });
+    }
+private:
+    void Step()
+    {
+        ErrorCode ec;
+        switch (terminator_.Handshake(ssl_.get(), ec)) {
+            case TlsStep::WANT_READ:
+                Wait(SocketType::wait_read);
+                return;
+            case TlsStep::WANT_WRITE:
+                Wait(SocketType::wait_write);
+                return;
+            case TlsStep::DONE:
+                Complete(ec);
+                return;
+            case TlsStep::RELAY:
+                socket_ = terminator_.Relay(std::move(socket_), std::move(ssl_), ec);
+                Complete(ec);
+                return;
+        }
+    }
+
+    void Wait(SocketType::wait_type type)
+    {
+        socket_.async_wait(type, [self=this->shared_from_this()](const ErrorCode& ec) {
+            if (self->timed_out_) {
+                self->Complete(boost::asio::error::timed_out);
+            } else if (ec) {
+                self->Complete(ec);
+            } else {
+                self->Step();
+            }
+        });
+    }
+
+    void Complete(const ErrorCode& ec)
+    {
+        done_ = true;
+        timer_.cancel();
+        ssl_.reset(); // keys stay with the kernel
+        Handler handler = std::move(handler_);
+        handler(ec, std::move(socket_));
+    }
+private:
+    TlsTerminator& terminator_;
+    SocketType socket_;
+    TimerType timer_;
+    Handler handler_;
+    TlsConnection ssl_;
+    bool timed_out_ = false;
+    bool done_ = false;
+};
+
+template <class CompletionToken>
+auto TlsTerminator::AsyncHandshake(SocketType socket, CompletionToken&& token)
+{
+    auto initiation = [this](auto handler, SocketType socket) {
+        using Handshake = TlsHandshake<decltype(handler)>;
+        auto handshake = std::allocate_shared<Handshake>(RecyclingAllocator<Handshake>(), *this, std::move(socket),
+                                                         std::move(handler));
+        handshake->Start();
+    };
+    return boost::asio::async_initiate<CompletionToken, void(boost::system::error_code, SocketType)>(
+        std::move(initiation), token, std::move(socket));
+}
+
+} // namespace lb::tcp
@@ -0,0 +1,230 @@
+#include <lb/thread_pool.hpp>
+#include <lb/logging.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/thread.hpp>
+#include <yaml-cpp/yaml.h>
+
+#include <pthread.h>
+#include <sched.h>
+
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace lb {
+
+CpuList ParseCpuList(const std::string& list)
+{
+    CpuList result;
+    std::vector<std::string> ranges;
+    boost::split(ranges, list, boost::is_any_of(","), boost::token_compress_on);
+    for (std::string range : ranges) {
+        boost::trim(range);
+        if (range.empty()) {
+            continue;
+        }
+        std::size_t dash = range.find('-');
+        try {
+            if (dash == std::string::npos) {
+                result.push_back(std::stoi(range));
+                continue;
+            }
+            int first = std::stoi(range.substr(0, dash));
+            int last = std::stoi(range.substr(dash + 1));
+            if (first > last) {
+                EXCEPTION("Invalid cpu range: {}", range);
+            }
+            for (int cpu = first; cpu <= last; ++cpu) {
+                result.push_back(cpu);
+            }
+        } catch (const std::logic_error&) {
+            EXCEPTION("Invalid cpu list: {}", list);
+        }
+    }
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    return result;
+}
+
+CpuList NumaNodeCpus(int node)
+{
+    std::ifstream in(fmt::format("/sys/devices/system/node/node{}/cpulist", node));
+    std::string list;
+    if (!in || !std::getline(in, list)) {
+        return {};
+    }
+    return ParseCpuList(list);
+}
+
+ThreadPoolConfig ConfigureThreadPool(const YAML::Node& config)
+{
+    ThreadPoolConfig result;
+    std::size_t threads_num = boost::thread::hardware_concurrency();
+    DEBUG("threads_num = {}", threads_num);
+    threads_num += (threads_num == 0);
+    result.threads_number = threads_num;
+
+    if (!config["thread_pool"].IsDefined()) {
+        return result;
+    }
+
+    const YAML::Node& tp_config = config["thread_pool"];
+    if (!tp_config.IsMap()) {
+        EXCEPTION("thread_pool configuration must be a map");
+    }
+
+    if (tp_config["cpus"].IsDefined()) {
+        result.cpus = ParseCpuList(tp_config["cpus"].as<std::string>());
+        if (result.cpus.empty()) {
+            EXCEPTION("thread_pool.cpus is empty");
+        }
+    }
+
+    if (tp_config["numa_node"].IsDefined()) {
+        int node = tp_config["numa_node"].as<int>();
+        CpuList node_cpus = NumaNodeCpus(node);
+        if (node_cpus.empty()) {
+            EXCEPTION("Unknown numa node: {}", node);
+        }
+        if (result.cpus.empty()) {
+            result.cpus = std::move(node_cpus);
+        } else {
+            CpuList intersection;
+            std::set_intersection(result.cpus.begin(), result.cpus.end(),
+                                  node_cpus.begin(), node_cpus.end(),
+                                  std::back_inserter(intersection));
+            if (intersection.empty()) {
+                EXCEPTION("thread_pool.cpus do not belong to numa node {}", node);
+            }
+            result.cpus = std::move(intersection);
+        }
+        result.numa_node = node;
+    }
+
+    if (tp_config["pin_threads"].IsDefined()) {
+        result.pin_threads = tp_config["pin_threads"].as<bool>();
+        if (result.pin_threads && result.cpus.empty()) {
+            for (std::size_t cpu = 0; cpu < threads_num; ++cpu) {
+                result.cpus.push_back(cpu);
+            }
+        }
+    }
+
+    if (!result.cpus.empty()) {
+        result.threads_number = result.cpus.size();
+    }
+
+    if (tp_config["threads_number"].IsDefined()) {
+        if (tp_config["threads_number"].as<std::string>() == "auto") {
+            DEBUG("Selected automatically threads_num={}", result.threads_number);
+        } else {
+            result.threads_number = tp_config["threads_number"].as<std::size_t>();
+            DEBUG("Selected explicitly threads_num={}", result.threads_number);
+        }
+    }
+
+    if (result.threads_number == 0) {
+        EXCEPTION("thread_pool.threads_number must be positive");
+    }
+
+    if (tp_config["realtime"].IsDefined()) {
+        const YAML::Node& rt_node = tp_config["realtime"];
+        if (!rt_node.IsMap()) {
+            EXCEPTION("thread_pool.realtime must be a map");
+        }
+        static const std::unordered_map<std::string, ThreadPoolConfig::SchedulingPolicy> policies = {
+            {"fifo", ThreadPoolConfig::SchedulingPolicy::FIFO},
+            {"rr", ThreadPoolConfig::SchedulingPolicy::ROUND_ROBIN},
+        };
+        std::string policy = rt_node["policy"].IsDefined() ? rt_node["policy"].as<std::string>() : "fifo";
+        auto it = policies.find(policy);
+        if (it == policies.end()) {
+            EXCEPTION("Unknown realtime policy: {}", policy);
+        }
+        result.policy = it->second;
+
+        int native_policy = result.policy == ThreadPoolConfig::SchedulingPolicy::FIFO ? SCHED_FIFO : SCHED_RR;
+        result.priority = sched_get_priority_min(native_policy);
+        if (rt_node["priority"].IsDefined()) {
+            result.priority = rt_node["priority"].as<int>();
+        }
+        if (result.priority < sched_get_priority_min(native_policy) ||
+            result.priority > sched_get_priority_max(native_policy)) {
+            EXCEPTION("Invalid realtime priority: {}", result.priority);
+        }
+    }
+
+    return result;
+}
+
+namespace {
+
+void SetThisThreadAffinity(const CpuList& cpus)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        CPU_SET(cpu, &set);
+    }
+    if (int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set); err != 0) {
+        WARN("Unable to set thread affinity: {}", std::strerror(err));
+    }
+}
+
+void BindThisThreadMemory(int node)
+{
+#ifdef __linux__
+    constexpr std::size_t bits = sizeof(unsigned long) * 8;
+    std::vector<unsigned long> mask(node / bits + 1, 0);
+    mask[node / bits] |= 1UL << (node % bits);
+    // Thread-local policy: pages first touched by this thread are taken from node
+    if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask.data(), mask.size() * bits) != 0) {
+        WARN("Unable to set memory policy for numa node {}: {}", node, std::strerror(errno));
+    }
+#else
+    WARN("NUMA memory policy is not supported on this platform");
+#endif
+}
+
+void SetThisThreadScheduling(ThreadPoolConfig::SchedulingPolicy policy, int priority)
+{
+    struct sched_param param;
+    param.sched_priority = priority;
+    int native_policy = policy == ThreadPoolConfig::SchedulingPolicy::FIFO ? SCHED_FIFO : SCHED_RR;
+    if (int err = pthread_setschedparam(pthread_self(), native_policy, &param); err != 0) {
+        WARN("Unable to set realtime scheduling policy: {}", std::strerror(err));
+    }
+}
+
+} // anonymous namespace
+
+void SetupWorkerThread(const ThreadPoolConfig& config, std::size_t worker_index)
+{
+    if (!config.cpus.empty()) {
+        if (config.pin_threads) {
+            int cpu = config.cpus[worker_index % config.cpus.size()];
+            DEBUG("Pinning worker {} to cpu {}", worker_index, cpu);
+            SetThisThreadAffinity({cpu});
+        } else {
+            SetThisThreadAffinity(config.cpus);
+        }
+    }
+
+    if (config.numa_node) {
+        BindThisThreadMemory(*config.numa_node);
+    }
+
+    if (config.policy != ThreadPoolConfig::SchedulingPolicy::DEFAULT) {
+        SetThisThreadScheduling(config.policy, config.priority);
+    }
+}
+
+} // namespace lb
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace YAML {class Node;}
+
+namespace lb {
+
+using CpuList = std::vector<int>;
+
+// Parses kernel cpu-list format: "0-3,8,10-11"
+CpuList ParseCpuList(const std::string& list);
+
+// Cpus belonging to NUMA node, empty if node is unknown
+CpuList NumaNodeCpus(int node);
+
+struct ThreadPoolConfig {
+    enum class SchedulingPolicy {
+        DEFAULT = 0, // leave kernel's SCHED_OTHER as is
+        FIFO,
+        ROUND_ROBIN
+    };
+
+    std::size_t threads_number = 1;
+    CpuList cpus;                        // empty means no affinity
+    bool pin_threads = false;            // one worker per cpu instead of whole cpu set
+    std::optional<int> numa_node;        // allocate worker memory from this node
+    SchedulingPolicy policy = SchedulingPolicy::DEFAULT;
+    int priority = 0;
+};
+
+ThreadPoolConfig ConfigureThreadPool(const YAML::Node& config);
+
+// Applies affinity, memory policy and scheduling policy to calling worker thread.
+// Must be called before worker allocates its per-thread state.
+void SetupWorkerThread(const ThreadPoolConfig& config, std::size_t worker_index);
+
+} // namespace lb
@@ -1,86 +1,165 @@
 #include <lb/url.hpp>
 #include <lb/logging.hpp>
 
+#include <boost/thread/mutex.hpp>
+#include <limits>
+#include <type_traits>
+#include <unordered_set>
+
 namespace lb
 {
 
-    std::string DefaultProtocolPort(const std::string &protocol)
+    static_assert(std::is_trivially_copyable_v<Url>);
+
+    namespace
     {
-        static const std::unordered_map<std::string, std::string> protocol_to_default_port = {
-            {"http", "80"},
-            {"https", "443"},
-            {"ftp", "21"},
-            {"ssh", "22"},
+
+        struct ProtocolInfo
+        {
+            std::string_view name;
+            UrlProtocol type;
+            std::uint16_t default_port;
         };
 
-        if (auto it = protocol_to_default_port.find(protocol); it != protocol_to_default_port.end())
+        constexpr ProtocolInfo known_protocols[] = {
+            {"http", UrlProtocol::HTTP, 80},
+            {"https", UrlProtocol::HTTPS, 443},
+            {"ftp", UrlProtocol::FTP, 21},
+            {"ssh", UrlProtocol::SSH, 22},
+        };
+
+        const ProtocolInfo* FindProtocol(std::string_view protocol)
         {
-            return it->second;
+            for (const ProtocolInfo& info : known_protocols)
+            {
+                if (info.name == protocol)
+                {
+                    return &info;
+                }
+            }
+            return nullptr;
         }
-        STACKTRACE("Unknown protocol: {}. Specify port mannualy", protocol);
-    }
 
-    bool Url::IsUrl(const std::string &src)
+        // Returns pointer to the interned copy of string, valid until process exit
+        const char* Intern(std::string_view string)
+        {
+            static boost::mutex mutex;
+            static std::unordered_set<std::string> interned; // node based: pointers are stable
+
+            boost::mutex::scoped_lock lock(mutex);
+            return interned.emplace(string).first->data();
+        }
+
+    } // anonymous namespace
+
+    bool Url::IsUrl(std::string_view src)
     {
         auto match_results = MatchUrl(src);
         return match_results;
     }
 
-    Url::Url(const std::string &string)
-        : whole_url(string)
+    Url::Url(std::string_view string)
     {
+        if (string.size() > std::numeric_limits<std::uint16_t>::max())
+        {
+            STACKTRACE("Url is too long: {}", string);
+        }
+
         auto match_results = MatchUrl(string);
         if (!match_results)
         {
             STACKTRACE("Invalid url: {}", string);
         }
 
-        protocol = !match_results.get<2>().to_string().empty() ? match_results.get<2>().to_string() : "http";
-        hostname = match_results.get<3>().to_string();
-        port = !match_results.get<5>().to_string().empty() ? match_results.get<5>().to_string() : DefaultProtocolPort(protocol);
-        path = match_results.get<6>().to_string();
-        query = match_results.get<8>().to_string();
-        fragment = match_results.get<10>().to_string();
+        data_ = Intern(string);
+        size_ = string.size();
+
+        // Groups follow each other and cover the whole url, so offsets are running sums of sizes
+        auto span = [](std::size_t offset, std::size_t length) {
+            return Span{static_cast<std::uint16_t>(offset), static_cast<std::uint16_t>(length)};
+        };
+        const std::size_t port_size = match_results.get<4>().size(); // ":port"
+        std::size_t offset = match_results.get<1>().size();           // "protocol://"
+        protocol_ = span(0, match_results.get<2>().size());
+        hostname_ = span(offset, match_results.get<3>().size());
+        offset += hostname_.length + port_size;
+        path_ = span(offset, match_results.get<6>().size());
+        offset += path_.length;
+        query_ = span(offset + (match_results.get<7>().size() ? 1 : 0), match_results.get<8>().size());
+        offset += match_results.get<7>().size();
+        fragment_ = span(offset + (match_results.get<9>().size() ? 1 : 0), match_results.get<10>().size());
+
+        const ProtocolInfo* protocol = FindProtocol(Protocol());
+        protocol_type_ = protocol ? protocol->type : UrlProtocol::OTHER;
+
+        if (port_size > 0)
+        {
+            unsigned long port = std::stoul(std::string(match_results.get<5>().to_view()));
+            if (port == 0 || port > std::numeric_limits<std::uint16_t>::max())
+            {
+                STACKTRACE("Invalid port in url: {}", string);
+            }
+            port_ = port;
+        }
+        else if (protocol)
+        {
+            port_ = protocol->default_port;
+        }
+        else
+        {
+            STACKTRACE("Unknown protocol: {}. Specify port mannualy", Protocol());
+        }
+    }
+
+    std::string_view Url::View(Span span) const noexcept
+    {
+        return std::string_view(data_ + span.offset, span.length);
+    }
+
+    std::string_view Url::Protocol() const noexcept
+    {
+        return protocol_.length > 0 ? View(protocol_) : std::string_view("http");
     }
 
-    const std::string &Url::Protocol() const noexcept
+    UrlProtocol Url::ProtocolType() const noexcept
     {
-        return protocol;
+        return protocol_type_;
     }
 
-    const std::string &Url::Hostname() const noexcept
+    std::string_view Url::Hostname() const noexcept
     {
-        return hostname;
+        return View(hostname_);
     }
 
-    const std::string &Url::Port() const noexcept
+    std::uint16_t Url::Port() const noexcept
     {
-        return port;
+        return port_;
     }
 
-    const std::string &Url::Path() const noexcept
+    std::string_view Url::Path() const noexcept
     {
-        return path;
+        return View(path_);
     }
 
-    const std::string &Url::Query() const noexcept
+    std::string_view Url::Query() const noexcept
     {
-        return query;
+        return View(query_);
     }
 
-    const std::string &Url::Fragment() const noexcept
+    std::string_view Url::Fragment() const noexcept
     {
-        return fragment;
+        return View(fragment_);
     }
 
-    const std::string& Url::ToString() const noexcept
+    std::string_view Url::ToString() const noexcept
     {
-        return whole_url;
+        return std::string_view(data_, size_);
     }
 
     bool operator==(const Url &lhs, const Url &rhs)
     {
-        return lhs.ToString() == rhs.ToString();
+        // interned: equal urls share text
+        return lhs.ToString().data() == rhs.ToString().data();
     }
 
-} // namespace lb
\ No newline at end of file
+} // namespace lb
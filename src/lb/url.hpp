@@ -1,35 +1,58 @@
 #pragma once
 
 #include <ctre.hpp>
+#include <cstdint>
+#include <string>
 #include <string_view>
 
 namespace lb {
 
+enum class UrlProtocol : std::uint8_t {
+    OTHER=0,
+    HTTP,
+    HTTPS,
+    FTP,
+    SSH,
+};
+
+// Parsed url. Text is interned once for the process lifetime (urls come from
+// configs, so there are few of them) and components are offsets into it: Url
+// is trivially copyable and copying a Backend never allocates.
 class Url {
 private:
     // TODO: add ip as hostnames
     static constexpr auto url_pattern = ctll::fixed_string{"((\\w+):\\/\\/)?([^/\\s:]+)(:(\\d{2,5}))?([^?\\s#]*)([?]([^\\s#]*))?([#]([^\\s]*))?"};
     static constexpr auto MatchUrl = ctre::match<url_pattern>; // parsing functor
 public:
-    Url(const std::string& string);
-    const std::string& Protocol() const noexcept;
-    const std::string& Hostname() const noexcept;
-    const std::string& Port() const noexcept;
-    const std::string& Path() const noexcept;
-    const std::string& Query() const noexcept;
-    const std::string& Fragment() const noexcept;
+    Url(std::string_view string);
+    std::string_view Protocol() const noexcept;
+    UrlProtocol ProtocolType() const noexcept;
+    std::string_view Hostname() const noexcept;
+    std::uint16_t Port() const noexcept;
+    std::string_view Path() const noexcept;
+    std::string_view Query() const noexcept;
+    std::string_view Fragment() const noexcept;
 
-    static bool IsUrl(const std::string& src);
+    static bool IsUrl(std::string_view src);
+
+    std::string_view ToString() const noexcept;
+private:
+    struct Span {
+        std::uint16_t offset = 0;
+        std::uint16_t length = 0;
+    };
 
-    const std::string& ToString() const noexcept;
+    std::string_view View(Span span) const noexcept;
 private:
-    std::string whole_url;
-    std::string protocol;
-    std::string hostname;
-    std::string port;
-    std::string path;
-    std::string query;
-    std::string fragment;
+    const char* data_;
+    std::uint16_t size_;
+    Span protocol_;
+    Span hostname_;
+    Span path_;
+    Span query_;
+    Span fragment_;
+    std::uint16_t port_;
+    UrlProtocol protocol_type_;
 };
 
 bool operator==(const Url& lhs, const Url& rhs);
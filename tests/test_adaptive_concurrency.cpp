@@ -0,0 +1,118 @@
+#include <gtest/gtest.h>
+#include <lb/tcp/adaptive_concurrency.hpp>
+#include <yaml-cpp/yaml.h>
+
+#include <boost/asio.hpp>
+
+#include <chrono>
+#include <optional>
+#include <vector>
+
+using namespace std::chrono_literals;
+using lb::tcp::AdaptiveConcurrency;
+using lb::tcp::Backend;
+using EndpointType = boost::asio::ip::tcp::endpoint;
+
+namespace {
+
+const Backend kBackend(EndpointType(boost::asio::ip::make_address("127.0.0.1"), 8081));
+
+void RecordWindow(AdaptiveConcurrency& limiter, std::chrono::nanoseconds latency, bool dropped = false)
+{
+    const std::size_t in_flight = limiter.Limit(kBackend);
+    for (std::size_t i = 0; i < limiter.Config().window; ++i) {
+        limiter.Record(kBackend, latency, in_flight, dropped);
+    }
+}
+
+} // anonymous namespace
+
+TEST(AdaptiveConcurrency, limitCapsRequestsInFlight)
+{
+    AdaptiveConcurrency limiter({.initial_limit = 2}, {kBackend}, "test_caps");
+
+    std::optional<AdaptiveConcurrency::Permit> first = limiter.TryAcquire(kBackend);
+    std::optional<AdaptiveConcurrency::Permit> second = limiter.TryAcquire(kBackend);
+    ASSERT_TRUE(first && *first);
+    ASSERT_TRUE(second && *second);
+    ASSERT_FALSE(limiter.TryAcquire(kBackend));
+    ASSERT_EQ(limiter.InFlight(kBackend), 2);
+
+    first->OnResponse();
+    ASSERT_FALSE(*first);
+    ASSERT_EQ(limiter.InFlight(kBackend), 1);
+    second.reset();
+    ASSERT_EQ(limiter.InFlight(kBackend), 0);
+
+    // backends outside the pool are not limited
+    const Backend other(EndpointType(boost::asio::ip::make_address("127.0.0.1"), 9999));
+    std::optional<AdaptiveConcurrency::Permit> unlimited = limiter.TryAcquire(other);
+    ASSERT_TRUE(unlimited);
+    ASSERT_FALSE(*unlimited);
+}
+
+TEST(AdaptiveConcurrency, gradientBacksOffWhenBackendQueues)
+{
+    AdaptiveConcurrency limiter({.initial_limit = 100, .window = 10}, {kBackend}, "test_gradient");
+
+    for (int i = 0; i < 5; ++i) {
+        RecordWindow(limiter, 1ms);
+    }
+    const std::size_t grown = limiter.Limit(kBackend);
+    ASSERT_GT(grown, 100);
+
+    for (int i = 0; i < 5; ++i) {
+        RecordWindow(limiter, 10ms);
+    }
+    ASSERT_LT(limiter.Limit(kBackend), grown * 3 / 4);
+
+    // windows that use less than half of the limit don't raise it
+    const std::size_t shrunk = limiter.Limit(kBackend);
+    for (std::size_t i = 0; i < 10 * limiter.Config().window; ++i) {
+        limiter.Record(kBackend, 10ms, 1, false);
+    }
+    ASSERT_LE(limiter.Limit(kBackend), shrunk);
+}
+
+TEST(AdaptiveConcurrency, vegasFollowsQueueEstimate)
+{
+    AdaptiveConcurrency limiter({.algorithm = AdaptiveConcurrency::Algorithm::VEGAS, .initial_limit = 20, .window = 10},
+                                {kBackend}, "test_vegas");
+
+    RecordWindow(limiter, 1ms);
+    const std::size_t grown = limiter.Limit(kBackend);
+    ASSERT_GT(grown, 20);
+
+    for (int i = 0; i < 10; ++i) {
+        RecordWindow(limiter, 5ms);
+    }
+    ASSERT_LT(limiter.Limit(kBackend), grown);
+
+    // timeouts back off whatever the times are
+    const std::size_t before = limiter.Limit(kBackend);
+    RecordWindow(limiter, 1ms, true);
+    ASSERT_LT(limiter.Limit(kBackend), before);
+}
+
+TEST(AdaptiveConcurrency, configure)
+{
+    const YAML::Node endpoints = YAML::Load(R"(
+endpoints:
+  - {ip: 127.0.0.1, port: 8081}
+)");
+    ASSERT_EQ(lb::tcp::ConfigureAdaptiveConcurrency(endpoints, "test_configure"), nullptr);
+
+    YAML::Node node = YAML::Clone(endpoints);
+    node["adaptive_concurrency"] = YAML::Load("{algorithm: vegas, initial_limit: 10, min_limit: 2, max_limit: 50}");
+    lb::tcp::AdaptiveConcurrencyPtr limiter = lb::tcp::ConfigureAdaptiveConcurrency(node, "test_configure");
+    ASSERT_NE(limiter, nullptr);
+    ASSERT_EQ(limiter->Config().algorithm, AdaptiveConcurrency::Algorithm::VEGAS);
+    ASSERT_EQ(limiter->Limit(kBackend), 10);
+
+    node["adaptive_concurrency"] = YAML::Load("{algorithm: aimd}");
+    ASSERT_THROW(lb::tcp::ConfigureAdaptiveConcurrency(node, "test_configure"), std::runtime_error);
+    node["adaptive_concurrency"] = YAML::Load("{initial_limit: 10, max_limit: 5}");
+    ASSERT_THROW(lb::tcp::ConfigureAdaptiveConcurrency(node, "test_configure"), std::runtime_error);
+    node["adaptive_concurrency"] = YAML::Load("{tolerance: 0.5}");
+    ASSERT_THROW(lb::tcp::ConfigureAdaptiveConcurrency(node, "test_configure"), std::runtime_error);
+}
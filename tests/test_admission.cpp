@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+#include <lb/tcp/admission.hpp>
+#include <yaml-cpp/yaml.h>
+
+
+TEST(Admission, concurrencyLimit)
+{
+    auto limit = std::make_shared<lb::tcp::ConcurrencyLimit>(2);
+    ASSERT_TRUE(limit->TryAcquire());
+    ASSERT_TRUE(limit->TryAcquire());
+    ASSERT_FALSE(limit->TryAcquire());
+    ASSERT_FALSE(limit->HasRoom());
+    limit->Release();
+    ASSERT_TRUE(limit->HasRoom());
+    ASSERT_EQ(limit->Active(), 1);
+
+    lb::tcp::ConcurrencyLimit unlimited;
+    for (int i = 0; i < 1000; ++i) {
+        ASSERT_TRUE(unlimited.TryAcquire());
+    }
+    ASSERT_TRUE(unlimited.HasRoom());
+}
+
+TEST(Admission, ticketsReleaseSlots)
+{
+    lb::tcp::AdmissionControl admission({.max_sessions = 2});
+    auto listener = std::make_shared<lb::tcp::ConcurrencyLimit>(1);
+
+    {
+        auto first = admission.AdmitSession(listener);
+        ASSERT_TRUE(first.has_value());
+        ASSERT_FALSE(admission.AdmitSession(listener).has_value()); // listener is full
+        ASSERT_TRUE(admission.HasRoom(nullptr));
+
+        auto second = admission.AdmitSession(nullptr);
+        ASSERT_TRUE(second.has_value());
+        ASSERT_FALSE(admission.AdmitSession(nullptr).has_value()); // global limit is reached
+
+        lb::tcp::AdmissionTicket moved = std::move(*second);
+        ASSERT_FALSE(admission.HasRoom(nullptr));
+    }
+
+    ASSERT_TRUE(admission.HasRoom(listener));
+    ASSERT_EQ(listener->Active(), 0);
+}
+
+TEST(Admission, connectsCappedPerListener)
+{
+    lb::tcp::AdmissionControl admission({.max_pending_connects = 2});
+    auto listener = std::make_shared<lb::tcp::ConcurrencyLimit>(1);
+
+    {
+        auto first = admission.AdmitConnect(listener);
+        ASSERT_TRUE(first.has_value());
+        ASSERT_FALSE(admission.AdmitConnect(listener).has_value()); // listener is full
+
+        auto second = admission.AdmitConnect();
+        ASSERT_TRUE(second.has_value());
+        ASSERT_FALSE(admission.AdmitConnect().has_value()); // global limit is reached
+    }
+
+    ASSERT_EQ(listener->Active(), 0);
+    ASSERT_TRUE(admission.AdmitConnect(listener).has_value());
+}
+
+TEST(Admission, configuration)
+{
+    YAML::Node config = YAML::Load(
+R"(admission:
+  max_sessions: 100
+  max_pending_connects: 10
+  action: pause
+  pause_ms: 50
+)");
+    auto admission = lb::tcp::ConfigureAdmission(config);
+    ASSERT_EQ(admission.max_sessions, 100);
+    ASSERT_EQ(admission.max_pending_connects, 10);
+    ASSERT_EQ(admission.action, lb::tcp::AdmissionControl::Action::PAUSE);
+    ASSERT_EQ(admission.pause, std::chrono::milliseconds(50));
+
+    ASSERT_THROW(lb::tcp::ConfigureAdmission(YAML::Load("admission:\n  action: drop\n")), std::runtime_error);
+}
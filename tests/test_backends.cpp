@@ -12,7 +12,7 @@ TEST(Backends, construction) {
         lb::tcp::Backend backend("https://www.example.com");
         ASSERT_TRUE(backend.IsUrl());
         ASSERT_EQ(backend.AsUrl().Hostname(), "www.example.com");
-        ASSERT_EQ(backend.AsUrl().Port(), "443");
+        ASSERT_EQ(backend.AsUrl().Port(), 443);
         ASSERT_EQ(backend.AsUrl().Path(), "");
         ASSERT_EQ(backend.AsUrl().Query(), "");
         ASSERT_EQ(backend.AsUrl().Fragment(), "");
@@ -21,7 +21,7 @@ TEST(Backends, construction) {
         lb::tcp::Backend backend("https://www.example.com/blog/article/search?docid=720&hl=en#dayone");
         ASSERT_TRUE(backend.IsUrl());
         ASSERT_EQ(backend.AsUrl().Hostname(), "www.example.com");
-        ASSERT_EQ(backend.AsUrl().Port(), "443");
+        ASSERT_EQ(backend.AsUrl().Port(), 443);
         ASSERT_EQ(backend.AsUrl().Path(), "/blog/article/search");
         ASSERT_EQ(backend.AsUrl().Query(), "docid=720&hl=en");
         ASSERT_EQ(backend.AsUrl().Fragment(), "dayone");
@@ -31,7 +31,7 @@ TEST(Backends, construction) {
         lb::tcp::Backend backend("https://www.example.com/blog/article/search?docid=720&hl=en");
         ASSERT_TRUE(backend.IsUrl());
         ASSERT_EQ(backend.AsUrl().Hostname(), "www.example.com");
-        ASSERT_EQ(backend.AsUrl().Port(), "443");
+        ASSERT_EQ(backend.AsUrl().Port(), 443);
         ASSERT_EQ(backend.AsUrl().Path(), "/blog/article/search");
         ASSERT_EQ(backend.AsUrl().Query(), "docid=720&hl=en");
         ASSERT_EQ(backend.AsUrl().Fragment(), "");
@@ -40,7 +40,7 @@ TEST(Backends, construction) {
         lb::tcp::Backend backend("https://www.example.com/blog/article/search?docid=720&hl=en#dayone");
         ASSERT_TRUE(backend.IsUrl());
         ASSERT_EQ(backend.AsUrl().Hostname(), "www.example.com");
-        ASSERT_EQ(backend.AsUrl().Port(), "443");
+        ASSERT_EQ(backend.AsUrl().Port(), 443);
         ASSERT_EQ(backend.AsUrl().Path(), "/blog/article/search");
         ASSERT_EQ(backend.AsUrl().Query(), "docid=720&hl=en");
         ASSERT_EQ(backend.AsUrl().Fragment(), "dayone");
@@ -0,0 +1,90 @@
+#include <lb/tcp/buffer_pool.hpp>
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+using lb::tcp::BufferPool;
+
+TEST(BufferPoolTests, roundUp)
+{
+    ASSERT_EQ(BufferPool::RoundUp(1), 4096);
+    ASSERT_EQ(BufferPool::RoundUp(4096), 4096);
+    ASSERT_EQ(BufferPool::RoundUp(4097), 16384);
+    ASSERT_EQ(BufferPool::RoundUp(65536), 65536);
+    ASSERT_EQ(BufferPool::RoundUp(65537), 65537);
+}
+
+TEST(BufferPoolTests, slabsAreReusedAndCounted)
+{
+    BufferPool& pool = BufferPool::Instance();
+    const BufferPool::Stats before = pool.GetStats();
+
+    void* slab = pool.Allocate(10000);
+    ASSERT_EQ(reinterpret_cast<std::uintptr_t>(slab) % 16384, 0);
+    BufferPool::Stats stats = pool.GetStats();
+    ASSERT_EQ(stats.classes[1].slab_size, 16384);
+    ASSERT_EQ(stats.classes[1].in_use, before.classes[1].in_use + 1);
+    ASSERT_GE(stats.classes[1].slabs, stats.classes[1].in_use);
+    ASSERT_GE(stats.mapped_bytes, BufferPool::kRegionSize);
+
+    pool.Deallocate(slab, 10000);
+    ASSERT_EQ(pool.GetStats().classes[1].in_use, before.classes[1].in_use);
+    void* again = pool.Allocate(16384);
+    ASSERT_EQ(again, slab);
+    pool.Deallocate(again, 16384);
+}
+
+TEST(BufferPoolTests, manySlabs)
+{
+    BufferPool& pool = BufferPool::Instance();
+    const std::size_t count = 2 * BufferPool::kRegionSize / 4096 + 1;
+    std::vector<char*> slabs;
+    for (std::size_t i = 0; i < count; ++i) {
+        slabs.push_back(static_cast<char*>(pool.Allocate(4096)));
+        slabs.back()[0] = 1;
+        slabs.back()[4095] = 1;
+    }
+    ASSERT_GE(pool.GetStats().classes[0].slabs, count);
+    for (char* slab : slabs) {
+        pool.Deallocate(slab, 4096);
+    }
+}
+
+TEST(BufferPoolTests, largeAllocationsComeFromHeap)
+{
+    BufferPool& pool = BufferPool::Instance();
+    const std::size_t before = pool.GetStats().heap_bytes;
+    void* buffer = pool.Allocate(BufferPool::kMaxBufferCapacity + 1);
+    ASSERT_EQ(pool.GetStats().heap_bytes, before + BufferPool::kMaxBufferCapacity + 1);
+    pool.Deallocate(buffer, BufferPool::kMaxBufferCapacity + 1);
+    ASSERT_EQ(pool.GetStats().heap_bytes, before);
+}
+
+TEST(BufferPoolTests, prepareReadGrowsBySlabs)
+{
+    lb::tcp::IoBuffer buffer;
+    std::vector<std::size_t> capacities;
+    while (buffer.size() < 100 * 1024) {
+        auto space = lb::tcp::PrepareRead(buffer, 64 * 1024);
+        buffer.commit(space.size());
+        if (capacities.empty() || capacities.back() != buffer.capacity()) {
+            capacities.push_back(buffer.capacity());
+        }
+    }
+    ASSERT_EQ(capacities, (std::vector<std::size_t>{4096, 16384, 65536, 131072}));
+}
+
+TEST(BufferPoolTests, releaseBuffer)
+{
+    lb::tcp::IoBuffer buffer;
+    buffer.commit(boost::asio::buffer_copy(lb::tcp::PrepareRead(buffer, 5), boost::asio::buffer("hello", 5)));
+
+    lb::tcp::ReleaseBuffer(buffer);
+    ASSERT_EQ(buffer.size(), 5);
+    ASSERT_EQ(buffer.capacity(), 4096);
+
+    buffer.consume(5);
+    lb::tcp::ReleaseBuffer(buffer);
+    ASSERT_EQ(buffer.capacity(), 0);
+}
@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+#include <lb/tcp/collapsed_forwarding.hpp>
+#include <yaml-cpp/yaml.h>
+
+#include <boost/asio.hpp>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+using namespace std::chrono_literals;
+using lb::tcp::CachedResponsePtr;
+using lb::tcp::CollapsedForwarding;
+using lb::tcp::CollapseLead;
+
+TEST(CollapsedForwarding, followersGetResponseOfLeader)
+{
+    boost::asio::io_context ioc;
+    CollapsedForwarding forwarding({}, "test_followers");
+
+    CollapseLead lead = forwarding.Lead("example.com /a");
+    ASSERT_TRUE(lead);
+    ASSERT_FALSE(forwarding.Lead("example.com /a"));
+    ASSERT_TRUE(forwarding.Lead("example.com /b")); // completed at once with nobody waiting
+
+    std::vector<CachedResponsePtr> delivered;
+    for (int i = 0; i < 3; ++i) {
+        forwarding.AsyncFollow("example.com /a", boost::asio::make_strand(ioc),
+                               [&](const boost::system::error_code& ec, CachedResponsePtr response) {
+                                   ASSERT_FALSE(ec);
+                                   delivered.push_back(std::move(response));
+                               });
+    }
+    ioc.poll();
+    ASSERT_TRUE(delivered.empty());
+
+    auto response = std::make_shared<lb::tcp::CachedResponse>();
+    response->raw = "HTTP/1.1 204 No Content\r\n\r\n";
+    lead.Complete(response);
+    ASSERT_FALSE(lead);
+    ioc.poll();
+    ASSERT_EQ(delivered, std::vector<CachedResponsePtr>(3, response));
+
+    // key is free again, a late follower goes upstream
+    ioc.restart();
+    std::vector<CachedResponsePtr> late;
+    forwarding.AsyncFollow("example.com /a", boost::asio::make_strand(ioc),
+                           [&](const boost::system::error_code& ec, CachedResponsePtr response) {
+                               late.push_back(std::move(response));
+                           });
+    ioc.poll();
+    ASSERT_EQ(late, std::vector<CachedResponsePtr>{nullptr});
+    ASSERT_TRUE(forwarding.Lead("example.com /a"));
+}
+
+TEST(CollapsedForwarding, followersGoUpstreamWithoutResponse)
+{
+    boost::asio::io_context ioc;
+    CollapsedForwarding forwarding({.max_wait = 10ms}, "test_upstream");
+
+    std::vector<boost::system::error_code> errors;
+    std::vector<CachedResponsePtr> delivered;
+    auto handler = [&](const boost::system::error_code& ec, CachedResponsePtr response) {
+        errors.push_back(ec);
+        delivered.push_back(std::move(response));
+    };
+
+    {
+        CollapseLead lead = forwarding.Lead("example.com /failed");
+        forwarding.AsyncFollow("example.com /failed", boost::asio::make_strand(ioc), handler);
+    }
+    ioc.poll();
+    ASSERT_EQ(errors, std::vector<boost::system::error_code>{{}});
+    ASSERT_EQ(delivered, std::vector<CachedResponsePtr>{nullptr});
+
+    // leader slower than max_wait
+    CollapseLead slow = forwarding.Lead("example.com /slow");
+    forwarding.AsyncFollow("example.com /slow", boost::asio::make_strand(ioc), handler);
+    ioc.restart();
+    ioc.run();
+    ASSERT_EQ(errors.size(), 2);
+    ASSERT_EQ(errors[1], boost::asio::error::timed_out);
+    ASSERT_EQ(delivered[1], nullptr);
+}
+
+TEST(CollapsedForwarding, configure)
+{
+    const YAML::Node endpoints = YAML::Load("endpoints: [{ip: 127.0.0.1, port: 8081}]");
+    ASSERT_EQ(lb::tcp::ConfigureCollapsedForwarding(endpoints, "test_configure"), nullptr);
+
+    YAML::Node node = YAML::Clone(endpoints);
+    node["collapsed_forwarding"] = YAML::Load("{max_wait_ms: 250}");
+    lb::tcp::CollapsedForwardingPtr forwarding = lb::tcp::ConfigureCollapsedForwarding(node, "test_configure");
+    ASSERT_NE(forwarding, nullptr);
+    ASSERT_EQ(forwarding->Config().max_wait, 250ms);
+
+    node["collapsed_forwarding"] = YAML::Load("{max_wait_ms: 0}");
+    ASSERT_THROW(lb::tcp::ConfigureCollapsedForwarding(node, "test_configure"), std::runtime_error);
+}
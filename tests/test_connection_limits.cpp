@@ -0,0 +1,185 @@
+#include <gtest/gtest.h>
+#include <lb/tcp/connection_limits.hpp>
+#include <lb/tcp/connector.hpp>
+#include <yaml-cpp/yaml.h>
+
+#include <boost/asio.hpp>
+
+#include <chrono>
+#include <optional>
+#include <vector>
+
+using namespace std::chrono_literals;
+using lb::tcp::Backend;
+using lb::tcp::BackendSlot;
+using lb::tcp::ConnectionLimits;
+using EndpointType = boost::asio::ip::tcp::endpoint;
+
+namespace {
+
+std::vector<Backend> TwoBackends()
+{
+    return {
+        Backend(EndpointType(boost::asio::ip::make_address("127.0.0.1"), 8081)),
+        Backend(EndpointType(boost::asio::ip::make_address("127.0.0.1"), 8082)),
+    };
+}
+
+} // anonymous namespace
+
+TEST(ConnectionLimits, slotsAreTakenOnTheGivenBackend)
+{
+    const std::vector<Backend> backends = TwoBackends();
+    ConnectionLimits limits({.max_connections = 1}, backends, "test_cap");
+
+    std::optional<BackendSlot> first = limits.TryAcquire(backends[0]);
+    ASSERT_TRUE(first);
+    ASSERT_TRUE(first->GetBackend() == backends[0]);
+    ASSERT_FALSE(limits.TryAcquire(backends[0]));
+    ASSERT_FALSE(limits.TryAcquire(Backend(EndpointType(boost::asio::ip::make_address("127.0.0.1"), 9000))));
+    ASSERT_EQ(limits.Active(backends[0]), 1);
+    ASSERT_EQ(limits.Active(backends[1]), 0);
+
+    first.reset();
+    ASSERT_EQ(limits.Active(backends[0]), 0);
+    std::optional<BackendSlot> exact = limits.TryAcquire(backends[0]);
+    ASSERT_TRUE(exact);
+
+    BackendSlot moved = std::move(*exact);
+    ASSERT_FALSE(*exact);
+    moved.Release();
+    ASSERT_EQ(limits.Active(backends[0]), 0);
+}
+
+TEST(ConnectionLimits, excludedBackendIsNeverGranted)
+{
+    YAML::Node config = YAML::Load(R"(
+load_balancing:
+  algorithm: round_robin
+  endpoints:
+    - {ip: 127.0.0.1, port: 8081}
+    - {ip: 127.0.0.1, port: 8082}
+    - {ip: 127.0.0.1, port: 8083}
+)");
+    boost::asio::io_context ioc;
+    lb::tcp::Connector connector(ioc, lb::tcp::ConfigureRouter(config), nullptr, nullptr,
+                                 lb::tcp::SessionEngine::CALLBACKS, {}, {});
+    lb::tcp::Pool pool{.name = "test", .selector = lb::tcp::MakeSelector(config["load_balancing"])};
+    std::vector<Backend> backends;
+    for (int port = 8081; port <= 8083; ++port) {
+        backends.emplace_back(EndpointType(boost::asio::ip::make_address("127.0.0.1"), port));
+    }
+    pool.limits = std::make_shared<ConnectionLimits>(ConnectionLimits::Configuration{.max_connections = 1}, backends,
+                                                     "test_excluded");
+    pool.selector->ExcludeBackend(backends[2]);
+    const EndpointType client(boost::asio::ip::make_address("10.0.0.1"), 40000);
+
+    std::optional<lb::tcp::Connector::Connection> first =
+        connector.TakeSlot(pool, {.backend = backends[0]}, {}, client);
+    ASSERT_TRUE(first);
+    ASSERT_TRUE(first->backend == backends[0]);
+    std::optional<lb::tcp::Connector::Connection> second =
+        connector.TakeSlot(pool, {.backend = backends[0]}, {}, client);
+    ASSERT_TRUE(second);
+    ASSERT_TRUE(second->backend == backends[1]);
+    ASSERT_TRUE(second->slot.GetBackend() == backends[1]);
+
+    // the excluded backend has free slots, the session has to wait
+    ASSERT_FALSE(connector.TakeSlot(pool, {.backend = backends[0]}, {}, client));
+    ASSERT_EQ(pool.limits->Active(backends[2]), 0);
+
+    // hash selectors keep the client on its backend
+    config["load_balancing"]["algorithm"] = "ip_hash";
+    pool.selector = lb::tcp::MakeSelector(config["load_balancing"]);
+    second.reset();
+    ASSERT_FALSE(connector.TakeSlot(pool, {.backend = backends[0]}, {}, client));
+}
+
+TEST(ConnectionLimits, releasedSlotGoesToOldestWaiter)
+{
+    boost::asio::io_context ioc;
+    const std::vector<Backend> backends = TwoBackends();
+    ConnectionLimits limits({.max_connections = 1, .queue_timeout = 10s}, backends, "test_queue");
+    std::optional<BackendSlot> first = limits.TryAcquire(backends[0]);
+    std::optional<BackendSlot> second = limits.TryAcquire(backends[1]);
+
+    std::vector<int> granted;
+    std::vector<BackendSlot> slots;
+    for (int waiter = 0; waiter < 3; ++waiter) {
+        // waiters 0 and 2 wait for the first backend, 1 for the second
+        limits.AsyncWait(backends[waiter % 2], boost::asio::make_strand(ioc),
+                         [&, waiter](const boost::system::error_code& ec, BackendSlot slot) {
+                             ASSERT_FALSE(ec);
+                             granted.push_back(waiter);
+                             slots.push_back(std::move(slot));
+                         });
+    }
+    ioc.poll();
+    ASSERT_TRUE(granted.empty());
+
+    first.reset();
+    ioc.poll();
+    ASSERT_EQ(granted, std::vector<int>{0});
+    ASSERT_TRUE(slots[0].GetBackend() == backends[0]);
+
+    // slot of a backend goes to its waiter only
+    slots[0].Release();
+    ioc.poll();
+    ASSERT_EQ(granted, (std::vector<int>{0, 2}));
+    ASSERT_TRUE(slots[1].GetBackend() == backends[0]);
+
+    second.reset();
+    ioc.poll();
+    ASSERT_EQ(granted, (std::vector<int>{0, 2, 1}));
+    ASSERT_TRUE(slots[2].GetBackend() == backends[1]);
+}
+
+TEST(ConnectionLimits, waitTimesOutOrIsRejected)
+{
+    boost::asio::io_context ioc;
+    const std::vector<Backend> backends = TwoBackends();
+    ConnectionLimits limits({.max_connections = 1, .max_pending = 1, .queue_timeout = 10ms}, backends, "test_timeout");
+    std::optional<BackendSlot> first = limits.TryAcquire(backends[0]);
+
+    std::vector<boost::system::error_code> errors;
+    auto handler = [&](const boost::system::error_code& ec, BackendSlot slot) {
+        ASSERT_FALSE(slot);
+        errors.push_back(ec);
+    };
+    limits.AsyncWait(backends[0], boost::asio::make_strand(ioc), handler);
+    limits.AsyncWait(backends[0], boost::asio::make_strand(ioc), handler); // queue of this thread is full
+    limits.AsyncWait(Backend(EndpointType(boost::asio::ip::make_address("127.0.0.1"), 9000)),
+                     boost::asio::make_strand(ioc), handler);
+    ioc.run();
+
+    ASSERT_EQ(errors.size(), 3);
+    ASSERT_EQ(errors[0], boost::asio::error::no_buffer_space);
+    ASSERT_EQ(errors[1], boost::asio::error::invalid_argument);
+    ASSERT_EQ(errors[2], boost::asio::error::timed_out);
+
+    // timed out waiter does not take the released slot
+    first.reset();
+    ASSERT_TRUE(limits.TryAcquire(backends[0]));
+}
+
+TEST(ConnectionLimits, configure)
+{
+    const YAML::Node endpoints = YAML::Load(R"(
+endpoints:
+  - {ip: 127.0.0.1, port: 8081}
+)");
+    ASSERT_EQ(lb::tcp::ConfigureConnectionLimits(endpoints, "test_configure"), nullptr);
+
+    YAML::Node node = YAML::Clone(endpoints);
+    node["connection_limits"] = YAML::Load("{max_connections: 2, max_pending: 5, queue_timeout_ms: 20}");
+    lb::tcp::ConnectionLimitsPtr limits = lb::tcp::ConfigureConnectionLimits(node, "test_configure");
+    ASSERT_NE(limits, nullptr);
+    ASSERT_EQ(limits->Config().max_connections, 2);
+    ASSERT_EQ(limits->Config().max_pending, 5);
+    ASSERT_EQ(limits->Config().queue_timeout, 20ms);
+
+    node["connection_limits"] = YAML::Load("{max_pending: 5}");
+    ASSERT_THROW(lb::tcp::ConfigureConnectionLimits(node, "test_configure"), std::runtime_error);
+    node["connection_limits"] = YAML::Load("{max_connections: 0}");
+    ASSERT_THROW(lb::tcp::ConfigureConnectionLimits(node, "test_configure"), std::runtime_error);
+}
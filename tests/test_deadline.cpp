@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+#include <lb/tcp/deadline.hpp>
+#include <yaml-cpp/yaml.h>
+
+#include <chrono>
+#include <string>
+
+using namespace std::chrono_literals;
+using lb::tcp::RequestDeadline;
+
+namespace {
+
+std::string Join(const lb::tcp::Segments& segments)
+{
+    std::string result;
+    for (const auto& segment : segments) {
+        result.append(static_cast<const char*>(segment.data()), segment.size());
+    }
+    return result;
+}
+
+} // anonymous namespace
+
+TEST(Deadline, clientDeadlineIsCappedAndForwarded)
+{
+    const std::string raw = "GET / HTTP/1.1\r\n"
+                            "Host: example.com\r\n"
+                            "x-request-timeout-ms: 5000\r\n"
+                            "Accept: */*\r\n"
+                            "\r\n";
+    lb::tcp::MessageHead head;
+    lb::tcp::RawRequestParser parser(head);
+    boost::system::error_code ec;
+    ASSERT_TRUE(parser.Parse(boost::asio::buffer(raw), ec));
+    const lb::tcp::MessageView request(head, raw);
+    const lb::tcp::DeadlinePolicy policy;
+    const RequestDeadline::Clock::time_point now = RequestDeadline::Clock::now();
+
+    RequestDeadline deadline;
+    deadline.Reset(policy, request, now, 0ms);
+    ASSERT_TRUE(deadline);
+    ASSERT_FALSE(deadline.Expired());
+    ASSERT_GT(*deadline.Left(), 4000ms);
+
+    // budget of the pool is shorter
+    deadline.Reset(policy, request, now, 100ms);
+    ASSERT_LE(*deadline.Left(), 100ms);
+
+    lb::tcp::Segments segments;
+    lb::tcp::SpliceMessage(request, nullptr, deadline.UpstreamLine(), segments, deadline.Replaced(head));
+    const std::string forwarded = Join(segments);
+    ASSERT_EQ(forwarded.find("x-request-timeout-ms"), std::string::npos);
+    ASSERT_EQ(forwarded.rfind("GET / HTTP/1.1\r\nHost: example.com\r\nAccept: */*\r\nX-Request-Timeout-Ms: ", 0), 0);
+
+    deadline.Reset(policy, request, now - 6s, 0ms);
+    ASSERT_TRUE(deadline.Expired());
+    ASSERT_EQ(*deadline.Left(), 0ms);
+}
+
+TEST(Deadline, requestsWithoutDeadline)
+{
+    const std::string raw = "GET / HTTP/1.1\r\nX-Request-Timeout-Ms: soon\r\n\r\n";
+    lb::tcp::MessageHead head;
+    lb::tcp::RawRequestParser parser(head);
+    boost::system::error_code ec;
+    ASSERT_TRUE(parser.Parse(boost::asio::buffer(raw), ec));
+    const lb::tcp::MessageView request(head, raw);
+
+    // malformed values are ignored and forwarded as is
+    RequestDeadline deadline;
+    deadline.Reset(lb::tcp::DeadlinePolicy{}, request, RequestDeadline::Clock::now(), 0ms);
+    ASSERT_FALSE(deadline);
+    ASSERT_FALSE(deadline.Expired());
+    ASSERT_FALSE(deadline.Left());
+    ASSERT_TRUE(deadline.UpstreamLine().empty());
+    ASSERT_EQ(deadline.Replaced(head), nullptr);
+
+    // without a header only budgets apply
+    deadline.Reset(lb::tcp::DeadlinePolicy{.header = ""}, request, RequestDeadline::Clock::now(), 50ms);
+    ASSERT_TRUE(deadline);
+    ASSERT_TRUE(deadline.UpstreamLine().empty());
+}
+
+TEST(Deadline, hugeClientTimeoutIsBounded)
+{
+    const std::string raw = "GET / HTTP/1.1\r\nX-Request-Timeout-Ms: 18446744073709551615\r\n\r\n";
+    lb::tcp::MessageHead head;
+    lb::tcp::RawRequestParser parser(head);
+    boost::system::error_code ec;
+    ASSERT_TRUE(parser.Parse(boost::asio::buffer(raw), ec));
+    const lb::tcp::MessageView request(head, raw);
+
+    RequestDeadline deadline;
+    deadline.Reset(lb::tcp::DeadlinePolicy{}, request, RequestDeadline::Clock::now(), 0ms);
+    ASSERT_TRUE(deadline);
+    ASSERT_FALSE(deadline.Expired());
+    ASSERT_LE(*deadline.Left(), RequestDeadline::kMaxClientTimeout);
+    ASSERT_GT(*deadline.Left(), RequestDeadline::kMaxClientTimeout - 1s);
+}
+
+TEST(Deadline, configure)
+{
+    lb::tcp::DeadlinePolicy policy = lb::tcp::ConfigureDeadlines(YAML::Load("acceptor: {port: 1}"));
+    ASSERT_EQ(policy.header, "X-Request-Timeout-Ms");
+    ASSERT_TRUE(policy.cancel_abandoned);
+
+    policy = lb::tcp::ConfigureDeadlines(YAML::Load("deadlines: {header: X-Deadline, cancel_abandoned: false}"));
+    ASSERT_EQ(policy.header, "X-Deadline");
+    ASSERT_FALSE(policy.cancel_abandoned);
+
+    ASSERT_THROW(lb::tcp::ConfigureDeadlines(YAML::Load("deadlines: 5")), std::runtime_error);
+}
@@ -0,0 +1,143 @@
+#include <gtest/gtest.h>
+#include <lb/tcp/happy_eyeballs.hpp>
+
+#include <boost/asio.hpp>
+
+#include <chrono>
+#include <vector>
+
+using boost::asio::ip::make_address;
+using EndpointType = boost::asio::ip::tcp::endpoint;
+
+namespace {
+
+// Listener that never accepts, with a full backlog: connects to it hang.
+// Backlog is filled from a context that is never run.
+struct DeadListener {
+    explicit DeadListener(boost::asio::io_context& ioc)
+        : acceptor(ioc, EndpointType(make_address("127.0.0.1"), 0), false)
+    {
+        acceptor.listen(0);
+        for (int i = 0; i < 3; ++i) {
+            fillers.emplace_back(filler_context).async_connect(acceptor.local_endpoint(), [](auto) {});
+        }
+    }
+
+    boost::asio::ip::tcp::acceptor acceptor;
+    boost::asio::io_context filler_context;
+    std::vector<boost::asio::ip::tcp::socket> fillers;
+};
+
+EndpointType ClosedPort(boost::asio::io_context& ioc)
+{
+    boost::asio::ip::tcp::acceptor acceptor(ioc, EndpointType(make_address("127.0.0.1"), 0));
+    return acceptor.local_endpoint();
+}
+
+} // namespace
+
+TEST(HappyEyeballs, familiesAlternate)
+{
+    const EndpointType v6a(make_address("2001:db8::1"), 80);
+    const EndpointType v6b(make_address("2001:db8::2"), 80);
+    const EndpointType v4a(make_address("192.0.2.1"), 80);
+    const EndpointType v4b(make_address("192.0.2.2"), 80);
+
+    std::vector<EndpointType> candidates = {v6a, v6b, v4a, v4b};
+    lb::tcp::SortCandidates(candidates, std::nullopt);
+    ASSERT_EQ(candidates, (std::vector<EndpointType>{v6a, v4a, v6b, v4b}));
+
+    candidates = {v6a, v6b, v4a, v4b};
+    lb::tcp::SortCandidates(candidates, v4b);
+    ASSERT_EQ(candidates, (std::vector<EndpointType>{v4b, v6a, v4a, v6b}));
+
+    // preferred endpoint is not among resolved ones
+    candidates = {v4a, v4b};
+    lb::tcp::SortCandidates(candidates, v6a);
+    ASSERT_EQ(candidates, (std::vector<EndpointType>{v4a, v4b}));
+}
+
+TEST(HappyEyeballs, deadAddressDoesNotBlock)
+{
+    boost::asio::io_context ioc;
+    DeadListener dead(ioc);
+    boost::asio::ip::tcp::acceptor live(ioc, EndpointType(make_address("127.0.0.1"), 0));
+    lb::tcp::PreferredEndpoints preferred;
+
+    auto race = [&](std::vector<EndpointType> candidates) {
+        lb::tcp::SocketType socket(boost::asio::make_strand(ioc));
+        boost::system::error_code result = boost::asio::error::would_block;
+        const auto start = std::chrono::steady_clock::now();
+        boost::asio::post(socket.get_executor(), [&]() {
+            lb::tcp::RaceConnect(socket, std::move(candidates), [&](const boost::system::error_code& ec) {
+                result = ec;
+            }, &preferred, "backend");
+        });
+        ioc.restart();
+        ioc.run();
+        EXPECT_FALSE(result);
+        EXPECT_EQ(socket.remote_endpoint(), live.local_endpoint());
+        return std::chrono::steady_clock::now() - start;
+    };
+
+    auto elapsed = race({dead.acceptor.local_endpoint(), live.local_endpoint()});
+    ASSERT_GE(elapsed, lb::tcp::ConnectRace<void(*)(const boost::system::error_code&)>::kAttemptDelay);
+    ASSERT_LT(elapsed, std::chrono::seconds(2));
+    ASSERT_EQ(preferred.Get("backend"), live.local_endpoint());
+
+    // winner goes first next time
+    elapsed = race({dead.acceptor.local_endpoint(), live.local_endpoint()});
+    ASSERT_LT(elapsed, lb::tcp::ConnectRace<void(*)(const boost::system::error_code&)>::kAttemptDelay);
+}
+
+TEST(HappyEyeballs, allAttemptsFail)
+{
+    boost::asio::io_context ioc;
+    std::vector<EndpointType> candidates = {ClosedPort(ioc), ClosedPort(ioc), ClosedPort(ioc)};
+    lb::tcp::SocketType socket(boost::asio::make_strand(ioc));
+    boost::system::error_code result;
+    bool called = false;
+    boost::asio::post(socket.get_executor(), [&]() {
+        lb::tcp::RaceConnect(socket, candidates, [&](const boost::system::error_code& ec) {
+            ASSERT_FALSE(called);
+            called = true;
+            result = ec;
+        });
+    });
+    ioc.run();
+    ASSERT_TRUE(called);
+    ASSERT_EQ(result, boost::asio::error::connection_refused);
+}
+
+TEST(HappyEyeballs, cancellationAbortsRace)
+{
+    boost::asio::io_context ioc;
+    DeadListener first(ioc);
+    DeadListener second(ioc);
+    lb::tcp::SocketType socket(boost::asio::make_strand(ioc));
+    lb::tcp::ConnectCancellation cancellation;
+    boost::system::error_code result;
+    bool called = false;
+    boost::asio::post(socket.get_executor(), [&]() {
+        lb::tcp::RaceConnect(socket, {first.acceptor.local_endpoint(), second.acceptor.local_endpoint()},
+                             [&](const boost::system::error_code& ec) {
+                                 ASSERT_FALSE(called);
+                                 called = true;
+                                 result = ec;
+                             }, nullptr, {}, &cancellation);
+    });
+
+    // both attempts hang, the second one on a socket of its own
+    boost::asio::basic_waitable_timer<std::chrono::steady_clock,
+                                      boost::asio::wait_traits<std::chrono::steady_clock>,
+                                      lb::tcp::ExecutorType> timer(socket.get_executor());
+    timer.expires_after(2 * lb::tcp::ConnectRace<void(*)(const boost::system::error_code&)>::kAttemptDelay);
+    timer.async_wait([&](const boost::system::error_code&) {
+        cancellation.Cancel();
+    });
+    const auto start = std::chrono::steady_clock::now();
+    ioc.run();
+    ASSERT_TRUE(called);
+    ASSERT_EQ(result, boost::asio::error::operation_aborted);
+    ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(2));
+}
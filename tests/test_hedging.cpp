@@ -0,0 +1,215 @@
+#include <gtest/gtest.h>
+#include <lb/tcp/connector.hpp>
+#include <lb/tcp/hedging.hpp>
+#include <yaml-cpp/yaml.h>
+
+#include <boost/asio.hpp>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+using namespace std::chrono_literals;
+using lb::tcp::Hedging;
+using EndpointType = boost::asio::ip::tcp::endpoint;
+
+TEST(Hedging, delayFollowsPercentile)
+{
+    Hedging hedging({.percentile = 90, .min_delay = 1ms, .max_delay = 1000ms});
+    ASSERT_EQ(hedging.Delay(), 1000ms);
+
+    for (std::uint64_t i = 0; i < Hedging::kRecomputeInterval; ++i) {
+        hedging.Record(2ms);
+    }
+    ASSERT_GE(hedging.Delay(), 2ms);
+    ASSERT_LT(hedging.Delay(), 3ms);
+
+    // older samples decay
+    for (std::uint64_t i = 0; i < Hedging::kRecomputeInterval; ++i) {
+        hedging.Record(50ms);
+    }
+    ASSERT_GE(hedging.Delay(), 50ms);
+    ASSERT_LT(hedging.Delay(), 60ms);
+
+    for (std::uint64_t i = 0; i < Hedging::kRecomputeInterval; ++i) {
+        hedging.Record(10s);
+    }
+    ASSERT_EQ(hedging.Delay(), 1000ms);
+}
+
+TEST(Hedging, configure)
+{
+    ASSERT_EQ(lb::tcp::ConfigureHedging(YAML::Load("algorithm: round_robin")), nullptr);
+
+    lb::tcp::HedgingPtr hedging = lb::tcp::ConfigureHedging(YAML::Load(R"(
+hedging:
+  percentile: 99
+  min_delay_ms: 2
+  max_delay_ms: 20
+  budget_percent: 0
+  min_hedges_per_second: 0
+)"));
+    ASSERT_NE(hedging, nullptr);
+    ASSERT_EQ(hedging->Delay(), 20ms);
+    hedging->Deposit();
+    ASSERT_FALSE(hedging->TryWithdraw());
+
+    ASSERT_THROW(lb::tcp::ConfigureHedging(YAML::Load("hedging: {percentile: 100}")), std::runtime_error);
+    ASSERT_THROW(lb::tcp::ConfigureHedging(YAML::Load("hedging: {min_delay_ms: 5, max_delay_ms: 1}")),
+                 std::runtime_error);
+}
+
+TEST(Hedging, slowBackendIsHedged)
+{
+    boost::asio::io_context ioc;
+    // accepts and never responds
+    boost::asio::ip::tcp::acceptor slow(ioc, EndpointType(boost::asio::ip::make_address("127.0.0.1"), 0));
+    boost::asio::ip::tcp::acceptor fast(ioc, EndpointType(boost::asio::ip::make_address("127.0.0.1"), 0));
+
+    YAML::Node config = YAML::Load(
+        "load_balancing:\n"
+        "  algorithm: round_robin\n"
+        "  hedging: {min_delay_ms: 20, max_delay_ms: 20}\n"
+        "  endpoints:\n"
+        "    - {ip: 127.0.0.1, port: " + std::to_string(slow.local_endpoint().port()) + "}\n"
+        "    - {ip: 127.0.0.1, port: " + std::to_string(fast.local_endpoint().port()) + "}\n");
+    lb::tcp::RouterPtr router = lb::tcp::ConfigureRouter(config);
+    lb::tcp::Pool* pool = router->Select("localhost", "/");
+    ASSERT_NE(pool, nullptr);
+    lb::tcp::Connector connector(ioc, router);
+
+    const std::string request = "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    const std::string response = "HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n";
+    boost::asio::ip::tcp::socket fast_peer(ioc);
+    char peer_buffer[256];
+    fast.async_accept(fast_peer, [&](const boost::system::error_code& ec) {
+        ASSERT_FALSE(ec);
+        fast_peer.async_read_some(boost::asio::buffer(peer_buffer), [&](const boost::system::error_code& ec,
+                                                                        std::size_t length) {
+            ASSERT_FALSE(ec);
+            ASSERT_EQ(std::string(peer_buffer, length), request);
+            boost::asio::write(fast_peer, boost::asio::buffer(response));
+        });
+    });
+
+    lb::tcp::SocketType socket(boost::asio::make_strand(ioc));
+    socket.connect(slow.local_endpoint());
+    boost::asio::write(socket, boost::asio::buffer(request));
+
+    lb::tcp::IoBuffer buffer;
+    lb::tcp::Segments segments{boost::asio::buffer(request)};
+    lb::tcp::TriedBackends tried{lb::tcp::Backend(slow.local_endpoint())};
+    const EndpointType client(boost::asio::ip::make_address("10.0.0.1"), 40000);
+    std::optional<lb::tcp::Connector::Connection> hedge;
+    bool called = false;
+    const auto start = std::chrono::steady_clock::now();
+    boost::asio::post(socket.get_executor(), [&]() {
+        connector.AsyncReadFirstBytes(*pool, socket, buffer, segments, tried, client, nullptr,
+                                      [&](const boost::system::error_code& ec,
+                                          std::optional<lb::tcp::Connector::Connection> winner) {
+                                          ASSERT_FALSE(ec);
+                                          called = true;
+                                          hedge = std::move(winner);
+                                      });
+    });
+    while (!called && ioc.run_one()) {}
+
+    ASSERT_TRUE(called);
+    ASSERT_GE(std::chrono::steady_clock::now() - start, 20ms);
+    ASSERT_TRUE(hedge);
+    ASSERT_TRUE(hedge->backend == lb::tcp::Backend(fast.local_endpoint()));
+    ASSERT_EQ(socket.remote_endpoint(), fast.local_endpoint());
+    ASSERT_EQ(std::string(static_cast<const char*>(buffer.data().data()), buffer.size()), response);
+}
+
+TEST(Hedging, hedgeHoldsConcurrencyPermit)
+{
+    YAML::Node config = YAML::Load(R"(
+load_balancing:
+  algorithm: round_robin
+  hedging: {min_delay_ms: 20, max_delay_ms: 20}
+  adaptive_concurrency: {initial_limit: 1, min_limit: 1}
+  endpoints:
+    - {ip: 127.0.0.1, port: 8081}
+    - {ip: 127.0.0.1, port: 8082}
+)");
+    boost::asio::io_context ioc;
+    lb::tcp::RouterPtr router = lb::tcp::ConfigureRouter(config);
+    lb::tcp::Pool* pool = router->Select("localhost", "/");
+    ASSERT_NE(pool, nullptr);
+    ASSERT_NE(pool->concurrency, nullptr);
+    lb::tcp::Connector connector(ioc, router);
+    const lb::tcp::Backend primary(EndpointType(boost::asio::ip::make_address("127.0.0.1"), 8081));
+    const lb::tcp::Backend other(EndpointType(boost::asio::ip::make_address("127.0.0.1"), 8082));
+    const EndpointType client(boost::asio::ip::make_address("10.0.0.1"), 40000);
+
+    std::optional<lb::tcp::Connector::Connection> hedge = connector.Hedge(*pool, {primary}, client);
+    ASSERT_TRUE(hedge);
+    ASSERT_TRUE(hedge->backend == other);
+    ASSERT_TRUE(hedge->permit);
+    ASSERT_EQ(pool->concurrency->InFlight(other), 1);
+
+    // the other backend is at its limit, no hedge goes there
+    ASSERT_FALSE(connector.Hedge(*pool, {primary}, client));
+    hedge.reset();
+    ASSERT_EQ(pool->concurrency->InFlight(other), 0);
+}
+
+TEST(Hedging, cancelReachesHedgeAfterPrimaryFailed)
+{
+    boost::asio::io_context ioc;
+    // primary closes once the hedge is out, the hedge backend never responds
+    boost::asio::ip::tcp::acceptor failing(ioc, EndpointType(boost::asio::ip::make_address("127.0.0.1"), 0));
+    boost::asio::ip::tcp::acceptor silent(ioc, EndpointType(boost::asio::ip::make_address("127.0.0.1"), 0));
+
+    YAML::Node config = YAML::Load(
+        "load_balancing:\n"
+        "  algorithm: round_robin\n"
+        "  hedging: {min_delay_ms: 20, max_delay_ms: 20}\n"
+        "  endpoints:\n"
+        "    - {ip: 127.0.0.1, port: " + std::to_string(failing.local_endpoint().port()) + "}\n"
+        "    - {ip: 127.0.0.1, port: " + std::to_string(silent.local_endpoint().port()) + "}\n");
+    lb::tcp::RouterPtr router = lb::tcp::ConfigureRouter(config);
+    lb::tcp::Pool* pool = router->Select("localhost", "/");
+    ASSERT_NE(pool, nullptr);
+    lb::tcp::Connector connector(ioc, router);
+
+    const std::string request = "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    lb::tcp::SocketType socket(boost::asio::make_strand(ioc));
+    socket.connect(failing.local_endpoint());
+    boost::asio::write(socket, boost::asio::buffer(request));
+    boost::asio::ip::tcp::socket failing_peer = failing.accept();
+    boost::asio::ip::tcp::socket silent_peer(ioc);
+    char peer_buffer[256];
+    silent.async_accept(silent_peer, [&](const boost::system::error_code& ec) {
+        ASSERT_FALSE(ec);
+        failing_peer.close();
+        silent_peer.async_read_some(boost::asio::buffer(peer_buffer), [](const boost::system::error_code&,
+                                                                         std::size_t) {});
+    });
+
+    lb::tcp::IoBuffer buffer;
+    lb::tcp::Segments segments{boost::asio::buffer(request)};
+    lb::tcp::TriedBackends tried{lb::tcp::Backend(failing.local_endpoint())};
+    const EndpointType client(boost::asio::ip::make_address("10.0.0.1"), 40000);
+    lb::tcp::ConnectCancellation cancellation;
+    std::vector<boost::system::error_code> results;
+    boost::asio::post(socket.get_executor(), [&]() {
+        connector.AsyncReadFirstBytes(*pool, socket, buffer, segments, tried, client, &cancellation,
+                                      [&](const boost::system::error_code& ec,
+                                          std::optional<lb::tcp::Connector::Connection> winner) {
+                                          ASSERT_FALSE(winner);
+                                          results.push_back(ec);
+                                      });
+    });
+    boost::asio::steady_timer timer(ioc, 100ms);
+    timer.async_wait([&](const boost::system::error_code&) {
+        boost::asio::post(socket.get_executor(), [&]() {
+            ASSERT_TRUE(results.empty()); // the hedge is still waiting
+            cancellation.Cancel();
+        });
+    });
+    while (results.empty() && ioc.run_one_for(1s)) {}
+
+    ASSERT_EQ(results, std::vector<boost::system::error_code>{boost::asio::error::operation_aborted});
+}
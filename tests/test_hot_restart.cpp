@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+#include <lb/hot_restart.hpp>
+
+#include <boost/asio.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace asio = boost::asio;
+namespace fs = std::filesystem;
+
+namespace {
+
+// Ends of a unix socket pair, closed on destruction
+struct SocketPair {
+    int ends[2] = {-1, -1};
+
+    SocketPair()
+    {
+        EXPECT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, ends), 0);
+    }
+
+    ~SocketPair()
+    {
+        ::close(ends[0]);
+        ::close(ends[1]);
+    }
+};
+
+// Inode of the file open as fd, tells a passed descriptor from another one
+ino_t Inode(int fd)
+{
+    struct stat st{};
+    ::fstat(fd, &st);
+    return st.st_ino;
+}
+
+} // anonymous namespace
+
+TEST(HotRestart, socketsRoundTrip)
+{
+    SocketPair channel;
+    SocketPair first;
+    SocketPair second;
+    lb::SendSockets(channel.ends[0], {first.ends[0], second.ends[1]});
+
+    std::vector<int> received = lb::ReceiveSockets(channel.ends[1]);
+    ASSERT_EQ(received.size(), 2);
+    ASSERT_EQ(Inode(received[0]), Inode(first.ends[0]));
+    ASSERT_EQ(Inode(received[1]), Inode(second.ends[1]));
+    for (int socket : received) {
+        ASSERT_NE(socket, first.ends[0]);
+        ::close(socket);
+    }
+}
+
+TEST(HotRestart, countMismatchIsRejected)
+{
+    SocketPair channel;
+    const std::uint32_t count = 2; // no sockets follow
+    ASSERT_EQ(::send(channel.ends[0], &count, sizeof(count), 0), sizeof(count));
+    ASSERT_THROW(lb::ReceiveSockets(channel.ends[1]), std::runtime_error);
+}
+
+TEST(HotRestart, handoffServerIsPrivateAndConcurrent)
+{
+    const fs::path path = fs::temp_directory_path() / "lb2_test_handoff.sock";
+    SocketPair listening;
+    bool handed_over = false;
+    asio::io_context ioc;
+    lb::HandoffServer server(ioc, path.string(), {listening.ends[0]}, [&handed_over] { handed_over = true; });
+    server.Run();
+
+    struct stat st{};
+    ASSERT_EQ(::stat(path.c_str(), &st), 0);
+    ASSERT_EQ(st.st_mode & 0777, 0600);
+
+    // a peer that never sends its request does not block the next instance
+    asio::io_context client_ioc;
+    asio::local::stream_protocol::socket silent(client_ioc);
+    silent.connect(asio::local::stream_protocol::endpoint(path.string()));
+
+    std::thread thread([&ioc] { ioc.run(); });
+    std::vector<int> sockets = lb::ReceiveListeningSockets(path.string());
+    silent.close();
+    thread.join();
+
+    ASSERT_TRUE(handed_over);
+    ASSERT_EQ(sockets.size(), 1);
+    ASSERT_EQ(Inode(sockets[0]), Inode(listening.ends[0]));
+    ::close(sockets[0]);
+    fs::remove(path);
+}
@@ -0,0 +1,65 @@
+#include <gtest/gtest.h>
+#include <lb/tcp/rate_limiter.hpp>
+#include <yaml-cpp/yaml.h>
+
+using namespace std::chrono_literals;
+
+TEST(RateLimiter, tokenBucket)
+{
+    lb::tcp::RateLimiter limiter({.connections = {.rate = 10, .burst = 3}});
+    auto client = boost::asio::ip::make_address("10.0.0.1");
+    auto now = lb::tcp::RateLimiter::Clock::now();
+
+    ASSERT_TRUE(limiter.AllowConnection(client, now));
+    ASSERT_TRUE(limiter.AllowConnection(client, now));
+    ASSERT_TRUE(limiter.AllowConnection(client, now));
+    ASSERT_FALSE(limiter.AllowConnection(client, now)); // burst exhausted
+
+    // one token per 100ms
+    ASSERT_FALSE(limiter.AllowConnection(client, now + 50ms));
+    ASSERT_TRUE(limiter.AllowConnection(client, now + 100ms));
+    ASSERT_FALSE(limiter.AllowConnection(client, now + 100ms));
+
+    // other clients have their own buckets
+    ASSERT_TRUE(limiter.AllowConnection(boost::asio::ip::make_address("10.0.0.2"), now));
+    ASSERT_TRUE(limiter.AllowConnection(boost::asio::ip::make_address("::1"), now));
+
+    // requests are not limited
+    ASSERT_FALSE(limiter.LimitsRequests());
+    for (int i = 0; i < 100; ++i) {
+        ASSERT_TRUE(limiter.AllowRequest(client, now));
+    }
+}
+
+TEST(RateLimiter, fixedMemoryUnderFlood)
+{
+    lb::tcp::RateLimiter limiter({.requests = {.rate = 1, .burst = 1}, .table_size = 1024, .shards = 4});
+    ASSERT_EQ(limiter.Capacity(), 1024);
+    auto now = lb::tcp::RateLimiter::Clock::now();
+
+    auto victim = boost::asio::ip::make_address("192.168.0.1");
+    ASSERT_TRUE(limiter.AllowRequest(victim, now));
+    ASSERT_FALSE(limiter.AllowRequest(victim, now));
+
+    // Spoofed sources: every address is new, all of them get their first token
+    for (std::uint32_t i = 1; i <= 100000; ++i) {
+        ASSERT_TRUE(limiter.AllowRequest(boost::asio::ip::address_v4(0x0A000000 + i), now));
+    }
+    ASSERT_EQ(limiter.Capacity(), 1024);
+}
+
+TEST(RateLimiter, configuration)
+{
+    ASSERT_EQ(lb::tcp::ConfigureRateLimiter(YAML::Load("acceptor:\n  port: 1\n")), nullptr);
+
+    auto limiter = lb::tcp::ConfigureRateLimiter(YAML::Load(
+R"(rate_limit:
+  requests_per_second: 5
+  table_size: 100
+)"));
+    ASSERT_NE(limiter, nullptr);
+    ASSERT_TRUE(limiter->LimitsRequests());
+    ASSERT_GE(limiter->Capacity(), 100);
+
+    ASSERT_THROW(lb::tcp::ConfigureRateLimiter(YAML::Load("rate_limit:\n  requests_burst: 0\n")), std::runtime_error);
+}
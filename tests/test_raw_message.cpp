@@ -0,0 +1,153 @@
+#include <gtest/gtest.h>
+#include <lb/tcp/raw_message.hpp>
+#include <yaml-cpp/yaml.h>
+
+namespace http = boost::beast::http;
+
+namespace {
+
+std::string Join(const lb::tcp::Segments& segments)
+{
+    std::string result;
+    for (const auto& segment : segments) {
+        result.append(static_cast<const char*>(segment.data()), segment.size());
+    }
+    return result;
+}
+
+} // anonymous namespace
+
+TEST(RawMessage, requestInPieces)
+{
+    const std::string raw = "POST /upload?id=1 HTTP/1.1\r\n"
+                            "Host: example.com\r\n"
+                            "Cookie: a=1\r\n"
+                            "Content-Length: 5\r\n"
+                            "Cookie: b=2\r\n"
+                            "\r\n"
+                            "hello"
+                            "GET /next HTTP/1.1\r\n\r\n"; // pipelined
+
+    lb::tcp::MessageHead head;
+    lb::tcp::RawRequestParser parser(head);
+    boost::system::error_code ec;
+
+    // header is incomplete
+    ASSERT_FALSE(parser.Parse(boost::asio::buffer(raw.data(), 30), ec));
+    ASSERT_FALSE(ec);
+    // body is incomplete
+    ASSERT_FALSE(parser.Parse(boost::asio::buffer(raw.data(), raw.find("hello") + 2), ec));
+    ASSERT_FALSE(ec);
+    ASSERT_TRUE(parser.Parse(boost::asio::buffer(raw), ec));
+    ASSERT_FALSE(ec);
+
+    lb::tcp::MessageView message(head, raw);
+    ASSERT_EQ(message.Raw(), raw.substr(0, raw.find("GET")));
+    ASSERT_EQ(head.header_size, raw.find("hello"));
+    ASSERT_EQ(message.Method(), http::verb::post);
+    ASSERT_EQ(message.Target(), "/upload?id=1");
+    ASSERT_EQ(message.Find(http::field::host), "example.com");
+    ASSERT_EQ(message.Find(http::field::accept), "");
+    ASSERT_TRUE(head.keep_alive);
+
+    std::vector<std::string> cookies;
+    message.ForEach(http::field::cookie, [&cookies](std::string_view value) {
+        cookies.emplace_back(value);
+    });
+    ASSERT_EQ(cookies, (std::vector<std::string>{"a=1", "b=2"}));
+}
+
+TEST(RawMessage, chunkedAndEofDelimitedResponses)
+{
+    const std::string chunked = "HTTP/1.1 200 OK\r\n"
+                                "Transfer-Encoding: chunked\r\n"
+                                "\r\n"
+                                "5\r\nhello\r\n0\r\n\r\n";
+    lb::tcp::MessageHead head;
+    boost::system::error_code ec;
+    {
+        lb::tcp::RawResponseParser parser(head);
+        ASSERT_TRUE(parser.Parse(boost::asio::buffer(chunked), ec));
+        ASSERT_EQ(head.message_size, chunked.size());
+        ASSERT_EQ(head.status, 200);
+    }
+
+    const std::string until_eof = "HTTP/1.0 200 OK\r\n\r\nbody";
+    {
+        lb::tcp::RawResponseParser parser(head);
+        ASSERT_FALSE(parser.Parse(boost::asio::buffer(until_eof), ec));
+        ASSERT_FALSE(ec);
+        ASSERT_TRUE(parser.need_eof());
+        ASSERT_TRUE(parser.ParseEof(ec));
+        ASSERT_EQ(head.message_size, until_eof.size());
+        ASSERT_FALSE(head.keep_alive);
+    }
+
+    const std::string head_response = "HTTP/1.1 200 OK\r\nContent-Length: 100\r\n\r\n";
+    {
+        lb::tcp::RawResponseParser parser(head);
+        parser.skip(true);
+        ASSERT_TRUE(parser.Parse(boost::asio::buffer(head_response), ec));
+        ASSERT_EQ(head.message_size, head_response.size());
+    }
+}
+
+TEST(RawMessage, malformed)
+{
+    lb::tcp::MessageHead head;
+    lb::tcp::RawRequestParser parser(head);
+    boost::system::error_code ec;
+    ASSERT_FALSE(parser.Parse(boost::asio::buffer(std::string_view("GET / HTTP/1.1\r\nBad Header\r\n\r\n")), ec));
+    ASSERT_TRUE(ec);
+}
+
+TEST(RawMessage, spliceWithoutEditsIsOneSegment)
+{
+    const std::string raw = "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok";
+    lb::tcp::MessageHead head;
+    lb::tcp::RawResponseParser parser(head);
+    boost::system::error_code ec;
+    ASSERT_TRUE(parser.Parse(boost::asio::buffer(raw), ec));
+
+    lb::tcp::Segments segments;
+    lb::tcp::SpliceMessage(lb::tcp::MessageView(head, raw), nullptr, {}, segments);
+    ASSERT_EQ(segments.size(), 1);
+    ASSERT_EQ(segments[0].data(), raw.data());
+    ASSERT_EQ(Join(segments), raw);
+}
+
+TEST(RawMessage, spliceEdits)
+{
+    const std::string raw = "HTTP/1.1 200 OK\r\n"
+                            "Server: backend/1.0\r\n"
+                            "Content-Length: 2\r\n"
+                            "X-Internal: secret\r\n"
+                            "x-internal: again\r\n"
+                            "Cache-Control: no-cache\r\n"
+                            "\r\n"
+                            "ok";
+    lb::tcp::MessageHead head;
+    lb::tcp::RawResponseParser parser(head);
+    boost::system::error_code ec;
+    ASSERT_TRUE(parser.Parse(boost::asio::buffer(raw), ec));
+
+    YAML::Node config = YAML::Load(R"(
+remove: ["X-Internal"]
+set:
+  Server: lb2
+)");
+    lb::tcp::HeaderRewritePtr rewrite = lb::tcp::ConfigureHeaderRewrite(config);
+    ASSERT_NE(rewrite, nullptr);
+
+    lb::tcp::Segments segments;
+    lb::tcp::SpliceMessage(lb::tcp::MessageView(head, raw), rewrite.get(), "Set-Cookie: a=b\r\n", segments);
+    ASSERT_EQ(Join(segments), "HTTP/1.1 200 OK\r\n"
+                              "Content-Length: 2\r\n"
+                              "Cache-Control: no-cache\r\n"
+                              "Server: lb2\r\n"
+                              "Set-Cookie: a=b\r\n"
+                              "\r\n"
+                              "ok");
+
+    ASSERT_EQ(lb::tcp::ConfigureHeaderRewrite(YAML::Node()), nullptr);
+}
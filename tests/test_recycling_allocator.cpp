@@ -0,0 +1,39 @@
+#include <lb/tcp/recycling_allocator.hpp>
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <vector>
+
+using lb::tcp::RecyclingCache;
+
+TEST(RecyclingAllocatorTests, blocksAreReusedBySize)
+{
+    void* block = RecyclingCache::Allocate(100);
+    RecyclingCache::Deallocate(block, 100);
+    // same 64 bytes granule
+    void* again = RecyclingCache::Allocate(128);
+    ASSERT_EQ(again, block);
+    void* other = RecyclingCache::Allocate(129);
+    ASSERT_NE(other, block);
+    RecyclingCache::Deallocate(again, 128);
+    RecyclingCache::Deallocate(other, 129);
+}
+
+TEST(RecyclingAllocatorTests, sharedObjects)
+{
+    struct Object {
+        int value[50];
+    };
+    lb::tcp::RecyclingAllocator<Object> allocator;
+    auto first = std::allocate_shared<Object>(allocator);
+    const Object* address = first.get();
+    first.reset();
+    auto second = std::allocate_shared<Object>(allocator);
+    ASSERT_EQ(second.get(), address);
+}
+
+TEST(RecyclingAllocatorTests, largeBlocks)
+{
+    std::vector<char, lb::tcp::RecyclingAllocator<char>> data(RecyclingCache::kMaxBlockSize + 1, 'x');
+    ASSERT_EQ(data.back(), 'x');
+}
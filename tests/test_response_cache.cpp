@@ -0,0 +1,186 @@
+#include <gtest/gtest.h>
+#include <lb/tcp/response_cache.hpp>
+#include <yaml-cpp/yaml.h>
+
+#include <string>
+
+using lb::tcp::CachedResponsePtr;
+using lb::tcp::ResponseCache;
+
+namespace {
+
+template <bool isRequest>
+struct Parsed {
+    explicit Parsed(std::string text)
+        : raw(std::move(text))
+    {
+        lb::tcp::RawParser<isRequest> parser(head);
+        boost::system::error_code ec;
+        EXPECT_TRUE(parser.Parse(boost::asio::buffer(raw), ec));
+        EXPECT_FALSE(ec);
+    }
+
+    lb::tcp::MessageView View() const
+    {
+        return lb::tcp::MessageView(head, raw);
+    }
+
+    std::string raw;
+    lb::tcp::MessageHead head;
+};
+
+using Request = Parsed<true>;
+using Response = Parsed<false>;
+
+std::string Get(const std::string& target, const std::string& fields = "")
+{
+    return "GET " + target + " HTTP/1.1\r\nHost: example.com\r\n" + fields + "\r\n";
+}
+
+std::string Ok(const std::string& fields, const std::string& body = "hello")
+{
+    return "HTTP/1.1 200 OK\r\n" + fields + "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+}
+
+std::string Join(const lb::tcp::Segments& segments)
+{
+    std::string result;
+    for (const auto& segment : segments) {
+        result.append(static_cast<const char*>(segment.data()), segment.size());
+    }
+    return result;
+}
+
+void Store(ResponseCache& cache, const std::string& key, const lb::tcp::MessageView& request,
+           const lb::tcp::MessageView& response)
+{
+    if (CachedResponsePtr shared = lb::tcp::ShareResponse(request, response)) {
+        cache.Store(key, std::move(shared));
+    }
+}
+
+// Stores response to request and looks it up with the same request
+CachedResponsePtr StoreAndFind(ResponseCache& cache, const std::string& request, const std::string& response)
+{
+    const Request parsed(request);
+    std::string key;
+    if (!lb::tcp::CacheKey(parsed.View(), key)) {
+        return nullptr;
+    }
+    Store(cache, key, parsed.View(), Response(response).View());
+    return cache.Find(key, parsed.View());
+}
+
+} // anonymous namespace
+
+TEST(ResponseCache, servesFreshResponses)
+{
+    ResponseCache cache({}, "test_fresh");
+    const Request request(Get("/a?x=1"));
+    std::string key;
+    ASSERT_TRUE(lb::tcp::CacheKey(request.View(), key));
+    ASSERT_EQ(cache.Find(key, request.View()), nullptr);
+
+    const std::string raw = Ok("Cache-Control: public, max-age=60\r\nAge: 10\r\n");
+    Store(cache, key, request.View(), Response(raw).View());
+    CachedResponsePtr cached = cache.Find(key, request.View());
+    ASSERT_NE(cached, nullptr);
+    ASSERT_EQ(cached->raw, raw);
+    ASSERT_GT(cache.Bytes(), raw.size());
+
+    // backend's Age is replaced by the current one
+    std::string age_line;
+    lb::tcp::Segments segments;
+    cached->Splice(nullptr, age_line, segments);
+    ASSERT_EQ(Join(segments), "HTTP/1.1 200 OK\r\n"
+                              "Cache-Control: public, max-age=60\r\n"
+                              "Content-Length: 5\r\n"
+                              "Age: 10\r\n"
+                              "\r\n"
+                              "hello");
+
+    // clients asking for a new response go to the backend
+    ASSERT_EQ(cache.Find(key, Request(Get("/a?x=1", "Cache-Control: no-cache\r\n")).View()), nullptr);
+    ASSERT_EQ(cache.Find(key, Request(Get("/a?x=1", "Pragma: no-cache\r\n")).View()), nullptr);
+    ASSERT_EQ(cache.Find(key, Request(Get("/a?x=1", "Cache-Control: max-age=5\r\n")).View()), nullptr);
+    ASSERT_NE(cache.Find(key, Request(Get("/a?x=1", "Cache-Control: max-age=30\r\n")).View()), nullptr);
+}
+
+TEST(ResponseCache, storesOnlyCacheableResponses)
+{
+    ResponseCache cache({}, "test_cacheable");
+    ASSERT_EQ(StoreAndFind(cache, Get("/"), Ok("")), nullptr);
+    ASSERT_EQ(StoreAndFind(cache, Get("/"), Ok("Cache-Control: max-age=60, private\r\n")), nullptr);
+    ASSERT_EQ(StoreAndFind(cache, Get("/"), Ok("Cache-Control: no-store\r\n")), nullptr);
+    ASSERT_EQ(StoreAndFind(cache, Get("/"), Ok("Cache-Control: max-age=60\r\nSet-Cookie: a=b\r\n")), nullptr);
+    ASSERT_EQ(StoreAndFind(cache, Get("/"), Ok("Cache-Control: max-age=60\r\nVary: *\r\n")), nullptr);
+    ASSERT_EQ(StoreAndFind(cache, Get("/"), Ok("Cache-Control: max-age=60\r\nConnection: close\r\n")), nullptr);
+    ASSERT_EQ(StoreAndFind(cache, Get("/"), Ok("Cache-Control: max-age=60\r\nAge: 60\r\n")), nullptr);
+    ASSERT_EQ(StoreAndFind(cache, Get("/"), Ok("Expires: 0\r\n")), nullptr);
+    ASSERT_EQ(StoreAndFind(cache, Get("/"), "HTTP/1.1 500 Internal Server Error\r\n"
+                                            "Cache-Control: max-age=60\r\nContent-Length: 0\r\n\r\n"), nullptr);
+    ASSERT_EQ(StoreAndFind(cache, Get("/", "Authorization: Basic eDp5\r\n"), Ok("Cache-Control: max-age=60\r\n")),
+              nullptr);
+    ASSERT_EQ(StoreAndFind(cache, Get("/", "Cache-Control: no-store\r\n"), Ok("Cache-Control: max-age=60\r\n")),
+              nullptr);
+    ASSERT_EQ(cache.Bytes(), 0);
+
+    ASSERT_NE(StoreAndFind(cache, Get("/"), Ok("Date: Sun, 06 Nov 1994 08:49:37 GMT\r\n"
+                                               "Expires: Sun, 06 Nov 1994 08:59:37 GMT\r\n")), nullptr);
+    ASSERT_NE(StoreAndFind(cache, Get("/"), Ok("Cache-Control: s-maxage=60, max-age=0\r\n")), nullptr);
+}
+
+TEST(ResponseCache, matchesVary)
+{
+    ResponseCache cache({}, "test_vary");
+    const Request gzip(Get("/", "Accept-Encoding: gzip\r\n"));
+    std::string key;
+    ASSERT_TRUE(lb::tcp::CacheKey(gzip.View(), key));
+    Store(cache, key, gzip.View(), Response(Ok("Cache-Control: max-age=60\r\nVary: accept-encoding\r\n")).View());
+
+    ASSERT_NE(cache.Find(key, gzip.View()), nullptr);
+    ASSERT_EQ(cache.Find(key, Request(Get("/", "Accept-Encoding: br\r\n")).View()), nullptr);
+    ASSERT_EQ(cache.Find(key, Request(Get("/")).View()), nullptr);
+}
+
+TEST(ResponseCache, clockKeepsHitResponses)
+{
+    const std::string body(1000, 'x');
+    ResponseCache cache({.max_bytes = 4 * 1024, .shards = 1}, "test_clock");
+    const Request hot(Get("/hot"));
+    std::string hot_key;
+    ASSERT_TRUE(lb::tcp::CacheKey(hot.View(), hot_key));
+    Store(cache, hot_key, hot.View(), Response(Ok("Cache-Control: max-age=60\r\n", body)).View());
+
+    for (int i = 0; i < 10; ++i) {
+        ASSERT_NE(cache.Find(hot_key, hot.View()), nullptr);
+        const Request cold(Get("/cold" + std::to_string(i)));
+        std::string key;
+        ASSERT_TRUE(lb::tcp::CacheKey(cold.View(), key));
+        Store(cache, key, cold.View(), Response(Ok("Cache-Control: max-age=60\r\n", body)).View());
+        ASSERT_LE(cache.Bytes(), cache.Config().max_bytes);
+    }
+    ASSERT_NE(cache.Find(hot_key, hot.View()), nullptr);
+    ASSERT_EQ(cache.Find("example.com /cold0", Request(Get("/cold0")).View()), nullptr);
+
+    // larger than a shard
+    ASSERT_EQ(StoreAndFind(cache, Get("/big"), Ok("Cache-Control: max-age=60\r\n", std::string(5000, 'x'))), nullptr);
+}
+
+TEST(ResponseCache, configure)
+{
+    const YAML::Node endpoints = YAML::Load("endpoints: [{ip: 127.0.0.1, port: 8081}]");
+    ASSERT_EQ(lb::tcp::ConfigureResponseCache(endpoints, "test_configure"), nullptr);
+
+    YAML::Node node = YAML::Clone(endpoints);
+    node["cache"] = YAML::Load("{max_bytes: 1048576, max_object_bytes: 4096, shards: 4}");
+    lb::tcp::ResponseCachePtr cache = lb::tcp::ConfigureResponseCache(node, "test_configure");
+    ASSERT_NE(cache, nullptr);
+    ASSERT_EQ(cache->Config().max_object_bytes, 4096);
+    ASSERT_EQ(cache->Config().shards, 4);
+
+    node["cache"] = YAML::Load("{shards: 0}");
+    ASSERT_THROW(lb::tcp::ConfigureResponseCache(node, "test_configure"), std::runtime_error);
+    node["cache"] = YAML::Load("[1]");
+    ASSERT_THROW(lb::tcp::ConfigureResponseCache(node, "test_configure"), std::runtime_error);
+}
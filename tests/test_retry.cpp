@@ -0,0 +1,188 @@
+#include <gtest/gtest.h>
+#include <lb/tcp/connector.hpp>
+#include <lb/tcp/retry.hpp>
+#include <yaml-cpp/yaml.h>
+
+using namespace std::chrono_literals;
+using lb::tcp::RetryBudget;
+
+TEST(RetryBudget, shareOfRecentTraffic)
+{
+    RetryBudget budget({.ratio = 0.5, .min_per_second = 0});
+    auto now = RetryBudget::Clock::now();
+    ASSERT_FALSE(budget.TryWithdraw(now));
+
+    for (int i = 0; i < 10; ++i) {
+        budget.Deposit(now);
+    }
+    for (int i = 0; i < 5; ++i) {
+        ASSERT_TRUE(budget.TryWithdraw(now));
+    }
+    ASSERT_FALSE(budget.TryWithdraw(now));
+
+    budget.Deposit(now + 5s);
+    budget.Deposit(now + 5s);
+    ASSERT_TRUE(budget.TryWithdraw(now + 5s));
+    ASSERT_FALSE(budget.TryWithdraw(now + 5s));
+
+    // first second left the window, with its deposits and retries
+    ASSERT_FALSE(budget.TryWithdraw(now + 11s));
+    budget.Deposit(now + 11s);
+    budget.Deposit(now + 11s);
+    ASSERT_TRUE(budget.TryWithdraw(now + 11s));
+}
+
+TEST(RetryBudget, minimumRate)
+{
+    RetryBudget budget({.ratio = 0, .min_per_second = 1});
+    auto now = RetryBudget::Clock::now();
+    for (std::size_t i = 0; i < RetryBudget::kWindowSeconds; ++i) {
+        ASSERT_TRUE(budget.TryWithdraw(now));
+    }
+    ASSERT_FALSE(budget.TryWithdraw(now));
+    ASSERT_TRUE(budget.TryWithdraw(now + 10s));
+}
+
+TEST(RetryBudget, configure)
+{
+    lb::tcp::RetryPolicy defaults = lb::tcp::ConfigureRetries(YAML::Load("acceptor: {port: 9090}"));
+    ASSERT_EQ(defaults.connect_attempts, 3);
+
+    lb::tcp::RetryPolicy policy = lb::tcp::ConfigureRetries(YAML::Load(R"(
+retries:
+  connect_attempts: 5
+  budget_percent: 10
+  min_retries_per_second: 2
+  replay_max_bytes: 0
+)"));
+    ASSERT_EQ(policy.connect_attempts, 5);
+    ASSERT_EQ(policy.replay_max_bytes, 0);
+    ASSERT_DOUBLE_EQ(policy.budget.ratio, 0.1);
+    ASSERT_DOUBLE_EQ(policy.budget.min_per_second, 2);
+
+    ASSERT_THROW(lb::tcp::ConfigureRetries(YAML::Load("retries: {connect_attempts: 0}")), std::runtime_error);
+    ASSERT_THROW(lb::tcp::ConfigureRetries(YAML::Load("retries: {connect_attempts: 9}")), std::runtime_error);
+}
+
+TEST(RetryBudget, reselectTriesOtherBackends)
+{
+    YAML::Node config = YAML::Load(R"(
+load_balancing:
+  algorithm: ip_hash
+  endpoints:
+    - ip: "127.0.0.1"
+      port: 8081
+    - ip: "127.0.0.2"
+      port: 8082
+    - ip: "127.0.0.3"
+      port: 8083
+)");
+    boost::asio::io_context ioc;
+    lb::tcp::Connector connector(ioc, lb::tcp::ConfigureRouter(config), nullptr, nullptr,
+                                 lb::tcp::SessionEngine::CALLBACKS, {},
+                                 {.connect_attempts = 3, .budget = {.ratio = 0, .min_per_second = 100}});
+    lb::tcp::Pool pool{.name = "test", .selector = lb::tcp::MakeSelector(config["load_balancing"])};
+    boost::asio::ip::tcp::endpoint client(boost::asio::ip::make_address("10.0.0.1"), 40000);
+
+    // ip hash gives the same backend to the client every time
+    lb::tcp::TriedBackends tried{pool.selector->SelectBackend(client)};
+    ASSERT_EQ(pool.selector->SelectBackend(client), tried[0]);
+
+    auto next = connector.Reselect(pool, tried, boost::asio::error::timed_out, client);
+    ASSERT_TRUE(next);
+    ASSERT_FALSE(next->backend == tried[0]);
+    tried.push_back(next->backend);
+
+    next = connector.Reselect(pool, tried, boost::asio::error::host_unreachable, client);
+    ASSERT_TRUE(next);
+    ASSERT_FALSE(next->backend == tried[0]);
+    ASSERT_FALSE(next->backend == tried[1]);
+    tried.push_back(next->backend);
+
+    // attempts are used up
+    ASSERT_FALSE(connector.Reselect(pool, tried, boost::asio::error::timed_out, client));
+    // session was closed
+    ASSERT_FALSE(connector.Reselect(pool, {tried[0]}, boost::asio::error::operation_aborted, client));
+}
+
+TEST(RetryBudget, refusedBackendsStaySelectable)
+{
+    YAML::Node config = YAML::Load(R"(
+load_balancing:
+  algorithm: round_robin
+  endpoints:
+    - ip: "127.0.0.1"
+      port: 8081
+    - ip: "127.0.0.2"
+      port: 8082
+)");
+    boost::asio::io_context ioc;
+    lb::tcp::Connector connector(ioc, lb::tcp::ConfigureRouter(config), nullptr, nullptr,
+                                 lb::tcp::SessionEngine::CALLBACKS, {},
+                                 {.connect_attempts = 3, .budget = {.ratio = 0, .min_per_second = 100}});
+    lb::tcp::Pool pool{.name = "test", .selector = lb::tcp::MakeSelector(config["load_balancing"])};
+    boost::asio::ip::tcp::endpoint client(boost::asio::ip::make_address("10.0.0.1"), 40000);
+
+    // both backends restarting: every connect is refused
+    for (int request = 0; request < 4; ++request) {
+        lb::tcp::TriedBackends tried{pool.selector->SelectBackend(client)};
+        std::optional<lb::tcp::Connector::Connection> next;
+        ASSERT_NO_THROW(next = connector.Reselect(pool, tried, boost::asio::error::connection_refused, client));
+        ASSERT_TRUE(next);
+        ASSERT_FALSE(next->backend == tried[0]);
+        tried.push_back(next->backend);
+        ASSERT_NO_THROW(next = connector.Reselect(pool, tried, boost::asio::error::connection_refused, client));
+        ASSERT_TRUE(next);
+        tried.push_back(next->backend);
+        ASSERT_FALSE(connector.Reselect(pool, tried, boost::asio::error::connection_refused, client));
+    }
+
+    // once they are back both get requests again
+    lb::tcp::Backend first = pool.selector->SelectBackend(client);
+    lb::tcp::Backend second = pool.selector->SelectBackend(client);
+    ASSERT_FALSE(first == second);
+}
+
+TEST(RetryBudget, replayIdempotentRequests)
+{
+    YAML::Node config = YAML::Load(R"(
+load_balancing:
+  algorithm: round_robin
+  endpoints:
+    - ip: "127.0.0.1"
+      port: 8081
+    - ip: "127.0.0.2"
+      port: 8082
+)");
+    boost::asio::io_context ioc;
+    lb::tcp::Connector connector(ioc, lb::tcp::ConfigureRouter(config), nullptr, nullptr,
+                                 lb::tcp::SessionEngine::CALLBACKS, {},
+                                 {.connect_attempts = 2, .replay_max_bytes = 100,
+                                  .budget = {.ratio = 0, .min_per_second = 100}});
+    lb::tcp::Pool pool{.name = "test", .selector = lb::tcp::MakeSelector(config["load_balancing"])};
+    boost::asio::ip::tcp::endpoint client(boost::asio::ip::make_address("10.0.0.1"), 40000);
+
+    lb::tcp::MessageHead request;
+    request.message_size = 100;
+    request.method = boost::beast::http::verb::get;
+    ASSERT_TRUE(connector.Replayable(request));
+    request.method = boost::beast::http::verb::put;
+    ASSERT_TRUE(connector.Replayable(request));
+    request.method = boost::beast::http::verb::post;
+    ASSERT_FALSE(connector.Replayable(request));
+    request.method = boost::beast::http::verb::get;
+    request.message_size = 101;
+    ASSERT_FALSE(connector.Replayable(request));
+
+    lb::tcp::TriedBackends tried{pool.selector->SelectBackend(client)};
+    auto next = connector.Replay(pool, tried, boost::asio::error::connection_reset, client);
+    ASSERT_TRUE(next);
+    ASSERT_FALSE(next->backend == tried[0]);
+    ASSERT_TRUE(connector.Replay(pool, tried, boost::asio::error::eof, client));
+
+    // slow upstream may be processing the request
+    ASSERT_FALSE(connector.Replay(pool, tried, boost::asio::error::timed_out, client));
+    ASSERT_FALSE(connector.Replay(pool, tried, boost::asio::error::operation_aborted, client));
+    tried.push_back(next->backend);
+    ASSERT_FALSE(connector.Replay(pool, tried, boost::asio::error::connection_reset, client));
+}
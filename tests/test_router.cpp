@@ -0,0 +1,155 @@
+#include <gtest/gtest.h>
+#include <lb/tcp/router.hpp>
+#include <yaml-cpp/yaml.h>
+
+TEST(PathTrie, longestPrefix)
+{
+    lb::tcp::PathTrie trie;
+    ASSERT_EQ(trie.Match("/"), lb::tcp::PathTrie::kNoMatch);
+
+    trie.Add("/", 0);
+    trie.Add("/api", 1);
+    trie.Add("/api/v2/", 2);
+    trie.Add("/static/", 3);
+    trie.Compile();
+
+    ASSERT_EQ(trie.Match("/"), 0);
+    ASSERT_EQ(trie.Match("/index.html"), 0);
+    ASSERT_EQ(trie.Match("/api"), 1);
+    ASSERT_EQ(trie.Match("/apix"), 1);
+    ASSERT_EQ(trie.Match("/api/v2"), 1);
+    ASSERT_EQ(trie.Match("/api/v2/users"), 2);
+    ASSERT_EQ(trie.Match("/static/"), 3);
+    ASSERT_EQ(trie.Match("/stat"), 0);
+    ASSERT_EQ(trie.Match(""), lb::tcp::PathTrie::kNoMatch);
+}
+
+TEST(PathTrie, duplicatedPrefix)
+{
+    lb::tcp::PathTrie trie;
+    trie.Add("/api", 1);
+    ASSERT_THROW(trie.Add("/api", 2), std::runtime_error);
+}
+
+TEST(RouteMatcher, hosts)
+{
+    lb::tcp::RouteMatcher matcher;
+    matcher.Add("api.example.com", "/", 1);
+    matcher.Add("api.example.com", "/v2/", 2);
+    matcher.Add("*.example.com", "/", 3);
+    matcher.Add("*.cdn.example.com", "/img/", 4);
+    matcher.Add("", "/", 5);
+    matcher.Add("", "/health", 6);
+    matcher.Compile();
+
+    ASSERT_EQ(matcher.Match("api.example.com", "/users"), 1);
+    ASSERT_EQ(matcher.Match("API.Example.COM:8080", "/v2/users"), 2);
+    ASSERT_EQ(matcher.Match("api.example.com.", "/v2/users"), 2);
+    ASSERT_EQ(matcher.Match("www.example.com", "/users"), 3);
+    ASSERT_EQ(matcher.Match("eu.cdn.example.com", "/img/logo.png"), 4);
+    ASSERT_EQ(matcher.Match("eu.cdn.example.com", "/index.html"), 3);
+    ASSERT_EQ(matcher.Match("example.com", "/"), 5);
+    ASSERT_EQ(matcher.Match("", "/health"), 6);
+    ASSERT_EQ(matcher.Match("other.org", "/healthz"), 6);
+    ASSERT_EQ(matcher.Match(std::string(1000, 'a'), "/"), 5);
+}
+
+TEST(RouteMatcher, hostRulesTakePrecedence)
+{
+    lb::tcp::RouteMatcher matcher;
+    matcher.Add("api.example.com", "/", 1);
+    matcher.Add("", "/api/", 2);
+    matcher.Add("", "/health", 3);
+    matcher.Add("static.example.com", "/assets/", 4);
+    matcher.Compile();
+
+    ASSERT_EQ(matcher.Match("api.example.com", "/api/users"), 1);
+    ASSERT_EQ(matcher.Match("static.example.com", "/health"), 3); // falls back to any host
+    ASSERT_EQ(matcher.Match("static.example.com", "/"), lb::tcp::RouteMatcher::kNoMatch);
+}
+
+TEST(Router, configure)
+{
+    YAML::Node config = YAML::Load(R"(
+load_balancing:
+  algorithm: round_robin
+  endpoints:
+    - ip: "127.0.0.1"
+      port: 8081
+pools:
+  api:
+    algorithm: least_connections
+    endpoints:
+      - ip: "127.0.0.1"
+        port: 8082
+      - ip: "127.0.0.1"
+        port: 8083
+  static:
+    algorithm: ip_hash
+    endpoints:
+      - ip: "127.0.0.1"
+        port: 8084
+routes:
+  - host: "api.example.com"
+    pool: api
+  - path: "/static/"
+    pool: static
+)");
+    lb::tcp::RouterPtr router = lb::tcp::ConfigureRouter(config);
+    ASSERT_EQ(router->PoolsCount(), 3);
+    ASSERT_EQ(router->CommonSelectorType(), std::nullopt);
+
+    ASSERT_EQ(router->Select("api.example.com", "/users")->name, "api");
+    ASSERT_EQ(router->Select("api.example.com", "/users")->selector->Type(),
+              lb::tcp::SelectorType::LEAST_CONNECTIONS);
+    ASSERT_EQ(router->Select("www.example.com", "/static/app.js")->name, "static");
+    ASSERT_EQ(router->Select("www.example.com", "/")->name, "default");
+
+    auto select = [&router](std::string_view raw) {
+        lb::tcp::MessageHead head;
+        lb::tcp::RawRequestParser parser(head);
+        boost::system::error_code ec;
+        EXPECT_TRUE(parser.Parse(boost::asio::buffer(raw.data(), raw.size()), ec));
+        return router->Select(lb::tcp::MessageView(head, raw))->name;
+    };
+    ASSERT_EQ(select("GET /static/app.js?v=1 HTTP/1.1\r\nHost: www.example.com\r\n\r\n"), "static");
+    ASSERT_EQ(select("GET http://api.example.com/static/app.js HTTP/1.1\r\nHost: www.example.com\r\n\r\n"), "api");
+}
+
+TEST(Router, withoutRoutesAndDefault)
+{
+    YAML::Node single = YAML::Load(R"(
+load_balancing:
+  algorithm: round_robin
+  endpoints:
+    - ip: "127.0.0.1"
+      port: 8081
+)");
+    lb::tcp::RouterPtr router = lb::tcp::ConfigureRouter(single);
+    ASSERT_EQ(router->PoolsCount(), 1);
+    ASSERT_EQ(router->Select("any.host", "/any/path")->name, "default");
+    ASSERT_EQ(router->CommonSelectorType(), lb::tcp::SelectorType::ROUND_ROBIN);
+
+    YAML::Node no_default = YAML::Load(R"(
+pools:
+  api:
+    algorithm: round_robin
+    endpoints:
+      - ip: "127.0.0.1"
+        port: 8082
+routes:
+  - path: "/api/"
+    pool: api
+)");
+    router = lb::tcp::ConfigureRouter(no_default);
+    ASSERT_NE(router->Select("", "/api/users"), nullptr);
+    ASSERT_EQ(router->Select("", "/index.html"), nullptr);
+
+    YAML::Node unknown_pool = YAML::Load(R"(
+pools: {}
+routes:
+  - path: "/"
+    pool: missing
+)");
+    ASSERT_THROW(lb::tcp::ConfigureRouter(unknown_pool), std::runtime_error);
+}
@@ -1,4 +1,5 @@
 #include <gtest/gtest.h>
+#include <lb/tcp/notifiers.hpp>
 #include <lb/tcp/selectors.hpp>
 #include <yaml-cpp/yaml.h>
 #include <boost/asio.hpp>
@@ -344,4 +345,31 @@ endpoints:
     selector.ExcludeBackend(b2);
     ASSERT_THROW(selector.ExcludeBackend(b1), std::runtime_error); // No backend left
 
-}
\ No newline at end of file
+}
+
+
+TEST(Notifiers, anyNotifierFollowsSelectorType)
+{
+    YAML::Node selector_config = YAML::Load(
+R"(algorithm: least_connections
+endpoints:
+  - ip: "127.0.0.1"
+    port: 8081
+  - ip: "127.0.0.2"
+    port: 8082
+)");
+
+    lb::tcp::LeastConnectionsSelector selector;
+    selector.Configure(selector_config);
+    boost::asio::ip::tcp::endpoint notused(boost::asio::ip::address::from_string("127.0.0.1"), 8080);
+    auto b1 = lb::tcp::Backend("127.0.0.1", 8081);
+    auto b2 = lb::tcp::Backend("127.0.0.2", 8082);
+
+    lb::tcp::AnyNotifier notifier;
+    notifier.OnConnect(selector, b1);
+    ASSERT_EQ(selector.SelectBackend(notused), b2);
+    ASSERT_EQ(selector.SelectBackend(notused), b2);
+
+    notifier.OnDisconnect();
+    ASSERT_EQ(selector.SelectBackend(notused), b1);
+}
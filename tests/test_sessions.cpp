@@ -0,0 +1,66 @@
+#include <gtest/gtest.h>
+
+#include "../benchmarks/in_process_lb.hpp"
+
+#include <boost/asio.hpp>
+
+#include <string>
+#include <vector>
+
+namespace asio = boost::asio;
+using lb::tcp::SessionEngine;
+
+namespace {
+
+std::vector<SessionEngine> Engines()
+{
+    std::vector<SessionEngine> engines{SessionEngine::CALLBACKS};
+#ifdef LB_COROUTINE_SESSIONS
+    engines.push_back(SessionEngine::COROUTINES);
+#endif
+    return engines;
+}
+
+// Sends a GET over client and reads the response, returns its body
+std::string Get(asio::ip::tcp::socket& client, asio::streambuf& buffer)
+{
+    asio::write(client, asio::buffer(std::string_view("GET / HTTP/1.1\r\nHost: localhost\r\n\r\n")));
+    const std::size_t head_size = asio::read_until(client, buffer, "\r\n\r\n");
+    const std::string head(asio::buffers_begin(buffer.data()), asio::buffers_begin(buffer.data()) + head_size);
+    buffer.consume(head_size);
+    EXPECT_EQ(head.rfind("HTTP/1.1 200 OK\r\n", 0), 0) << head;
+
+    const std::string length_field = "Content-Length: ";
+    const std::size_t length_at = head.find(length_field);
+    EXPECT_NE(length_at, std::string::npos) << head;
+    const std::size_t length = std::stoul(head.substr(length_at + length_field.size()));
+    if (buffer.size() < length) {
+        asio::read(client, buffer, asio::transfer_exactly(length - buffer.size()));
+    }
+    const std::string body(asio::buffers_begin(buffer.data()), asio::buffers_begin(buffer.data()) + length);
+    buffer.consume(length);
+    return body;
+}
+
+} // anonymous namespace
+
+TEST(Sessions, enginesProxyKeepAliveRequests)
+{
+    constexpr std::size_t kBodySize = 100000; // takes several reads
+    for (SessionEngine engine : Engines()) {
+        SCOPED_TRACE(engine == SessionEngine::CALLBACKS ? "callbacks" : "coroutines");
+        lb::bench::InProcessLb lb(kBodySize, "round_robin", engine);
+
+        asio::io_context ioc;
+        std::vector<asio::ip::tcp::socket> clients;
+        std::vector<asio::streambuf> buffers(2);
+        for (int i = 0; i < 2; ++i) {
+            clients.emplace_back(ioc).connect(lb.Endpoint());
+        }
+        for (int request = 0; request < 3; ++request) {
+            for (std::size_t i = 0; i < clients.size(); ++i) {
+                ASSERT_EQ(Get(clients[i], buffers[i]), std::string(kBodySize, 'x'));
+            }
+        }
+    }
+}
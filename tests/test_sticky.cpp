@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+#include <lb/tcp/sticky.hpp>
+#include <yaml-cpp/yaml.h>
+
+namespace {
+
+std::vector<lb::tcp::Backend> TestBackends()
+{
+    return {
+        lb::tcp::Backend("127.0.0.1", 8081),
+        lb::tcp::Backend("127.0.0.1", 8082),
+        lb::tcp::Backend("127.0.0.1", 8083),
+    };
+}
+
+} // anonymous namespace
+
+TEST(StickySessions, encodeDecode)
+{
+    lb::tcp::StickySessions sticky({.cookie_name = "aff", .secret = "secret"}, TestBackends());
+
+    for (const auto& backend : TestBackends()) {
+        std::string token = sticky.Encode(backend);
+        auto decoded = sticky.Decode(token);
+        ASSERT_TRUE(decoded.has_value());
+        ASSERT_EQ(*decoded, backend);
+
+        auto looked_up = sticky.Lookup("theme=dark; aff=" + token + "; lang=en");
+        ASSERT_TRUE(looked_up.has_value());
+        ASSERT_EQ(*looked_up, backend);
+    }
+
+    ASSERT_EQ(sticky.MakeSetCookie(TestBackends()[0]),
+              "aff=" + sticky.Encode(TestBackends()[0]) + "; Path=/; HttpOnly");
+    ASSERT_FALSE(sticky.Lookup("theme=dark").has_value());
+    ASSERT_FALSE(sticky.Lookup("").has_value());
+}
+
+TEST(StickySessions, stableAcrossInstances)
+{
+    lb::tcp::StickySessions first({.secret = "secret"}, TestBackends());
+    lb::tcp::StickySessions second({.secret = "secret"}, TestBackends());
+    lb::tcp::StickySessions other_key({.secret = "other"}, TestBackends());
+
+    std::string token = first.Encode(TestBackends()[1]);
+    ASSERT_EQ(*second.Decode(token), TestBackends()[1]);
+    ASSERT_FALSE(other_key.Decode(token).has_value());
+}
+
+TEST(StickySessions, rejectsForgedCookies)
+{
+    lb::tcp::StickySessions sticky({.secret = "secret"}, TestBackends());
+    std::string token = sticky.Encode(TestBackends()[0]);
+
+    std::string tampered_signature = token;
+    tampered_signature.back() = tampered_signature.back() == '0' ? '1' : '0';
+    ASSERT_FALSE(sticky.Decode(tampered_signature).has_value());
+
+    // valid signature of one backend attached to id of another one
+    std::string other = sticky.Encode(TestBackends()[1]);
+    std::string swapped = other.substr(0, other.find('.')) + token.substr(token.find('.'));
+    ASSERT_FALSE(sticky.Decode(swapped).has_value());
+
+    ASSERT_FALSE(sticky.Decode("garbage").has_value());
+    ASSERT_FALSE(sticky.Decode(token.substr(1)).has_value());
+    ASSERT_FALSE(sticky.Decode(token + "0").has_value());
+
+    // signed for a backend that is not configured
+    lb::tcp::StickySessions wider({.secret = "secret"}, {lb::tcp::Backend("10.0.0.1", 80)});
+    ASSERT_FALSE(sticky.Decode(wider.Encode(lb::tcp::Backend("10.0.0.1", 80))).has_value());
+}
+
+TEST(StickySessions, configure)
+{
+    YAML::Node without = YAML::Load(R"(
+load_balancing:
+  algorithm: round_robin
+  endpoints:
+    - ip: "127.0.0.1"
+      port: 8081
+)");
+    ASSERT_EQ(lb::tcp::ConfigureStickySessions(without["load_balancing"]), nullptr);
+
+    YAML::Node with = YAML::Load(R"(
+load_balancing:
+  algorithm: round_robin
+  endpoints:
+    - ip: "127.0.0.1"
+      port: 8081
+    - ip: "127.0.0.1"
+      port: 8082
+  sticky:
+    cookie: "srv"
+    secret: "secret"
+    max_age: 3600
+)");
+    auto sticky = lb::tcp::ConfigureStickySessions(with["load_balancing"]);
+    ASSERT_NE(sticky, nullptr);
+    lb::tcp::Backend backend("127.0.0.1", 8082);
+    ASSERT_EQ(sticky->MakeSetCookie(backend),
+              "srv=" + sticky->Encode(backend) + "; Path=/; HttpOnly; Max-Age=3600");
+}
@@ -0,0 +1,61 @@
+#include <gtest/gtest.h>
+#include <lb/thread_pool.hpp>
+#include <yaml-cpp/yaml.h>
+
+
+TEST(ThreadPool, parseCpuList)
+{
+    ASSERT_EQ(lb::ParseCpuList("0"), lb::CpuList({0}));
+    ASSERT_EQ(lb::ParseCpuList("0-3"), lb::CpuList({0, 1, 2, 3}));
+    ASSERT_EQ(lb::ParseCpuList("8,0-2, 10-11"), lb::CpuList({0, 1, 2, 8, 10, 11}));
+    ASSERT_EQ(lb::ParseCpuList("1,1,0-1"), lb::CpuList({0, 1}));
+    ASSERT_THROW(lb::ParseCpuList("3-1"), std::runtime_error);
+    ASSERT_THROW(lb::ParseCpuList("a-b"), std::runtime_error);
+}
+
+TEST(ThreadPool, explicitCpus)
+{
+    YAML::Node config = YAML::Load(
+R"(thread_pool:
+  threads_number: auto
+  cpus: "0-1,4"
+  pin_threads: true
+)");
+
+    lb::ThreadPoolConfig tp = lb::ConfigureThreadPool(config);
+    ASSERT_EQ(tp.threads_number, 3);
+    ASSERT_EQ(tp.cpus, lb::CpuList({0, 1, 4}));
+    ASSERT_TRUE(tp.pin_threads);
+    ASSERT_FALSE(tp.numa_node.has_value());
+    ASSERT_EQ(tp.policy, lb::ThreadPoolConfig::SchedulingPolicy::DEFAULT);
+}
+
+TEST(ThreadPool, realtimeIsOptIn)
+{
+    YAML::Node config = YAML::Load(
+R"(thread_pool:
+  threads_number: 2
+)");
+    lb::ThreadPoolConfig tp = lb::ConfigureThreadPool(config);
+    ASSERT_EQ(tp.threads_number, 2);
+    ASSERT_TRUE(tp.cpus.empty());
+    ASSERT_EQ(tp.policy, lb::ThreadPoolConfig::SchedulingPolicy::DEFAULT);
+
+    config = YAML::Load(
+R"(thread_pool:
+  threads_number: 2
+  realtime:
+    policy: rr
+    priority: 5
+)");
+    tp = lb::ConfigureThreadPool(config);
+    ASSERT_EQ(tp.policy, lb::ThreadPoolConfig::SchedulingPolicy::ROUND_ROBIN);
+    ASSERT_EQ(tp.priority, 5);
+
+    config = YAML::Load(
+R"(thread_pool:
+  realtime:
+    policy: deadline
+)");
+    ASSERT_THROW(lb::ConfigureThreadPool(config), std::runtime_error);
+}
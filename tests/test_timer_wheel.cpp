@@ -0,0 +1,145 @@
+#include <lb/tcp/timer_wheel.hpp>
+#include <lb/tcp/timeouts.hpp>
+#include <gtest/gtest.h>
+
+#include <yaml-cpp/yaml.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+using lb::tcp::TimerWheel;
+
+namespace {
+
+struct Expiry {
+    TimerWheel* wheel;
+    std::vector<std::pair<int, std::uint64_t>>* fired; // timer id, tick
+    int id;
+};
+
+void RecordExpiry(void* context)
+{
+    auto* expiry = static_cast<Expiry*>(context);
+    expiry->fired->emplace_back(expiry->id, expiry->wheel->Now());
+}
+
+} // namespace
+
+TEST(TimerWheelTests, timersExpireAtTheirDeadlines)
+{
+    TimerWheel wheel;
+    std::vector<std::pair<int, std::uint64_t>> fired;
+    // deadlines on every level and on level boundaries
+    const std::vector<std::uint64_t> deadlines = {1, 5, 63, 64, 65, 200, 4095, 4096, 5000, 262143, 262144, 300000};
+    std::vector<std::unique_ptr<Expiry>> contexts;
+    std::vector<std::unique_ptr<TimerWheel::Timer>> timers;
+    for (std::size_t i = 0; i < deadlines.size(); ++i) {
+        contexts.push_back(std::make_unique<Expiry>(Expiry{&wheel, &fired, static_cast<int>(i)}));
+        timers.push_back(std::make_unique<TimerWheel::Timer>(&RecordExpiry, contexts.back().get()));
+    }
+    // scheduled in reverse to check ordering does not depend on it
+    for (std::size_t i = deadlines.size(); i-- > 0;) {
+        wheel.Schedule(*timers[i], deadlines[i]);
+    }
+    ASSERT_EQ(wheel.Size(), deadlines.size());
+
+    for (std::uint64_t now = 0; now <= 300000; now += 7) {
+        wheel.Advance(now);
+    }
+    wheel.Advance(300000);
+    ASSERT_EQ(wheel.Size(), 0);
+    ASSERT_EQ(fired.size(), deadlines.size());
+    for (std::size_t i = 0; i < fired.size(); ++i) {
+        EXPECT_EQ(fired[i].first, static_cast<int>(i));
+        EXPECT_EQ(fired[i].second, deadlines[i]);
+    }
+}
+
+TEST(TimerWheelTests, cancelAndReschedule)
+{
+    TimerWheel wheel;
+    std::vector<std::pair<int, std::uint64_t>> fired;
+    Expiry first_context{&wheel, &fired, 1};
+    Expiry second_context{&wheel, &fired, 2};
+    TimerWheel::Timer first(&RecordExpiry, &first_context);
+    TimerWheel::Timer second(&RecordExpiry, &second_context);
+
+    wheel.Schedule(first, 100);
+    wheel.Schedule(second, 100);
+    const std::uint64_t generation = first.Generation();
+    wheel.Cancel(first);
+    ASSERT_FALSE(first.IsArmed());
+    ASSERT_NE(first.Generation(), generation);
+    wheel.Schedule(second, 5000);
+    ASSERT_EQ(wheel.Size(), 1);
+
+    wheel.Advance(4999);
+    ASSERT_TRUE(fired.empty());
+    wheel.Advance(5000);
+    ASSERT_EQ(fired.size(), 1);
+    ASSERT_EQ(fired[0].first, 2);
+    ASSERT_EQ(fired[0].second, 5000);
+    ASSERT_FALSE(second.IsArmed());
+}
+
+TEST(TimerWheelTests, deadlinesAreClamped)
+{
+    TimerWheel wheel;
+    std::vector<std::pair<int, std::uint64_t>> fired;
+    Expiry past_context{&wheel, &fired, 1};
+    Expiry far_context{&wheel, &fired, 2};
+    TimerWheel::Timer past(&RecordExpiry, &past_context);
+    TimerWheel::Timer far(&RecordExpiry, &far_context);
+
+    wheel.Advance(1000);
+    wheel.Schedule(past, 10);
+    wheel.Schedule(far, UINT64_MAX);
+    wheel.Advance(1001);
+    ASSERT_EQ(fired.size(), 1);
+    ASSERT_EQ(fired[0].second, 1001);
+
+    wheel.Advance(1000 + TimerWheel::kMaxDelay);
+    ASSERT_EQ(fired.size(), 2);
+    ASSERT_EQ(fired[1].second, 1000 + TimerWheel::kMaxDelay);
+}
+
+TEST(TimerWheelTests, callbackMayScheduleAgain)
+{
+    struct Periodic {
+        TimerWheel wheel;
+        std::unique_ptr<TimerWheel::Timer> timer;
+        int expirations = 0;
+    } periodic;
+    periodic.timer = std::make_unique<TimerWheel::Timer>([](void* context) {
+        auto* periodic = static_cast<Periodic*>(context);
+        if (++periodic->expirations < 3) {
+            periodic->wheel.Schedule(*periodic->timer, periodic->wheel.Now() + 100);
+        }
+    }, &periodic);
+
+    periodic.wheel.Schedule(*periodic.timer, 100);
+    periodic.wheel.Advance(1000);
+    ASSERT_EQ(periodic.expirations, 3);
+    ASSERT_EQ(periodic.wheel.Size(), 0);
+}
+
+TEST(TimerWheelTests, configureTimeouts)
+{
+    lb::tcp::SessionTimeouts defaults = lb::tcp::ConfigureTimeouts(YAML::Load("acceptor: {port: 9090}"));
+    ASSERT_EQ(defaults.idle.count(), 60000);
+    ASSERT_EQ(defaults.connect.count(), 5000);
+
+    lb::tcp::SessionTimeouts timeouts = lb::tcp::ConfigureTimeouts(YAML::Load(R"(
+timeouts:
+  idle_ms: 0
+  header_read_ms: 250
+  first_byte_ms: 1000
+)"));
+    ASSERT_EQ(timeouts.Of(lb::tcp::TimeoutPhase::IDLE).count(), 0);
+    ASSERT_EQ(timeouts.Of(lb::tcp::TimeoutPhase::HEADER_READ).count(), 250);
+    ASSERT_EQ(timeouts.Of(lb::tcp::TimeoutPhase::BODY_READ).count(), 30000);
+    ASSERT_EQ(timeouts.Of(lb::tcp::TimeoutPhase::FIRST_BYTE).count(), 1000);
+
+    ASSERT_ANY_THROW(lb::tcp::ConfigureTimeouts(YAML::Load("timeouts: 5")));
+}
@@ -0,0 +1,300 @@
+#include <gtest/gtest.h>
+#include <lb/metrics.hpp>
+#include <lb/tcp/tls.hpp>
+#include <yaml-cpp/yaml.h>
+
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+namespace asio = boost::asio;
+namespace fs = std::filesystem;
+
+namespace {
+
+// Self-signed P-256 certificate for localhost and its key
+struct TestCertificate {
+    fs::path certificate = fs::temp_directory_path() / "lb2_test_tls_cert.pem";
+    fs::path private_key = fs::temp_directory_path() / "lb2_test_tls_key.pem";
+
+    TestCertificate()
+    {
+        EVP_PKEY* key = EVP_EC_gen("P-256");
+        X509* cert = X509_new();
+        X509_set_version(cert, 2);
+        ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+        X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+        X509_gmtime_adj(X509_getm_notAfter(cert), 24 * 3600);
+        X509_set_pubkey(cert, key);
+        X509_NAME* name = X509_get_subject_name(cert);
+        X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>("localhost"),
+                                   -1, -1, 0);
+        X509_set_issuer_name(cert, name);
+        X509_sign(cert, key, EVP_sha256());
+
+        FILE* file = std::fopen(certificate.c_str(), "w");
+        PEM_write_X509(file, cert);
+        std::fclose(file);
+        file = std::fopen(private_key.c_str(), "w");
+        PEM_write_PrivateKey(file, key, nullptr, nullptr, 0, nullptr, nullptr);
+        std::fclose(file);
+        X509_free(cert);
+        EVP_PKEY_free(key);
+    }
+
+    ~TestCertificate()
+    {
+        fs::remove(certificate);
+        fs::remove(private_key);
+    }
+
+    lb::tcp::TlsTerminator::Configuration Config() const
+    {
+        lb::tcp::TlsTerminator::Configuration config;
+        config.certificate = certificate;
+        config.private_key = private_key;
+        return config;
+    }
+};
+
+// Accepts connections and runs their handshakes until count are done. With
+// answer set it reads plaintext of a handshaken connection once and answers
+// "pong".
+class HandshakeServer {
+public:
+    HandshakeServer(lb::tcp::TlsTerminator& terminator, std::size_t count, bool answer = false)
+        : terminator_(terminator)
+        , acceptor_(asio::make_strand(ioc_), {asio::ip::address_v4::loopback(), 0})
+        , endpoint_(acceptor_.local_endpoint())
+        , count_(count)
+        , answer_(answer)
+    {
+        Accept();
+        thread_ = std::thread([this] { ioc_.run(); });
+    }
+
+    ~HandshakeServer()
+    {
+        ioc_.stop();
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    const asio::ip::tcp::endpoint& Endpoint() const
+    {
+        return endpoint_;
+    }
+
+    std::vector<boost::system::error_code> Results()
+    {
+        thread_.join();
+        return results_;
+    }
+
+    // Plaintext read by answering connections, valid after Results()
+    const std::string& Received() const
+    {
+        return received_;
+    }
+private:
+    void Accept()
+    {
+        acceptor_.async_accept(asio::make_strand(ioc_), [this](const boost::system::error_code& ec,
+                                                               lb::tcp::SocketType socket) {
+            ASSERT_FALSE(ec);
+            terminator_.AsyncHandshake(std::move(socket), [this](const boost::system::error_code& ec,
+                                                                 lb::tcp::SocketType socket) {
+                results_.push_back(ec);
+                if (!ec && answer_) {
+                    Answer(std::make_shared<lb::tcp::SocketType>(std::move(socket)));
+                }
+            });
+            if (++accepted_ < count_) {
+                Accept();
+            }
+        });
+    }
+
+    void Answer(std::shared_ptr<lb::tcp::SocketType> socket)
+    {
+        socket->async_read_some(asio::buffer(buffer_), [this, socket](const boost::system::error_code& ec,
+                                                                      std::size_t size) {
+            ASSERT_FALSE(ec);
+            received_.append(buffer_.data(), size);
+            asio::async_write(*socket, asio::buffer(std::string_view("pong")),
+                              [socket](const boost::system::error_code& ec, std::size_t) {
+                                  ASSERT_FALSE(ec);
+                              });
+        });
+    }
+private:
+    lb::tcp::TlsTerminator& terminator_;
+    asio::io_context ioc_;
+    asio::basic_socket_acceptor<asio::ip::tcp, lb::tcp::ExecutorType> acceptor_;
+    const asio::ip::tcp::endpoint endpoint_;
+    const std::size_t count_;
+    const bool answer_;
+    std::size_t accepted_ = 0;
+    std::vector<boost::system::error_code> results_; // in order of completion
+    std::array<char, 64> buffer_;
+    std::string received_;
+    std::thread thread_;
+};
+
+} // anonymous namespace
+
+TEST(Tls, handshakeResumesSessions)
+{
+    TestCertificate certificate;
+    auto& handshakes = lb::metrics::Registry::Instance().GetCounter("tls.handshakes");
+    auto& resumed = lb::metrics::Registry::Instance().GetCounter("tls.resumed");
+
+    // by ticket, then by session id from the server's cache
+    for (bool tickets : {true, false}) {
+        lb::tcp::TlsTerminator::Configuration config = certificate.Config();
+        config.session_tickets = tickets;
+        lb::tcp::TlsTerminator terminator(config);
+        const std::uint64_t handshakes_before = handshakes.Value();
+        const std::uint64_t resumed_before = resumed.Value();
+
+        HandshakeServer server(terminator, 2);
+        asio::io_context ioc;
+        asio::ssl::context client(asio::ssl::context::tls_client);
+        SSL_SESSION* session = nullptr;
+        for (int i = 0; i < 2; ++i) {
+            asio::ssl::stream<asio::ip::tcp::socket> stream(ioc, client);
+            stream.next_layer().connect(server.Endpoint());
+            if (session) {
+                SSL_set_session(stream.native_handle(), session);
+            }
+            stream.handshake(asio::ssl::stream_base::client);
+            ASSERT_EQ(SSL_session_reused(stream.native_handle()) == 1, session != nullptr);
+            ASSERT_EQ(SSL_version(stream.native_handle()), TLS1_2_VERSION);
+            if (!session) {
+                session = SSL_get1_session(stream.native_handle());
+                ASSERT_EQ(SSL_SESSION_has_ticket(session) == 1, tickets);
+            }
+            // Server goes on without close_notify, freeing the stream must not spoil the session
+            SSL_set_shutdown(stream.native_handle(), SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+        }
+        SSL_SESSION_free(session);
+
+        ASSERT_EQ(server.Results(), std::vector<boost::system::error_code>(2));
+        ASSERT_EQ(handshakes.Value() - handshakes_before, 2);
+        ASSERT_EQ(resumed.Value() - resumed_before, 1);
+    }
+}
+
+TEST(Tls, plaintextRoundTripAfterHandover)
+{
+    TestCertificate certificate;
+    auto& relayed = lb::metrics::Registry::Instance().GetCounter("tls.relayed");
+
+    // kTLS where the kernel has it, then userspace relay
+    for (lb::tcp::KtlsMode mode : {lb::tcp::KtlsMode::AUTO, lb::tcp::KtlsMode::OFF}) {
+        lb::tcp::TlsTerminator::Configuration config = certificate.Config();
+        config.ktls = mode;
+        lb::tcp::TlsTerminator terminator(config);
+        const std::uint64_t relayed_before = relayed.Value();
+
+        HandshakeServer server(terminator, 1, true);
+        asio::io_context ioc;
+        asio::ssl::context client(asio::ssl::context::tls_client);
+        {
+            asio::ssl::stream<asio::ip::tcp::socket> stream(ioc, client);
+            stream.next_layer().connect(server.Endpoint());
+            stream.handshake(asio::ssl::stream_base::client);
+            asio::write(stream, asio::buffer(std::string_view("ping")));
+            std::string answer(4, '\0');
+            asio::read(stream, asio::buffer(answer));
+            ASSERT_EQ(answer, "pong");
+        }
+
+        ASSERT_EQ(server.Results(), std::vector<boost::system::error_code>(1));
+        ASSERT_EQ(server.Received(), "ping");
+        const bool offloaded = mode == lb::tcp::KtlsMode::AUTO && terminator.UserspaceCiphers().empty();
+        ASSERT_EQ(relayed.Value() - relayed_before, offloaded ? 0 : 1);
+    }
+}
+
+TEST(Tls, requiredKernelTlsIsCheckedAtStartup)
+{
+    TestCertificate certificate;
+    lb::tcp::TlsTerminator::Configuration config = certificate.Config();
+    config.ktls = lb::tcp::KtlsMode::OFF;
+    ASSERT_FALSE(lb::tcp::TlsTerminator(config).UserspaceCiphers().empty());
+
+    config.ktls = lb::tcp::KtlsMode::REQUIRED;
+    config.ciphers = "ECDHE+AESGCM:ECDHE-ECDSA-AES128-SHA256"; // CBC is never offloaded
+    ASSERT_THROW(lb::tcp::TlsTerminator terminator(config), std::runtime_error);
+    if (!lb::tcp::KernelTlsAvailable()) {
+        config.ciphers = lb::tcp::TlsTerminator::Configuration().ciphers;
+        ASSERT_THROW(lb::tcp::TlsTerminator terminator(config), std::runtime_error);
+    }
+}
+
+TEST(Tls, handshakeTimesOut)
+{
+    TestCertificate certificate;
+    lb::tcp::TlsTerminator::Configuration config = certificate.Config();
+    config.handshake_timeout = 20ms;
+    lb::tcp::TlsTerminator terminator(config);
+
+    HandshakeServer server(terminator, 1);
+    asio::io_context ioc;
+    asio::ip::tcp::socket silent(ioc);
+    silent.connect(server.Endpoint());
+    ASSERT_EQ(server.Results(), std::vector<boost::system::error_code>{asio::error::timed_out});
+}
+
+TEST(Tls, configure)
+{
+    TestCertificate certificate;
+    const YAML::Node acceptor = YAML::Load("port: 9090");
+    ASSERT_EQ(lb::tcp::ConfigureTls(acceptor), nullptr);
+
+    YAML::Node node = YAML::Clone(acceptor);
+    node["tls"]["certificate"] = certificate.certificate.string();
+    ASSERT_THROW(lb::tcp::ConfigureTls(node), std::runtime_error);
+
+    node["tls"]["private_key"] = certificate.private_key.string();
+    node["tls"]["session_cache_size"] = 0;
+    node["tls"]["handshake_timeout_ms"] = 500;
+    lb::tcp::TlsTerminatorPtr terminator = lb::tcp::ConfigureTls(node);
+    ASSERT_NE(terminator, nullptr);
+    ASSERT_EQ(terminator->Config().session_cache_size, 0);
+    ASSERT_EQ(terminator->Config().handshake_timeout, 500ms);
+    ASSERT_TRUE(terminator->Config().session_tickets);
+    ASSERT_EQ(terminator->Config().ktls, lb::tcp::KtlsMode::AUTO);
+
+    YAML::Node ktls = YAML::Clone(node);
+    ktls["tls"]["ktls"] = "off";
+    ASSERT_EQ(lb::tcp::ConfigureTls(ktls)->Config().ktls, lb::tcp::KtlsMode::OFF);
+    ktls["tls"]["ktls"] = "sometimes";
+    ASSERT_THROW(lb::tcp::ConfigureTls(ktls), std::runtime_error);
+
+    YAML::Node ciphers = YAML::Clone(node);
+    ciphers["tls"]["ciphers"] = "NO-SUCH-CIPHER";
+    ASSERT_THROW(lb::tcp::ConfigureTls(ciphers), std::runtime_error);
+
+    YAML::Node keys = YAML::Clone(node);
+    keys["tls"]["ticket_key_file"] = certificate.private_key.string(); // not 80 bytes
+    ASSERT_THROW(lb::tcp::ConfigureTls(keys), std::runtime_error);
+
+    YAML::Node missing = YAML::Clone(node);
+    missing["tls"]["certificate"] = "/nonexistent/cert.pem";
+    ASSERT_THROW(lb::tcp::ConfigureTls(missing), std::runtime_error);
+}
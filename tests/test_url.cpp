@@ -1,5 +1,6 @@
 #include <lb/url.hpp>
 #include <gtest/gtest.h>
+#include <type_traits>
 
 
 TEST(UrlTests, multiple)
@@ -7,7 +8,7 @@ TEST(UrlTests, multiple)
     lb::Url url("https://www.example.co.uk:443/blog/article/search?docid=720&hl=en#dayone");
     ASSERT_EQ(url.Protocol(), "https");
     ASSERT_EQ(url.Hostname(), "www.example.co.uk");
-    ASSERT_EQ(url.Port(), "443");
+    ASSERT_EQ(url.Port(), 443);
     ASSERT_EQ(url.Path(), "/blog/article/search");
     ASSERT_EQ(url.Query(), "docid=720&hl=en");
     ASSERT_EQ(url.Fragment(), "dayone");
@@ -18,7 +19,7 @@ TEST(UrlTests, multipleNoPort)
     lb::Url url("https://www.example.co.uk/blog/article/search?docid=720&hl=en#dayone");
     ASSERT_EQ(url.Protocol(), "https");
     ASSERT_EQ(url.Hostname(), "www.example.co.uk");
-    ASSERT_EQ(url.Port(), "443");
+    ASSERT_EQ(url.Port(), 443);
     ASSERT_EQ(url.Path(), "/blog/article/search");
     ASSERT_EQ(url.Query(), "docid=720&hl=en");
     ASSERT_EQ(url.Fragment(), "dayone");
@@ -29,7 +30,7 @@ TEST(UrlTests, noPort)
     lb::Url url("https://www.example.co.uk/blog/article/search?docid=720&hl=en#dayone");
     ASSERT_EQ(url.Protocol(), "https");
     ASSERT_EQ(url.Hostname(), "www.example.co.uk");
-    ASSERT_EQ(url.Port(), "443");
+    ASSERT_EQ(url.Port(), 443);
     ASSERT_EQ(url.Path(), "/blog/article/search");
     ASSERT_EQ(url.Query(), "docid=720&hl=en");
     ASSERT_EQ(url.Fragment(), "dayone");
@@ -39,7 +40,7 @@ TEST(UrlTests, noQuery)
     lb::Url url("https://www.example.co.uk/blog/article/search#dayone");
     ASSERT_EQ(url.Protocol(), "https");
     ASSERT_EQ(url.Hostname(), "www.example.co.uk");
-    ASSERT_EQ(url.Port(), "443");
+    ASSERT_EQ(url.Port(), 443);
     ASSERT_EQ(url.Path(), "/blog/article/search");
     ASSERT_EQ(url.Query(), "");
     ASSERT_EQ(url.Fragment(), "dayone");
@@ -50,8 +51,50 @@ TEST(UrlTests, noPath)
     lb::Url url("https://www.example.co.uk/blog/article/search?docid=720&hl=en");
     ASSERT_EQ(url.Protocol(), "https");
     ASSERT_EQ(url.Hostname(), "www.example.co.uk");
-    ASSERT_EQ(url.Port(), "443");
+    ASSERT_EQ(url.Port(), 443);
     ASSERT_EQ(url.Path(), "/blog/article/search");
     ASSERT_EQ(url.Query(), "docid=720&hl=en");
     ASSERT_EQ(url.Fragment(), "");
-}
\ No newline at end of file
+}
+
+TEST(UrlTests, portAndProtocol)
+{
+    lb::Url url("http://backend.local:8080/api?x=1#top");
+    ASSERT_EQ(url.Protocol(), "http");
+    ASSERT_EQ(url.ProtocolType(), lb::UrlProtocol::HTTP);
+    ASSERT_EQ(url.Hostname(), "backend.local");
+    ASSERT_EQ(url.Port(), 8080);
+    ASSERT_EQ(url.Path(), "/api");
+    ASSERT_EQ(url.Query(), "x=1");
+    ASSERT_EQ(url.Fragment(), "top");
+    ASSERT_EQ(url.ToString(), "http://backend.local:8080/api?x=1#top");
+
+    lb::Url no_protocol("backend.local");
+    ASSERT_EQ(no_protocol.Protocol(), "http");
+    ASSERT_EQ(no_protocol.ProtocolType(), lb::UrlProtocol::HTTP);
+    ASSERT_EQ(no_protocol.Port(), 80);
+    ASSERT_EQ(no_protocol.Path(), "");
+
+    lb::Url custom("redis://cache.local:6379");
+    ASSERT_EQ(custom.Protocol(), "redis");
+    ASSERT_EQ(custom.ProtocolType(), lb::UrlProtocol::OTHER);
+    ASSERT_EQ(custom.Port(), 6379);
+
+    ASSERT_THROW(lb::Url("redis://cache.local"), std::runtime_error);
+    ASSERT_THROW(lb::Url("http://backend.local:99999"), std::runtime_error);
+}
+
+TEST(UrlTests, copy)
+{
+    static_assert(std::is_trivially_copyable_v<lb::Url>);
+
+    std::string text = "https://www.example.com/path";
+    lb::Url url(text);
+    text.assign("garbage");
+
+    lb::Url copy = url;
+    ASSERT_EQ(copy.Hostname(), "www.example.com");
+    ASSERT_EQ(copy, url);
+    ASSERT_EQ(lb::Url("https://www.example.com/path"), url);
+    ASSERT_FALSE(lb::Url("https://www.example.com/other") == url);
+}